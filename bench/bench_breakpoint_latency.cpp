@@ -0,0 +1,128 @@
+// Measures how long the debugger takes from a breakpoint being hit to showing
+// the prompt again, by driving the debugger through pipes as a user would.
+// The target prints the time just before calling the function with the
+// breakpoint, and the latency is the time from then until the prompt is read.
+//
+// Usage: bench_breakpoint_latency [iterations] [driver] [target]
+//
+// |driver| and |target| default to the ones built alongside the benchmark.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::string_view prompt = "smldbg >> ";
+
+int64_t now_ns() {
+    timespec clock_time;
+    clock_gettime(CLOCK_MONOTONIC, &clock_time);
+    return clock_time.tv_sec * 1000000000LL + clock_time.tv_nsec;
+}
+
+// Read from |fd| into |pending| until the prompt turns up, and return the
+// output before it. Returns std::nullopt if the debugger exits first.
+std::optional<std::string> read_to_prompt(int fd, std::string& pending) {
+    while (true) {
+        if (const auto found = pending.find(prompt);
+            found != std::string::npos) {
+            std::string output = pending.substr(0, found);
+            pending.erase(0, found + prompt.size());
+            return output;
+        }
+        char buffer[4096];
+        const ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size <= 0)
+            return std::nullopt;
+        pending.append(buffer, size);
+    }
+}
+
+bool send(int fd, std::string_view command) {
+    return write(fd, command.data(), command.size()) ==
+           static_cast<ssize_t>(command.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const std::string driver = argc > 2 ? argv[2] : SMLDBG_DRIVER;
+    const std::string target = argc > 3 ? argv[3] : SMLDBG_LATENCY_TARGET;
+
+    // Run the debugger with pipes for its input and output. The target
+    // inherits the output pipe.
+    int input[2];
+    int output[2];
+    if (pipe(input) == -1 || pipe(output) == -1) {
+        std::cerr << "pipe() failed.\n";
+        return 1;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        close(input[1]);
+        close(output[0]);
+        execl(driver.c_str(), driver.c_str(), target.c_str(), nullptr);
+        std::exit(1);
+    }
+    close(input[0]);
+    close(output[1]);
+
+    std::string pending;
+    if (!read_to_prompt(output[0], pending) || !send(input[1], "start\n") ||
+        !read_to_prompt(output[0], pending) ||
+        !send(input[1], "break breakpoint_here\n") ||
+        !read_to_prompt(output[0], pending)) {
+        std::cerr << "Unable to start " << target << " with " << driver
+                  << ".\n";
+        return 1;
+    }
+
+    std::vector<double> latencies;
+    for (int i = 0; i < iterations; ++i) {
+        if (!send(input[1], "cont\n"))
+            break;
+        const std::optional<std::string> stop =
+            read_to_prompt(output[0], pending);
+        const int64_t prompted = now_ns();
+        if (!stop)
+            break;
+        const auto time = stop->rfind('@');
+        if (time == std::string::npos ||
+            stop->find("Hit breakpoint", time) == std::string::npos)
+            continue;
+        const int64_t hit = std::atoll(stop->c_str() + time + 1);
+        latencies.push_back(static_cast<double>(prompted - hit) / 1000);
+    }
+    send(input[1], "quit\n");
+    close(input[1]);
+    waitpid(pid, nullptr, 0);
+
+    if (latencies.empty()) {
+        std::cerr << "No breakpoint hits were measured.\n";
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double fraction) {
+        return latencies[static_cast<std::size_t>(fraction *
+                                                  (latencies.size() - 1))];
+    };
+    std::cout << "Measured " << latencies.size()
+              << " breakpoint hits, hit to prompt latency in us:\n";
+    std::cout << "min " << latencies.front() << ", median " << percentile(0.5)
+              << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99)
+              << ", max " << latencies.back() << "\n";
+    return static_cast<int>(latencies.size()) == iterations ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+// Measures the throughput of the x86-64 decoder used for range stepping, by
+// repeatedly decoding the .text section of an ELF file.
+//
+// Usage: bench_x86_decoder [path] [iterations]
+//
+// |path| defaults to the benchmark itself.
+
+#include "elf.h"
+#include "x86_decoder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace smldbg;
+
+// Decode every instruction of |text|, skipping bytes that don't decode (e.g.
+// padding or data in the code section). Returns the number of instructions.
+std::size_t decode_text(std::span<const uint8_t> text, uint64_t address) {
+    std::size_t count = 0;
+    std::size_t offset = 0;
+    while (offset < text.size()) {
+        const std::vector<x86::Instruction> instructions =
+            x86::decode_all(text.subspan(offset), address + offset);
+        count += instructions.size();
+        if (!instructions.empty())
+            offset = instructions.back().address +
+                     instructions.back().length - address;
+        // Skip the byte that stopped decoding.
+        if (offset < text.size())
+            ++offset;
+    }
+    return count;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string path = argc > 1 ? argv[1] : "/proc/self/exe";
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    elf::ELF elf(path);
+    const elf::ELFSection section = elf.get_section_data(".text");
+    if (!section.data) {
+        std::cerr << "No .text section in " << path << ".\n";
+        return 1;
+    }
+    const std::span<const uint8_t> text(
+        reinterpret_cast<const uint8_t*>(section.data), section.size);
+
+    // Warm up, and count the instructions once.
+    const std::size_t instructions = decode_text(text, 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t total = 0;
+    for (int i = 0; i < iterations; ++i)
+        total += decode_text(text, 0);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const double seconds = elapsed.count();
+    const double bytes = static_cast<double>(text.size()) * iterations;
+    std::cout << "Decoded " << instructions << " instructions ("
+              << text.size() << " bytes) " << iterations << " times in "
+              << seconds * 1000 << " ms.\n";
+    std::cout << bytes / seconds / 1e6 << " MB/s, "
+              << static_cast<double>(total) / seconds / 1e6
+              << " M instructions/s.\n";
+    return total == instructions * iterations ? 0 : 1;
+}
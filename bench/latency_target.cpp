@@ -0,0 +1,26 @@
+// Target for bench_breakpoint_latency. Forever prints the time, then calls a
+// function for the benchmark to break on.
+
+#include <cstdio>
+#include <ctime>
+
+#include <unistd.h>
+
+void breakpoint_here() {}
+
+int main() {
+    while (true) {
+        // Written straight to the pipe, so that the time is read before the
+        // breakpoint is hit.
+        timespec clock_time;
+        clock_gettime(CLOCK_MONOTONIC, &clock_time);
+        char buffer[64];
+        const long long nanoseconds =
+            clock_time.tv_sec * 1000000000LL + clock_time.tv_nsec;
+        const int length =
+            std::snprintf(buffer, sizeof(buffer), "@%lld\n", nanoseconds);
+        if (write(STDOUT_FILENO, buffer, length) != length)
+            return 1;
+        breakpoint_here();
+    }
+}
@@ -0,0 +1,77 @@
+#include "abbreviation_table.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+namespace smldbg::dwarf {
+
+AbbreviationTable::AbbreviationTable(char* debug_abbrev,
+                                     const FormContext& context) {
+    // Section 7.5.3
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    std::vector<std::pair<uint64_t, AbbreviationTableEntry>> decoded;
+    char* iter = debug_abbrev;
+    while (true) {
+        // Decode the code of the current entry. A null code indicates we have
+        // reached the end of the abbreviation table for the compile unit.
+        const uint64_t code = util::decodeULEB128(iter);
+        if (code == 0)
+            break;
+
+        AbbreviationTableEntry ate = {};
+        ate.tag = static_cast<DW_TAG>(util::decodeULEB128(iter));
+
+        // Does this tag have any children or is the next entry a sibling?
+        ate.has_children =
+            static_cast<DW_CHLIDREN>(util::read_bytes<char>(iter));
+
+        // Decode the tags attributes and their forms. A null entry for both
+        // the attribute and form indicate we have reached the end of the
+        // current table entry.
+        DW_AT att = static_cast<DW_AT>(util::decodeULEB128(iter));
+        DW_FORM form = static_cast<DW_FORM>(util::decodeULEB128(iter));
+        while (att != DW_AT::DW_AT_null && form != DW_FORM::DW_FORM_null) {
+            // DW_FORM_implicit_const attributes carry their value here.
+            if (form == DW_FORM::DW_FORM_implicit_const) {
+                ate.implicit_consts.resize(ate.attributes.size() + 1);
+                ate.implicit_consts.back() = util::decodeLEB128(iter);
+            }
+            ate.attributes.push_back(att);
+            ate.forms.push_back(form);
+            att = static_cast<DW_AT>(util::decodeULEB128(iter));
+            form = static_cast<DW_FORM>(util::decodeULEB128(iter));
+        }
+        if (!ate.implicit_consts.empty())
+            ate.implicit_consts.resize(ate.attributes.size());
+
+        ate.fixed_offsets.push_back(0);
+        for (const DW_FORM form : ate.forms) {
+            const std::optional<uint64_t> size =
+                Attribute::fixed_size(form, context);
+            if (!size)
+                break;
+            ate.fixed_offsets.push_back(ate.fixed_offsets.back() + *size);
+        }
+
+        decoded.emplace_back(code, std::move(ate));
+    }
+
+    // Size the dense table to cover every code, unless the codes are too
+    // sparse for that to be sensible.
+    uint64_t max_code = 0;
+    for (const auto& [code, ate] : decoded)
+        max_code = std::max(max_code, code);
+    const uint64_t dense_size =
+        max_code <= 2 * decoded.size() + 64 ? max_code + 1 : 0;
+
+    m_entries.resize(dense_size, m_null_entry);
+    for (auto& [code, ate] : decoded) {
+        if (code < dense_size)
+            m_entries[code] = std::move(ate);
+        else
+            m_sparse_entries.emplace(code, std::move(ate));
+    }
+}
+
+} // namespace smldbg::dwarf
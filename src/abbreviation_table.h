@@ -0,0 +1,149 @@
+#pragma once
+
+#include "attribute.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+// Section 7
+// http://www.dwarfstd.org/doc/DWARF4.pdf
+enum class DW_TAG {
+    DW_TAG_null = 0x0,
+    DW_TAG_array_type = 0x01,
+    DW_TAG_class_type = 0x02,
+    DW_TAG_entry_point = 0x03,
+    DW_TAG_enumeration_type = 0x04,
+    DW_TAG_formal_parameter = 0x05,
+    DW_TAG_imported_declaration = 0x08,
+    DW_TAG_label = 0x0a,
+    DW_TAG_lexical_block = 0x0b,
+    DW_TAG_member = 0x0d,
+    DW_TAG_pointer_type = 0x0f,
+    DW_TAG_reference_type = 0x10,
+    DW_TAG_compile_unit = 0x11,
+    DW_TAG_string_type = 0x12,
+    DW_TAG_structure_type = 0x13,
+    DW_TAG_subroutine_type = 0x15,
+    DW_TAG_typedef = 0x16,
+    DW_TAG_union_type = 0x17,
+    DW_TAG_unspecified_parameters = 0x18,
+    DW_TAG_variant = 0x19,
+    DW_TAG_common_block = 0x1a,
+    DW_TAG_common_inclusion = 0x1b,
+    DW_TAG_inheritance = 0x1c,
+    DW_TAG_inlined_subroutine = 0x1d,
+    DW_TAG_module = 0x1e,
+    DW_TAG_ptr_to_member_type = 0x1f,
+    DW_TAG_set_type = 0x20,
+    DW_TAG_subrange_type = 0x21,
+    DW_TAG_with_stmt = 0x22,
+    DW_TAG_access_declaration = 0x23,
+    DW_TAG_base_type = 0x24,
+    DW_TAG_catch_block = 0x25,
+    DW_TAG_const_type = 0x26,
+    DW_TAG_constant = 0x27,
+    DW_TAG_enumerator = 0x28,
+    DW_TAG_file_type = 0x29,
+    DW_TAG_friend = 0x2a,
+    DW_TAG_namelist = 0x2b,
+    DW_TAG_namelist_item = 0x2c,
+    DW_TAG_packed_type = 0x2d,
+    DW_TAG_subprogram = 0x2e,
+    DW_TAG_template_type_parameter = 0x2f,
+    DW_TAG_template_value_parameter = 0x30,
+    DW_TAG_thrown_type = 0x31,
+    DW_TAG_try_block = 0x32,
+    DW_TAG_variant_part = 0x33,
+    DW_TAG_variable = 0x34,
+    DW_TAG_volatile_type = 0x35,
+    DW_TAG_dwarf_procedure = 0x36,
+    DW_TAG_restrict_type = 0x37,
+    DW_TAG_interface_type = 0x38,
+    DW_TAG_namespace = 0x39,
+    DW_TAG_imported_module = 0x3a,
+    DW_TAG_unspecified_type = 0x3b,
+    DW_TAG_partial_unit = 0x3c,
+    DW_TAG_imported_unit = 0x3d,
+    DW_TAG_condition = 0x3f,
+    DW_TAG_shared_type = 0x40,
+    DW_TAG_type_unit = 0x41,
+    DW_TAG_rvalue_reference_type = 0x42,
+    DW_TAG_template_alias = 0x43,
+    DW_TAG_call_site = 0x48,
+    DW_TAG_call_site_parameter = 0x49,
+    DW_TAG_lo_user = 0x4080,
+    DW_TAG_GNU_call_site = 0x4109,
+    DW_TAG_GNU_call_site_parameter = 0x410a,
+    DW_TAG_hi_user = 0xffff,
+};
+
+// Section 7
+// http://www.dwarfstd.org/doc/DWARF4.pdf
+enum class DW_CHLIDREN {
+    DW_CHILDREN_no = 0x00,
+    DW_CHILDREN_yes = 0x01,
+};
+
+// A single decoded .debug_abbrev entry. Entries are owned by an
+// AbbreviationTable and shared by every DIE using the same abbreviation code.
+struct AbbreviationTableEntry {
+    DW_TAG tag;
+    DW_CHLIDREN has_children;
+    std::vector<DW_AT> attributes;
+    std::vector<DW_FORM> forms;
+
+    // The value of each DW_FORM_implicit_const attribute, which is held by
+    // the abbreviation rather than the entry. Indexed like |attributes|, and
+    // empty if there are none.
+    std::vector<int64_t> implicit_consts;
+
+    // Where the data of each attribute starts, relative to the data of the
+    // first, for as long as the forms before it have a fixed size. Entries
+    // whose forms all have a fixed size (most of them) are skipped with a
+    // single addition: the last element is then the size of the entry's data.
+    std::vector<uint32_t> fixed_offsets;
+};
+
+class AbbreviationTable {
+public:
+    // Decode the abbreviation table of a compile unit. |context| is the form
+    // context of the unit, which the size of section offsets and addresses
+    // depends on.
+    //
+    // Preconditions: |debug_abbrev| should point to the first byte of the
+    // .debug_abbrev entry for the compile unit.
+    //
+    // Postconditions: None. The table does not reference |debug_abbrev| after
+    // construction.
+    AbbreviationTable(char* debug_abbrev, const FormContext& context);
+
+    // Return the entry for abbreviation |code|. If the table doesn't contain
+    // an entry for |code| (including the null code 0), an entry with
+    // DW_TAG_null and no attributes is returned.
+    const AbbreviationTableEntry* entry(uint64_t code) const {
+        if (code < m_entries.size())
+            return &m_entries[code];
+        if (const auto sparse = m_sparse_entries.find(code);
+            sparse != m_sparse_entries.end())
+            return &sparse->second;
+        return &m_null_entry;
+    }
+
+private:
+    // Codes are normally assigned densely from 1, so entries are indexed
+    // directly by code. The rare producer that uses large, sparse codes falls
+    // back to |m_sparse_entries|.
+    std::vector<AbbreviationTableEntry> m_entries;
+    std::unordered_map<uint64_t, AbbreviationTableEntry> m_sparse_entries;
+
+    const AbbreviationTableEntry m_null_entry = {
+        .tag = DW_TAG::DW_TAG_null,
+        .has_children = DW_CHLIDREN::DW_CHILDREN_no,
+        .fixed_offsets = {0},
+    };
+};
+
+} // namespace smldbg::dwarf
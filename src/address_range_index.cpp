@@ -0,0 +1,47 @@
+#include "address_range_index.h"
+
+#include <algorithm>
+
+namespace smldbg::dwarf {
+
+void AddressRangeIndex::insert(uint64_t low, uint64_t high, uint64_t value) {
+    if (low >= high)
+        return;
+    m_entries.push_back({.low = low, .high = high, .value = value});
+}
+
+void AddressRangeIndex::finalize() {
+    // Entries read back from the index cache are already sorted.
+    const auto by_low = [](const Entry& lhs, const Entry& rhs) {
+        return lhs.low < rhs.low;
+    };
+    if (!std::is_sorted(m_entries.begin(), m_entries.end(), by_low))
+        std::stable_sort(m_entries.begin(), m_entries.end(), by_low);
+
+    m_max_high.resize(m_entries.size());
+    uint64_t max_high = 0;
+    for (unsigned i = 0, e = m_entries.size(); i < e; ++i) {
+        max_high = std::max(max_high, m_entries[i].high);
+        m_max_high[i] = max_high;
+    }
+}
+
+std::optional<uint64_t> AddressRangeIndex::find(uint64_t address) const {
+    // Find the first entry starting after |address|, then walk back over the
+    // entries starting at or before it. For non-overlapping ranges the first
+    // candidate is the only one we need to check.
+    const auto upper = std::upper_bound(
+        m_entries.begin(), m_entries.end(), address,
+        [](uint64_t address, const Entry& entry) {
+            return address < entry.low;
+        });
+    for (auto i = std::distance(m_entries.begin(), upper) - 1; i >= 0; --i) {
+        if (m_max_high[i] <= address)
+            break; // No earlier range reaches |address|.
+        if (address < m_entries[i].high)
+            return m_entries[i].value;
+    }
+    return std::nullopt;
+}
+
+} // namespace smldbg::dwarf
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+// A half open [low, high) range of program counter values.
+struct AddressRange {
+    uint64_t low;
+    uint64_t high;
+};
+
+// Maps half open [low, high) address ranges to a value (for example the
+// .debug_info offset of a DIE, or the index of a compile unit). The index is
+// built once with insert(...) followed by finalize(), after which lookups are a
+// binary search.
+class AddressRangeIndex {
+public:
+    struct Entry {
+        uint64_t low;
+        uint64_t high;
+        uint64_t value;
+    };
+
+    AddressRangeIndex() = default;
+
+    // Add the range [|low|, |high|) mapping to |value|. Empty ranges are
+    // ignored.
+    //
+    // Preconditions: finalize() has not yet been called.
+    void insert(uint64_t low, uint64_t high, uint64_t value);
+
+    // Reserve space for at least |entries| ranges.
+    void reserve(std::size_t entries) { m_entries.reserve(entries); }
+
+    // Sort the inserted ranges. Must be called once all ranges have been
+    // inserted and before any call to find(...).
+    void finalize();
+
+    // Return the value of the range containing |address|. If several ranges
+    // contain |address|, the one with the greatest low address (i.e. the
+    // innermost, for properly nested ranges) wins.
+    //
+    // Preconditions: finalize() has been called.
+    std::optional<uint64_t> find(uint64_t address) const;
+
+    // Return the sorted entries of the index.
+    const std::vector<Entry>& entries() const { return m_entries; }
+
+    bool empty() const { return m_entries.empty(); }
+
+private:
+    std::vector<Entry> m_entries; // Sorted by |low| once finalized.
+
+    std::vector<uint64_t>
+        m_max_high; // m_max_high[i] is the greatest |high| of m_entries[0..i],
+                    // bounding how far back find(...) has to look when ranges
+                    // overlap.
+};
+
+} // namespace smldbg::dwarf
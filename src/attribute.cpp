@@ -1,91 +1,286 @@
 #include "attribute.h"
 
+#include <array>
+
 namespace smldbg::dwarf {
 
-Attribute::Attribute(DW_FORM form, char* debug_info)
-    : m_form(form), m_debug_info(debug_info) {}
+namespace {
+
+// How the size of the data of a form is found.
+enum class FormEncoding : uint8_t {
+    unsupported,
+    fixed,   // |size| bytes.
+    offset,  // A section offset, 4 or 8 bytes depending on the format.
+    address, // A target address, of the unit's address size.
+    uleb,    // An unsigned LEB128 number.
+    sleb,    // A signed LEB128 number.
+    block,   // An unsigned LEB128 length, then that many bytes.
+    block1,  // A 1 byte length, then that many bytes.
+    block2,  // A 2 byte length, then that many bytes.
+    block4,  // A 4 byte length, then that many bytes.
+    string,  // A null terminated string.
+};
+
+struct FormSize {
+    FormEncoding encoding = FormEncoding::unsupported;
+    uint8_t size = 0;
+};
+
+// The size of each standard form, indexed by form.
+// Section 7.5.6
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+constexpr auto form_sizes = [] {
+    std::array<FormSize, 0x2d> sizes = {};
+    const auto set = [&](DW_FORM form, FormEncoding encoding,
+                         uint8_t size = 0) {
+        sizes[static_cast<std::size_t>(form)] = {encoding, size};
+    };
+    set(DW_FORM::DW_FORM_addr, FormEncoding::address);
+    set(DW_FORM::DW_FORM_block2, FormEncoding::block2);
+    set(DW_FORM::DW_FORM_block4, FormEncoding::block4);
+    set(DW_FORM::DW_FORM_data2, FormEncoding::fixed, 2);
+    set(DW_FORM::DW_FORM_data4, FormEncoding::fixed, 4);
+    set(DW_FORM::DW_FORM_data8, FormEncoding::fixed, 8);
+    set(DW_FORM::DW_FORM_string, FormEncoding::string);
+    set(DW_FORM::DW_FORM_block, FormEncoding::block);
+    set(DW_FORM::DW_FORM_block1, FormEncoding::block1);
+    set(DW_FORM::DW_FORM_data1, FormEncoding::fixed, 1);
+    set(DW_FORM::DW_FORM_flag, FormEncoding::fixed, 1);
+    set(DW_FORM::DW_FORM_sdata, FormEncoding::sleb);
+    set(DW_FORM::DW_FORM_strp, FormEncoding::offset);
+    set(DW_FORM::DW_FORM_udata, FormEncoding::uleb);
+    set(DW_FORM::DW_FORM_ref_addr, FormEncoding::offset);
+    set(DW_FORM::DW_FORM_ref1, FormEncoding::fixed, 1);
+    set(DW_FORM::DW_FORM_ref2, FormEncoding::fixed, 2);
+    set(DW_FORM::DW_FORM_ref4, FormEncoding::fixed, 4);
+    set(DW_FORM::DW_FORM_ref8, FormEncoding::fixed, 8);
+    set(DW_FORM::DW_FORM_ref_udata, FormEncoding::uleb);
+    set(DW_FORM::DW_FORM_sec_offset, FormEncoding::offset);
+    set(DW_FORM::DW_FORM_exprloc, FormEncoding::block);
+    set(DW_FORM::DW_FORM_flag_present, FormEncoding::fixed, 0);
+    set(DW_FORM::DW_FORM_strx, FormEncoding::uleb);
+    set(DW_FORM::DW_FORM_addrx, FormEncoding::uleb);
+    set(DW_FORM::DW_FORM_ref_sup4, FormEncoding::fixed, 4);
+    set(DW_FORM::DW_FORM_strp_sup, FormEncoding::offset);
+    set(DW_FORM::DW_FORM_data16, FormEncoding::fixed, 16);
+    set(DW_FORM::DW_FORM_line_strp, FormEncoding::offset);
+    set(DW_FORM::DW_FORM_ref_sig8, FormEncoding::fixed, 8);
+    // The value is held by the abbreviation.
+    set(DW_FORM::DW_FORM_implicit_const, FormEncoding::fixed, 0);
+    set(DW_FORM::DW_FORM_loclistx, FormEncoding::uleb);
+    set(DW_FORM::DW_FORM_rnglistx, FormEncoding::uleb);
+    set(DW_FORM::DW_FORM_ref_sup8, FormEncoding::fixed, 8);
+    set(DW_FORM::DW_FORM_strx1, FormEncoding::fixed, 1);
+    set(DW_FORM::DW_FORM_strx2, FormEncoding::fixed, 2);
+    set(DW_FORM::DW_FORM_strx3, FormEncoding::fixed, 3);
+    set(DW_FORM::DW_FORM_strx4, FormEncoding::fixed, 4);
+    set(DW_FORM::DW_FORM_addrx1, FormEncoding::fixed, 1);
+    set(DW_FORM::DW_FORM_addrx2, FormEncoding::fixed, 2);
+    set(DW_FORM::DW_FORM_addrx3, FormEncoding::fixed, 3);
+    set(DW_FORM::DW_FORM_addrx4, FormEncoding::fixed, 4);
+    return sizes;
+}();
+
+// Return the size of |form|, including the GNU extensions outside of
+// |form_sizes|.
+FormSize form_size(DW_FORM form) {
+    const auto index = static_cast<std::size_t>(form);
+    if (index < form_sizes.size())
+        return form_sizes[index];
+    switch (form) {
+    case DW_FORM::DW_FORM_GNU_addr_index:
+    case DW_FORM::DW_FORM_GNU_str_index:
+        return {FormEncoding::uleb, 0};
+    case DW_FORM::DW_FORM_GNU_ref_alt:
+    case DW_FORM::DW_FORM_GNU_strp_alt:
+        return {FormEncoding::offset, 0};
+    default:
+        return {};
+    }
+}
+
+// Read the |size| byte little endian number at |data|.
+uint64_t read_number(const char* data, unsigned size) {
+    uint64_t value = 0;
+    std::memcpy(&value, data, size);
+    return value;
+}
+
+} // namespace
 
-void Attribute::eat(DW_FORM form, char*& data, bool is_64bit) {
+bool is_address(DW_FORM form) {
     switch (form) {
-    // TODO: Use platform address size.
     case DW_FORM::DW_FORM_addr:
-        std::advance(data, sizeof(uint64_t));
-        break;
-    case DW_FORM::DW_FORM_data2:
-    case DW_FORM::DW_FORM_ref2:
-        std::advance(data, sizeof(uint16_t));
-        break;
-    case DW_FORM::DW_FORM_data4:
-    case DW_FORM::DW_FORM_ref4:
-        std::advance(data, sizeof(uint32_t));
+    case DW_FORM::DW_FORM_addrx:
+    case DW_FORM::DW_FORM_addrx1:
+    case DW_FORM::DW_FORM_addrx2:
+    case DW_FORM::DW_FORM_addrx3:
+    case DW_FORM::DW_FORM_addrx4:
+    case DW_FORM::DW_FORM_GNU_addr_index:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::optional<uint64_t> FormContext::address(uint64_t index) const {
+    if (!sections.debug_addr)
+        return std::nullopt;
+    return read_number(sections.debug_addr + addr_base + index * address_size,
+                       address_size);
+}
+
+std::optional<uint64_t> FormContext::string_offset(uint64_t index) const {
+    if (!sections.debug_str_offsets)
+        return std::nullopt;
+    return read_number(sections.debug_str_offsets + str_offsets_base +
+                           index * offset_size(),
+                       offset_size());
+}
+
+// The offsets of the lists of a range or location list table are relative to
+// the table's base.
+// Section 7.28 and 7.29
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+std::optional<uint64_t> FormContext::range_list_offset(uint64_t index) const {
+    if (!sections.debug_rnglists)
+        return std::nullopt;
+    return rnglists_base +
+           read_number(sections.debug_rnglists + rnglists_base +
+                           index * offset_size(),
+                       offset_size());
+}
+
+std::optional<uint64_t>
+FormContext::location_list_offset(uint64_t index) const {
+    if (!sections.debug_loclists)
+        return std::nullopt;
+    return loclists_base +
+           read_number(sections.debug_loclists + loclists_base +
+                           index * offset_size(),
+                       offset_size());
+}
+
+Attribute::Attribute(DW_FORM form, char* debug_info,
+                     const FormContext* context)
+    : m_form(form), m_debug_info(debug_info), m_context(context) {}
+
+void Attribute::eat(DW_FORM form, char*& data, const FormContext& context) {
+    const FormSize size = form_size(form);
+    switch (size.encoding) {
+    case FormEncoding::fixed:
+        std::advance(data, size.size);
         break;
-    case DW_FORM::DW_FORM_data8:
-    case DW_FORM::DW_FORM_ref8:
-        std::advance(data, sizeof(uint64_t));
+    case FormEncoding::offset:
+        std::advance(data, context.offset_size());
         break;
-    case DW_FORM::DW_FORM_data1:
-    case DW_FORM::DW_FORM_flag:
-    case DW_FORM::DW_FORM_ref1:
-        std::advance(data, sizeof(uint8_t));
+    case FormEncoding::address:
+        std::advance(data, context.address_size);
         break;
-    case DW_FORM::DW_FORM_strp:
-    case DW_FORM::DW_FORM_ref_addr:
-    case DW_FORM::DW_FORM_sec_offset: {
-        const uint64_t size = is_64bit ? sizeof(uint64_t) : sizeof(uint32_t);
-        std::advance(data, size);
+    case FormEncoding::uleb:
+        util::decodeULEB128(data);
         break;
-    }
-    case DW_FORM::DW_FORM_sdata:
+    case FormEncoding::sleb:
         util::decodeLEB128(data);
         break;
-    case DW_FORM::DW_FORM_udata:
-        util::decodeULEB128(data);
-        break;
-    case DW_FORM::DW_FORM_block:
-    case DW_FORM::DW_FORM_exprloc: {
-        const uint64_t size = util::decodeULEB128(data);
-        std::advance(data, size);
+    case FormEncoding::block: {
+        const uint64_t length = util::decodeULEB128(data);
+        std::advance(data, length);
         break;
     }
-    case DW_FORM::DW_FORM_flag_present:
-        break; // No associated data.
-    case DW_FORM::DW_FORM_block1: {
-        uint8_t length = 0;
-        std::memcpy(&length, data, sizeof(length));
-        std::advance(data, length + sizeof(length));
+    case FormEncoding::block1: {
+        const uint8_t length = util::read_bytes<uint8_t>(data);
+        std::advance(data, length);
         break;
     }
-    case DW_FORM::DW_FORM_block2: {
-        uint16_t length = 0;
-        std::memcpy(&length, data, sizeof(length));
-        std::advance(data, length + sizeof(length));
+    case FormEncoding::block2: {
+        const uint16_t length = util::read_bytes<uint16_t>(data);
+        std::advance(data, length);
         break;
     }
-    case DW_FORM::DW_FORM_block4: {
-        uint32_t length = 0;
-        std::memcpy(&length, data, sizeof(length));
-        std::advance(data, length + sizeof(length));
+    case FormEncoding::block4: {
+        const uint32_t length = util::read_bytes<uint32_t>(data);
+        std::advance(data, length);
         break;
     }
-    case DW_FORM::DW_FORM_ref_udata:
-    case DW_FORM::DW_FORM_indirect:
-    case DW_FORM::DW_FORM_string:
-    case DW_FORM::DW_FORM_ref_sig8:
-    case DW_FORM::DW_FORM_null:
+    case FormEncoding::string:
+        // Null terminated string, stored inline.
+        std::advance(data, std::strlen(data) + 1);
+        break;
+    case FormEncoding::unsupported:
+        // DW_FORM_indirect, or a form we don't know the size of.
         std::cerr << "Unsupported DW_FORM type.\n";
         std::exit(1);
     }
 }
 
+std::optional<uint64_t> Attribute::fixed_size(DW_FORM form,
+                                              const FormContext& context) {
+    const FormSize size = form_size(form);
+    switch (size.encoding) {
+    case FormEncoding::fixed:
+        return size.size;
+    case FormEncoding::offset:
+        return context.offset_size();
+    case FormEncoding::address:
+        return context.address_size;
+    default:
+        return std::nullopt;
+    }
+}
+
 uint64_t Attribute::as_uint64t() {
     uint64_t value = 0;
     switch (m_form) {
     case DW_FORM::DW_FORM_addr:
+        value = read_number(m_debug_info, m_context->address_size);
+        break;
+    case DW_FORM::DW_FORM_data8:
+    case DW_FORM::DW_FORM_ref8:
+    case DW_FORM::DW_FORM_implicit_const:
+        std::memcpy(&value, m_debug_info, sizeof(uint64_t));
+        break;
+    case DW_FORM::DW_FORM_data1:
+    case DW_FORM::DW_FORM_flag:
+    case DW_FORM::DW_FORM_ref1:
+        std::memcpy(&value, m_debug_info, sizeof(uint8_t));
+        break;
+    case DW_FORM::DW_FORM_data2:
+    case DW_FORM::DW_FORM_ref2:
+        std::memcpy(&value, m_debug_info, sizeof(uint16_t));
+        break;
     case DW_FORM::DW_FORM_data4:
+    case DW_FORM::DW_FORM_ref4:
         std::memcpy(&value, m_debug_info, sizeof(uint32_t));
         break;
     case DW_FORM::DW_FORM_sec_offset:
-        std::memcpy(&value, m_debug_info, sizeof(uint32_t));
+    case DW_FORM::DW_FORM_ref_addr:
+        value = read_offset();
+        break;
+    case DW_FORM::DW_FORM_udata:
+    case DW_FORM::DW_FORM_ref_udata: {
+        char* iter = m_debug_info;
+        value = util::decodeULEB128(iter);
+        break;
+    }
+    case DW_FORM::DW_FORM_sdata: {
+        char* iter = m_debug_info;
+        value = util::decodeLEB128(iter);
+        break;
+    }
+    case DW_FORM::DW_FORM_addrx:
+    case DW_FORM::DW_FORM_addrx1:
+    case DW_FORM::DW_FORM_addrx2:
+    case DW_FORM::DW_FORM_addrx3:
+    case DW_FORM::DW_FORM_addrx4:
+    case DW_FORM::DW_FORM_GNU_addr_index:
+        value = m_context->address(read_index()).value_or(0);
+        break;
+    case DW_FORM::DW_FORM_rnglistx:
+        value = m_context->range_list_offset(read_index()).value_or(0);
+        break;
+    case DW_FORM::DW_FORM_loclistx:
+        value = m_context->location_list_offset(read_index()).value_or(0);
         break;
     default:
         std::cerr << "Unsupported DW_FORM type.\n";
@@ -94,23 +289,60 @@ uint64_t Attribute::as_uint64t() {
     return value;
 }
 
-std::string_view Attribute::as_string_view(char* debug_str) {
+std::string_view Attribute::as_string_view() {
+    const FormSections& sections = m_context->sections;
     switch (m_form) {
     case DW_FORM::DW_FORM_string:
         // Data is in the form of a null terminated string.
         return std::string_view(m_debug_info);
-    case DW_FORM::DW_FORM_strp: {
+    case DW_FORM::DW_FORM_strp:
         // Data is in the form of an offset into the .debug_str section.
-        uint32_t offset = 0;
-        std::memcpy(&offset, m_debug_info, sizeof(offset));
-        return std::string_view(debug_str + offset);
-    }
+        return std::string_view(sections.debug_str + read_offset());
+    case DW_FORM::DW_FORM_line_strp:
+        return std::string_view(sections.debug_line_str + read_offset());
+    case DW_FORM::DW_FORM_strx:
+    case DW_FORM::DW_FORM_strx1:
+    case DW_FORM::DW_FORM_strx2:
+    case DW_FORM::DW_FORM_strx3:
+    case DW_FORM::DW_FORM_strx4:
+    case DW_FORM::DW_FORM_GNU_str_index:
+        // Data is in the form of an index into the string offsets table.
+        if (const std::optional<uint64_t> offset =
+                m_context->string_offset(read_index());
+            offset && sections.debug_str)
+            return std::string_view(sections.debug_str + *offset);
+        return {};
     default:
         std::cerr << "Trying to stringify an unsupported DW_FORM.\n";
         std::exit(1);
     }
 }
 
+uint64_t Attribute::read_offset() const {
+    return read_number(m_debug_info, m_context->offset_size());
+}
+
+uint64_t Attribute::read_index() const {
+    switch (m_form) {
+    case DW_FORM::DW_FORM_strx1:
+    case DW_FORM::DW_FORM_addrx1:
+        return read_number(m_debug_info, 1);
+    case DW_FORM::DW_FORM_strx2:
+    case DW_FORM::DW_FORM_addrx2:
+        return read_number(m_debug_info, 2);
+    case DW_FORM::DW_FORM_strx3:
+    case DW_FORM::DW_FORM_addrx3:
+        return read_number(m_debug_info, 3);
+    case DW_FORM::DW_FORM_strx4:
+    case DW_FORM::DW_FORM_addrx4:
+        return read_number(m_debug_info, 4);
+    default: {
+        char* iter = m_debug_info;
+        return util::decodeULEB128(iter);
+    }
+    }
+}
+
 std::vector<char> Attribute::as_raw() {
     switch (m_form) {
     case DW_FORM::DW_FORM_exprloc: {
@@ -126,4 +358,28 @@ std::vector<char> Attribute::as_raw() {
     }
 }
 
-} // namespace smldbg::dwarf
\ No newline at end of file
+std::span<char> Attribute::as_block() {
+    char* data = m_debug_info;
+    uint64_t size = 0;
+    switch (m_form) {
+    case DW_FORM::DW_FORM_block:
+    case DW_FORM::DW_FORM_exprloc:
+        size = util::decodeULEB128(data);
+        break;
+    case DW_FORM::DW_FORM_block1:
+        size = util::read_bytes<uint8_t>(data);
+        break;
+    case DW_FORM::DW_FORM_block2:
+        size = util::read_bytes<uint16_t>(data);
+        break;
+    case DW_FORM::DW_FORM_block4:
+        size = util::read_bytes<uint32_t>(data);
+        break;
+    default:
+        std::cerr << "Trying to extract a block from an unsupported DW_FORM.\n";
+        std::exit(1);
+    }
+    return {data, size};
+}
+
+} // namespace smldbg::dwarf
@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <optional>
+#include <span>
 #include <string_view>
 
 namespace smldbg::dwarf {
@@ -103,7 +105,14 @@ enum class DW_AT {
     DW_AT_const_expr = 0x6c,
     DW_AT_enum_class = 0x6d,
     DW_AT_linkage_name = 0x6e,
+    DW_AT_str_offsets_base = 0x72,
+    DW_AT_addr_base = 0x73,
+    DW_AT_rnglists_base = 0x74,
+    DW_AT_call_return_pc = 0x7d,
+    DW_AT_call_value = 0x7e,
+    DW_AT_loclists_base = 0x8c,
     DW_AT_lo_user = 0x2000,
+    DW_AT_GNU_call_site_value = 0x2111,
     DW_AT_hi_user = 0x3fff,
 };
 
@@ -133,7 +142,80 @@ enum class DW_FORM {
     DW_FORM_sec_offset = 0x17,
     DW_FORM_exprloc = 0x18,
     DW_FORM_flag_present = 0x19,
+    DW_FORM_strx = 0x1a,
+    DW_FORM_addrx = 0x1b,
+    DW_FORM_ref_sup4 = 0x1c,
+    DW_FORM_strp_sup = 0x1d,
+    DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f,
     DW_FORM_ref_sig8 = 0x20,
+    DW_FORM_implicit_const = 0x21,
+    DW_FORM_loclistx = 0x22,
+    DW_FORM_rnglistx = 0x23,
+    DW_FORM_ref_sup8 = 0x24,
+    DW_FORM_strx1 = 0x25,
+    DW_FORM_strx2 = 0x26,
+    DW_FORM_strx3 = 0x27,
+    DW_FORM_strx4 = 0x28,
+    DW_FORM_addrx1 = 0x29,
+    DW_FORM_addrx2 = 0x2a,
+    DW_FORM_addrx3 = 0x2b,
+    DW_FORM_addrx4 = 0x2c,
+    DW_FORM_GNU_addr_index = 0x1f01,
+    DW_FORM_GNU_str_index = 0x1f02,
+    DW_FORM_GNU_ref_alt = 0x1f20,
+    DW_FORM_GNU_strp_alt = 0x1f21,
+};
+
+// Is |form| of the address class, either an address or, from DWARF 5, an
+// index into the .debug_addr section?
+bool is_address(DW_FORM form);
+
+// The sections, other than .debug_info, that forms refer into. Null where the
+// ELF file doesn't have the section.
+struct FormSections {
+    char* debug_str = nullptr;
+    char* debug_line_str = nullptr;
+    char* debug_str_offsets = nullptr;
+    char* debug_addr = nullptr;
+    char* debug_rnglists = nullptr;
+    char* debug_loclists = nullptr;
+};
+
+// What reading the attributes of a unit depends on, other than their bytes:
+// the format of the unit, the sections forms refer into, and where the unit's
+// part of each table indexed by the DWARF 5 index forms (e.g. DW_FORM_strx)
+// starts, as given by the DW_AT_*_base attributes of the unit's root DIE.
+// Section 7.5.5
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+struct FormContext {
+    bool is_64bit = false;
+    uint8_t address_size = 8; // The size of target addresses, from the unit
+                              // header.
+    FormSections sections;
+    uint64_t str_offsets_base = 0;
+    uint64_t addr_base = 0;
+    uint64_t rnglists_base = 0;
+    uint64_t loclists_base = 0;
+
+    // Return the size of section offsets, 8 bytes in the 64-bit DWARF
+    // format and 4 otherwise.
+    unsigned offset_size() const { return is_64bit ? 8 : 4; }
+
+    // Return entry |index| of the unit's .debug_addr table, or std::nullopt
+    // if there is no .debug_addr section.
+    std::optional<uint64_t> address(uint64_t index) const;
+
+    // Return the offset into .debug_str of entry |index| of the unit's
+    // .debug_str_offsets table, or std::nullopt if there is no
+    // .debug_str_offsets section.
+    std::optional<uint64_t> string_offset(uint64_t index) const;
+
+    // Return the offset into .debug_rnglists (or .debug_loclists) of list
+    // |index| of the unit's range (or location) list table, or std::nullopt
+    // if there is no such section.
+    std::optional<uint64_t> range_list_offset(uint64_t index) const;
+    std::optional<uint64_t> location_list_offset(uint64_t index) const;
 };
 
 class Attribute {
@@ -141,43 +223,66 @@ public:
     // Construct a new attribute.
     //
     // Preconditions: |debug_info| should point to the first byte of the
-    // .debug_info section associated with the entry.
+    // .debug_info section associated with the entry, or for
+    // DW_FORM_implicit_const to the int64_t value held by the abbreviation.
+    // |context| should be the context of the unit the entry belongs to, and
+    // outlive the attribute.
     //
     // Postconditions : None.
-    Attribute(DW_FORM form, char* debug_info);
+    Attribute(DW_FORM form, char* debug_info, const FormContext* context);
 
-    // Eat |form| size bytes from |data|.
+    // Eat |form| size bytes from |data|. The size of each form is looked up
+    // in a table built at compile time, and for section offsets and
+    // addresses in |context|.
     //
     // Preconditions: |data| should point to the first byte of the attribute.
     //
     // Postconditions: |data| is advanced by the size of the entry associated
     // with |form|.
-    static void eat(DW_FORM form, char*& data, bool is_64bit);
+    static void eat(DW_FORM form, char*& data, const FormContext& context);
+
+    // Return the size of the data of |form|, if it is the same for every
+    // attribute of the form in a unit with |context|. Every form has a fixed
+    // size except for LEB128 numbers, blocks and inline strings.
+    static std::optional<uint64_t> fixed_size(DW_FORM form,
+                                              const FormContext& context);
 
     // Get the form of this attribute. This is often useful to interpret the
     // decoded value (i.e. is an address absolute or an offset).
     DW_FORM form() { return m_form; }
 
-    // Extract the data associated with |form| to a uint64_t.
+    // Extract the data associated with |form| to a uint64_t. Index forms are
+    // resolved: DW_FORM_addrx to the address, and DW_FORM_rnglistx and
+    // DW_FORM_loclistx to the offset of the list in its section.
     uint64_t as_uint64t();
 
     // Extract the data associated with |form| to a string view. It is up to the
     // user to ensure that this is only called with forms that are represented
-    // as strings, i.e. the form data is a null terminated series of characters
-    // or an offset into the .debug_str section.
+    // as strings, i.e. the form data is a null terminated series of characters,
+    // an offset into the .debug_str or .debug_line_str section or an index
+    // into the .debug_str_offsets section.
     //
-    // Preconditions: |debug_str| should point to the first byte of the
-    // .debug_str section of the parent ELF file.
+    // Preconditions: None.
     //
     // Postconditions: None.
-    std::string_view as_string_view(char* debug_str);
+    std::string_view as_string_view();
 
     // Extract the raw bytes associated with the |form|.
     std::vector<char> as_raw();
 
+    // Return the bytes of a block or exprloc class attribute, in place.
+    std::span<char> as_block();
+
 private:
+    // Read a section offset at |m_debug_info|.
+    uint64_t read_offset() const;
+
+    // Read the index of an index form (e.g. DW_FORM_strx1) at |m_debug_info|.
+    uint64_t read_index() const;
+
     DW_FORM m_form;     // The form this attribute represents.
     char* m_debug_info; // The first byte of the attribute.
+    const FormContext* m_context; // The context of the attribute's unit.
 };
 
 } // namespace smldbg::dwarf
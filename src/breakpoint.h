@@ -1,28 +1,43 @@
 #pragma once
 
+#include "breakpoint_condition.h"
+#include "location_list.h"
+#include "memory.h"
+
 #include <cstdint>
+#include <optional>
+#include <vector>
 
 namespace smldbg {
 
 class Breakpoint {
 public:
     Breakpoint() = default;
-    Breakpoint(int pid, uint64_t address)
-        : m_pid(pid), m_address(address), m_enabled(false) {}
+    Breakpoint(Memory* memory, uint64_t address)
+        : m_memory(memory), m_address(address), m_enabled(false) {}
 
     void enable();
     void disable();
-    void step_over();
 
     bool enabled() const { return m_enabled; }
     uint64_t address() const { return m_address; }
 
 public:
-    int m_pid;
+    Memory* m_memory;
     uint64_t m_address;
     uint8_t m_data;
 
     bool m_enabled;
+
+    // Only stop when the condition is true, if there is one.
+    std::optional<BreakpointCondition> m_condition;
+
+    // The locations of the variables of |m_condition|, indexed by the ids
+    // they were resolved to.
+    std::vector<dwarf::VariableLocation> m_condition_variables;
+
+    uint64_t m_hits = 0;        // Number of times the breakpoint was reached.
+    uint64_t m_evaluations = 0; // Number of times |m_condition| was evaluated.
 };
 
 } // namespace smldbg
@@ -0,0 +1,363 @@
+#include "breakpoint_condition.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <iostream>
+
+namespace smldbg {
+
+// A recursive descent parser that emits bytecode as it goes. Each parse_*
+// member handles one level of C operator precedence, from || down to unary
+// operators and primaries.
+class BreakpointCondition::Parser {
+public:
+    Parser(std::string_view expression, const VariableResolver& resolve,
+           BreakpointCondition& condition)
+        : m_input(expression), m_resolve(resolve), m_condition(condition) {}
+
+    // Parse the whole expression. Returns false, after printing the reason,
+    // on failure.
+    bool parse() {
+        if (!parse_or())
+            return false;
+        skip_whitespace();
+        if (m_position != m_input.size())
+            return error("Unexpected input");
+        return true;
+    }
+
+private:
+    bool parse_or() {
+        if (!parse_and())
+            return false;
+        while (accept("||")) {
+            const std::size_t jump = emit(Opcode::or_jump);
+            if (!parse_and())
+                return false;
+            emit(Opcode::to_bool);
+            patch(jump);
+        }
+        return true;
+    }
+
+    bool parse_and() {
+        if (!parse_equality())
+            return false;
+        while (accept("&&")) {
+            const std::size_t jump = emit(Opcode::and_jump);
+            if (!parse_equality())
+                return false;
+            emit(Opcode::to_bool);
+            patch(jump);
+        }
+        return true;
+    }
+
+    bool parse_equality() {
+        if (!parse_relational())
+            return false;
+        while (true) {
+            Opcode opcode;
+            if (accept("=="))
+                opcode = Opcode::equal;
+            else if (accept("!="))
+                opcode = Opcode::not_equal;
+            else
+                return true;
+            if (!parse_relational())
+                return false;
+            emit(opcode);
+        }
+    }
+
+    bool parse_relational() {
+        if (!parse_additive())
+            return false;
+        while (true) {
+            Opcode opcode;
+            if (accept("<="))
+                opcode = Opcode::less_equal;
+            else if (accept(">="))
+                opcode = Opcode::greater_equal;
+            else if (accept("<"))
+                opcode = Opcode::less;
+            else if (accept(">"))
+                opcode = Opcode::greater;
+            else
+                return true;
+            if (!parse_additive())
+                return false;
+            emit(opcode);
+        }
+    }
+
+    bool parse_additive() {
+        if (!parse_multiplicative())
+            return false;
+        while (true) {
+            Opcode opcode;
+            if (accept("+"))
+                opcode = Opcode::add;
+            else if (accept("-"))
+                opcode = Opcode::subtract;
+            else
+                return true;
+            if (!parse_multiplicative())
+                return false;
+            emit(opcode);
+        }
+    }
+
+    bool parse_multiplicative() {
+        if (!parse_unary())
+            return false;
+        while (true) {
+            Opcode opcode;
+            if (accept("*"))
+                opcode = Opcode::multiply;
+            else if (accept("/"))
+                opcode = Opcode::divide;
+            else if (accept("%"))
+                opcode = Opcode::remainder;
+            else
+                return true;
+            if (!parse_unary())
+                return false;
+            emit(opcode);
+        }
+    }
+
+    bool parse_unary() {
+        if (accept("!")) {
+            if (!parse_unary())
+                return false;
+            emit(Opcode::logical_not);
+            return true;
+        } else if (accept("-")) {
+            if (!parse_unary())
+                return false;
+            emit(Opcode::negate);
+            return true;
+        }
+        return parse_primary();
+    }
+
+    bool parse_primary() {
+        skip_whitespace();
+        if (accept("(")) {
+            if (!parse_or())
+                return false;
+            if (!accept(")"))
+                return error("Expected ')'");
+            return true;
+        }
+        if (m_position == m_input.size())
+            return error("Unexpected end of condition");
+
+        const char c = m_input[m_position];
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            // Decimal or hexadecimal literal.
+            int base = 10;
+            if (m_input.substr(m_position).starts_with("0x") ||
+                m_input.substr(m_position).starts_with("0X")) {
+                base = 16;
+                m_position += 2;
+            }
+            int64_t value = 0;
+            const auto [end, error_code] =
+                std::from_chars(m_input.data() + m_position,
+                                m_input.data() + m_input.size(), value, base);
+            if (error_code != std::errc())
+                return error("Invalid number");
+            m_position = end - m_input.data();
+            emit(Opcode::constant, value);
+            return true;
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            const std::size_t start = m_position;
+            while (m_position < m_input.size() &&
+                   (std::isalnum(static_cast<unsigned char>(
+                        m_input[m_position])) ||
+                    m_input[m_position] == '_'))
+                ++m_position;
+            const std::string_view name =
+                m_input.substr(start, m_position - start);
+            const std::optional<int64_t> id = m_resolve(name);
+            if (!id) {
+                std::cerr << "Unable to resolve " << name
+                          << " in breakpoint context.\n";
+                return false;
+            }
+            emit(Opcode::variable, *id);
+            return true;
+        }
+        return error("Unexpected input");
+    }
+
+    // Consume |token| if it comes next, ignoring whitespace.
+    bool accept(std::string_view token) {
+        skip_whitespace();
+        if (!m_input.substr(m_position).starts_with(token))
+            return false;
+        m_position += token.size();
+        return true;
+    }
+
+    void skip_whitespace() {
+        while (m_position < m_input.size() &&
+               std::isspace(static_cast<unsigned char>(m_input[m_position])))
+            ++m_position;
+    }
+
+    // Append an instruction, tracking the depth of the stack it leaves.
+    // Returns the index of the instruction.
+    std::size_t emit(Opcode opcode, int64_t operand = 0) {
+        switch (opcode) {
+        case Opcode::constant:
+        case Opcode::variable:
+            ++m_depth;
+            break;
+        case Opcode::negate:
+        case Opcode::logical_not:
+        case Opcode::to_bool:
+            break;
+        default:
+            // Binary operators pop two values and push one, the jumps pop the
+            // left operand when they fall through.
+            --m_depth;
+            break;
+        }
+        m_condition.m_stack_depth =
+            std::max(m_condition.m_stack_depth, m_depth);
+        m_condition.m_code.push_back({.opcode = opcode, .operand = operand});
+        return m_condition.m_code.size() - 1;
+    }
+
+    // Point the jump at |index| to the next instruction.
+    void patch(std::size_t index) {
+        m_condition.m_code[index].operand = m_condition.m_code.size();
+    }
+
+    bool error(std::string_view message) {
+        std::cerr << message << " at position " << m_position
+                  << " of condition '" << m_input << "'.\n";
+        return false;
+    }
+
+    std::string_view m_input;
+    std::size_t m_position = 0;
+    const VariableResolver& m_resolve;
+    BreakpointCondition& m_condition;
+    std::size_t m_depth = 0; // Depth of the stack after the emitted code.
+};
+
+std::optional<BreakpointCondition>
+BreakpointCondition::compile(std::string_view expression,
+                             const VariableResolver& resolve) {
+    BreakpointCondition condition;
+    condition.m_expression = expression;
+    if (!Parser(expression, resolve, condition).parse())
+        return std::nullopt;
+    return condition;
+}
+
+std::optional<int64_t>
+BreakpointCondition::evaluate(const VariableReader& read) const {
+    std::vector<int64_t> stack;
+    stack.reserve(m_stack_depth);
+
+    for (std::size_t pc = 0; pc < m_code.size(); ++pc) {
+        const Instruction& instruction = m_code[pc];
+        switch (instruction.opcode) {
+        case Opcode::constant:
+            stack.push_back(instruction.operand);
+            continue;
+        case Opcode::variable: {
+            const std::optional<int64_t> value = read(instruction.operand);
+            if (!value)
+                return std::nullopt;
+            stack.push_back(*value);
+            continue;
+        }
+        case Opcode::negate:
+            stack.back() = -static_cast<uint64_t>(stack.back());
+            continue;
+        case Opcode::logical_not:
+            stack.back() = !stack.back();
+            continue;
+        case Opcode::to_bool:
+            stack.back() = stack.back() != 0;
+            continue;
+        case Opcode::and_jump:
+            if (stack.back() == 0)
+                pc = instruction.operand - 1;
+            else
+                stack.pop_back();
+            continue;
+        case Opcode::or_jump:
+            if (stack.back() != 0) {
+                stack.back() = 1;
+                pc = instruction.operand - 1;
+            } else {
+                stack.pop_back();
+            }
+            continue;
+        default:
+            break;
+        }
+
+        // Binary operators. Arithmetic wraps around on overflow, as in
+        // two's complement, rather than being undefined.
+        const int64_t right = stack.back();
+        stack.pop_back();
+        int64_t& left = stack.back();
+        switch (instruction.opcode) {
+        case Opcode::multiply:
+            left = static_cast<uint64_t>(left) * static_cast<uint64_t>(right);
+            break;
+        case Opcode::divide:
+        case Opcode::remainder:
+            if (right == 0)
+                return std::nullopt;
+            // INT64_MIN / -1 overflows, and traps on x86.
+            if (right == -1)
+                left = instruction.opcode == Opcode::divide
+                           ? -static_cast<uint64_t>(left)
+                           : 0;
+            else
+                left = instruction.opcode == Opcode::divide ? left / right
+                                                            : left % right;
+            break;
+        case Opcode::add:
+            left = static_cast<uint64_t>(left) + static_cast<uint64_t>(right);
+            break;
+        case Opcode::subtract:
+            left = static_cast<uint64_t>(left) - static_cast<uint64_t>(right);
+            break;
+        case Opcode::less:
+            left = left < right;
+            break;
+        case Opcode::less_equal:
+            left = left <= right;
+            break;
+        case Opcode::greater:
+            left = left > right;
+            break;
+        case Opcode::greater_equal:
+            left = left >= right;
+            break;
+        case Opcode::equal:
+            left = left == right;
+            break;
+        case Opcode::not_equal:
+            left = left != right;
+            break;
+        default:
+            break;
+        }
+    }
+    return stack.back();
+}
+
+} // namespace smldbg
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace smldbg {
+
+// The condition of a conditional breakpoint, e.g. "n > 1000 && w == 0",
+// compiled once into bytecode for a small stack machine. Variables are
+// resolved at compile time to ids for the debugger's compiled locations of
+// them, so evaluating the condition at a breakpoint hit only reads the
+// variables.
+//
+// Conditions are C expressions over integer variables and integer literals,
+// evaluated with 64-bit signed arithmetic that wraps around on overflow, with
+// the operators || && == != < <= > >= + - * / % and unary ! and -. && and ||
+// short-circuit.
+class BreakpointCondition {
+public:
+    // Return an id for the named variable, which is passed to the
+    // VariableReader when the condition is evaluated.
+    using VariableResolver =
+        std::function<std::optional<int64_t>(std::string_view)>;
+
+    // Read the variable with the given id from the target, extended to 64
+    // bits according to its type.
+    using VariableReader = std::function<std::optional<int64_t>(int64_t)>;
+
+    // Compile |expression|, resolving its variables with |resolve|.
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt, after printing the reason, if
+    // |expression| doesn't parse or one of its variables can't be resolved.
+    static std::optional<BreakpointCondition>
+    compile(std::string_view expression, const VariableResolver& resolve);
+
+    // Evaluate the condition, reading variables with |read|.
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if a variable couldn't be read or
+    // the expression divides by zero.
+    std::optional<int64_t> evaluate(const VariableReader& read) const;
+
+    // The condition as entered.
+    const std::string& expression() const { return m_expression; }
+
+private:
+    enum class Opcode : uint8_t {
+        constant, // Push |operand|.
+        variable, // Push the variable with id |operand|.
+        negate,
+        logical_not,
+        multiply,
+        divide,
+        remainder,
+        add,
+        subtract,
+        less,
+        less_equal,
+        greater,
+        greater_equal,
+        equal,
+        not_equal,
+        to_bool,  // Replace the top of the stack with 0 or 1.
+        and_jump, // If the top is 0 jump to |operand|, otherwise pop.
+        or_jump,  // If the top isn't 0 replace it with 1 and jump to
+                  // |operand|, otherwise pop.
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        int64_t operand;
+    };
+
+    class Parser;
+
+    BreakpointCondition() = default;
+
+    std::string m_expression;
+    std::vector<Instruction> m_code;
+    std::size_t m_stack_depth = 0; // Maximum depth of the stack.
+};
+
+} // namespace smldbg
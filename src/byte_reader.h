@@ -0,0 +1,95 @@
+#pragma once
+
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace smldbg::dwarf {
+
+// Reads the fixed size and LEB128 encoded values of a DWARF expression or
+// section, failing rather than reading past its end. Once a read has failed,
+// |failed()| stays true.
+class ByteReader {
+public:
+    ByteReader(std::span<const char> bytes)
+        : m_begin(bytes.data()), m_data(bytes.data()),
+          m_end(bytes.data() + bytes.size()) {}
+
+    bool at_end() const { return m_data == m_end; }
+    bool failed() const { return m_failed; }
+    uint64_t offset() const { return m_data - m_begin; }
+
+    template <typename T> T fixed() {
+        if (static_cast<std::size_t>(m_end - m_data) < sizeof(T)) {
+            m_failed = true;
+            return 0;
+        }
+        T value = {};
+        std::memcpy(&value, m_data, sizeof(T));
+        m_data += sizeof(T);
+        return value;
+    }
+
+    uint64_t uleb() {
+        if (!leb_fits())
+            return 0;
+        char* data = const_cast<char*>(m_data);
+        const uint64_t value = util::decodeULEB128(data);
+        m_data = data;
+        return value;
+    }
+
+    int64_t sleb() {
+        if (!leb_fits())
+            return 0;
+        char* data = const_cast<char*>(m_data);
+        const int64_t value = util::decodeLEB128(data);
+        m_data = data;
+        return value;
+    }
+
+    // A section offset, |size| bytes long.
+    uint64_t offset(unsigned size) {
+        return size == 8 ? fixed<uint64_t>() : fixed<uint32_t>();
+    }
+
+    // A target address, |size| bytes long.
+    uint64_t address(unsigned size) {
+        const std::span<const char> bytes = block(size);
+        uint64_t value = 0;
+        std::memcpy(&value, bytes.data(),
+                    std::min<std::size_t>(bytes.size(), sizeof(value)));
+        return value;
+    }
+
+    std::span<const char> block(uint64_t size) {
+        if (size > static_cast<uint64_t>(m_end - m_data)) {
+            m_failed = true;
+            return {};
+        }
+        const std::span<const char> bytes(m_data, size);
+        m_data += size;
+        return bytes;
+    }
+
+private:
+    // Is the last byte of the LEB128 number at |m_data| within the
+    // bytes?
+    bool leb_fits() {
+        const char* last = std::find_if(m_data, m_end, [](char byte) {
+            return (byte & 0x80) == 0;
+        });
+        m_failed |= last == m_end;
+        return !m_failed;
+    }
+
+    const char* m_begin;
+    const char* m_data;
+    const char* m_end;
+    bool m_failed = false;
+};
+
+} // namespace smldbg::dwarf
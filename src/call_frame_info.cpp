@@ -0,0 +1,569 @@
+#include "call_frame_info.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+namespace smldbg::dwarf {
+
+namespace {
+
+// Pointer encodings used by .eh_frame and .eh_frame_hdr, the format in the
+// low bits and how the value is applied in the high bits.
+// Section 10.5.1
+// https://refspecs.linuxfoundation.org/LSB_5.0.0/LSB-Core-generic/LSB-Core-generic/ehframechpt.html
+enum : uint8_t {
+    DW_EH_PE_absptr = 0x00,
+    DW_EH_PE_uleb128 = 0x01,
+    DW_EH_PE_udata2 = 0x02,
+    DW_EH_PE_udata4 = 0x03,
+    DW_EH_PE_udata8 = 0x04,
+    DW_EH_PE_sleb128 = 0x09,
+    DW_EH_PE_sdata2 = 0x0a,
+    DW_EH_PE_sdata4 = 0x0b,
+    DW_EH_PE_sdata8 = 0x0c,
+    DW_EH_PE_pcrel = 0x10,
+    DW_EH_PE_datarel = 0x30,
+    DW_EH_PE_indirect = 0x80,
+    DW_EH_PE_omit = 0xff,
+};
+
+// Call frame instructions. The first three take their operand in the low six
+// bits of the opcode.
+// Section 7.23
+// http://www.dwarfstd.org/doc/DWARF4.pdf
+enum : uint8_t {
+    DW_CFA_advance_loc = 0x40,
+    DW_CFA_offset = 0x80,
+    DW_CFA_restore = 0xc0,
+    DW_CFA_nop = 0x00,
+    DW_CFA_set_loc = 0x01,
+    DW_CFA_advance_loc1 = 0x02,
+    DW_CFA_advance_loc2 = 0x03,
+    DW_CFA_advance_loc4 = 0x04,
+    DW_CFA_offset_extended = 0x05,
+    DW_CFA_restore_extended = 0x06,
+    DW_CFA_undefined = 0x07,
+    DW_CFA_same_value = 0x08,
+    DW_CFA_register = 0x09,
+    DW_CFA_remember_state = 0x0a,
+    DW_CFA_restore_state = 0x0b,
+    DW_CFA_def_cfa = 0x0c,
+    DW_CFA_def_cfa_register = 0x0d,
+    DW_CFA_def_cfa_offset = 0x0e,
+    DW_CFA_def_cfa_expression = 0x0f,
+    DW_CFA_expression = 0x10,
+    DW_CFA_offset_extended_sf = 0x11,
+    DW_CFA_def_cfa_sf = 0x12,
+    DW_CFA_def_cfa_offset_sf = 0x13,
+    DW_CFA_val_offset = 0x14,
+    DW_CFA_val_offset_sf = 0x15,
+    DW_CFA_val_expression = 0x16,
+    DW_CFA_GNU_args_size = 0x2e,
+    DW_CFA_GNU_negative_offset_extended = 0x2f,
+};
+
+// Read a pointer encoded with |encoding| from |data|, which lies in
+// |section|. Returns std::nullopt for encodings that aren't used on x86-64.
+std::optional<uint64_t> read_encoded(char*& data, uint8_t encoding,
+                                     const FrameSection& section) {
+    if (encoding == DW_EH_PE_omit)
+        return std::nullopt;
+
+    const uint64_t position = section.address + (data - section.data);
+    uint64_t value = 0;
+    switch (encoding & 0x0f) {
+    case DW_EH_PE_absptr:
+    case DW_EH_PE_udata8:
+    case DW_EH_PE_sdata8:
+        value = util::read_bytes<uint64_t>(data);
+        break;
+    case DW_EH_PE_uleb128:
+        value = util::decodeULEB128(data);
+        break;
+    case DW_EH_PE_sleb128:
+        value = util::decodeLEB128(data);
+        break;
+    case DW_EH_PE_udata2:
+        value = util::read_bytes<uint16_t>(data);
+        break;
+    case DW_EH_PE_sdata2:
+        value = util::read_bytes<int16_t>(data);
+        break;
+    case DW_EH_PE_udata4:
+        value = util::read_bytes<uint32_t>(data);
+        break;
+    case DW_EH_PE_sdata4:
+        value = util::read_bytes<int32_t>(data);
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    // Indirect pointers only turn up for personality routines, which are
+    // skipped, so the value is left as the address of the pointer.
+    switch (encoding & 0x70) {
+    case DW_EH_PE_absptr:
+        return value;
+    case DW_EH_PE_pcrel:
+        return value + position;
+    case DW_EH_PE_datarel:
+        return value + section.address;
+    default:
+        return std::nullopt;
+    }
+}
+
+// The start of a CIE or FDE after its initial length, and its end.
+// Section 7.2.2
+// http://www.dwarfstd.org/doc/DWARF4.pdf
+struct Entry {
+    char* body;
+    char* end;
+    bool is_64bit;
+};
+
+// Read the initial length of the entry at |entry|. Returns std::nullopt at
+// the zero terminator of .eh_frame, or if the entry runs past |section|.
+std::optional<Entry> read_entry(char* entry, const FrameSection& section) {
+    char* const section_end = section.data + section.size;
+    if (entry < section.data || section_end - entry < 4)
+        return std::nullopt;
+
+    char* data = entry;
+    uint64_t length = util::read_bytes<uint32_t>(data);
+    const bool is_64bit = length == 0xffffffff;
+    if (is_64bit) {
+        if (section_end - data < 8)
+            return std::nullopt;
+        length = util::read_bytes<uint64_t>(data);
+    }
+    if (length == 0 || length > static_cast<uint64_t>(section_end - data))
+        return std::nullopt;
+    return Entry{.body = data, .end = data + length, .is_64bit = is_64bit};
+}
+
+FrameSection frame_section(elf::ELF& elf, const std::string& name) {
+    const elf::ELFSection section = elf.get_section_data(name);
+    return {.data = section.data,
+            .size = section.data ? section.size : 0,
+            .address = elf.section_address(name).value_or(0)};
+}
+
+} // namespace
+
+CallFrameInfo::CallFrameInfo(elf::ELF& elf)
+    : CallFrameInfo(frame_section(elf, ".eh_frame_hdr"),
+                    frame_section(elf, ".eh_frame"),
+                    frame_section(elf, ".debug_frame")) {}
+
+CallFrameInfo::CallFrameInfo(FrameSection eh_frame_hdr, FrameSection eh_frame,
+                             FrameSection debug_frame)
+    : m_eh_frame(eh_frame), m_debug_frame(debug_frame) {
+    // The header is a version, the encodings of the three fields that
+    // follow, a pointer to .eh_frame, the number of FDEs and then the table.
+    // Only the table layout every linker emits is searched: signed 32 bit
+    // offsets from the start of .eh_frame_hdr.
+    if (eh_frame_hdr.size < 4 || eh_frame_hdr.data[0] != 1)
+        return;
+    char* data = eh_frame_hdr.data + 4;
+    const uint8_t eh_frame_pointer_encoding = eh_frame_hdr.data[1];
+    const uint8_t fde_count_encoding = eh_frame_hdr.data[2];
+    const uint8_t table_encoding = eh_frame_hdr.data[3];
+    if (!read_encoded(data, eh_frame_pointer_encoding, eh_frame_hdr))
+        return;
+    const auto fde_count =
+        read_encoded(data, fde_count_encoding, eh_frame_hdr);
+    if (!fde_count || table_encoding != (DW_EH_PE_datarel | DW_EH_PE_sdata4))
+        return;
+    const uint64_t table_size =
+        eh_frame_hdr.data + eh_frame_hdr.size - data;
+    if (*fde_count > table_size / 8)
+        return;
+    m_table = data;
+    m_table_entries = *fde_count;
+    m_table_base = eh_frame_hdr.address;
+}
+
+std::optional<CallFrameRow> CallFrameInfo::row_at(uint64_t pc) {
+    if (const auto found = m_rows.find(pc); found != m_rows.end())
+        return found->second;
+
+    std::optional<CallFrameRow> row;
+    if (const auto fde = find_fde(pc))
+        row = execute(*fde, pc);
+    m_rows.emplace(pc, row);
+    return row;
+}
+
+std::optional<CallFrameInfo::Fde> CallFrameInfo::find_fde(uint64_t pc) {
+    if (m_table) {
+        if (const auto fde = search_table(pc))
+            return fde;
+    }
+
+    // Without a table, or for code only .debug_frame describes.
+    if (!m_fdes)
+        index_fdes();
+    const auto after = std::upper_bound(
+        m_fdes->begin(), m_fdes->end(), pc,
+        [](uint64_t pc, const Fde& fde) { return pc < fde.low; });
+    if (after == m_fdes->begin())
+        return std::nullopt;
+    const Fde& fde = *std::prev(after);
+    if (pc >= fde.high)
+        return std::nullopt;
+    return fde;
+}
+
+std::optional<CallFrameInfo::Fde> CallFrameInfo::search_table(uint64_t pc) {
+    const auto field = [&](uint64_t index, unsigned offset) {
+        int32_t value = 0;
+        std::memcpy(&value, m_table + index * 8 + offset, sizeof(value));
+        return m_table_base + value;
+    };
+
+    // Find the last function starting at or before |pc|.
+    uint64_t low = 0;
+    uint64_t high = m_table_entries;
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        if (field(middle, 0) <= pc)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0)
+        return std::nullopt;
+
+    const uint64_t fde_address = field(low - 1, 4);
+    if (fde_address < m_eh_frame.address ||
+        fde_address >= m_eh_frame.address + m_eh_frame.size)
+        return std::nullopt;
+    const auto fde =
+        read_fde(true, m_eh_frame.data + (fde_address - m_eh_frame.address));
+    if (!fde || pc < fde->low || pc >= fde->high)
+        return std::nullopt;
+    return fde;
+}
+
+std::optional<CallFrameInfo::Fde> CallFrameInfo::read_fde(bool is_eh_frame,
+                                                          char* entry) {
+    const FrameSection& section = is_eh_frame ? m_eh_frame : m_debug_frame;
+    const auto header = read_entry(entry, section);
+    if (!header)
+        return std::nullopt;
+
+    // The CIE pointer is relative to itself in .eh_frame, and an offset into
+    // the section in .debug_frame, where CIEs have all ones instead.
+    char* data = header->body;
+    const uint64_t id = header->is_64bit ? util::read_bytes<uint64_t>(data)
+                                         : util::read_bytes<uint32_t>(data);
+    char* cie_entry = nullptr;
+    if (is_eh_frame) {
+        if (id == 0)
+            return std::nullopt;
+        cie_entry = header->body - id;
+    } else {
+        if (id == (header->is_64bit ? ~uint64_t{0} : 0xffffffff))
+            return std::nullopt;
+        cie_entry = section.data + id;
+    }
+    const Cie* cie = read_cie(is_eh_frame, cie_entry);
+    if (!cie)
+        return std::nullopt;
+
+    // The range is a size, so only the format of the encoding applies.
+    const auto low = read_encoded(data, cie->pointer_encoding, section);
+    const auto range =
+        read_encoded(data, cie->pointer_encoding & 0x0f, section);
+    if (!low || !range)
+        return std::nullopt;
+    if (cie->has_augmentation_data) {
+        const uint64_t length = util::decodeULEB128(data);
+        data += length;
+    }
+    if (data > header->end)
+        return std::nullopt;
+
+    return Fde{.low = *low,
+               .high = *low + *range,
+               .cie = cie,
+               .instructions = {data, header->end},
+               .is_eh_frame = is_eh_frame};
+}
+
+const CallFrameInfo::Cie* CallFrameInfo::read_cie(bool is_eh_frame,
+                                                  char* entry) {
+    if (const auto found = m_cies.find(entry); found != m_cies.end())
+        return &found->second;
+
+    const FrameSection& section = is_eh_frame ? m_eh_frame : m_debug_frame;
+    const auto header = read_entry(entry, section);
+    if (!header)
+        return nullptr;
+
+    // Section 6.4.1
+    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    Cie cie;
+    char* data = header->body + (header->is_64bit ? 8 : 4);
+    const uint8_t version = util::read_bytes<uint8_t>(data);
+    const std::string_view augmentation(
+        data, strnlen(data, header->end - data));
+    data += augmentation.size() + 1;
+    if (version >= 4)
+        data += 2; // Address and segment selector sizes.
+    cie.code_alignment = util::decodeULEB128(data);
+    cie.data_alignment = util::decodeLEB128(data);
+    cie.return_address_register = version == 1
+                                      ? util::read_bytes<uint8_t>(data)
+                                      : util::decodeULEB128(data);
+
+    // The augmentation string says what the augmentation data holds. Without
+    // a leading 'z' its length is unknown, so the CIE can't be read.
+    // Section 10.6.1.1
+    // https://refspecs.linuxfoundation.org/LSB_5.0.0/LSB-Core-generic/LSB-Core-generic/ehframechpt.html
+    if (!augmentation.empty()) {
+        if (augmentation[0] != 'z')
+            return nullptr;
+        cie.has_augmentation_data = true;
+        const uint64_t length = util::decodeULEB128(data);
+        char* const augmentation_end = data + length;
+        for (const char c : augmentation.substr(1)) {
+            if (c == 'R') {
+                cie.pointer_encoding = util::read_bytes<uint8_t>(data);
+            } else if (c == 'P') {
+                const uint8_t encoding = util::read_bytes<uint8_t>(data);
+                read_encoded(data, encoding & ~DW_EH_PE_indirect, section);
+            } else if (c == 'L') {
+                data += 1;
+            } else if (c == 'S') {
+                cie.signal_frame = true;
+            }
+        }
+        data = augmentation_end;
+    }
+    if (data > header->end)
+        return nullptr;
+    cie.instructions = {data, header->end};
+
+    return &m_cies.emplace(entry, cie).first->second;
+}
+
+void CallFrameInfo::index_fdes() {
+    m_fdes.emplace();
+    for (const bool is_eh_frame : {true, false}) {
+        const FrameSection& section = is_eh_frame ? m_eh_frame : m_debug_frame;
+        char* entry = section.data;
+        while (const auto header = read_entry(entry, section)) {
+            if (const auto fde = read_fde(is_eh_frame, entry))
+                m_fdes->push_back(*fde);
+            entry = header->end;
+        }
+    }
+    std::sort(m_fdes->begin(), m_fdes->end(),
+              [](const Fde& a, const Fde& b) { return a.low < b.low; });
+}
+
+std::optional<CallFrameRow> CallFrameInfo::execute(const Fde& fde,
+                                                   uint64_t pc) {
+    const Cie& cie = *fde.cie;
+    CallFrameRow row;
+    row.return_address_register = cie.return_address_register;
+    row.signal_frame = cie.signal_frame;
+
+    // The row after the CIE's initial instructions, which DW_CFA_restore goes
+    // back to, and the rows saved by DW_CFA_remember_state.
+    CallFrameRow initial;
+    std::vector<CallFrameRow> remembered;
+    uint64_t location = fde.low;
+
+    const auto set_rule = [&](uint64_t reg, RegisterRule::Kind kind,
+                              int64_t value = 0,
+                              std::span<char> expression = {}) {
+        if (reg < cfi_registers)
+            row.registers[reg] = {kind, value, expression};
+    };
+    const auto read_block = [](char*& data) {
+        const uint64_t length = util::decodeULEB128(data);
+        const std::span<char> block(data, length);
+        data += length;
+        return block;
+    };
+
+    // Returns false once the location has moved past |pc|, or on an
+    // instruction that can't be decoded, which sets |malformed|.
+    bool malformed = false;
+    const auto run = [&](std::span<char> instructions) {
+        char* data = instructions.data();
+        char* const end = instructions.data() + instructions.size();
+        while (data < end) {
+            const uint8_t opcode = util::read_bytes<uint8_t>(data);
+            const uint8_t operand = opcode & 0x3f;
+            uint64_t advance = 0;
+            switch (opcode & 0xc0) {
+            case DW_CFA_advance_loc:
+                advance = operand;
+                break;
+            case DW_CFA_offset:
+                set_rule(operand, RegisterRule::Kind::offset,
+                         util::decodeULEB128(data) * cie.data_alignment);
+                continue;
+            case DW_CFA_restore:
+                if (operand < cfi_registers)
+                    row.registers[operand] = initial.registers[operand];
+                continue;
+            }
+
+            if ((opcode & 0xc0) == 0) {
+                switch (opcode) {
+                case DW_CFA_nop:
+                    break;
+                case DW_CFA_set_loc: {
+                    const auto address = read_encoded(
+                        data, cie.pointer_encoding,
+                        fde.is_eh_frame ? m_eh_frame : m_debug_frame);
+                    if (!address) {
+                        malformed = true;
+                        return false;
+                    }
+                    if (*address > pc)
+                        return false;
+                    location = *address;
+                    break;
+                }
+                case DW_CFA_advance_loc1:
+                    advance = util::read_bytes<uint8_t>(data);
+                    break;
+                case DW_CFA_advance_loc2:
+                    advance = util::read_bytes<uint16_t>(data);
+                    break;
+                case DW_CFA_advance_loc4:
+                    advance = util::read_bytes<uint32_t>(data);
+                    break;
+                case DW_CFA_offset_extended: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg, RegisterRule::Kind::offset,
+                             util::decodeULEB128(data) * cie.data_alignment);
+                    break;
+                }
+                case DW_CFA_restore_extended: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    if (reg < cfi_registers)
+                        row.registers[reg] = initial.registers[reg];
+                    break;
+                }
+                case DW_CFA_undefined:
+                    set_rule(util::decodeULEB128(data),
+                             RegisterRule::Kind::undefined);
+                    break;
+                case DW_CFA_same_value:
+                    set_rule(util::decodeULEB128(data),
+                             RegisterRule::Kind::same_value);
+                    break;
+                case DW_CFA_register: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg, RegisterRule::Kind::reg,
+                             util::decodeULEB128(data));
+                    break;
+                }
+                case DW_CFA_remember_state:
+                    remembered.push_back(row);
+                    break;
+                case DW_CFA_restore_state:
+                    if (remembered.empty()) {
+                        malformed = true;
+                        return false;
+                    }
+                    row = remembered.back();
+                    remembered.pop_back();
+                    break;
+                case DW_CFA_def_cfa:
+                    row.cfa_register = util::decodeULEB128(data);
+                    row.cfa_offset = util::decodeULEB128(data);
+                    row.cfa_expression = {};
+                    break;
+                case DW_CFA_def_cfa_sf:
+                    row.cfa_register = util::decodeULEB128(data);
+                    row.cfa_offset =
+                        util::decodeLEB128(data) * cie.data_alignment;
+                    row.cfa_expression = {};
+                    break;
+                case DW_CFA_def_cfa_register:
+                    row.cfa_register = util::decodeULEB128(data);
+                    row.cfa_expression = {};
+                    break;
+                case DW_CFA_def_cfa_offset:
+                    row.cfa_offset = util::decodeULEB128(data);
+                    break;
+                case DW_CFA_def_cfa_offset_sf:
+                    row.cfa_offset =
+                        util::decodeLEB128(data) * cie.data_alignment;
+                    break;
+                case DW_CFA_def_cfa_expression:
+                    row.cfa_expression = read_block(data);
+                    break;
+                case DW_CFA_expression:
+                case DW_CFA_val_expression: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg,
+                             opcode == DW_CFA_expression
+                                 ? RegisterRule::Kind::expression
+                                 : RegisterRule::Kind::val_expression,
+                             0, read_block(data));
+                    break;
+                }
+                case DW_CFA_offset_extended_sf: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg, RegisterRule::Kind::offset,
+                             util::decodeLEB128(data) * cie.data_alignment);
+                    break;
+                }
+                case DW_CFA_val_offset: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg, RegisterRule::Kind::val_offset,
+                             util::decodeULEB128(data) * cie.data_alignment);
+                    break;
+                }
+                case DW_CFA_val_offset_sf: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg, RegisterRule::Kind::val_offset,
+                             util::decodeLEB128(data) * cie.data_alignment);
+                    break;
+                }
+                case DW_CFA_GNU_args_size:
+                    util::decodeULEB128(data);
+                    break;
+                case DW_CFA_GNU_negative_offset_extended: {
+                    const uint64_t reg = util::decodeULEB128(data);
+                    set_rule(reg, RegisterRule::Kind::offset,
+                             -static_cast<int64_t>(util::decodeULEB128(data)) *
+                                 cie.data_alignment);
+                    break;
+                }
+                default:
+                    malformed = true;
+                    return false;
+                }
+            }
+
+            if (advance) {
+                location += advance * cie.code_alignment;
+                if (location > pc)
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    run(cie.instructions);
+    initial = row;
+    run(fde.instructions);
+    if (malformed)
+        return std::nullopt;
+    return row;
+}
+
+} // namespace smldbg::dwarf
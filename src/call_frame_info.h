@@ -0,0 +1,142 @@
+#pragma once
+
+#include "elf.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+// DWARF register numbers of the x86-64 registers that call frame information
+// describes, the general purpose registers and the return address.
+// Section 3.38
+// https://software.intel.com/sites/default/files/article/402129/mpx-linux64-abi.pdf
+constexpr std::size_t cfi_registers = 17;
+constexpr unsigned cfi_rbp = 6;
+constexpr unsigned cfi_rsp = 7;
+constexpr unsigned cfi_return_address = 16;
+
+// How to recover the value a register had in the caller, given the canonical
+// frame address (CFA) of the callee.
+// Section 6.4.1
+// http://www.dwarfstd.org/doc/DWARF4.pdf
+struct RegisterRule {
+    enum class Kind : uint8_t {
+        undefined,      // Not recoverable.
+        same_value,     // Unchanged from the caller.
+        offset,         // Saved at CFA + |value|.
+        val_offset,     // Is CFA + |value|.
+        reg,            // Saved in register |value|.
+        expression,     // Saved at the address computed by |expression|.
+        val_expression, // Is the value computed by |expression|.
+    };
+
+    Kind kind = Kind::same_value;
+    int64_t value = 0;
+    std::span<char> expression;
+};
+
+// A row of the call frame table: how to compute the CFA, and then how to
+// recover the caller's registers, at one program counter.
+struct CallFrameRow {
+    // The CFA is either register + offset, or the value of an expression.
+    unsigned cfa_register = cfi_rsp;
+    int64_t cfa_offset = 0;
+    std::span<char> cfa_expression;
+
+    unsigned return_address_register = cfi_return_address;
+    std::array<RegisterRule, cfi_registers> registers;
+    bool signal_frame = false; // The frame of a signal handler trampoline.
+};
+
+// The bytes of a section that call frame information is read from, and the
+// link-time address it is loaded at, which encoded pointers can be relative
+// to.
+struct FrameSection {
+    char* data = nullptr;
+    uint64_t size = 0;
+    uint64_t address = 0;
+};
+
+// Reads the call frame information of an object, as used by compilers for
+// exception handling (.eh_frame) or emitted for debuggers (.debug_frame).
+// The frame description entry (FDE) for a program counter is found through
+// the binary search table of .eh_frame_hdr when there is one, or else
+// through a sorted index of every FDE built on first use. Rows are cached
+// per program counter, so unwinding the same stacks again is cheap.
+class CallFrameInfo {
+public:
+    CallFrameInfo() = default;
+
+    // Read call frame information from the sections of |elf|.
+    explicit CallFrameInfo(elf::ELF& elf);
+
+    // Read call frame information from the given sections, any of which may
+    // be empty.
+    CallFrameInfo(FrameSection eh_frame_hdr, FrameSection eh_frame,
+                  FrameSection debug_frame);
+
+    // Return the row of the call frame table at the link-time address |pc|,
+    // or std::nullopt if no FDE covers it.
+    std::optional<CallFrameRow> row_at(uint64_t pc);
+
+private:
+    // Common information entry, shared by a number of FDEs.
+    struct Cie {
+        uint64_t code_alignment = 1;
+        int64_t data_alignment = 1;
+        unsigned return_address_register = cfi_return_address;
+        uint8_t pointer_encoding = 0; // Encoding of FDE addresses.
+        bool has_augmentation_data = false;
+        bool signal_frame = false;
+        std::span<char> instructions;
+    };
+
+    // Frame description entry, describing the frames of a range of code.
+    struct Fde {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        const Cie* cie = nullptr;
+        std::span<char> instructions;
+        bool is_eh_frame = false;
+    };
+
+    // Find the FDE covering |pc|.
+    std::optional<Fde> find_fde(uint64_t pc);
+
+    // Look |pc| up in the binary search table of .eh_frame_hdr.
+    std::optional<Fde> search_table(uint64_t pc);
+
+    // Read the entry starting at |entry|, which is an FDE if it has a CIE
+    // pointer. Returns std::nullopt if it's a CIE, or malformed.
+    std::optional<Fde> read_fde(bool is_eh_frame, char* entry);
+
+    // Read the CIE starting at |entry|, caching it. Returns nullptr if it's
+    // malformed.
+    const Cie* read_cie(bool is_eh_frame, char* entry);
+
+    // Index every FDE of .eh_frame and .debug_frame, sorted by address.
+    void index_fdes();
+
+    // Run the call frame instructions of the CIE and FDE up to |pc|.
+    std::optional<CallFrameRow> execute(const Fde& fde, uint64_t pc);
+
+    FrameSection m_eh_frame;
+    FrameSection m_debug_frame;
+
+    // The binary search table of .eh_frame_hdr, pairs of 32 bit addresses of
+    // functions and their FDEs relative to |m_table_base|, if there is one.
+    char* m_table = nullptr;
+    uint64_t m_table_entries = 0;
+    uint64_t m_table_base = 0;
+
+    std::unordered_map<char*, Cie> m_cies;
+    std::optional<std::vector<Fde>> m_fdes; // Sorted by |low|, once built.
+    std::unordered_map<uint64_t, std::optional<CallFrameRow>> m_rows;
+};
+
+} // namespace smldbg::dwarf
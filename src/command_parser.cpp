@@ -13,16 +13,26 @@ CommandWithArguments CommandParser::parse(const std::string& user_input) {
     }();
 
     // Match the minimum amount of |user_input| to identify the command.
-    if (user_input.substr(0, 2) == "br")
+    if (user_input.substr(0, 2) == "aw")
+        return {.command = Command::AccessWatch, .arguments = arguments};
+    else if (user_input.substr(0, 2) == "at")
+        return {.command = Command::Attach, .arguments = arguments};
+    else if (user_input.substr(0, 2) == "br")
         return {.command = Command::Break, .arguments = arguments};
     else if (user_input.substr(0, 2) == "bt")
         return {.command = Command::BackTrace, .arguments = {}};
     else if (user_input.find('c', 0) == 0)
         return {.command = Command::Continue, .arguments = {}};
+    else if (user_input.substr(0, 3) == "det")
+        return {.command = Command::Detach, .arguments = {}};
     else if (user_input.find('d', 0) == 0)
         return {.command = Command::Delete, .arguments = {}};
     else if (user_input.find('f', 0) == 0)
         return {.command = Command::Finish, .arguments = {}};
+    else if (user_input.substr(0, 2) == "hb")
+        return {.command = Command::HardwareBreak, .arguments = arguments};
+    else if (user_input.substr(0, 3) == "int")
+        return {.command = Command::Interrupt, .arguments = {}};
     else if (user_input.find('i', 0) == 0)
         return {.command = Command::Info, .arguments = arguments};
     else if (user_input.find('n', 0) == 0)
@@ -37,6 +47,10 @@ CommandWithArguments CommandParser::parse(const std::string& user_input) {
         return {.command = Command::Start, .arguments = {}};
     else if (user_input.substr(0, 3) == "ste")
         return {.command = Command::Step, .arguments = arguments};
+    else if (user_input.substr(0, 2) == "th")
+        return {.command = Command::Thread, .arguments = arguments};
+    else if (user_input.find('w', 0) == 0)
+        return {.command = Command::Watch, .arguments = arguments};
     else
         return {.command = Command::Unknown, .arguments = {}};
 }
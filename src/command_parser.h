@@ -6,19 +6,26 @@
 namespace smldbg {
 
 enum class Command {
+    AccessWatch,
+    Attach,
     BackTrace,
     Break,
     Continue,
     Delete,
+    Detach,
     Finish,
+    HardwareBreak,
     Info,
+    Interrupt,
     Next,
     Print,
     Quit,
     Set,
     Start,
     Step,
+    Thread,
     Unknown,
+    Watch,
 };
 
 struct CommandWithArguments {
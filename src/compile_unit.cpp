@@ -1,11 +1,14 @@
 #include "compile_unit.h"
 
+#include <array>
+
 namespace smldbg::dwarf {
 
-CompileUnit::CompileUnit(char** debug_info, char* debug_abbrev)
-    : m_debug_info(*debug_info), m_debug_abbrev(debug_abbrev) {
-    // Section 7.5
-    // http://www.dwarfstd.org/doc/DWARF4.pdf
+CompileUnit::CompileUnit(char** debug_info, char* debug_abbrev,
+                         const FormSections& sections)
+    : m_debug_info(*debug_info) {
+    // Section 7.5.1
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
     char* start = *debug_info;
     uint32_t maybe_unit_length =
         smldbg::util::read_bytes<uint32_t>(*debug_info);
@@ -17,60 +20,196 @@ CompileUnit::CompileUnit(char** debug_info, char* debug_abbrev)
         unit_length = maybe_unit_length;
     }
     version = smldbg::util::read_bytes<uint16_t>(*debug_info);
+
+    // DWARF 5 moved the address size before the abbreviation offset, and
+    // added the unit type. Some unit types have more fields: the id of the
+    // split unit of a skeleton unit, or the signature and offset of the type
+    // a type unit describes.
+    if (version >= 5) {
+        unit_type = smldbg::util::read_bytes<uint8_t>(*debug_info);
+        address_size = smldbg::util::read_bytes<uint8_t>(*debug_info);
+    }
     if (is_64bit)
         debug_abbrev_offset = smldbg::util::read_bytes<uint64_t>(*debug_info);
     else
         debug_abbrev_offset = smldbg::util::read_bytes<uint32_t>(*debug_info);
-    address_size = smldbg::util::read_bytes<uint8_t>(*debug_info);
+    if (version < 5)
+        address_size = smldbg::util::read_bytes<uint8_t>(*debug_info);
+    switch (unit_type) {
+    case DW_UT_skeleton:
+    case DW_UT_split_compile:
+        std::advance(*debug_info, sizeof(uint64_t));
+        break;
+    case DW_UT_type:
+    case DW_UT_split_type:
+        std::advance(*debug_info, sizeof(uint64_t) + offset_size());
+        break;
+    }
+    header_size = *debug_info - start;
+
+    // Decode the abbreviations used by this compile unit.
+    auto context = std::make_shared<FormContext>(
+        FormContext{.is_64bit = is_64bit,
+                    .address_size = address_size,
+                    .sections = sections});
+    m_context = context;
+    m_abbreviations = std::make_shared<const AbbreviationTable>(
+        debug_abbrev + debug_abbrev_offset, *context);
+
+    // Find the unit's part of the tables DWARF 5 index forms refer to. The
+    // attributes giving them are section offsets, which can be read before
+    // the context is complete.
+    auto [str_offsets_base, addr_base, rnglists_base, loclists_base] =
+        root().attributes(std::array{
+            DW_AT::DW_AT_str_offsets_base, DW_AT::DW_AT_addr_base,
+            DW_AT::DW_AT_rnglists_base, DW_AT::DW_AT_loclists_base});
+    if (str_offsets_base)
+        context->str_offsets_base = str_offsets_base->as_uint64t();
+    if (addr_base)
+        context->addr_base = addr_base->as_uint64t();
+    if (rnglists_base)
+        context->rnglists_base = rnglists_base->as_uint64t();
+    if (loclists_base)
+        context->loclists_base = loclists_base->as_uint64t();
 
     // Advance |debug_info| to the end of this compile unit.
     std::advance(start, unit_length + (is_64bit ? 12 : 4));
     *debug_info = start;
 }
 
-DIE CompileUnit::root() const {
-    uint64_t header_size = is_64bit ? (12 + 2 + 8 + 1) : (4 + 2 + 4 + 1);
-    return DIE(m_debug_info + header_size,
-               m_debug_info + unit_length + (is_64bit ? 12 : 4),
-               m_debug_abbrev + debug_abbrev_offset, is_64bit);
+DIE CompileUnit::root() const { return die_at(m_debug_info + header_size); }
+
+DIE CompileUnit::die_at(char* entry) const {
+    return DIE(entry, debug_info_end(), m_abbreviations.get(),
+               m_context.get());
 }
 
-bool CompileUnit::contains_address(uint64_t address, char* debug_ranges) {
-    // Our root DIE should be DW_TAG_compile_unit which should contain a
-    // DW_AT_low_pc and either DW_AT_high_pc or DW_AT_ranges attributes.
-    DIE die = root();
-    if (die.tag() != DW_TAG::DW_TAG_compile_unit) {
-        std::cerr << "Root DIE of CompileUnit is not DW_TAG_compile_unit.\n";
-        std::exit(1);
-    }
+char* CompileUnit::reference(Attribute attribute, char* debug_info) const {
+    // Section 7.5.4
+    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    // DW_FORM_ref_addr is an offset from the start of the .debug_info section,
+    // the other reference forms are offsets from the start of the compile unit
+    // header.
+    if (attribute.form() == DW_FORM::DW_FORM_ref_addr)
+        return debug_info + attribute.as_uint64t();
+    return m_debug_info + attribute.as_uint64t();
+}
+
+uint64_t CompileUnit::base_address() const {
+    auto low_pc = root().attribute(DW_AT::DW_AT_low_pc);
+    return low_pc ? low_pc->as_uint64t() : 0;
+}
 
-    // Check if we have a simple low_pc/high_pc pair.
+std::vector<AddressRange>
+CompileUnit::address_ranges(DIE die, char* debug_ranges) const {
+    // Section 2.17
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+
+    // A single contiguous range. |high_pc| is either an absolute address or an
+    // offset from |low_pc|.
     if (auto low_pc = die.attribute(DW_AT::DW_AT_low_pc),
         high_pc = die.attribute(DW_AT::DW_AT_high_pc);
         low_pc && high_pc) {
-        return address > low_pc->as_uint64t() &&
-               address < high_pc->as_uint64t();
+        const uint64_t low = low_pc->as_uint64t();
+        const uint64_t high = is_address(high_pc->form())
+                                  ? high_pc->as_uint64t()
+                                  : low + high_pc->as_uint64t();
+        return {{.low = low, .high = high}};
     }
 
-    // No low_pc/high_pc pair, must have a set of non-contiguous address ranges.
+    // Non-contiguous ranges.
     std::optional<Attribute> ranges_offset = die.attribute(DW_AT::DW_AT_ranges);
-    if (!ranges_offset) {
-        std::cerr << "Missing DW_AT_ranges.\n";
-        return false;
-    }
+    if (!ranges_offset)
+        return {};
+    if (version >= 5)
+        return range_list(ranges_offset->as_uint64t());
+    if (!debug_ranges)
+        return {};
 
-    // Decode range entries. Stop if we find an interval containing |address|.
-    char* debug_ranges_iter = debug_ranges + ranges_offset->as_uint64t();
-    uint64_t range_start = util::read_bytes<uint64_t>(debug_ranges_iter);
-    uint64_t range_end = util::read_bytes<uint64_t>(debug_ranges_iter);
-    while (range_start && range_end) {
-        if (address >= range_start && address <= range_end)
-            return true;
-        range_start = util::read_bytes<uint64_t>(debug_ranges_iter);
-        range_end = util::read_bytes<uint64_t>(debug_ranges_iter);
+    // Range list entries are relative to the base address of the compile
+    // unit, which is the low_pc of the root DIE (if any). Base address
+    // selection entries change the base for the entries that follow.
+    uint64_t base_address = this->base_address();
+
+    std::vector<AddressRange> ranges;
+    char* iter = debug_ranges + ranges_offset->as_uint64t();
+    while (true) {
+        const uint64_t range_start = util::read_bytes<uint64_t>(iter);
+        const uint64_t range_end = util::read_bytes<uint64_t>(iter);
+        if (range_start == 0 && range_end == 0)
+            break; // End of list entry.
+        if (range_start == ~uint64_t(0)) {
+            base_address = range_end; // Base address selection entry.
+            continue;
+        }
+        ranges.push_back({.low = base_address + range_start,
+                          .high = base_address + range_end});
     }
+    return ranges;
+}
 
-    return false;
+std::vector<AddressRange> CompileUnit::range_list(uint64_t offset) const {
+    // Section 2.17.3
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    enum : uint8_t {
+        DW_RLE_end_of_list = 0x00,
+        DW_RLE_base_addressx = 0x01,
+        DW_RLE_startx_endx = 0x02,
+        DW_RLE_startx_length = 0x03,
+        DW_RLE_offset_pair = 0x04,
+        DW_RLE_base_address = 0x05,
+        DW_RLE_start_end = 0x06,
+        DW_RLE_start_length = 0x07,
+    };
+    if (!m_context->sections.debug_rnglists)
+        return {};
+    const auto address = [&](uint64_t index) {
+        return m_context->address(index).value_or(0);
+    };
+
+    uint64_t base_address = this->base_address();
+    std::vector<AddressRange> ranges;
+    char* iter = m_context->sections.debug_rnglists + offset;
+    while (true) {
+        uint64_t low = 0;
+        uint64_t high = 0;
+        switch (util::read_bytes<uint8_t>(iter)) {
+        case DW_RLE_end_of_list:
+            return ranges;
+        case DW_RLE_base_addressx:
+            base_address = address(util::decodeULEB128(iter));
+            continue;
+        case DW_RLE_startx_endx:
+            low = address(util::decodeULEB128(iter));
+            high = address(util::decodeULEB128(iter));
+            break;
+        case DW_RLE_startx_length:
+            low = address(util::decodeULEB128(iter));
+            high = low + util::decodeULEB128(iter);
+            break;
+        case DW_RLE_offset_pair:
+            low = base_address + util::decodeULEB128(iter);
+            high = base_address + util::decodeULEB128(iter);
+            break;
+        case DW_RLE_base_address:
+            base_address = util::read_bytes<uint64_t>(iter);
+            continue;
+        case DW_RLE_start_end:
+            low = util::read_bytes<uint64_t>(iter);
+            high = util::read_bytes<uint64_t>(iter);
+            break;
+        case DW_RLE_start_length:
+            low = util::read_bytes<uint64_t>(iter);
+            high = low + util::decodeULEB128(iter);
+            break;
+        default:
+            // The size of an unknown entry isn't known, so nothing after it
+            // can be read.
+            return ranges;
+        }
+        if (low < high)
+            ranges.push_back({.low = low, .high = high});
+    }
 }
 
-} // namespace smldbg::dwarf
\ No newline at end of file
+} // namespace smldbg::dwarf
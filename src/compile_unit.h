@@ -1,54 +1,131 @@
 #pragma once
 
+#include "abbreviation_table.h"
+#include "address_range_index.h"
 #include "die.h"
 #include "util.h"
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace smldbg::dwarf {
 
 class CompileUnit {
 
 public:
-    // Construct a new CompileUnit instance from a .debug_info entry.
+    // Construct a new CompileUnit instance from a .debug_info entry. Both the
+    // DWARF 4 and DWARF 5 unit headers are understood. |sections| are the
+    // sections the forms of the unit's attributes refer into.
     //
     // Preconditions: |debug_info| should point to the first byte of the
     // .debug_info entry for the compile unit.
     //
     // Postconditions : |debug_info| is advanced by the size of the compile
     // unit. I.e. after construction |debug_info| points to the first byte of
-    // the next compile unit.
-    CompileUnit(char** debug_info, char* debug_abbrev);
+    // the next compile unit. The abbreviation table of the compile unit is
+    // decoded once, up front, and shared by every DIE of the unit, as is its
+    // form context.
+    CompileUnit(char** debug_info, char* debug_abbrev,
+                const FormSections& sections = {});
 
     // Return the root (first) Debug Information Entry (DIE) for the compile
     // unit (normally DW_TAG_compile_unit). The DIE instance can be used to
     // iterate the other tags of this compile unit and extract attribute values.
     DIE root() const;
 
-    // Does |address| fall into the range of addresses represented by the
-    // compile unit?
+    // Return the DIE starting at |entry|.
     //
-    // Precondition: |debug_ranges| should point to the start of the
-    // .debug_ranges section of the corresponding ELF file.
+    // Preconditions: |entry| should point to the first byte (the abbreviation
+    // code) of an entry of this compile unit, i.e. a value previously returned
+    // by DIE::entry() for a DIE of this compile unit.
     //
     // Postconditions: None.
-    bool contains_address(uint64_t address, char* debug_ranges);
+    DIE die_at(char* entry) const;
+
+    // Return the first byte of the .debug_info entry for the compile unit.
+    char* debug_info_begin() const { return m_debug_info; }
+
+    // Return one past the last byte of the .debug_info entry for the compile
+    // unit.
+    char* debug_info_end() const {
+        return m_debug_info + unit_length + (is_64bit ? 12 : 4);
+    }
+
+    // Return the first byte of the entry referred to by |attribute|, a
+    // reference class attribute (e.g. DW_AT_specification) of a DIE of this
+    // compile unit.
+    //
+    // Preconditions: |debug_info| should point to the start of the .debug_info
+    // section of the corresponding ELF file.
+    //
+    // Postconditions: None.
+    char* reference(Attribute attribute, char* debug_info) const;
+
+    // Return the size of section offsets in the compile unit, 8 bytes in the
+    // 64-bit DWARF format and 4 otherwise.
+    unsigned offset_size() const { return is_64bit ? 8 : 4; }
+
+    // Return the version of the DWARF format the compile unit is in.
+    uint16_t dwarf_version() const { return version; }
+
+    // Return the base address of the compile unit, which range and location
+    // list entries are relative to: the DW_AT_low_pc of the root DIE, or zero
+    // if it has none.
+    uint64_t base_address() const;
+
+    // Return the form context shared by the DIEs of the unit.
+    const FormContext& form_context() const { return *m_context; }
+
+    // Return the address ranges covered by |die|, described either by a
+    // DW_AT_low_pc/DW_AT_high_pc pair or by a DW_AT_ranges list. Range list
+    // entries are relative to the base address of the compile unit. Lists
+    // are read from .debug_ranges, or .debug_rnglists from DWARF 5.
+    //
+    // Precondition: |die| should belong to this compile unit. |debug_ranges|
+    // should point to the start of the .debug_ranges section of the
+    // corresponding ELF file.
+    //
+    // Postconditions: None.
+    std::vector<AddressRange> address_ranges(DIE die, char* debug_ranges) const;
 
 private:
+    // Unit types.
+    // Section 7.5.1
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    enum : uint8_t {
+        DW_UT_compile = 0x01,
+        DW_UT_type = 0x02,
+        DW_UT_partial = 0x03,
+        DW_UT_skeleton = 0x04,
+        DW_UT_split_compile = 0x05,
+        DW_UT_split_type = 0x06,
+    };
+
+    // Return the address ranges of the DWARF 5 range list at |offset| bytes
+    // into the .debug_rnglists section.
+    std::vector<AddressRange> range_list(uint64_t offset) const;
+
     bool is_64bit;
     uint64_t unit_length;
     uint16_t version;
+    uint8_t unit_type = DW_UT_compile;
     uint64_t debug_abbrev_offset;
     uint8_t address_size;
+    uint64_t header_size; // The size of the unit header, which the root DIE
+                          // follows.
 
     char* m_debug_info; // Points to the first byte of the .debug_info entry for
                         // the compile unit.
 
-    char* m_debug_abbrev; // Points to the first byte of the .debug_abbrev
-                          // section of the parent ELF file. The start of
-                          // the debug_abbrev entry for this compile
-                          // unit is located at |m_debug_abbrev| +
-                          // |debug_abbrev_offset|.
+    std::shared_ptr<const AbbreviationTable>
+        m_abbreviations; // The decoded .debug_abbrev entry for this compile
+                         // unit, located at |debug_abbrev_offset| in the
+                         // .debug_abbrev section of the parent ELF file.
+
+    std::shared_ptr<const FormContext>
+        m_context; // What reading the attributes of the unit depends on. Held
+                   // by pointer so DIEs can refer to it while the unit moves.
 };
 
 } // namespace smldbg::dwarf
@@ -0,0 +1,137 @@
+#include "debug_registers.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+namespace smldbg {
+
+namespace {
+
+// Offset of debug register |index| in the user area.
+uint64_t offset(std::size_t index) {
+    return offsetof(struct user, u_debugreg) + index * sizeof(uint64_t);
+}
+
+// The DR7 LEN field encoding of |size|.
+// Section 17.2.5
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+std::optional<uint64_t> length_bits(std::size_t size) {
+    switch (size) {
+    case 1:
+        return 0b00;
+    case 2:
+        return 0b01;
+    case 4:
+        return 0b11;
+    case 8:
+        return 0b10;
+    default:
+        return std::nullopt;
+    }
+}
+
+// DR7 bits of |slot|: the local enable bit, and the R/W and LEN fields.
+uint64_t enable_bit(std::size_t slot) { return 1ull << (slot * 2); }
+uint64_t control_shift(std::size_t slot) { return 16 + slot * 4; }
+
+} // namespace
+
+void DebugRegisters::add_thread(int tid) {
+    m_threads.push_back(tid);
+    if (!any())
+        return;
+    for (std::size_t slot = 0; slot < slots; ++slot)
+        if (m_dr7 & enable_bit(slot))
+            poke(tid, slot, m_addresses[slot]);
+    poke(tid, 7, m_dr7);
+}
+
+void DebugRegisters::remove_thread(int tid) {
+    m_threads.erase(std::remove(m_threads.begin(), m_threads.end(), tid),
+                    m_threads.end());
+}
+
+std::optional<std::size_t> DebugRegisters::set(uint64_t address,
+                                               Condition condition,
+                                               std::size_t size) {
+    const std::optional<uint64_t> length = length_bits(size);
+    if (!length || (condition == Condition::execute && size != 1)) {
+        std::cerr << "Unsupported hardware breakpoint size " << size << ".\n";
+        return std::nullopt;
+    }
+    if (address % size != 0) {
+        std::cerr << "Hardware breakpoint address 0x" << std::hex << address
+                  << std::dec << " is not aligned to its size " << size
+                  << ".\n";
+        return std::nullopt;
+    }
+
+    std::size_t slot = 0;
+    while (slot < slots && (m_dr7 & enable_bit(slot)))
+        ++slot;
+    if (slot == slots) {
+        std::cerr << "All " << slots
+                  << " hardware breakpoints are already in use.\n";
+        return std::nullopt;
+    }
+
+    // The address must be in place before DR7 enables the slot.
+    uint64_t dr7 = m_dr7 & ~(0b1111ull << control_shift(slot));
+    dr7 |= enable_bit(slot);
+    dr7 |= (static_cast<uint64_t>(condition) | *length << 2)
+           << control_shift(slot);
+    for (const int tid : m_threads) {
+        if (poke(tid, slot, address) && poke(tid, 7, dr7))
+            continue;
+        std::cerr << "Unable to set hardware breakpoint at 0x" << std::hex
+                  << address << std::dec << ": " << std::strerror(errno)
+                  << ".\n";
+        for (const int programmed : m_threads)
+            poke(programmed, 7, m_dr7);
+        return std::nullopt;
+    }
+    m_addresses[slot] = address;
+    m_dr7 = dr7;
+    return slot;
+}
+
+void DebugRegisters::clear(std::size_t slot) {
+    if (!(m_dr7 & enable_bit(slot)))
+        return;
+    m_dr7 &= ~(enable_bit(slot) | 0b1111ull << control_shift(slot));
+    for (const int tid : m_threads)
+        poke(tid, 7, m_dr7);
+}
+
+std::vector<std::size_t> DebugRegisters::triggered(int tid) {
+    if (!any())
+        return {};
+
+    // B0 to B3 of DR6 flag the breakpoints whose conditions were met.
+    // Section 17.2.3
+    // https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+    errno = 0;
+    const uint64_t dr6 = ptrace(PTRACE_PEEKUSER, tid, offset(6), nullptr);
+    if (errno != 0)
+        return {};
+    std::vector<std::size_t> fired;
+    for (std::size_t slot = 0; slot < slots; ++slot) {
+        if ((dr6 & (1ull << slot)) && (m_dr7 & enable_bit(slot)))
+            fired.push_back(slot);
+    }
+    if (!fired.empty())
+        poke(tid, 6, 0);
+    return fired;
+}
+
+bool DebugRegisters::poke(int tid, std::size_t index, uint64_t value) {
+    return ptrace(PTRACE_POKEUSER, tid, offset(index),
+                  reinterpret_cast<void*>(value)) == 0;
+}
+
+} // namespace smldbg
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace smldbg {
+
+// Programs the x86 debug registers of a stopped target through
+// PTRACE_POKEUSER. DR0 to DR3 hold the addresses of up to four hardware
+// breakpoints or watchpoints, DR7 enables them and sets what they trap on and
+// DR6 reports which of them fired. Debug registers belong to a thread, and
+// new threads start with them clear, so every thread of the target is
+// programmed alike. Unlike software breakpoints the target's code is never
+// modified, and the kernel sets the resume flag after an execution
+// breakpoint fires, so resuming doesn't need to step over it.
+// Section 17.2
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+class DebugRegisters {
+public:
+    static constexpr std::size_t slots = 4;
+
+    // The access that triggers a breakpoint, encoded as in the DR7 R/W
+    // fields. Intel has no read-only watchpoints.
+    enum class Condition : uint8_t {
+        execute = 0b00,
+        write = 0b01,
+        read_write = 0b11,
+    };
+
+    DebugRegisters() = default;
+
+    // Program the stopped thread |tid| with the breakpoints set so far, and
+    // include it when breakpoints are set or cleared from now on.
+    void add_thread(int tid);
+
+    // Forget about the thread |tid|, e.g. after it exits.
+    void remove_thread(int tid);
+
+    // Program a free debug register to trap on |condition| accesses to the
+    // |size| bytes at |address|. Returns the slot used.
+    //
+    // Preconditions: |size| is 1 for execution breakpoints and 1, 2, 4 or 8
+    // for watchpoints, and |address| is aligned to |size|.
+    //
+    // Postconditions: Returns std::nullopt, after printing the reason, if the
+    // preconditions don't hold, every slot is in use or the kernel rejected
+    // the breakpoint.
+    std::optional<std::size_t> set(uint64_t address, Condition condition,
+                                   std::size_t size);
+
+    // Disable the breakpoint in |slot|, making the slot free for reuse.
+    void clear(std::size_t slot);
+
+    // Return the slots of the breakpoints that stopped the thread |tid|, in
+    // slot order, and reset the status in DR6 so that the next stop starts
+    // from a clean slate. Several can fire on the same stop, e.g. a
+    // watchpoint on a write and an execution breakpoint on the instruction
+    // after it.
+    std::vector<std::size_t> triggered(int tid);
+
+    // Is any slot in use?
+    bool any() const { return m_dr7 != 0; }
+
+private:
+    // Write |value| to debug register |index| of the thread |tid|.
+    bool poke(int tid, std::size_t index, uint64_t value);
+
+    std::vector<int> m_threads; // Thread ids of the target.
+    std::array<uint64_t, slots> m_addresses = {}; // DR0 to DR3.
+    uint64_t m_dr7 = 0; // The value last written to DR7.
+};
+
+} // namespace smldbg
@@ -5,36 +5,143 @@
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 
+#include <sys/mman.h>
 #include <sys/ptrace.h>
 #include <sys/signal.h>
+#include <sys/syscall.h>
 #include <sys/user.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 namespace smldbg {
 
+namespace {
+
+// Whether the waitpid(...) |status| is a stop the debugger asked for.
+// Attaching interrupts threads with PTRACE_INTERRUPT, which reports a
+// PTRACE_EVENT_STOP, and stopping threads sends them a SIGSTOP.
+bool is_requested_stop(int status) {
+    return status >> 16 == PTRACE_EVENT_STOP ||
+           (status >> 16 == 0 && WSTOPSIG(status) == SIGSTOP);
+}
+
+} // namespace
+
 Debugger::Debugger(int argc, char** argv) : m_is_running(false) {
-    m_target = argv[1];
-    auto elf_stream = std::make_unique<std::ifstream>(m_target);
-    if (!(*elf_stream)) {
-        std::cerr << "Unable to open target " << m_target << ".\n";
+    // 'profile' as the first argument selects the profile mode.
+    int first = 1;
+    if (argc > 1 && std::string_view(argv[1]) == "profile") {
+        m_profile_options.emplace();
+        first = 2;
+    }
+
+    // Options take their value after an '=' or as the next argument.
+    const auto option_value =
+        [&](int& i,
+            std::string_view option) -> std::optional<std::string_view> {
+        std::string_view argument = argv[i];
+        if (!argument.starts_with(option))
+            return std::nullopt;
+        argument.remove_prefix(option.size());
+        if (argument.starts_with("="))
+            return argument.substr(1);
+        if (argument.empty() && i + 1 < argc)
+            return argv[++i];
+        return std::nullopt;
+    };
+    const auto parse_number = [](std::string_view value,
+                                 std::string_view option, unsigned& number) {
+        const auto [end, error] =
+            std::from_chars(value.begin(), value.end(), number);
+        if (error != std::errc() || end != value.end()) {
+            std::cerr << "Invalid " << option << " value.\n";
+            std::exit(1);
+        }
+    };
+
+    // The first positional argument is the debug target.
+    unsigned index_threads = 0;
+    std::filesystem::path index_cache_directory =
+        dwarf::IndexCache::default_directory();
+    for (int i = first; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (const auto value = option_value(i, "--index-threads"); value) {
+            parse_number(*value, "--index-threads", index_threads);
+        } else if (argument == "--no-index-cache") {
+            index_cache_directory.clear();
+        } else if (!m_profile_options) {
+            if (m_target.empty())
+                m_target = argument;
+        } else if (const auto value = option_value(i, "--hz"); value) {
+            parse_number(*value, "--hz", m_profile_options->frequency);
+            if (m_profile_options->frequency == 0) {
+                std::cerr << "Invalid --hz value.\n";
+                std::exit(1);
+            }
+        } else if (const auto value = option_value(i, "--duration"); value) {
+            m_profile_options->duration = util::parse_duration(*value);
+            if (!m_profile_options->duration) {
+                std::cerr << "Invalid --duration value.\n";
+                std::exit(1);
+            }
+        } else if (const auto value = option_value(i, "--output"); value) {
+            m_profile_options->output = *value;
+        } else if (argument == "--lines") {
+            m_profile_options->lines = true;
+        } else if (m_target.empty()) {
+            m_target = argument;
+        }
+    }
+    if (m_target.empty()) {
+        std::cerr << "No target provided...\n";
         std::exit(1);
     }
 
-    m_elf = elf::ELF(std::move(elf_stream));
-    m_dwarf = dwarf::Dwarf(&m_elf);
+    // A process id rather than a path profiles a running process, debugged
+    // through the executable it is running.
+    int pid = 0;
+    if (m_profile_options && !std::filesystem::exists(m_target) &&
+        std::from_chars(m_target.data(), m_target.data() + m_target.size(),
+                        pid)
+                .ptr == m_target.data() + m_target.size() &&
+        pid > 0) {
+        m_profile_options->pid = pid;
+        m_target = "/proc/" + m_target + "/exe";
+    }
+
+    m_elf = elf::ELF(m_target);
+    m_dwarf = dwarf::Dwarf(&m_elf, index_threads, index_cache_directory);
+
+    const dwarf::IndexStatistics& statistics = m_dwarf.index_statistics();
+    if (!statistics.cache.empty())
+        std::cout << "Loaded the indexes of " << statistics.compile_units
+                  << " compile units from " << statistics.cache.string()
+                  << " in " << statistics.elapsed.count() << " ms.\n";
+    else
+        std::cout << "Indexed " << statistics.compile_units
+                  << " compile units in " << statistics.elapsed.count()
+                  << " ms using " << statistics.threads << " threads.\n";
 }
 
 void Debugger::exec() {
+    if (m_profile_options) {
+        profile(*m_profile_options);
+        return;
+    }
+
     CommandParser command_parser;
     while (true) {
-        // Display the prompt and wait for user input.
-        std::cout << "smldbg >> ";
-        std::string input;
-        std::getline(std::cin, input);
+        // Display the prompt and wait for user input. Running out of input
+        // is as good as quitting.
+        std::cout << "smldbg >> " << std::flush;
+        const std::string input = read_line().value_or("quit");
 
         // Parse the requested command and any arguments.
         const CommandWithArguments command_with_args =
@@ -44,6 +151,7 @@ void Debugger::exec() {
         if (!m_is_running) {
             const bool valid_command =
                 command_with_args.command == Command::Start ||
+                command_with_args.command == Command::Attach ||
                 command_with_args.command == Command::Quit;
             if (!valid_command) {
                 std::cerr << "The target is not currently running.\n";
@@ -58,14 +166,69 @@ void Debugger::exec() {
                 std::cerr << "Expected a breakpoint location.\n";
                 break;
             }
-            // Breakpoint is either of the form 'function' or 'file:line'
-            if (command_with_args.arguments->find(':') != std::string::npos) {
-                const auto tokens =
-                    util::tokenize(*command_with_args.arguments, ':');
-                break_on_line_and_file(std::stoul(tokens[1]), tokens[0]);
-            } else {
-                break_on_function(*command_with_args.arguments);
+            // Breakpoint is either of the form 'function' or 'file:line',
+            // optionally followed by 'if condition'. Qualified function names
+            // (e.g. 'ns::function') contain colons too, so only treat a single
+            // colon followed by digits as a line.
+            {
+                std::string_view location = *command_with_args.arguments;
+                std::string_view condition;
+                if (const auto split = location.find(" if ");
+                    split != std::string_view::npos) {
+                    condition = location.substr(split + 4);
+                    location = location.substr(0, split);
+                }
+                if (util::is_line_location(location)) {
+                    const auto colon = location.rfind(':');
+                    break_on_line_and_file(
+                        std::stoul(std::string(location.substr(colon + 1))),
+                        location.substr(0, colon), condition);
+                } else {
+                    break_on_function(location, condition);
+                }
+            }
+            break;
+        case Command::HardwareBreak:
+            if (command_with_args.arguments->empty()) {
+                std::cerr << "Expected a breakpoint location.\n";
+                break;
+            }
+            hardware_break(*command_with_args.arguments);
+            break;
+        case Command::Watch:
+        case Command::AccessWatch:
+            if (command_with_args.arguments->empty()) {
+                std::cerr << "Expected a variable name.\n";
+                break;
             }
+            watch(*command_with_args.arguments,
+                  command_with_args.command == Command::Watch
+                      ? DebugRegisters::Condition::write
+                      : DebugRegisters::Condition::read_write);
+            break;
+        case Command::Attach: {
+            if (m_is_running) {
+                std::cerr << "The target is already running.\n";
+                break;
+            }
+            int pid = 0;
+            const std::string& arguments = *command_with_args.arguments;
+            const char* last = arguments.data() + arguments.size();
+            const auto [end, error] =
+                std::from_chars(arguments.data(), last, pid);
+            if (error != std::errc() || end != last || pid <= 0) {
+                std::cerr << "Expected a process id.\n";
+                break;
+            }
+            attach(pid);
+            break;
+        }
+        case Command::Detach:
+            if (!m_attached) {
+                std::cerr << "The target was not attached to.\n";
+                break;
+            }
+            detach();
             break;
         case Command::BackTrace:
             backtrace();
@@ -79,8 +242,19 @@ void Debugger::exec() {
         case Command::Finish:
             continue_to_end_of_stack_frame();
             break;
+        case Command::Interrupt:
+            // Only meaningful while the target runs, see wait_for_thread(...).
+            std::cerr << "The target is already stopped.\n";
+            break;
         case Command::Info:
-            print_hardware_registers();
+            if (command_with_args.arguments->starts_with("b"))
+                print_breakpoints();
+            else if (command_with_args.arguments->starts_with("th"))
+                print_threads();
+            else if (command_with_args.arguments->starts_with("cache"))
+                print_cache_statistics();
+            else
+                print_hardware_registers();
             break;
         case Command::Next:
             next();
@@ -90,17 +264,16 @@ void Debugger::exec() {
                 std::cout << "Expected a variable name\n.";
                 break;
             }
-            if (const auto value =
-                    get_variable_value(*command_with_args.arguments);
-                value) {
-                std::cout << *value << "\n";
-            } else {
-                std::cout << "Unable to retrieve value for variable "
-                          << *command_with_args.arguments << ".\n";
-            }
+            print_variable(*command_with_args.arguments);
             break;
         case Command::Quit:
-            std::cout << "Sending SIGTERM to process " << m_pid << "\n";
+            // Leave attached processes running, as gdb does.
+            if (m_attached)
+                detach();
+            if (!m_is_running)
+                exit(0);
+            std::cout << std::dec << "Sending SIGTERM to process " << m_pid
+                      << "\n";
             kill(m_pid, SIGTERM);
             exit(0);
         case Command::Set: {
@@ -110,7 +283,7 @@ void Debugger::exec() {
                 std::cerr << "Expected a variable name and value.\n";
                 break;
             }
-            set_variable_value(args[0], std::stoi(args[1]));
+            set_variable_value(args[0], args[1]);
             break;
         }
         case Command::Step: {
@@ -125,12 +298,43 @@ void Debugger::exec() {
         case Command::Start:
             start();
             break;
+        case Command::Thread: {
+            const std::string& arguments = *command_with_args.arguments;
+            if (arguments.empty()) {
+                std::cout << std::dec << "[Current thread is "
+                          << m_thread->number << " (" << m_thread->tid
+                          << ")]\n";
+                break;
+            }
+            int number = 0;
+            const char* last = arguments.data() + arguments.size();
+            const auto [end, error] =
+                std::from_chars(arguments.data(), last, number);
+            if (error != std::errc() || end != last) {
+                std::cerr << "Expected a thread number.\n";
+                break;
+            }
+            select_thread(number);
+            break;
+        }
         case Command::Unknown:
             break;
         }
     }
 }
 
+std::optional<std::string> Debugger::read_line() {
+    while (true) {
+        if (auto line = m_events.next_line(); line)
+            return line;
+        if (m_events.end_of_input())
+            return std::nullopt;
+
+        // The target is stopped, so there is nothing to interrupt.
+        m_events.wait();
+    }
+}
+
 void Debugger::start() {
     // Sanity check.
     if (m_is_running)
@@ -140,97 +344,956 @@ void Debugger::start() {
     int wait_status = 0;
     const auto pid = fork();
     if (pid == 0) {
+        m_events.restore_signal_mask();
         ptrace(PTRACE_TRACEME, nullptr, 0, nullptr);
         std::cout << "Starting: " << m_target << "\n";
         execl(m_target.c_str(), m_target.c_str(), nullptr);
     } else if (pid > 0) {
         m_pid = pid;
+        m_memory = Memory(pid);
+        m_unwinder = Unwinder(pid, &m_memory);
+        m_debug_registers = DebugRegisters();
+        m_threads = ThreadTable();
+        m_events.watch_process(pid);
         waitpid(pid, &wait_status, 0);
+
+        // Trace threads as they are created.
+        ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACECLONE);
+        m_thread = &add_thread(pid);
+        m_reported_tid = pid;
     } else {
         std::cerr << "fork() failed with code " << pid << "\n";
         std::exit(1);
     }
 
     m_is_running = true;
+    detect_load_bias();
+    m_scratch_page.reset();
+    m_scratch_slots.clear();
     break_on_function("main");
     continue_execution();
 }
 
-void Debugger::wait_for_target() {
-    int status = 0;
-    waitpid(m_pid, &status, 0);
+void Debugger::attach(int pid) {
+    m_pid = pid;
+    m_memory = Memory(pid);
+    m_unwinder = Unwinder(pid, &m_memory);
+    m_debug_registers = DebugRegisters();
+    m_threads = ThreadTable();
+
+    // Seize every thread, rescanning until no new threads turn up as threads
+    // already seized are traced as they create new threads. PTRACE_SEIZE
+    // doesn't stop the thread, so interrupt it. The interrupt is reported as
+    // a PTRACE_EVENT_STOP as soon as the thread is scheduled, with no signal
+    // left pending to disturb it after detaching.
+    const std::string tasks = "/proc/" + std::to_string(pid) + "/task";
+    for (bool seized = true; seized;) {
+        seized = false;
+        std::error_code error;
+        for (const auto& task :
+             std::filesystem::directory_iterator(tasks, error)) {
+            const int tid = std::stoi(task.path().filename().string());
+            if (m_threads.find(tid))
+                continue;
+            if (ptrace(PTRACE_SEIZE, tid, 0, PTRACE_O_TRACECLONE) == -1 ||
+                ptrace(PTRACE_INTERRUPT, tid, 0, 0) == -1) {
+                // Other threads may have exited, or already be traced as
+                // children of seized threads.
+                if (tid != pid)
+                    continue;
+                std::cerr << "Unable to attach to process " << pid << ": "
+                          << std::strerror(errno) << "\n";
+                for (auto& [seized_tid, thread] : m_threads)
+                    ptrace(PTRACE_DETACH, seized_tid, 0, 0);
+                m_threads = ThreadTable();
+                return;
+            }
+            Thread& thread = add_thread(tid);
+            thread.running = true;
+            thread.stop_requested = true;
+            seized = true;
+        }
+        if (error) {
+            std::cerr << "Unable to attach to process " << pid << ": "
+                      << error.message() << "\n";
+            return;
+        }
+    }
+    stop_all_threads();
+    m_thread = m_threads.find(pid);
+    m_reported_tid = pid;
+    m_is_running = true;
+    m_attached = true;
+    m_events.watch_process(pid);
+
+    // The Dwarf data is only any use if the process is running the target.
+    std::error_code error;
+    const auto executable = std::filesystem::read_symlink(
+        "/proc/" + std::to_string(pid) + "/exe", error);
+    if (!error &&
+        !std::filesystem::equivalent(executable, m_target, error))
+        std::cerr << "Warning: process " << pid << " is running "
+                  << executable.string() << ", not " << m_target << ".\n";
+
+    detect_load_bias();
+    m_scratch_page.reset();
+    m_scratch_slots.clear();
+
+    std::cout << "Attached to process " << pid << " with " << m_threads.size()
+              << " threads";
+    const uint64_t rip = get_register_value(HardwareRegister::rip);
+    if (const auto function_name =
+            m_dwarf.function_from_program_counter(rip - m_load_bias);
+        function_name)
+        std::cout << " in " << *function_name;
+    if (const auto location = source_location_at(rip); location)
+        std::cout << " at " << location->file << ":" << location->line;
+    std::cout << "\n";
+}
+
+void Debugger::detach() {
+    // Restore the target's code and debug registers before letting it go.
+    for (auto& [address, breakpoint] : m_breakpoints)
+        breakpoint.disable();
+    m_breakpoints.clear();
+    for (std::size_t slot = 0; slot < DebugRegisters::slots; ++slot) {
+        if (!m_hardware_breakpoints[slot])
+            continue;
+        m_debug_registers.clear(slot);
+        m_hardware_breakpoints[slot].reset();
+    }
+    m_memory.invalidate();
+
+    // Write back any modified registers. All threads are stopped, with no
+    // stops left pending, so nothing is left to disturb them.
+    for (auto& [tid, thread] : m_threads) {
+        thread.registers.invalidate();
+        if (ptrace(PTRACE_DETACH, tid, 0, 0) == -1)
+            std::cerr << "Unable to detach from thread " << tid << ": "
+                      << std::strerror(errno) << "\n";
+    }
+    m_events.unwatch_process();
+    std::cout << "Detached from process " << m_pid << "\n";
+    m_threads = ThreadTable();
+    m_thread = nullptr;
+    m_is_running = false;
+    m_attached = false;
+    m_load_bias = 0;
+}
+
+bool Debugger::detect_load_bias() {
+    m_load_bias = 0;
+    if (!m_elf.is_position_independent())
+        return true;
+
+    // The bias is the difference between where the first loadable segment
+    // was mapped and its link-time address.
+    const auto& program_headers = m_elf.program_headers();
+    const auto first_segment = std::find_if(
+        program_headers.begin(), program_headers.end(),
+        [](const elf::ELFProgramHeader& header) {
+            return header.P_TYPE == elf::PT_LOAD;
+        });
+    if (first_segment == program_headers.end())
+        return true;
+
+    // Each line of the maps file is of the form
+    // 'start-end permissions offset device inode path'.
+    // https://man7.org/linux/man-pages/man5/proc.5.html
+    const std::string proc = "/proc/" + std::to_string(m_pid);
+    std::error_code error;
+    const auto executable =
+        std::filesystem::read_symlink(proc + "/exe", error);
+    std::ifstream maps(proc + "/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        const std::vector<std::string> fields = util::tokenize(line, ' ');
+        if (fields.size() < 6 || !line.ends_with(" " + executable.string()))
+            continue;
+        if (std::stoull(fields[2], nullptr, 16) !=
+            (first_segment->P_OFFSET & ~uint64_t(0xfff)))
+            continue;
+        const uint64_t start = std::stoull(fields[0], nullptr, 16);
+        m_load_bias = start - (first_segment->P_VADDR & ~uint64_t(0xfff));
+        return true;
+    }
+
+    std::cerr << "Unable to find the load address of " << m_target << ".\n";
+    return false;
+}
+
+std::optional<dwarf::SourceLocation>
+Debugger::source_location_at(uint64_t address) {
+    auto location =
+        m_dwarf.source_location_from_program_counter(address - m_load_bias,
+                                                     false);
+    if (location)
+        location->address += m_load_bias;
+    return location;
+}
+
+std::optional<dwarf::AddressRange> Debugger::line_range_at(uint64_t address) {
+    auto range = m_dwarf.line_range_from_program_counter(address - m_load_bias);
+    if (range) {
+        range->low += m_load_bias;
+        range->high += m_load_bias;
+    }
+    return range;
+}
+
+Thread& Debugger::add_thread(int tid) {
+    Thread& thread = m_threads.add(tid);
+    m_debug_registers.add_thread(tid);
+    if (thread.number > 1)
+        std::cout << std::dec << "[New thread " << thread.number << " ("
+                  << tid << ")]\n";
+    return thread;
+}
+
+void Debugger::remove_thread(int tid) {
+    Thread* thread = m_threads.find(tid);
+    if (!thread)
+        return;
+    std::cout << std::dec << "[Thread " << thread->number << " (" << tid
+              << ") exited]\n";
+    if (m_thread == thread)
+        m_thread = nullptr;
+    m_debug_registers.remove_thread(tid);
+    m_threads.remove(tid);
+}
+
+Thread* Debugger::wait_for_thread(int& status, bool interruptible) {
+    // Stops that are sure to follow soon, like single steps, are waited for
+    // directly. Otherwise only block in the event loop, so that the user can
+    // interrupt the target meanwhile. SIGCHLD, or the target's exit, says
+    // when there is something for waitpid(...) to report.
+    int tid = interruptible ? 0 : waitpid(-1, &status, __WALL);
+    while (tid == 0 && (tid = waitpid(-1, &status, __WALL | WNOHANG)) == 0) {
+        const EventLoop::Events events = m_events.wait();
+        bool interrupt = events.interrupt;
+        if (events.input) {
+            CommandParser command_parser;
+            interrupt |= m_events.erase_lines([&](const std::string& line) {
+                return command_parser.parse(line).command ==
+                       Command::Interrupt;
+            }) > 0;
+        }
+        if (interrupt)
+            interrupt_target();
+    }
+    if (tid == -1) {
+        std::cerr << "waitpid() failed: " << std::strerror(errno) << "\n";
+        std::exit(1);
+    }
 
     // TODO: Handle restarting processes.
     if (WIFEXITED(status) || WIFSIGNALED(status)) {
-        print_waitpid_status(status);
-        std::exit(1);
+        if (tid == m_pid) {
+            print_waitpid_status(status);
+            std::exit(1);
+        }
+        remove_thread(tid);
+        return nullptr;
     }
+
+    Thread* thread = m_threads.find(tid);
+    if (!thread) {
+        add_thread(tid).stop_reason = StopReason::created;
+        return nullptr;
+    }
+    thread->running = false;
+    return thread;
 }
 
-void Debugger::continue_execution() {
-    ptrace(PTRACE_CONT, m_pid, 0, nullptr);
-    wait_for_target();
+Thread& Debugger::add_cloned_thread(Thread& parent) {
+    unsigned long tid = 0;
+    ptrace(PTRACE_GETEVENTMSG, parent.tid, 0, &tid);
+    if (Thread* thread = m_threads.find(tid); thread)
+        return *thread;
+
+    // New threads start with a stop of their own, which is sure to follow.
+    int status = 0;
+    waitpid(tid, &status, __WALL);
+    Thread& thread = add_thread(tid);
+    thread.stop_reason = StopReason::created;
+    return thread;
+}
+
+void Debugger::record_stop(Thread& thread, int status) {
+    thread.stop_signal = WSTOPSIG(status);
+    if (thread.stop_signal != SIGTRAP) {
+        thread.stop_reason = StopReason::signal;
+    } else if (thread.resumed_with == PTRACE_SINGLESTEP) {
+        thread.stop_reason = StopReason::step;
+    } else {
+        siginfo_t info = {};
+        ptrace(PTRACE_GETSIGINFO, thread.tid, 0, &info);
+        thread.stop_reason = info.si_code == TRAP_HWBKPT
+                                 ? StopReason::hardware
+                                 : StopReason::breakpoint;
+    }
+}
+
+void Debugger::resume_thread(Thread& thread, __ptrace_request request,
+                             int signal) {
+    thread.registers.invalidate();
+    ptrace(request, thread.tid, 0, signal);
+    thread.running = true;
+    thread.resumed_with = request;
+}
+
+Thread& Debugger::wait_for_event(int& status, bool all_threads,
+                                  bool interruptible) {
+    while (true) {
+        Thread* thread = wait_for_thread(status, interruptible);
+        if (!thread)
+            continue;
+
+        if (thread->stop_requested && is_requested_stop(status)) {
+            thread->stop_requested = false;
+            thread->stop_reason = StopReason::interrupted;
+            thread->stop_signal = SIGSTOP;
+            return *thread;
+        }
+
+        // Thread creation isn't worth stopping for.
+        if (status >> 8 == (SIGTRAP | PTRACE_EVENT_CLONE << 8)) {
+            Thread& created = add_cloned_thread(*thread);
+            resume_thread(*thread, thread->resumed_with);
+            if (all_threads)
+                resume_thread(created, PTRACE_CONT);
+            continue;
+        }
+        record_stop(*thread, status);
+        return *thread;
+    }
+}
+
+void Debugger::interrupt_target() {
+    // Stop one running thread, preferably the current one, and the others
+    // are stopped along with it as usual.
+    Thread* stopping = m_thread && m_thread->running ? m_thread : nullptr;
+    for (auto& [tid, thread] : m_threads) {
+        if (thread.stop_requested)
+            return; // Already interrupted.
+        if (!stopping && thread.running)
+            stopping = &thread;
+    }
+    if (!stopping)
+        return;
+    tgkill(m_pid, stopping->tid, SIGSTOP);
+    stopping->stop_requested = true;
+}
+
+bool Debugger::was_interrupted() const {
+    // Ctrl-C reaches a target started from the same terminal as a SIGINT, as
+    // well as reaching the debugger.
+    return m_thread->stop_reason == StopReason::interrupted ||
+           (m_thread->stop_reason == StopReason::signal &&
+            m_thread->stop_signal == SIGINT);
+}
+
+void Debugger::stop_all_threads() {
+    for (auto& [tid, thread] : m_threads) {
+        // A thread that was interrupted may have stopped for something else
+        // before the SIGSTOP arrived. Let it take the SIGSTOP, as below.
+        if (!thread.running && thread.stop_requested) {
+            resume_thread(thread, PTRACE_CONT);
+            continue;
+        }
+        if (!thread.running || thread.stop_requested)
+            continue;
+        tgkill(m_pid, tid, SIGSTOP);
+        thread.stop_requested = true;
+        thread.stop_reason = StopReason::stopped;
+    }
+
+    const auto any_running = [&] {
+        return std::any_of(m_threads.begin(), m_threads.end(),
+                           [](const auto& thread) {
+                               return thread.second.running;
+                           });
+    };
+    while (any_running()) {
+        int status = 0;
+        Thread* thread = wait_for_thread(status);
+        if (!thread)
+            continue;
+
+        if (thread->stop_requested && is_requested_stop(status)) {
+            thread->stop_requested = false;
+            if (thread->stop_reason == StopReason::none)
+                thread->stop_reason = StopReason::stopped;
+            continue;
+        }
+
+        if (status >> 8 == (SIGTRAP | PTRACE_EVENT_CLONE << 8)) {
+            add_cloned_thread(*thread);
+        } else {
+            record_stop(*thread, status);
+            if (cancel_breakpoint_hit(*thread))
+                thread->stop_reason = StopReason::stopped;
+            else
+                thread->pending_status = status;
+        }
+
+        // The thread stopped for something else before the SIGSTOP arrived.
+        // Let it take the SIGSTOP, which is delivered before the thread gets
+        // back to running its own code, so that none is left pending.
+        if (thread->stop_requested)
+            resume_thread(*thread, PTRACE_CONT);
+    }
+}
+
+bool Debugger::cancel_breakpoint_hit(Thread& thread) {
+    if (thread.stop_reason != StopReason::breakpoint)
+        return false;
+    const uint64_t address = thread.registers.get().rip - 1;
+    if (!trap_at(address))
+        return false;
+    thread.registers.modify().rip = address;
+    return true;
+}
+
+int Debugger::resume(__ptrace_request request, bool all_threads) {
+    all_threads = all_threads && request == PTRACE_CONT;
+
+    // Report stops held back from the last time the threads were stopped
+    // before letting anything run.
+    if (all_threads) {
+        for (auto& [tid, thread] : m_threads) {
+            if (!thread.pending_status)
+                continue;
+            m_thread = &thread;
+            return *std::exchange(thread.pending_status, std::nullopt);
+        }
+    }
+
+    m_memory.invalidate();
+    if (all_threads) {
+        for (auto& [tid, thread] : m_threads)
+            resume_thread(thread, request);
+    } else {
+        resume_thread(*m_thread, request);
+    }
+
+    // Running threads can be interrupted, single steps finish soon enough.
+    int status = 0;
+    m_thread = &wait_for_event(status, all_threads, request == PTRACE_CONT);
+    stop_all_threads();
+    return status;
+}
+
+bool Debugger::skip_breakpoint_hit() {
+    if (was_interrupted())
+        return false;
+    const auto rip = get_register_value(HardwareRegister::rip);
+    if (!has_breakpoint(rip - 1))
+        return false;
+    Breakpoint& breakpoint = m_breakpoints.at(rip - 1);
+    ++breakpoint.m_hits;
+    if (!breakpoint.m_condition)
+        return false;
+
+    // Variables are read as when printing them, as many bytes as their type
+    // has, then extended to 64 bits.
+    ++breakpoint.m_evaluations;
+    const Unwinder::Registers registers =
+        Unwinder::frame_registers(m_thread->registers.get());
+    const std::optional<int64_t> value = breakpoint.m_condition->evaluate(
+        [&](int64_t id) -> std::optional<int64_t> {
+            const dwarf::VariableLocation& variable =
+                breakpoint.m_condition_variables[id];
+            const auto location = evaluate_location(variable, registers);
+            if (!location)
+                return std::nullopt;
+            const auto bytes =
+                read_location(*location, registers, variable.type->size());
+            if (!bytes)
+                return std::nullopt;
+            return dwarf::integer_value(variable.type, *bytes);
+        });
+    if (!value) {
+        std::cerr << "Error evaluating condition '"
+                  << breakpoint.m_condition->expression() << "'.\n";
+        return false;
+    }
+    if (*value != 0)
+        return false;
+
+    // Back up over the trap, the instruction hasn't run yet.
+    m_thread->registers.modify().rip = rip - 1;
+    return true;
+}
+
+bool Debugger::handle_breakpoint_hit() {
+    report_thread_switch();
+    if (handle_interrupt())
+        return true;
+    if (handle_hardware_breakpoint_hit())
+        return true;
 
     // Check if we have stopped on a breakpoint.
     const auto rip = get_register_value(HardwareRegister::rip);
-    if (m_breakpoints.count(rip - 1) == 0)
-        return;
+    if (!has_breakpoint(rip - 1))
+        return false;
 
-    // Fixup the breakpoint.
-    auto& [address, breakpoint] = *m_breakpoints.find(rip - 1);
-    breakpoint.step_over();
+    // Back up over the trap and execute the original instruction.
+    const uint64_t address = rip - 1;
+    m_thread->registers.modify().rip = address;
+    step_instruction();
+    m_thread->stop_reason = StopReason::breakpoint;
 
     // Print some information about the breakpoint we hit.
     std::cout << "Hit breakpoint at " << std::hex << "0x" << address;
-    if (const auto source_location =
-            m_dwarf.source_location_from_program_counter(address, false);
+    if (const auto source_location = source_location_at(address);
         source_location)
         std::cout << " (" << source_location->file << ":" << std::dec
                   << source_location->line << ")";
     std::cout << "\n";
+    return true;
+}
+
+bool Debugger::handle_interrupt() {
+    if (!was_interrupted())
+        return false;
+    const auto rip = get_register_value(HardwareRegister::rip);
+    std::cout << "Interrupted at " << std::hex << "0x" << rip;
+    if (const auto source_location = source_location_at(rip); source_location)
+        std::cout << " (" << source_location->file << ":" << std::dec
+                  << source_location->line << ")";
+    std::cout << "\n";
+    return true;
+}
+
+bool Debugger::has_breakpoint(uint64_t address) const {
+    const auto found = m_breakpoints.find(address);
+    return found != m_breakpoints.end() && found->second.enabled();
+}
+
+Breakpoint* Debugger::trap_at(uint64_t address) {
+    if (const auto found = m_breakpoints.find(address);
+        found != m_breakpoints.end() && found->second.enabled())
+        return &found->second;
+    for (Breakpoint& breakpoint : m_temporary_breakpoints)
+        if (breakpoint.enabled() && breakpoint.address() == address)
+            return &breakpoint;
+    return nullptr;
+}
+
+void Debugger::report_thread_switch() {
+    if (!m_thread || m_thread->tid == m_reported_tid)
+        return;
+    std::cout << std::dec << "[Switching to thread " << m_thread->number << " ("
+              << m_thread->tid << ")]\n";
+    m_reported_tid = m_thread->tid;
+}
+
+bool Debugger::handle_hardware_breakpoint_hit() {
+    std::vector<std::size_t> slots = m_debug_registers.triggered(m_thread->tid);
+    std::erase_if(slots, [&](std::size_t slot) {
+        return !m_hardware_breakpoints[slot];
+    });
+    if (slots.empty())
+        return false;
+
+    // A watchpoint traps after the access, just before the next instruction,
+    // and an execution breakpoint on that instruction fires on the same
+    // stop. The kernel then sets the resume flag, so the thread won't stop
+    // at the breakpoint again when resumed: it has to be reported now.
+    // Watchpoints are reported first, as the access happened first.
+    std::stable_partition(slots.begin(), slots.end(), [&](std::size_t slot) {
+        return m_hardware_breakpoints[slot]->condition !=
+               DebugRegisters::Condition::execute;
+    });
+    for (const std::size_t slot : slots)
+        report_hardware_breakpoint_hit(slot);
+    return true;
+}
+
+void Debugger::report_hardware_breakpoint_hit(std::size_t slot) {
+    HardwareBreakpoint& breakpoint = *m_hardware_breakpoints[slot];
+
+    // Execution breakpoints trap before the instruction runs, and the kernel
+    // sets the resume flag so that it doesn't trap again when resumed.
+    if (breakpoint.condition == DebugRegisters::Condition::execute) {
+        std::cout << "Hit hardware breakpoint at " << std::hex << "0x"
+                  << breakpoint.address;
+        if (const auto source_location = source_location_at(breakpoint.address);
+            source_location)
+            std::cout << " (" << source_location->file << ":" << std::dec
+                      << source_location->line << ")";
+        std::cout << "\n";
+        return;
+    }
+
+    // Watchpoints trap after the access.
+    const uint64_t value = read_watched_value(breakpoint).value_or(0);
+    if (breakpoint.condition == DebugRegisters::Condition::write) {
+        std::cout << "Hardware watchpoint " << std::dec << slot + 1 << ": "
+                  << breakpoint.expression << "\n"
+                  << "Old value = " << breakpoint.value << "\n"
+                  << "New value = " << value << "\n";
+    } else {
+        std::cout << "Hardware access (read/write) watchpoint " << std::dec
+                  << slot + 1 << ": " << breakpoint.expression << "\n"
+                  << "Value = " << value << "\n";
+    }
+    breakpoint.value = value;
+}
+
+void Debugger::step_instruction() {
+    const auto rip = get_register_value(HardwareRegister::rip);
+    if (Breakpoint* breakpoint = trap_at(rip); breakpoint) {
+        // Execute the original instruction rather than the trap, out of line
+        // if possible. Otherwise remove the trap while stepping; the other
+        // threads are stopped, so they can't run past it in the meantime.
+        if (!displaced_step(*breakpoint)) {
+            breakpoint->disable();
+            resume(PTRACE_SINGLESTEP);
+            breakpoint->enable();
+        }
+    } else {
+        resume(PTRACE_SINGLESTEP);
+    }
+
+    // Watchpoints that fire on the stepped instruction aren't reported, but
+    // their status has to be reset so that it isn't mistaken for a later hit.
+    m_debug_registers.triggered(m_thread->tid);
+}
+
+bool Debugger::displaced_step(const Breakpoint& breakpoint) {
+    if (!m_scratch_page)
+        m_scratch_page = allocate_scratch_page().value_or(0);
+    if (*m_scratch_page == 0)
+        return false;
+
+    // Decode the original instruction. It may end less than the maximum
+    // instruction length before the end of the mapping.
+    const uint64_t address = breakpoint.address();
+    std::array<uint8_t, x86::max_instruction_length> bytes = {};
+    std::size_t size = bytes.size();
+    while (size > 0 &&
+           !m_memory.read(address,
+                          std::span(reinterpret_cast<char*>(bytes.data()),
+                                    size)))
+        --size;
+    if (size == 0)
+        return false;
+    bytes[0] = breakpoint.m_data;
+    const std::optional<x86::Instruction> instruction =
+        x86::decode(std::span(bytes.data(), size), address);
+    if (!instruction ||
+        instruction->control_flow == x86::ControlFlow::syscall ||
+        instruction->control_flow == x86::ControlFlow::other)
+        return false;
+
+    // Copy the instruction to a slot, unless it is still there from the last
+    // time the breakpoint was stepped over. RIP relative operands are
+    // pointed back at what they addressed, as long as that is still in reach
+    // of a disp32.
+    uint64_t slot = 0;
+    if (const auto found = m_scratch_slots.find(address);
+        found != m_scratch_slots.end()) {
+        slot = found->second;
+    } else {
+        constexpr std::size_t slots = Memory::page_size / scratch_slot_size;
+        slot = *m_scratch_page + m_next_scratch_slot * scratch_slot_size;
+        if (instruction->rip_displacement) {
+            int32_t displacement = 0;
+            std::memcpy(&displacement,
+                        bytes.data() + instruction->rip_displacement,
+                        sizeof(displacement));
+            const int64_t moved =
+                displacement + static_cast<int64_t>(address - slot);
+            if (moved != static_cast<int32_t>(moved))
+                return false;
+            displacement = static_cast<int32_t>(moved);
+            std::memcpy(bytes.data() + instruction->rip_displacement,
+                        &displacement, sizeof(displacement));
+        }
+        std::erase_if(m_scratch_slots,
+                      [&](const auto& entry) { return entry.second == slot; });
+        if (!m_memory.write(slot,
+                            std::span(reinterpret_cast<char*>(bytes.data()),
+                                      instruction->length)))
+            return false;
+        m_scratch_slots.emplace(address, slot);
+        m_next_scratch_slot = (m_next_scratch_slot + 1) % slots;
+    }
+
+    m_thread->registers.modify().rip = slot;
+    resume(PTRACE_SINGLESTEP);
+
+    // Move the program counter back. It is still at the copy if the step was
+    // interrupted, and past it after falling through or taking a relative
+    // branch. Indirect branches and returns go wherever they went.
+    user_regs_struct& registers = m_thread->registers.modify();
+    const bool executed = registers.rip != slot;
+    if (!executed || instruction->target ||
+        instruction->control_flow == x86::ControlFlow::none)
+        registers.rip += address - slot;
+    if (executed && instruction->control_flow == x86::ControlFlow::call)
+        m_memory.write_value<uint64_t>(registers.rsp,
+                                       address + instruction->length);
+    return true;
+}
+
+std::optional<uint64_t> Debugger::allocate_scratch_page() {
+    const uint64_t entry = m_elf.file_header().E_ENTRY + m_load_bias;
+    std::array<char, 2> code;
+    if (!m_memory.read(entry, code))
+        return std::nullopt;
+    const std::array<char, 2> syscall = {'\x0f', '\x05'};
+    if (!m_memory.write(entry, syscall))
+        return std::nullopt;
+
+    // Ask for the page just below the first loadable segment.
+    uint64_t hint = 0;
+    for (const elf::ELFProgramHeader& header : m_elf.program_headers()) {
+        if (header.P_TYPE != elf::PT_LOAD)
+            continue;
+        hint = (header.P_VADDR & ~(Memory::page_size - 1)) + m_load_bias -
+               Memory::page_size;
+        break;
+    }
+
+    const user_regs_struct saved = m_thread->registers.get();
+    user_regs_struct& registers = m_thread->registers.modify();
+    registers.rax = SYS_mmap;
+    registers.rdi = hint;
+    registers.rsi = Memory::page_size;
+    registers.rdx = PROT_READ | PROT_EXEC;
+    registers.r10 = MAP_PRIVATE | MAP_ANONYMOUS;
+    registers.r8 = static_cast<uint64_t>(-1);
+    registers.r9 = 0;
+    registers.rip = entry;
+    resume(PTRACE_SINGLESTEP);
+    const uint64_t page = m_thread->registers.get().rax;
+
+    m_thread->registers.modify() = saved;
+    m_memory.write(entry, code);
+
+    // System calls return -errno on failure.
+    if (page > static_cast<uint64_t>(-4096)) {
+        std::cerr << "Unable to map a page for displaced stepping: "
+                  << std::strerror(-static_cast<int64_t>(page)) << "\n";
+        return std::nullopt;
+    }
+    return page;
+}
+
+std::vector<x86::Instruction> Debugger::decode_instructions(uint64_t begin,
+                                                            uint64_t end) {
+    std::vector<uint8_t> bytes(end - begin);
+    if (!m_memory.read(begin, std::span(reinterpret_cast<char*>(bytes.data()),
+                                        bytes.size())))
+        return {};
+
+    // Breakpoints replace the first byte of an instruction with a trap.
+    for (const auto& [address, breakpoint] : m_breakpoints)
+        if (breakpoint.enabled() && address >= begin && address < end)
+            bytes[address - begin] = breakpoint.m_data;
+
+    return x86::decode_all(bytes, begin);
+}
+
+bool Debugger::step_out_of_range(dwarf::AddressRange range,
+                                 bool step_over_calls) {
+    const auto in_range = [&](uint64_t address) {
+        return address >= range.low && address < range.high;
+    };
+
+    while (true) {
+        const uint64_t rip = get_register_value(HardwareRegister::rip);
+        if (!in_range(rip))
+            return true;
+
+        // Decode the whole range, as loops within the line can branch back
+        // to before the program counter. Fall back to decoding from the
+        // program counter if it isn't on an instruction boundary of the range.
+        std::vector<x86::Instruction> instructions =
+            decode_instructions(range.low, range.high);
+        const auto on_boundary = [&](uint64_t address) {
+            return std::any_of(instructions.begin(), instructions.end(),
+                               [&](const x86::Instruction& instruction) {
+                                   return instruction.address == address;
+                               });
+        };
+        if (!on_boundary(rip))
+            instructions = decode_instructions(rip, range.high);
+
+        // Find the exits of the range. Direct branches within the range can't
+        // leave it, every other change of control flow might.
+        std::vector<uint64_t> exits;
+        for (const x86::Instruction& instruction : instructions) {
+            switch (instruction.control_flow) {
+            case x86::ControlFlow::none:
+            case x86::ControlFlow::syscall:
+                continue;
+            case x86::ControlFlow::jump:
+            case x86::ControlFlow::conditional_jump:
+                if (instruction.target) {
+                    if (!in_range(*instruction.target))
+                        exits.push_back(*instruction.target);
+                    continue;
+                }
+                break; // Indirect jump.
+            default:
+                break;
+            }
+            exits.push_back(instruction.address);
+        }
+        // Running off the end of the range, or into something we couldn't
+        // decode, is an exit too.
+        exits.push_back(instructions.empty() ? rip
+                                             : instructions.back().address +
+                                                   instructions.back().length);
+        if (exits.back() != range.high)
+            exits.push_back(range.high);
+
+        // At an exit within the range, or a breakpoint that would trap
+        // straight away, execute the instruction itself.
+        if (std::find(exits.begin(), exits.end(), rip) != exits.end() ||
+            has_breakpoint(rip)) {
+            const auto instruction =
+                std::find_if(instructions.begin(), instructions.end(),
+                             [&](const x86::Instruction& instruction) {
+                                 return instruction.address == rip;
+                             });
+            if (step_over_calls && instruction != instructions.end() &&
+                instruction->control_flow == x86::ControlFlow::call) {
+                const uint64_t stack_pointer =
+                    get_register_value(HardwareRegister::rsp);
+                step_instruction();
+                if (!run_to_return_address(rip + instruction->length,
+                                           stack_pointer))
+                    return false;
+            } else {
+                step_instruction();
+            }
+            continue;
+        }
+
+        // Run to the next exit. Breakpoints already in |m_breakpoints| trap
+        // by themselves.
+        std::sort(exits.begin(), exits.end());
+        exits.erase(std::unique(exits.begin(), exits.end()), exits.end());
+        for (const uint64_t exit : exits) {
+            if (has_breakpoint(exit))
+                continue;
+            m_temporary_breakpoints.emplace_back(&m_memory, exit);
+            m_temporary_breakpoints.back().enable();
+        }
+        resume(PTRACE_CONT, false);
+        const uint64_t address = get_register_value(HardwareRegister::rip) - 1;
+        const bool exited = !was_interrupted() && std::any_of(
+            m_temporary_breakpoints.begin(), m_temporary_breakpoints.end(),
+            [&](const Breakpoint& breakpoint) {
+                return breakpoint.address() == address;
+            });
+        for (Breakpoint& breakpoint : m_temporary_breakpoints)
+            breakpoint.disable();
+        m_temporary_breakpoints.clear();
+
+        if (exited) {
+            // Back up over the trap, the instruction hasn't run yet.
+            m_thread->registers.modify().rip = address;
+            continue;
+        }
+        if (skip_breakpoint_hit())
+            continue;
+        handle_breakpoint_hit();
+        return false;
+    }
+}
+
+bool Debugger::run_to_return_address(uint64_t return_address,
+                                     uint64_t stack_pointer) {
+    if (has_breakpoint(return_address)) {
+        continue_execution();
+        return false;
+    }
+
+    const int tid = m_thread->tid;
+    m_temporary_breakpoints.emplace_back(&m_memory, return_address);
+    m_temporary_breakpoints.back().enable();
+    bool returned = false;
+    while (true) {
+        resume(PTRACE_CONT);
+        if (was_interrupted() ||
+            get_register_value(HardwareRegister::rip) - 1 != return_address) {
+            if (!skip_breakpoint_hit())
+                break;
+            step_instruction();
+            continue;
+        }
+
+        // The call pushed the return address, so once it has returned the
+        // stack pointer is back to |stack_pointer|. Recursive calls return
+        // to the same address with the stack pointer below it.
+        m_thread->registers.modify().rip = return_address;
+        if (m_thread->tid == tid &&
+            get_register_value(HardwareRegister::rsp) >= stack_pointer) {
+            returned = true;
+            break;
+        }
+        step_instruction();
+    }
+    for (Breakpoint& breakpoint : m_temporary_breakpoints)
+        breakpoint.disable();
+    m_temporary_breakpoints.clear();
+    if (!returned)
+        handle_breakpoint_hit();
+    return returned;
+}
+
+void Debugger::continue_execution() {
+    // Conditional breakpoints whose conditions are false don't stop the
+    // target, step over them and carry on.
+    resume(PTRACE_CONT);
+    while (skip_breakpoint_hit()) {
+        step_instruction();
+        resume(PTRACE_CONT);
+    }
+    handle_breakpoint_hit();
 }
 
 void Debugger::continue_to_end_of_stack_frame() {
-    // Get the return address from the stack. This assumes that targets
-    // have been build with -fno-omit-frame-pointer or equivalent.
-    const auto rbp = get_register_value(HardwareRegister::rbp) + 8;
-    const auto address = ptrace(PTRACE_PEEKTEXT, m_pid, rbp, nullptr);
+    // The caller's frame gives the return address, and the stack pointer
+    // once the current frame has returned.
+    const std::vector<StackFrame> frames =
+        m_unwinder.unwind(m_thread->registers.get(), 2);
+    if (frames.size() < 2) {
+        std::cerr << "Unable to find the caller of the current frame.\n";
+        return;
+    }
+    const uint64_t address = frames[1].pc;
 
     // Print the return address and the associated source location.
     std::cout << "Run till end of current stack frame (0x" << std::hex
               << address;
-    if (const auto source_location =
-            m_dwarf.source_location_from_program_counter(address, false);
+    if (const auto source_location = source_location_at(address);
         source_location) {
         std::cout << ", " << source_location->file << ":" << std::dec
                   << source_location->line;
     }
     std::cout << ")\n";
 
-    // Create a temporary breakpoint at the return address.
-    Breakpoint breakpoint(m_pid, address);
-    breakpoint.enable();
-
-    // Run the target to the return address.
-    ptrace(PTRACE_CONT, m_pid, 0, nullptr);
-    wait_for_target();
-
-    // Clean up the temporary breakpoint.
-    breakpoint.step_over();
-    breakpoint.disable();
+    // Run the target to the return address. Once the frame has returned the
+    // stack pointer is back to the caller's, which tells this frame apart
+    // from recursive calls returning to the same address.
+    run_to_return_address(address, frames[1].sp);
 }
 
 void Debugger::next() {
-    // This is a slightly naive way to do source level 'step-over'. We
-    // essentially want to single step until we change source location, with one
-    // caveat, we don't want to enter function calls. We can do this by checking
-    // each instruction to see if it is a call, if it is, place a breakpoint on
-    // the next instruction and run to the breakpoint.
+    // Source level 'step-over'. Rather than single stepping every instruction
+    // of the line, run to the instructions that can leave the line's address
+    // range, stepping over any calls along the way.
 
     // Get the current program counter and the corresponding source location.
     auto rip = get_register_value(HardwareRegister::rip);
-    const auto location =
-        m_dwarf.source_location_from_program_counter(rip, false);
+    const auto location = source_location_at(rip);
     if (!location) {
         std::cerr << "No debug information available for source file.\n";
         return;
@@ -239,37 +1302,28 @@ void Debugger::next() {
     // Keep going until we change the source location.
     std::optional<dwarf::SourceLocation> next_location;
     while (true) {
-        // Check if the current instruction is a call.
-        const auto data = ptrace(PTRACE_PEEKTEXT, m_pid, rip, nullptr);
-        if (const auto opcode = (data & 0xff); opcode == 0xe8) {
-            // Set a breakpoint on the next instruction and continue.
-            // Assume here that we have E8 cd (i.e. 5 bytes).
-            Breakpoint breakpoint(m_pid, rip + 5);
-            breakpoint.enable();
-            ptrace(PTRACE_CONT, m_pid, 0, nullptr);
-            wait_for_target();
-            breakpoint.step_over();
-            breakpoint.disable();
-        } else {
-            // Not a call, so safe to single step.
-            ptrace(PTRACE_SINGLESTEP, m_pid, 0, nullptr);
-            wait_for_target();
+        if (const auto range = line_range_at(rip); !range) {
+            step_instruction();
+        } else if (!step_out_of_range(*range, true)) {
+            // Stopped by a breakpoint, which has already been reported.
+            return;
         }
 
         // Get the source location associated with the current program counter.
         rip = get_register_value(HardwareRegister::rip);
-        next_location =
-            m_dwarf.source_location_from_program_counter(rip, false);
-
-        if (next_location && (next_location->line != location->line ||
-                              next_location->file != location->file)) {
-            // Skip locations that can't be attributed to any source lines.
-            if (next_location->line == 0) {
-                continue;
-            } else {
-                break;
-            }
+        next_location = source_location_at(rip);
+        if (!next_location) {
+            // Returned into code without debug information, e.g. the C
+            // runtime, so there is no next line to stop at.
+            continue_execution();
+            return;
         }
+
+        // Skip locations that can't be attributed to any source lines.
+        if (next_location->line != 0 &&
+            (next_location->line != location->line ||
+             next_location->file != location->file))
+            break;
     }
 
     // Print some information about where we stopped.
@@ -280,25 +1334,39 @@ void Debugger::next() {
 void Debugger::step() {
     // Get the current program counter and the corresponding source location.
     auto rip = get_register_value(HardwareRegister::rip);
-    const auto location =
-        m_dwarf.source_location_from_program_counter(rip, false);
+    const auto location = source_location_at(rip);
     if (!location) {
         std::cerr << "No debug information available for source file.\n";
         return;
     }
 
-    // Single step until we hit a different source line.
+    // Run out of the current line, entering calls, until we hit a different
+    // source line.
     std::optional<dwarf::SourceLocation> next_location;
     while (true) {
-        ptrace(PTRACE_SINGLESTEP, m_pid, 0, nullptr);
-        wait_for_target();
+        if (const auto range = line_range_at(rip); !range) {
+            step_instruction();
+        } else if (!step_out_of_range(*range, false)) {
+            return;
+        }
 
         // Get the source location associated with the current program counter.
         rip = get_register_value(HardwareRegister::rip);
-        next_location =
-            m_dwarf.source_location_from_program_counter(rip, false);
-        if (next_location && (next_location->line != location->line ||
-                              next_location->file != location->file)) {
+        next_location = source_location_at(rip);
+        if (!next_location) {
+            // Stepped into a function without debug information, such as a
+            // PLT stub or library function. Step over it by running to the
+            // return address on top of the stack.
+            const uint64_t rsp = get_register_value(HardwareRegister::rsp);
+            const auto return_address = m_memory.read_value<uint64_t>(rsp);
+            if (!return_address ||
+                !run_to_return_address(*return_address, rsp + 8))
+                return;
+            rip = get_register_value(HardwareRegister::rip);
+            continue;
+        }
+        if (next_location->line != location->line ||
+            next_location->file != location->file) {
             break;
         }
     }
@@ -309,20 +1377,55 @@ void Debugger::step() {
               << next_location->line << ")\n";
 }
 
-void Debugger::break_on_function(std::string_view method) {
-    const auto source_location = m_dwarf.source_location_from_function(method);
+std::optional<BreakpointCondition>
+Debugger::compile_condition(uint64_t address, std::string_view condition,
+                            std::vector<dwarf::VariableLocation>& variables) {
+    variables.clear();
+    return BreakpointCondition::compile(
+        condition, [&](std::string_view variable) -> std::optional<int64_t> {
+            std::optional<dwarf::VariableLocation> location =
+                m_dwarf.variable_location(address - m_load_bias, variable);
+            if (!location)
+                return std::nullopt;
+            if (!dwarf::is_integer(location->type)) {
+                std::cerr << variable
+                          << " can't be used in a condition, it isn't an "
+                             "integer.\n";
+                return std::nullopt;
+            }
+            variables.push_back(std::move(*location));
+            return variables.size() - 1;
+        });
+}
+
+void Debugger::break_on_function(std::string_view method,
+                                 std::string_view condition) {
+    auto source_location = m_dwarf.source_location_from_function(method);
     if (!source_location) {
         std::cerr << method << " method not found.\n";
         return;
     }
+    source_location->address += m_load_bias;
 
     if (m_breakpoints.count(source_location->address)) {
         std::cout << "A breakpoint is already active at this address\n";
         return;
     }
 
+    std::optional<BreakpointCondition> compiled_condition;
+    std::vector<dwarf::VariableLocation> condition_variables;
+    if (!condition.empty()) {
+        compiled_condition = compile_condition(source_location->address,
+                                               condition, condition_variables);
+        if (!compiled_condition)
+            return;
+    }
+
     auto [breakpoint, added] = m_breakpoints.emplace(
-        source_location->address, Breakpoint(m_pid, source_location->address));
+        source_location->address,
+        Breakpoint(&m_memory, source_location->address));
+    breakpoint->second.m_condition = std::move(compiled_condition);
+    breakpoint->second.m_condition_variables = std::move(condition_variables);
     breakpoint->second.enable();
 
     // Print some information about the new breakpoint.
@@ -333,41 +1436,160 @@ void Debugger::break_on_function(std::string_view method) {
               << "\n";
 }
 
-void Debugger::break_on_line_and_file(uint64_t line, std::string_view file) {
-    const std::optional<uint64_t> program_counter =
-        m_dwarf.program_counter_from_line_and_file(line, file);
-    if (!program_counter) {
+void Debugger::break_on_line_and_file(uint64_t line, std::string_view file,
+                                      std::string_view condition) {
+    // A line may have code in several places, e.g. in a header included by
+    // several compile units, so set a breakpoint on each of them.
+    const std::vector<dwarf::SourceLocation> source_locations =
+        m_dwarf.program_counters_from_line_and_file(line, file);
+    if (source_locations.empty()) {
         std::cerr << "Unable to set breakpoint on " << file << ":" << line
                   << "\n";
         return;
     }
 
-    if (m_breakpoints.count(*program_counter)) {
-        std::cout << "A breakpoint is already active at pc " << *program_counter
+    for (const dwarf::SourceLocation& source_location : source_locations) {
+        const uint64_t program_counter = source_location.address + m_load_bias;
+        if (m_breakpoints.count(program_counter)) {
+            std::cout << "A breakpoint is already active at pc 0x" << std::hex
+                      << program_counter << std::dec << "\n";
+            continue;
+        }
+
+        // Variables are resolved in the scope of each location separately.
+        std::optional<BreakpointCondition> compiled_condition;
+        std::vector<dwarf::VariableLocation> condition_variables;
+        if (!condition.empty()) {
+            compiled_condition = compile_condition(program_counter, condition,
+                                                   condition_variables);
+            if (!compiled_condition)
+                continue;
+        }
+
+        auto [breakpoint, added] = m_breakpoints.emplace(
+            program_counter, Breakpoint(&m_memory, program_counter));
+        breakpoint->second.m_condition = std::move(compiled_condition);
+        breakpoint->second.m_condition_variables =
+            std::move(condition_variables);
+        breakpoint->second.enable();
+
+        // Print some information about the new breakpoint.
+        std::cout << "Breakpoint " << m_breakpoints.size() << " at 0x"
+                  << std::hex << program_counter << " ("
+                  << source_location.file << ":" << std::dec
+                  << source_location.line << ")\n";
+    }
+}
+
+void Debugger::hardware_break(std::string_view location) {
+    // Resolve the location in the same way as software breakpoints.
+    std::vector<dwarf::SourceLocation> source_locations;
+    if (util::is_line_location(location)) {
+        const auto colon = location.rfind(':');
+        source_locations = m_dwarf.program_counters_from_line_and_file(
+            std::stoul(std::string(location.substr(colon + 1))),
+            location.substr(0, colon));
+    } else if (const auto source_location =
+                   m_dwarf.source_location_from_function(location);
+               source_location) {
+        source_locations.push_back(*source_location);
+    }
+    if (source_locations.empty()) {
+        std::cerr << "Unable to set hardware breakpoint on " << location
                   << "\n";
         return;
     }
 
-    auto [breakpoint, added] = m_breakpoints.emplace(
-        *program_counter, Breakpoint(m_pid, *program_counter));
-    breakpoint->second.enable();
+    for (const dwarf::SourceLocation& source_location : source_locations) {
+        const uint64_t address = source_location.address + m_load_bias;
+        const std::optional<std::size_t> slot = m_debug_registers.set(
+            address, DebugRegisters::Condition::execute, 1);
+        if (!slot)
+            return;
+        m_hardware_breakpoints[*slot] = HardwareBreakpoint{
+            .expression = std::string(location),
+            .address = address,
+            .size = 1,
+            .condition = DebugRegisters::Condition::execute,
+            .value = 0};
 
-    // Print some information about the new breakpoint.
-    std::cout << "Breakpoint " << m_breakpoints.size() << " at 0x" << std::hex
-              << *program_counter << " (" << file << ":" << std::dec << line
-              << ")\n";
+        std::cout << "Hardware breakpoint " << *slot + 1 << " at 0x"
+                  << std::hex << address << " ("
+                  << source_location.file << ":" << std::dec
+                  << source_location.line << ")\n";
+    }
+}
+
+void Debugger::watch(std::string_view variable,
+                     DebugRegisters::Condition condition) {
+    const std::optional<dwarf::VariableLocation> location =
+        find_variable(variable);
+    if (!location)
+        return;
+    if (!location->type) {
+        std::cerr << "Unable to determine the type of variable " << variable
+                  << ".\n";
+        return;
+    }
+
+    // The debug registers watch 1, 2, 4 or 8 bytes.
+    const uint64_t size = location->type->size();
+    if (size != 1 && size != 2 && size != 4 && size != 8) {
+        std::cerr << "Can't watch " << variable << ", its size (" << std::dec
+                  << size << " bytes) isn't 1, 2, 4 or 8 bytes.\n";
+        return;
+    }
+    const std::optional<uint64_t> address =
+        variable_address(variable, *location);
+    if (!address)
+        return;
+
+    HardwareBreakpoint watchpoint = {.expression = std::string(variable),
+                                     .address = *address,
+                                     .size = size,
+                                     .condition = condition,
+                                     .value = 0};
+    const std::optional<std::size_t> slot =
+        m_debug_registers.set(watchpoint.address, condition, watchpoint.size);
+    if (!slot)
+        return;
+    watchpoint.value = read_watched_value(watchpoint).value_or(0);
+    m_hardware_breakpoints[*slot] = std::move(watchpoint);
+
+    std::cout << (condition == DebugRegisters::Condition::write
+                      ? "Hardware watchpoint "
+                      : "Hardware access (read/write) watchpoint ")
+              << std::dec << *slot + 1 << ": " << variable << "\n";
+}
+
+std::optional<uint64_t>
+Debugger::read_watched_value(const HardwareBreakpoint& watchpoint) {
+    uint64_t value = 0;
+    if (!m_memory.read(watchpoint.address,
+                       std::span(reinterpret_cast<char*>(&value),
+                                 watchpoint.size)))
+        return std::nullopt;
+    return value;
 }
 
 void Debugger::delete_all_breakpoints() {
     for (auto& [address, breakpoint] : m_breakpoints)
         breakpoint.disable();
-    std::cout << "Deleted " << m_breakpoints.size() << " breakpoints.\n";
+    std::size_t deleted = m_breakpoints.size();
     m_breakpoints.clear();
+
+    for (std::size_t slot = 0; slot < DebugRegisters::slots; ++slot) {
+        if (!m_hardware_breakpoints[slot])
+            continue;
+        m_debug_registers.clear(slot);
+        m_hardware_breakpoints[slot].reset();
+        ++deleted;
+    }
+    std::cout << "Deleted " << deleted << " breakpoints.\n";
 }
 
 uint64_t Debugger::get_register_value(HardwareRegister hardware_register) {
-    user_regs_struct registers;
-    ptrace(PTRACE_GETREGS, m_pid, 0, &registers);
+    const user_regs_struct& registers = m_thread->registers.get();
     switch (hardware_register) {
     case HardwareRegister::r15:
         return registers.r15;
@@ -428,102 +1650,609 @@ uint64_t Debugger::get_register_value(HardwareRegister hardware_register) {
     }
 }
 
-std::optional<uint64_t>
-Debugger::get_variable_value(std::string_view variable) {
-    // Try and find the location of the named variable in the current context.
-    const auto variable_location = m_dwarf.variable_location(
-        get_register_value(HardwareRegister::rip), variable);
-    if (!variable_location) {
+std::optional<dwarf::VariableLocation>
+Debugger::find_variable(std::string_view variable) {
+    std::optional<dwarf::VariableLocation> location = m_dwarf.variable_location(
+        get_register_value(HardwareRegister::rip) - m_load_bias, variable);
+    if (!location)
         std::cerr << "No symbol named " << variable << " in current context.\n";
+    return location;
+}
+
+std::optional<dwarf::DwarfLocation>
+Debugger::evaluate_location(const dwarf::VariableLocation& variable,
+                            const Unwinder::Registers& registers,
+                            bool is_caller) {
+    // A return address may be just past the end of the call's location
+    // list entry, the call itself isn't.
+    const std::optional<uint64_t> pc = registers[dwarf::cfi_return_address];
+    if (!pc)
+        return std::nullopt;
+    const uint64_t program_counter = *pc - m_load_bias - (is_caller ? 1 : 0);
+    const dwarf::DwarfExpression* expression =
+        variable.location.find(program_counter);
+    if (!expression)
+        return dwarf::DwarfLocation{};
+
+    dwarf::DwarfExpression::Context context;
+    context.load_bias = m_load_bias;
+    context.read_register = [&](uint64_t reg) -> std::optional<uint64_t> {
+        if (reg >= registers.size())
+            return std::nullopt;
+        return registers[reg];
+    };
+    context.read_memory = [&](uint64_t address, std::span<char> bytes) {
+        return m_memory.read(address, bytes);
+    };
+    context.cfa = [&]() { return m_unwinder.cfa(registers, is_caller); };
+    if (variable.form_context)
+        context.debug_addr = [&](uint64_t index) {
+            return variable.form_context->address(index);
+        };
+
+    // The frame base is itself a location, e.g. DW_OP_call_frame_cfa, or
+    // DW_OP_reg6 (rbp) in older code. DW_OP_fbreg in the frame base would
+    // recurse forever, so it fails.
+    bool evaluating_frame_base = false;
+    context.frame_base = [&]() -> std::optional<uint64_t> {
+        const dwarf::DwarfExpression* frame_base_expression =
+            variable.frame_base ? variable.frame_base->find(program_counter)
+                                : nullptr;
+        if (!frame_base_expression || evaluating_frame_base)
+            return std::nullopt;
+        evaluating_frame_base = true;
+        const auto frame_base = frame_base_expression->evaluate(context);
+        evaluating_frame_base = false;
+        if (!frame_base)
+            return std::nullopt;
+        if (frame_base->kind == dwarf::DwarfLocationKind::memory)
+            return frame_base->value;
+        if (frame_base->kind == dwarf::DwarfLocationKind::reg)
+            return context.read_register(frame_base->value);
+        return std::nullopt;
+    };
+
+    // The executable's TLS block ends at the thread pointer.
+    // Section 4.4.6
+    // https://www.akkadia.org/drepper/tls.pdf
+    context.tls_address = [&](uint64_t offset) -> std::optional<uint64_t> {
+        for (const auto& header : m_elf.program_headers()) {
+            if (header.P_TYPE != elf::PT_TLS)
+                continue;
+            const uint64_t align = std::max<uint64_t>(header.P_ALIGN, 1);
+            const uint64_t size = (header.P_MEMSZ + align - 1) / align * align;
+            return m_thread->registers.get().fs_base - size + offset;
+        }
         return std::nullopt;
+    };
+
+    // Values on entry are those the caller passed, as recorded at its call
+    // site. Only the innermost frame's caller is looked at.
+    context.entry_value = [&](uint64_t reg) -> std::optional<uint64_t> {
+        if (is_caller)
+            return std::nullopt;
+        const std::optional<Unwinder::Registers> caller =
+            m_unwinder.caller(registers);
+        if (!caller || !(*caller)[dwarf::cfi_return_address])
+            return std::nullopt;
+        const std::optional<dwarf::VariableLocation> value =
+            m_dwarf.call_site_value(
+                *(*caller)[dwarf::cfi_return_address] - m_load_bias, reg);
+        if (!value)
+            return std::nullopt;
+        const auto location = evaluate_location(*value, *caller, true);
+        if (!location)
+            return std::nullopt;
+        if (location->kind == dwarf::DwarfLocationKind::memory ||
+            location->kind == dwarf::DwarfLocationKind::value)
+            return location->value;
+        if (location->kind == dwarf::DwarfLocationKind::reg &&
+            location->value < caller->size())
+            return (*caller)[location->value];
+        return std::nullopt;
+    };
+    return expression->evaluate(context);
+}
+
+std::optional<std::string>
+Debugger::read_location(const dwarf::DwarfLocation& location,
+                        const Unwinder::Registers& registers,
+                        std::size_t size) {
+    std::string bytes(size, '\0');
+    const auto copy = [&](const void* data, std::size_t available) {
+        std::memcpy(bytes.data(), data, std::min(size, available));
+    };
+    switch (location.kind) {
+    case dwarf::DwarfLocationKind::memory:
+        if (!m_memory.read(location.value, bytes))
+            return std::nullopt;
+        return bytes;
+    case dwarf::DwarfLocationKind::reg:
+        if (location.value >= registers.size() || !registers[location.value])
+            return std::nullopt;
+        copy(&*registers[location.value], sizeof(uint64_t));
+        return bytes;
+    case dwarf::DwarfLocationKind::value:
+        copy(&location.value, sizeof(location.value));
+        return bytes;
+    case dwarf::DwarfLocationKind::implicit:
+        copy(location.bytes.data(), location.bytes.size());
+        return bytes;
+    case dwarf::DwarfLocationKind::undefined:
+        return std::nullopt;
+    case dwarf::DwarfLocationKind::composite:
+        break;
     }
 
-    // Currently only support frame base relative variable locations.
-    const int64_t location =
-        get_register_value(HardwareRegister::rbp) + *variable_location;
-    const auto data = ptrace(PTRACE_PEEKDATA, m_pid, location, nullptr);
-    return (data & (~uint32_t(0)));
+    // Assemble the pieces, bit by bit as they needn't be byte aligned.
+    uint64_t position = 0;
+    for (const dwarf::DwarfLocation& piece : location.pieces) {
+        if (position >= size * 8)
+            break;
+        const std::optional<std::string> piece_bytes = read_location(
+            piece, registers, (piece.bit_offset + piece.bit_size + 7) / 8);
+        if (!piece_bytes)
+            return std::nullopt;
+        for (uint64_t bit = 0; bit < piece.bit_size && position < size * 8;
+             ++bit, ++position) {
+            const uint64_t from = piece.bit_offset + bit;
+            if ((*piece_bytes)[from / 8] >> (from % 8) & 1)
+                bytes[position / 8] |= char(1 << (position % 8));
+        }
+    }
+    return bytes;
 }
 
-void Debugger::set_variable_value(std::string_view variable_name,
-                                  int32_t value) {
-    const auto variable_location = m_dwarf.variable_location(
-        get_register_value(HardwareRegister::rip), variable_name);
-    if (!variable_location)
+std::optional<uint64_t>
+Debugger::variable_address(std::string_view variable,
+                           const dwarf::VariableLocation& location) {
+    const std::optional<dwarf::DwarfLocation> evaluated = evaluate_location(
+        location, Unwinder::frame_registers(m_thread->registers.get()));
+    if (!evaluated || evaluated->kind != dwarf::DwarfLocationKind::memory) {
+        std::cerr << variable << " isn't in memory.\n";
+        return std::nullopt;
+    }
+    return evaluated->value;
+}
+
+void Debugger::print_variable(std::string_view variable) {
+    const std::optional<dwarf::VariableLocation> location =
+        find_variable(variable);
+    const Unwinder::Registers registers =
+        Unwinder::frame_registers(m_thread->registers.get());
+    const std::optional<dwarf::DwarfLocation> evaluated =
+        location ? evaluate_location(*location, registers) : std::nullopt;
+    if (evaluated && evaluated->kind == dwarf::DwarfLocationKind::undefined) {
+        std::cout << "<optimized out>\n";
+        return;
+    }
+    if (location && !location->type) {
+        std::cout << "Unable to determine the type of variable " << variable
+                  << ".\n";
         return;
+    }
 
-    // Get the data word at the variable address.
-    const int64_t location =
-        get_register_value(HardwareRegister::rbp) + *variable_location;
-    auto data = ptrace(PTRACE_PEEKDATA, m_pid, location, nullptr);
+    // The whole value is fetched at once, however large it is.
+    const dwarf::Type* type = location ? location->type : nullptr;
+    const std::optional<std::string> bytes =
+        evaluated ? read_location(*evaluated, registers, type->size())
+                  : std::nullopt;
+    if (!bytes) {
+        std::cout << "Unable to retrieve value for variable " << variable
+                  << ".\n";
+        return;
+    }
 
-    // Set the variable value.
-    auto modified_data = (data & 0xFFFFFFFF00000000) | value;
-    ptrace(PTRACE_POKEDATA, m_pid, location, (void*)modified_data);
+    // Pointers are shown with their type, and references with the value
+    // they refer to, as gdb does.
+    const dwarf::Type* stripped = type->strip();
+    if (stripped->kind == dwarf::TypeKind::pointer ||
+        stripped->kind == dwarf::TypeKind::reference)
+        std::cout << "(" << type->display_name() << ") ";
+    std::cout << dwarf::format_value(type, *bytes);
+    if (stripped->kind == dwarf::TypeKind::reference && stripped->target) {
+        uint64_t address = 0;
+        std::memcpy(&address, bytes->data(),
+                    std::min(bytes->size(), sizeof(address)));
+        std::string referenced(stripped->target->size(), '\0');
+        std::cout << ": "
+                  << (m_memory.read(address, referenced)
+                          ? dwarf::format_value(stripped->target, referenced)
+                          : "<unavailable>");
+    }
+    std::cout << "\n";
 }
 
-void Debugger::backtrace() {
-    // Get the name of the function we are currently in.
-    const auto rip = get_register_value(HardwareRegister::rip);
-    auto function_name = m_dwarf.function_from_program_counter(rip);
+void Debugger::set_variable_value(std::string_view variable_name,
+                                  std::string_view value) {
+    const std::optional<dwarf::VariableLocation> location =
+        find_variable(variable_name);
+    if (!location)
+        return;
+    const std::optional<std::string> bytes =
+        dwarf::encode_value(location->type, value);
+    if (!bytes) {
+        std::cerr << "Unable to set " << variable_name << " to " << value
+                  << ", it isn't a value of its type.\n";
+        return;
+    }
+    const std::optional<dwarf::DwarfLocation> evaluated = evaluate_location(
+        *location, Unwinder::frame_registers(m_thread->registers.get()));
+    if (evaluated && evaluated->kind == dwarf::DwarfLocationKind::memory) {
+        m_memory.write(evaluated->value, *bytes);
+        return;
+    }
 
-    // Print the function name and current frame count.
-    int frame_count = 0;
-    std::cout << "#" << frame_count++ << " : ";
-    if (function_name) {
-        std::cout << *function_name;
-    } else {
-        std::cout << "unknown";
+    // Only the low bytes of a register are set, as many as the type has.
+    if (evaluated && evaluated->kind == dwarf::DwarfLocationKind::reg &&
+        evaluated->value < Unwinder::register_fields.size()) {
+        unsigned long long& reg = m_thread->registers.modify().*
+                                  Unwinder::register_fields[evaluated->value];
+        std::memcpy(&reg, bytes->data(), std::min(bytes->size(), sizeof(reg)));
+        return;
     }
+    std::cerr << "Unable to set " << variable_name
+              << ", it isn't in memory or a register.\n";
+}
 
-    // If we can, print the source location.
-    if (auto location = m_dwarf.source_location_from_function(*function_name);
-        location)
-        std::cout << " (" << location->file << ":" << std::dec << location->line
-                  << ")";
-    std::cout << "\n";
+void Debugger::backtrace() {
+    const std::vector<StackFrame> frames =
+        m_unwinder.unwind(m_thread->registers.get());
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        // Return addresses may be just past the end of the calling function,
+        // so callers are looked up by the call instead.
+        const uint64_t pc = i == 0 ? frames[i].pc : frames[i].pc - 1;
+        const auto function_name =
+            m_dwarf.function_from_program_counter(pc - m_load_bias);
+        std::cout << "#" << std::dec << i << " : "
+                  << function_name.value_or("unknown");
 
-    // Walk up the stack until we reach main.
-    uint64_t frame_pointer = get_register_value(HardwareRegister::rbp);
-    uint64_t return_address =
-        ptrace(PTRACE_PEEKDATA, m_pid, frame_pointer + 8, nullptr);
-    while (*function_name != "main") {
-        // Get the name of the function we are currently in.
-        function_name = m_dwarf.function_from_program_counter(return_address);
-
-        // Print the function name and current frame count.
-        std::cout << "#" << frame_count++ << " : ";
-        if (function_name) {
-            std::cout << *function_name;
+        // Print the source location if there is one, and otherwise the
+        // object the frame is in.
+        if (const auto location = source_location_at(pc); location) {
+            std::cout << " (" << location->file << ":" << std::dec
+                      << location->line << ")";
         } else {
-            std::cout << "unknown";
+            std::cout << " (0x" << std::hex << frames[i].pc;
+            if (const auto object = m_unwinder.object_at(pc); object)
+                std::cout << " in "
+                          << std::filesystem::path(*object).filename().string();
+            std::cout << ")";
         }
+        std::cout << std::dec << "\n";
 
-        // If we can, print the source location.
-        if (auto location =
-                m_dwarf.source_location_from_function(*function_name);
-            location) {
-            std::cout << " (" << location->file << ":" << std::dec
-                      << location->line << ")";
+        // Like gdb, stop at main rather than showing the C runtime.
+        if (function_name == "main")
+            break;
+    }
+}
+
+void Debugger::profile(const ProfileOptions& options) {
+    if (options.pid)
+        attach(*options.pid);
+    else
+        start();
+    if (!m_is_running)
+        return;
+
+    // The breakpoint on main that the target was started up to has served
+    // its purpose.
+    for (auto& [address, breakpoint] : m_breakpoints)
+        breakpoint.disable();
+    m_breakpoints.clear();
+
+    using Clock = std::chrono::steady_clock;
+    std::cout << "Profiling process " << m_pid << " at " << options.frequency
+              << " Hz";
+    if (options.duration)
+        std::cout << " for "
+                  << std::chrono::duration<double>(*options.duration).count()
+                  << " s";
+    std::cout << ", interrupt to stop.\n";
+
+    Profile profile;
+    Clock::duration stopping{};  // Stopping all threads, over all samples.
+    Clock::duration unwinding{}; // Reading registers and unwinding.
+    Clock::duration longest{};   // The most any one sample took.
+    uint64_t rounds = 0;         // Times the target was stopped to sample.
+    uint64_t missed = 0;
+    const Clock::time_point begin = Clock::now();
+    m_events.start_timer(std::chrono::nanoseconds(std::chrono::seconds(1)) /
+                         options.frequency);
+    while (!options.duration || Clock::now() - begin < *options.duration) {
+        // Let the target run until the next sample is due, passing on any
+        // signals held back when it was last stopped.
+        m_memory.invalidate();
+        for (auto& [tid, thread] : m_threads) {
+            const std::optional<int> status =
+                std::exchange(thread.pending_status, std::nullopt);
+            const bool is_signal = status && *status >> 16 == 0 &&
+                                   WSTOPSIG(*status) != SIGTRAP;
+            resume_thread(thread, PTRACE_CONT,
+                          is_signal ? WSTOPSIG(*status) : 0);
         }
-        std::cout << "\n";
+        if (!run_until_sample(missed))
+            break;
 
-        // Move on to the next frame.
-        frame_pointer = ptrace(PTRACE_PEEKDATA, m_pid, frame_pointer, nullptr);
-        return_address =
-            ptrace(PTRACE_PEEKDATA, m_pid, frame_pointer + 8, nullptr);
+        // Stop the whole target, so that the stacks are consistent, and take
+        // a sample of every thread. Each thread's registers are read once.
+        const Clock::time_point sample_begin = Clock::now();
+        stop_all_threads();
+        const Clock::time_point stopped = Clock::now();
+        for (auto& [tid, thread] : m_threads) {
+            std::vector<uint64_t> stack;
+            for (const StackFrame& frame :
+                 m_unwinder.unwind(thread.registers.get()))
+                stack.push_back(stack.empty() ? frame.pc : frame.pc - 1);
+            profile.add_sample(std::move(stack));
+        }
+        const Clock::time_point sampled = Clock::now();
+        stopping += stopped - sample_begin;
+        unwinding += sampled - stopped;
+        longest = std::max(longest, sampled - sample_begin);
+        ++rounds;
+    }
+    m_events.stop_timer();
+    const Clock::time_point end = Clock::now();
+    if (m_is_running)
+        stop_all_threads();
+
+    // Symbolize each distinct program counter once, now that sampling is
+    // over. Callers were sampled by their calls, rather than the return
+    // addresses, which may be in the next function or line.
+    std::ofstream output(options.output);
+    const Clock::time_point symbolize_begin = Clock::now();
+    const std::size_t symbolized =
+        profile.write_folded(output, [&](uint64_t pc) -> std::string {
+            std::string name;
+            if (const auto function =
+                    m_dwarf.function_from_program_counter(pc - m_load_bias);
+                function)
+                name = *function;
+            else if (const auto object = m_unwinder.object_at(pc); !object)
+                name = "[unknown]";
+            else if (object->starts_with('['))
+                name = *object; // [vdso]
+            else
+                name = "[" +
+                       std::filesystem::path(*object).filename().string() +
+                       "]";
+            if (options.lines) {
+                if (const auto location = source_location_at(pc); location)
+                    name += " (" + std::string(location->file) + ":" +
+                            std::to_string(location->line) + ")";
+            }
+            return name;
+        });
+    const double symbolize_ms = std::chrono::duration<double, std::milli>(
+                                    Clock::now() - symbolize_begin)
+                                    .count();
+    if (!output) {
+        std::cerr << "Unable to write " << options.output << ".\n";
+        std::exit(1);
+    }
+
+    // Report what sampling cost the target.
+    const auto microseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+    std::cout << std::dec << "Wrote " << profile.samples() << " samples of "
+              << profile.stacks() << " distinct stacks to " << options.output
+              << ", symbolizing " << symbolized << " program counters in "
+              << symbolize_ms << " ms.\n";
+    if (rounds > 0) {
+        std::cout << "Overhead per sample: "
+                  << microseconds(stopping + unwinding) / rounds
+                  << " us (stopping " << microseconds(stopping) / rounds
+                  << " us, unwinding " << microseconds(unwinding) / rounds
+                  << " us), " << microseconds(longest)
+                  << " us at most. The target was stopped for "
+                  << 100 * microseconds(stopping + unwinding) /
+                         microseconds(end - begin)
+                  << "% of the time";
+        if (missed > 0)
+            std::cout << ", and " << missed << " samples were missed";
+        std::cout << ".\n";
+    }
+
+    // Leave attached processes running, and end started ones, as quitting
+    // does.
+    if (!m_is_running)
+        return;
+    if (m_attached) {
+        detach();
+        return;
+    }
+    std::cout << "Sending SIGTERM to process " << m_pid << "\n";
+    kill(m_pid, SIGTERM);
+}
+
+bool Debugger::run_until_sample(uint64_t& missed) {
+    while (true) {
+        const EventLoop::Events events = m_events.wait();
+        if (events.interrupt)
+            return false;
+        if (events.input) {
+            CommandParser command_parser;
+            if (m_events.erase_lines([&](const std::string& line) {
+                    return command_parser.parse(line).command ==
+                           Command::Interrupt;
+                }) > 0)
+                return false;
+        }
+
+        int status = 0;
+        int tid = 0;
+        while (events.target &&
+               (tid = waitpid(-1, &status, __WALL | WNOHANG)) > 0) {
+            if (WIFEXITED(status) || WIFSIGNALED(status)) {
+                if (tid == m_pid) {
+                    print_waitpid_status(status);
+                    m_events.unwatch_process();
+                    m_is_running = false;
+                    return false;
+                }
+                remove_thread(tid);
+                continue;
+            }
+
+            // New threads stop before running, and are resumed along with
+            // the thread that created them.
+            Thread* thread = m_threads.find(tid);
+            if (!thread) {
+                add_thread(tid).stop_reason = StopReason::created;
+                continue;
+            }
+            thread->running = false;
+            if (status >> 8 == (SIGTRAP | PTRACE_EVENT_CLONE << 8)) {
+                resume_thread(add_cloned_thread(*thread), PTRACE_CONT);
+                resume_thread(*thread, PTRACE_CONT);
+                continue;
+            }
+
+            // Ctrl-C reaches a target started from the same terminal too.
+            const int signal = status >> 16 == 0 ? WSTOPSIG(status) : 0;
+            if (signal == SIGINT)
+                return false;
+            resume_thread(*thread, PTRACE_CONT,
+                          signal == SIGTRAP ? 0 : signal);
+        }
+
+        if (events.timer > 0) {
+            missed += events.timer - 1;
+            return true;
+        }
     }
 }
 
 void Debugger::print_hardware_registers() {
     for (const auto& reg : m_registers) {
-        const uint64_t register_value = get_register_value(
-            reg.hardware_register); // TODO: Fetch all register values once.
+        const uint64_t register_value =
+            get_register_value(reg.hardware_register);
         std::cout << reg.name << " " << std::dec << register_value << std::hex
                   << " (0x" << register_value << ")\n";
     }
 }
 
+void Debugger::print_breakpoints() {
+    std::vector<const Breakpoint*> breakpoints;
+    for (const auto& [address, breakpoint] : m_breakpoints)
+        breakpoints.push_back(&breakpoint);
+    std::sort(breakpoints.begin(), breakpoints.end(),
+              [](const Breakpoint* lhs, const Breakpoint* rhs) {
+                  return lhs->m_address < rhs->m_address;
+              });
+
+    for (const Breakpoint* breakpoint : breakpoints) {
+        std::cout << "Breakpoint at 0x" << std::hex << breakpoint->m_address;
+        if (const auto source_location =
+                source_location_at(breakpoint->m_address);
+            source_location)
+            std::cout << " (" << source_location->file << ":" << std::dec
+                      << source_location->line << ")";
+        std::cout << std::dec << ", hit " << breakpoint->m_hits << " times";
+        if (breakpoint->m_condition)
+            std::cout << ", stop only if "
+                      << breakpoint->m_condition->expression() << " (evaluated "
+                      << breakpoint->m_evaluations << " times)";
+        std::cout << "\n";
+    }
+
+    for (std::size_t slot = 0; slot < DebugRegisters::slots; ++slot) {
+        const std::optional<HardwareBreakpoint>& breakpoint =
+            m_hardware_breakpoints[slot];
+        if (!breakpoint)
+            continue;
+        std::cout << (breakpoint->condition ==
+                              DebugRegisters::Condition::execute
+                          ? "Hardware breakpoint "
+                          : "Hardware watchpoint ")
+                  << std::dec << slot + 1 << " at 0x" << std::hex
+                  << breakpoint->address << std::dec << ": "
+                  << breakpoint->expression << "\n";
+    }
+}
+
+void Debugger::print_threads() {
+    const auto describe = [](const Thread& thread) -> std::string {
+        switch (thread.stop_reason) {
+        case StopReason::none:
+            return "running";
+        case StopReason::created:
+            return "created";
+        case StopReason::stopped:
+            return "stopped";
+        case StopReason::breakpoint:
+            return "breakpoint";
+        case StopReason::hardware:
+            return "hardware breakpoint";
+        case StopReason::step:
+            return "step";
+        case StopReason::signal:
+            return strsignal(thread.stop_signal);
+        case StopReason::interrupted:
+            return "interrupted";
+        }
+        return {};
+    };
+
+    for (auto& [tid, thread] : m_threads) {
+        const uint64_t rip = thread.registers.get().rip;
+        std::cout << (&thread == m_thread ? "* " : "  ") << std::dec
+                  << thread.number << " Thread " << tid << " ("
+                  << describe(thread) << ") 0x" << std::hex << rip;
+        if (const auto function_name =
+                m_dwarf.function_from_program_counter(rip - m_load_bias);
+            function_name)
+            std::cout << " in " << *function_name;
+        if (const auto location = source_location_at(rip); location)
+            std::cout << " at " << location->file << ":" << std::dec
+                      << location->line;
+        std::cout << "\n";
+    }
+}
+
+void Debugger::select_thread(int number) {
+    Thread* thread = m_threads.find_number(number);
+    if (!thread) {
+        std::cerr << "Unknown thread " << number << ".\n";
+        return;
+    }
+    m_thread = thread;
+    m_reported_tid = thread->tid;
+
+    const uint64_t rip = get_register_value(HardwareRegister::rip);
+    std::cout << std::dec << "[Switching to thread " << number << " ("
+              << thread->tid << ")] 0x" << std::hex << rip;
+    if (const auto location = source_location_at(rip); location)
+        std::cout << " (" << location->file << ":" << std::dec
+                  << location->line << ")";
+    std::cout << "\n";
+}
+
+void Debugger::print_cache_statistics() {
+    RegisterCache::Statistics registers = {};
+    for (auto& [tid, thread] : m_threads) {
+        const RegisterCache::Statistics& statistics =
+            thread.registers.statistics();
+        registers.reads += statistics.reads;
+        registers.writes += statistics.writes;
+        registers.getregs += statistics.getregs;
+        registers.setregs += statistics.setregs;
+    }
+    std::cout << std::dec << "Register cache: " << registers.reads
+              << " reads, " << registers.writes << " writes, "
+              << registers.getregs << " PTRACE_GETREGS, " << registers.setregs
+              << " PTRACE_SETREGS (" << registers.saved()
+              << " ptrace calls saved)\n";
+
+    const Memory::Statistics& memory = m_memory.statistics();
+    std::cout << "Memory cache: " << memory.reads << " reads, "
+              << memory.writes << " writes, " << memory.page_hits
+              << " page hits, " << memory.page_misses << " page misses, "
+              << memory.syscalls << " syscalls\n";
+}
+
 void Debugger::print_waitpid_status(int waitpid_status) {
     if (WIFEXITED(waitpid_status)) {
         std::cout << "The child terminated normally, that is, ";
@@ -1,12 +1,24 @@
 #pragma once
 
 #include "breakpoint.h"
+#include "debug_registers.h"
 #include "dwarf.h"
 #include "elf.h"
+#include "event_loop.h"
+#include "memory.h"
+#include "profile.h"
+#include "thread_table.h"
+#include "unwinder.h"
+#include "x86_decoder.h"
 
+#include <array>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#include <sys/ptrace.h>
 
 namespace smldbg {
 
@@ -14,7 +26,7 @@ class Debugger {
 public:
     Debugger(int argc, char** argv);
 
-    // Run the main event loop.
+    // Run the main event loop, or profile the target in the profile mode.
     void exec();
 
 private:
@@ -54,17 +66,193 @@ private:
         std::string name;
     };
 
+    // A breakpoint or watchpoint held in a debug register.
+    struct HardwareBreakpoint {
+        std::string expression; // Location or variable as entered.
+        uint64_t address;
+        std::size_t size;
+        DebugRegisters::Condition condition;
+        uint64_t value; // Last seen value of a watched variable.
+    };
+
     // Emulate the gdb/lldb 'start' command. Create the target process, set a
     // breakpoint on main, and run to the breakpoint.
     void start();
 
-    // Wait for the target process (|m_pid|).
-    void wait_for_target();
+    // Attach to the running process |pid| with PTRACE_SEIZE and stop it.
+    // Unlike PTRACE_ATTACH no SIGSTOP is queued, so the target sees no
+    // difference once detached.
+    void attach(int pid);
+
+    // Remove all breakpoints from the target and let it run on untraced.
+    void detach();
+
+    // Find the address the target executable was loaded at from
+    // /proc/<pid>/maps, and set |m_load_bias| to its difference from the
+    // link-time addresses. The bias is zero for non position independent
+    // executables.
+    bool detect_load_bias();
+
+    // The Dwarf data describes link-time addresses. Look up the source
+    // location or line address range of the target |address|, returning target
+    // addresses.
+    std::optional<dwarf::SourceLocation> source_location_at(uint64_t address);
+    std::optional<dwarf::AddressRange> line_range_at(uint64_t address);
+
+    // Start tracking the stopped thread |tid| of the target.
+    Thread& add_thread(int tid);
+
+    // Stop tracking the thread |tid| once it has exited.
+    void remove_thread(int tid);
+
+    // Return the next line of user input, waiting for it if need be, or
+    // std::nullopt once there is no more.
+    std::optional<std::string> read_line();
+
+    // Wait for the next stop of any thread of the target and set |status| to
+    // its waitpid(...) status. Returns nullptr if the stop was handled here:
+    // the exit of a thread, or the first stop of a new thread that was
+    // reported before the clone event of the thread that created it. The
+    // debugger exits along with the target. If |interruptible|, the
+    // 'interrupt' command and Ctrl-C interrupt the target meanwhile, and
+    // other input is kept for the prompt.
+    Thread* wait_for_thread(int& status, bool interruptible = false);
+
+    // Track the thread created by |parent|, which stopped at a clone event.
+    // Returns the new thread, stopped before running any of its code.
+    Thread& add_cloned_thread(Thread& parent);
+
+    // Record why |thread| stopped, given its waitpid(...) |status|.
+    void record_stop(Thread& thread, int status);
+
+    // Resume the single |thread| with |request|, writing back any modified
+    // registers first, and delivering |signal| if it isn't zero.
+    void resume_thread(Thread& thread, __ptrace_request request,
+                       int signal = 0);
+
+    // Wait for a resumed thread to stop for a reason worth reporting. Threads
+    // that stop to create new threads are resumed, and the new threads are
+    // resumed too if |all_threads| are running. Returns the thread that
+    // stopped and sets |status| to its waitpid(...) status.
+    Thread& wait_for_event(int& status, bool all_threads, bool interruptible);
+
+    // Send a SIGSTOP to a running thread, which is reported as an interrupted
+    // stop by wait_for_event(...), unless an interrupt is already on its way.
+    void interrupt_target();
+
+    // Whether the current thread last stopped because the user interrupted
+    // the target.
+    bool was_interrupted() const;
+
+    // Stop every thread that is still running, so that the whole target is
+    // stopped when one thread stops (all-stop). The running threads are all
+    // signalled before any of them is waited for, and their stops collected
+    // in whatever order they arrive. Breakpoint hits in the other threads are
+    // cancelled, to be hit again when resumed, and other stops are kept as
+    // pending to be reported next.
+    void stop_all_threads();
+
+    // If |thread| stopped on one of our breakpoint traps, back it up so that
+    // it executes the trap again when resumed. Returns whether it did.
+    bool cancel_breakpoint_hit(Thread& thread);
+
+    // Resume the target with |request| (i.e. PTRACE_CONT or
+    // PTRACE_SINGLESTEP) and wait for it to stop again. Single steps only
+    // resume the current thread, as does PTRACE_CONT unless |all_threads| is
+    // set. Whichever thread stops becomes the current thread, and all threads
+    // are stopped again before returning. Returns the waitpid(...) status.
+    int resume(__ptrace_request request, bool all_threads = true);
+
+    // Return whether an enabled breakpoint in |m_breakpoints| is at |address|.
+    bool has_breakpoint(uint64_t address) const;
+
+    // Return the enabled breakpoint at |address|, either in |m_breakpoints| or
+    // |m_temporary_breakpoints|, or nullptr if there isn't one.
+    Breakpoint* trap_at(uint64_t address);
+
+    // Tell the user if the current thread isn't the one they last saw stop.
+    void report_thread_switch();
+
+    // If the target stopped on one of the breakpoints in |m_breakpoints|, step
+    // over the breakpoint and report it. Interrupts and hardware breakpoints
+    // are reported too. Returns whether it reported anything.
+    bool handle_breakpoint_hit();
+
+    // If the user interrupted the target, report where. Returns whether it
+    // did.
+    bool handle_interrupt();
+
+    // If the target stopped on a conditional breakpoint in |m_breakpoints|
+    // whose condition is false, back up to the breakpoint's address so that
+    // the caller can step over it and resume. Counts the hit either way.
+    // Returns whether the target should carry on.
+    bool skip_breakpoint_hit();
+
+    // If the target stopped on any of |m_hardware_breakpoints|, report each
+    // of them. Returns whether it did.
+    bool handle_hardware_breakpoint_hit();
+
+    // Report the hit of the hardware breakpoint or watchpoint in |slot|.
+    void report_hardware_breakpoint_hit(std::size_t slot);
+
+    // Execute a single instruction of the current thread, stepping over any
+    // breakpoint at its program counter.
+    void step_instruction();
+
+    // Step the current thread over |breakpoint|, at its program counter, by
+    // executing a copy of the original instruction in the scratch page and
+    // moving the program counter back. The trap stays in place, so other
+    // threads can't run past it, and inserting and removing it again costs
+    // nothing. RIP relative operands and relative branches are adjusted for
+    // the move, as is the return address pushed by calls.
+    //
+    // Postconditions: Returns false, without running the target, if the
+    // instruction can't be moved, e.g. system calls the kernel may restart.
+    bool displaced_step(const Breakpoint& breakpoint);
+
+    // Have the current thread map a page for displaced instructions, as close
+    // to the target executable as the kernel allows so that RIP relative
+    // operands stay in reach. The mmap(2) system call is made from the entry
+    // point, which has run before any breakpoint can be hit and never runs
+    // again, and the thread's code and registers are restored afterwards.
+    std::optional<uint64_t> allocate_scratch_page();
+
+    // Decode the instructions in [|begin|, |end|) of the target, seeing
+    // through any breakpoints. Decoding stops at the first byte that isn't a
+    // valid instruction.
+    std::vector<x86::Instruction> decode_instructions(uint64_t begin,
+                                                      uint64_t end);
+
+    // Run the target until the program counter leaves |range|. Rather than
+    // single stepping, temporary breakpoints are planted on the exits of the
+    // range: branches that leave it, calls, returns and indirect jumps, and
+    // the end of the range. The current thread runs at full speed in between,
+    // while the other threads stay stopped. If |step_over_calls| is set, calls
+    // made from the range run to completion.
+    //
+    // Preconditions: The target is stopped.
+    //
+    // Postconditions: Returns false if the target stopped for any other
+    // reason, e.g. a breakpoint in |m_breakpoints| was hit.
+    bool step_out_of_range(dwarf::AddressRange range, bool step_over_calls);
+
+    // Run the target until the current thread returns to |return_address|
+    // from the call made with the stack pointer at |stack_pointer|. Returns to
+    // the same address from deeper, recursive, calls or other threads are
+    // ignored. All threads run, as the call may wait on them.
+    //
+    // Preconditions: The target is stopped.
+    //
+    // Postconditions: Returns false if the target stopped for any other
+    // reason.
+    bool run_to_return_address(uint64_t return_address,
+                               uint64_t stack_pointer);
 
     // Run child process until new signal is raised.
     void continue_execution();
 
-    // Run the child process to the end of the current stack frame (step out).
+    // Run the child process to the end of the current stack frame (step out),
+    // found by unwinding the current thread's stack.
     void continue_to_end_of_stack_frame();
 
     // Run the program to the next source line in the current file (step over).
@@ -73,11 +261,36 @@ private:
     // Do a source level single step (step in).
     void step();
 
-    // Set a breakpoint on the named function.
-    void break_on_function(std::string_view method);
+    // Compile |condition| against the variables in scope at |address|,
+    // setting |variables| to the locations of the variables it reads. Only
+    // variables of integer types can be read.
+    std::optional<BreakpointCondition>
+    compile_condition(uint64_t address, std::string_view condition,
+                      std::vector<dwarf::VariableLocation>& variables);
+
+    // Set a breakpoint on the named function. If |condition| isn't empty the
+    // breakpoint only stops the target when it is true.
+    void break_on_function(std::string_view method,
+                           std::string_view condition = {});
 
-    // Set a breakpoint on the specified line of a named source file.
-    void break_on_line_and_file(uint64_t line, std::string_view file);
+    // Set a breakpoint on the specified line of a named source file. If
+    // |condition| isn't empty the breakpoint only stops the target when it is
+    // true.
+    void break_on_line_and_file(uint64_t line, std::string_view file,
+                                std::string_view condition = {});
+
+    // Set a hardware breakpoint on |location|, either a function name or
+    // 'file:line'. Nothing is written to the target's code.
+    void hardware_break(std::string_view location);
+
+    // Set a watchpoint on the named variable in the current context, stopping
+    // the target after |condition| accesses to it. The target runs at full
+    // speed in between.
+    void watch(std::string_view variable, DebugRegisters::Condition condition);
+
+    // Read the current value of the variable watched by |watchpoint|.
+    std::optional<uint64_t>
+    read_watched_value(const HardwareBreakpoint& watchpoint);
 
     // Delete all of the previously set breakpoints.
     void delete_all_breakpoints();
@@ -85,18 +298,79 @@ private:
     // Return the current value of the specified register.
     uint64_t get_register_value(HardwareRegister desc);
 
-    // Return the value of the named variable in the current context.
-    std::optional<uint64_t> get_variable_value(std::string_view variable);
+    // Return the location of the named variable in the current context,
+    // after printing why if there isn't one.
+    std::optional<dwarf::VariableLocation>
+    find_variable(std::string_view variable);
+
+    // Evaluate the location of |variable| in the frame with |registers|,
+    // using the entry of its location list for the frame's pc. |is_caller|
+    // says whether the frame's pc is a return address. Entry values are read
+    // from the caller of the frame, if it is the innermost one.
+    //
+    // Preconditions: The target should be stopped.
+    //
+    // Postconditions: The location is undefined if no entry covers the pc.
+    // The bytes of an implicit location point into |variable|.
+    std::optional<dwarf::DwarfLocation>
+    evaluate_location(const dwarf::VariableLocation& variable,
+                      const Unwinder::Registers& registers,
+                      bool is_caller = false);
+
+    // Read the first |size| bytes of the object at |location| in the frame
+    // with |registers|. Returns std::nullopt if any of them have been
+    // optimized out or can't be read.
+    std::optional<std::string>
+    read_location(const dwarf::DwarfLocation& location,
+                  const Unwinder::Registers& registers, std::size_t size);
+
+    // Return the address of |variable|, found at |location|, in the current
+    // context.
+    std::optional<uint64_t>
+    variable_address(std::string_view variable,
+                     const dwarf::VariableLocation& location);
 
-    // Set the value of the named variable in the current context.
-    void set_variable_value(std::string_view variable, int32_t value);
+    // Print the value of the named variable in the current context, formatted
+    // according to its type.
+    void print_variable(std::string_view variable);
 
-    // Print a backtrace of the target process from the current context.
+    // Set the value of the named variable in the current context to |value|,
+    // parsed according to the variable's type. Only variables of base,
+    // enumeration and pointer types can be set.
+    void set_variable_value(std::string_view variable, std::string_view value);
+
+    // Print a backtrace of the current thread, up to main.
     void backtrace();
 
+    // Sample the stacks of every thread of the target |options.frequency|
+    // times a second, by stopping the whole target and unwinding each thread,
+    // until the target exits, |options.duration| has passed or the user
+    // interrupts. The samples are written out as folded stacks for flame
+    // graphs, along with how long each sample kept the target stopped.
+    void profile(const ProfileOptions& options);
+
+    // Let the resumed target run until the profiling timer expires, keeping
+    // track of its threads and passing on the signals they receive. Adds the
+    // number of timer expirations missed to |missed|. Returns false if the
+    // profile should end instead, as the target exited or the user
+    // interrupted.
+    bool run_until_sample(uint64_t& missed);
+
     // Dump the current values of each hardware register.
     void print_hardware_registers();
 
+    // List the breakpoints and watchpoints, with their hit counts.
+    void print_breakpoints();
+
+    // List the threads of the target, with where and why they stopped.
+    void print_threads();
+
+    // Make the thread numbered |number| the current thread.
+    void select_thread(int number);
+
+    // Print the hit rates of the target state caches.
+    void print_cache_statistics();
+
     // Print diagnostic information about the status returned from waitpid(...)
     void print_waitpid_status(int waitpid_status);
 
@@ -104,12 +378,43 @@ private:
     dwarf::Dwarf
         m_dwarf; // The Dwarf interpreter instance associated with |m_elf|.
 
+    EventLoop m_events; // Target state changes, Ctrl-C and user input.
+
+    // Set in the profile mode, where the target is profiled rather than
+    // debugged interactively.
+    std::optional<ProfileOptions> m_profile_options;
+
     std::string m_target; // Debug target path.
     bool m_is_running;    // Is the target currently running.
     int m_pid;            // PID of the target if |m_is_running| == true.
+    bool m_attached = false; // Was the target attached to rather than started.
+    uint64_t m_load_bias = 0; // Target address minus link-time address.
+
+    ThreadTable m_threads;      // Threads of the target.
+    Thread* m_thread = nullptr; // The current thread, which commands inspect.
+    int m_reported_tid = 0;     // The thread the user last saw stop.
+
+    Memory m_memory;     // Memory of the target, cached between resumes.
+    Unwinder m_unwinder; // Unwinds the target's stacks through |m_memory|.
 
     std::unordered_map<uint64_t, Breakpoint>
         m_breakpoints; // Map program counter values to breakpoints..
+    std::vector<Breakpoint>
+        m_temporary_breakpoints; // Planted while stepping, and removed as
+                                 // soon as the target stops.
+
+    DebugRegisters m_debug_registers; // Debug registers of every thread.
+
+    // Displaced instructions are executed from a page in the target, with a
+    // slot for each of the most recently stepped over breakpoints, so that
+    // hot breakpoints are only copied once.
+    static constexpr std::size_t scratch_slot_size = 16;
+    std::optional<uint64_t> m_scratch_page; // Zero if it couldn't be mapped.
+    std::unordered_map<uint64_t, uint64_t>
+        m_scratch_slots; // Instruction address to the address of its copy.
+    std::size_t m_next_scratch_slot = 0; // Slots are reused round robin.
+    std::array<std::optional<HardwareBreakpoint>, DebugRegisters::slots>
+        m_hardware_breakpoints; // Indexed by debug register slot.
 
     // Convenient mapping between hardware registers, dwarf register indexes and
     // printable names.
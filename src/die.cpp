@@ -2,10 +2,10 @@
 
 namespace smldbg::dwarf {
 
-DIE::DIE(char* debug_info, char* debug_info_end, char* debug_abbrev,
-         bool is_64bit)
+DIE::DIE(char* debug_info, char* debug_info_end,
+         const AbbreviationTable* abbreviations, const FormContext* context)
     : m_debug_info(debug_info), m_debug_info_end(debug_info_end),
-      m_debug_abbrev(debug_abbrev), m_is_64bit(is_64bit) {
+      m_abbreviations(abbreviations), m_context(context) {
     read_abbreviation_code();
 }
 
@@ -13,14 +13,10 @@ std::optional<Attribute> DIE::attribute(DW_AT attribute) {
     // Eat bytes until |data| points to the first byte of the form for the
     // requested attribute.
     const auto entry = find_attribute(attribute);
-    if (entry == m_ate.attributes.end())
+    if (entry == m_ate->attributes.end())
         return std::nullopt;
-    const auto index = std::distance(m_ate.attributes.begin(), entry);
-    char* data = m_debug_info;
-    for (unsigned i = 0; i < index; ++i) {
-        Attribute::eat(m_ate.forms[i], data, m_is_64bit);
-    }
-    return Attribute(m_ate.forms[index], data);
+    const auto index = std::distance(m_ate->attributes.begin(), entry);
+    return make_attribute(index, attribute_data(index));
 }
 
 std::vector<DIE> DIE::get_nested() {
@@ -30,20 +26,20 @@ std::vector<DIE> DIE::get_nested() {
 
     // If the next entry is null or the current entry has no children, there are
     // no nested entries to extract.
-    if (die.is_null() || m_ate.has_children == DW_CHLIDREN::DW_CHILDREN_no)
+    if (die.is_null() || m_ate->has_children == DW_CHLIDREN::DW_CHILDREN_no)
         return {};
 
-    // Extract nested entries until we return to the current nesting depth.
-    int depth = 0;
+    // Extract nested entries until the null entry that ends our children.
+    int depth = 1;
     std::vector<DIE> nested;
     do {
-        if (die.m_ate.has_children == DW_CHLIDREN::DW_CHILDREN_yes)
-            ++depth;
-        else if (die.tag() == DW_TAG::DW_TAG_null)
+        if (die.tag() == DW_TAG::DW_TAG_null) {
             --depth;
-
-        if (die.tag() != DW_TAG::DW_TAG_null)
+        } else {
             nested.push_back(die);
+            if (die.m_ate->has_children == DW_CHLIDREN::DW_CHILDREN_yes)
+                ++depth;
+        }
         ++die;
     } while (!die.is_null() && depth > 0);
 
@@ -59,60 +55,39 @@ DIE& DIE::operator++() {
 }
 
 void DIE::eat_entry() {
-    for (unsigned i = 0, e = m_ate.attributes.size(); i < e; ++i) {
-        Attribute::eat(m_ate.forms[i], m_debug_info, m_is_64bit);
-    }
+    m_debug_info = attribute_data(m_ate->attributes.size());
 }
 
 void DIE::read_abbreviation_code() {
-    // Read the tag for the entry. After we've read the tag, |m_debug_info|
-    // points to the first byte of the first attribute. Use the
-    // AbbreviationTableEntry instance returned by decode_abbreviations(...)
-    // to interpret the data.
-    const uint64_t tag_index = util::decodeULEB128(m_debug_info);
-    if (tag_index > 0)
-        m_ate = decode_abbreviations(tag_index);
-    else
-        m_ate = {}; // Null entry.
+    // Read the code for the entry. After we've read the code, |m_debug_info|
+    // points to the first byte of the first attribute. Use the (shared)
+    // AbbreviationTableEntry for the code to interpret the data. A code of 0
+    // maps to the null entry.
+    m_entry = m_debug_info;
+    const uint64_t code = util::decodeULEB128(m_debug_info);
+    m_ate = m_abbreviations->entry(code);
 }
 
-DIE::AbbreviationTableEntry DIE::decode_abbreviations(uint64_t index) {
-    char* iter = m_debug_abbrev;
-    while (true) {
-        // Decode the index of the current tag.
-        const uint64_t entry_index = util::decodeULEB128(iter);
-
-        // Decode the tag. A null tag indicates we have reached the end of
-        // the abbreviation table for the associated compile unit.
-        AbbreviationTableEntry ate = {};
-        ate.tag = static_cast<DW_TAG>(util::decodeULEB128(iter));
-        if (ate.tag == DW_TAG::DW_TAG_null)
-            return ate;
-
-        // Does this tag have any children or is the next entry a sibling?
-        ate.has_children =
-            static_cast<DW_CHLIDREN>(util::read_bytes<char>(iter));
-
-        // Decode the tags attributes and their forms. A null entry for both
-        // the attribute and form indicate we have reached the end of the
-        // current table entry.
-        DW_AT att = static_cast<DW_AT>(util::decodeULEB128(iter));
-        DW_FORM form = static_cast<DW_FORM>(util::decodeULEB128(iter));
-        while (att != DW_AT::DW_AT_null && form != DW_FORM::DW_FORM_null) {
-            ate.attributes.push_back(att);
-            ate.forms.push_back(form);
-            att = static_cast<DW_AT>(util::decodeULEB128(iter));
-            form = static_cast<DW_FORM>(util::decodeULEB128(iter));
-        }
+std::vector<DW_AT>::const_iterator DIE::find_attribute(DW_AT attribute) {
+    return std::find_if(m_ate->attributes.begin(), m_ate->attributes.end(),
+                        [&](DW_AT entry) { return entry == attribute; });
+}
 
-        if (entry_index == index)
-            return ate;
-    }
+char* DIE::attribute_data(std::size_t index) const {
+    // Jump over the forms of fixed size, then eat the rest.
+    const std::size_t fixed =
+        std::min(index, m_ate->fixed_offsets.size() - 1);
+    char* data = m_debug_info + m_ate->fixed_offsets[fixed];
+    for (std::size_t i = fixed; i < index; ++i)
+        Attribute::eat(m_ate->forms[i], data, *m_context);
+    return data;
 }
 
-std::vector<DW_AT>::iterator DIE::find_attribute(DW_AT attribute) {
-    return std::find_if(m_ate.attributes.begin(), m_ate.attributes.end(),
-                        [&](DW_AT entry) { return entry == attribute; });
+Attribute DIE::make_attribute(std::size_t index, char* data) const {
+    if (m_ate->forms[index] == DW_FORM::DW_FORM_implicit_const)
+        data = reinterpret_cast<char*>(
+            const_cast<int64_t*>(&m_ate->implicit_consts[index]));
+    return Attribute(m_ate->forms[index], data, m_context);
 }
 
-} // namespace smldbg::dwarf
\ No newline at end of file
+} // namespace smldbg::dwarf
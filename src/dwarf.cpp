@@ -1,13 +1,16 @@
 #include "dwarf.h"
 
 #include "compile_unit.h"
-#include "dwarf_location_stack_machine.h"
 #include "elf.h"
 #include "line_vm.h"
+#include "util.h"
+#include "work_queue.h"
 
 #include <algorithm>
+#include <charconv>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <string>
 #include <vector>
@@ -16,269 +19,915 @@ namespace smldbg::dwarf {
 
 using namespace util;
 
-Dwarf::Dwarf(elf::ELF* elf) : m_elf(elf) { read_compile_units(); }
+namespace {
+
+// Is |form| of the block or exprloc class, which locations described by a
+// single expression are?
+bool is_block(DW_FORM form) {
+    return form == DW_FORM::DW_FORM_exprloc || form == DW_FORM::DW_FORM_block ||
+           form == DW_FORM::DW_FORM_block1 || form == DW_FORM::DW_FORM_block2 ||
+           form == DW_FORM::DW_FORM_block4;
+}
+
+} // namespace
+
+Dwarf::Dwarf(elf::ELF* elf, unsigned index_threads,
+             const std::filesystem::path& index_cache_directory)
+    : m_elf(elf), m_index_threads(index_threads) {
+    read_compile_units();
+    if (index_cache_directory.empty() || m_compile_units.empty()) {
+        build_indexes(index_threads);
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::string id = index_cache_id();
+    const std::filesystem::path path = index_cache_directory / (id + ".index");
+    if (auto cache = IndexCache::open(path, id);
+        cache && load_indexes(std::move(*cache))) {
+        m_index_statistics = {.compile_units = m_compile_units.size(),
+                              .threads = 1,
+                              .elapsed = std::chrono::steady_clock::now() -
+                                         start,
+                              .cache = path};
+        return;
+    }
+
+    build_indexes(index_threads);
+    const NameIndex* name_index =
+        m_name_index.source() == NameIndex::Source::dwarf ? &m_name_index
+                                                          : nullptr;
+    if (!IndexCache::write(path, id, m_compile_unit_index, m_function_index,
+                           name_index, m_line_tables))
+        std::cerr << "Unable to write the index cache " << path << ".\n";
+}
 
 std::optional<SourceLocation>
 Dwarf::source_location_from_function(std::string_view function) {
-    elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
+    // Use the entry point of the first definition: DW_AT_entry_pc if given,
+    // otherwise the start of the function. That is DW_AT_low_pc, or for a
+    // function split into several ranges the start of the first one listed.
+    // Producers list the range holding the entry first; it isn't necessarily
+    // the lowest, e.g. GCC places the ".cold" part of a function before it.
+    // From DWARF 5, DW_AT_entry_pc may be an offset from the start.
+    // Section 2.18
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    const IndexSections sections = index_sections();
+    for (DIE& entry : functions_from_name(function)) {
+        std::optional<uint64_t> start;
+        if (auto low_pc = entry.attribute(DW_AT::DW_AT_low_pc); low_pc) {
+            start = low_pc->as_uint64t();
+        } else if (const CompileUnit* cu = compile_unit_from_offset(
+                       entry.entry() - sections.debug_info);
+                   cu) {
+            const std::vector<AddressRange> ranges =
+                cu->address_ranges(entry, sections.debug_ranges);
+            if (!ranges.empty())
+                start = ranges.front().low;
+        }
 
-    std::optional<uint64_t> address;
-    std::vector<DIE> entries = filter_die_by_tag(DW_TAG::DW_TAG_subprogram);
-    for (auto& entry : entries) {
-        if (auto name = entry.attribute(DW_AT::DW_AT_name); name) {
-            if (name->as_string_view(debug_str.data) != function)
+        auto entry_pc = entry.attribute(DW_AT::DW_AT_entry_pc);
+        if (entry_pc && is_address(entry_pc->form()))
+            return source_location_from_program_counter(entry_pc->as_uint64t(),
+                                                        true);
+        if (start)
+            return source_location_from_program_counter(
+                *start + (entry_pc ? entry_pc->as_uint64t() : 0), true);
+    }
+    return std::nullopt;
+}
+
+std::vector<DIE> Dwarf::functions_from_name(std::string_view function) {
+    std::vector<DIE> functions;
+    const IndexSections sections = index_sections();
+    // Look up |key| in |index| and keep the functions named |function|.
+    const auto find = [&](const NameIndex& index, std::string_view key) {
+        std::vector<const CompileUnit*> compile_units;
+        for (const NameIndex::Entry& entry : index.find(key)) {
+            if (!entry.is_compile_unit && key == function) {
+                if (auto die = die_at_offset(entry.offset); die)
+                    functions.push_back(*die);
                 continue;
-            if (auto low_pc = entry.attribute(DW_AT::DW_AT_low_pc); low_pc)
-                address = low_pc->as_uint64t();
+            }
+
+            // Either the index only records which compile unit defines the
+            // name, or we need the qualified name of the entry.
+            const CompileUnit* cu = compile_unit_from_offset(entry.offset);
+            if (cu && std::find(compile_units.begin(), compile_units.end(),
+                                cu) == compile_units.end())
+                compile_units.push_back(cu);
+        }
+        for (const CompileUnit* cu : compile_units) {
+            for_each_function(*cu, sections, true, [&](Function& candidate) {
+                if (candidate.name == function ||
+                    candidate.qualified_name == function ||
+                    candidate.linkage_name == function)
+                    functions.push_back(candidate.die);
+            });
+        }
+    };
+    // Qualified names aren't indexed, find the candidates by their last
+    // component instead.
+    const auto find_qualified = [&](const NameIndex& index) {
+        find(index, function);
+        if (const std::string_view name = util::unqualified_name(function);
+            functions.empty() && name != function)
+            find(index, name);
+    };
+
+    find_qualified(m_name_index);
+    if (functions.empty() && m_name_index.source() != NameIndex::Source::dwarf)
+        find_qualified(dwarf_name_index());
+    return functions;
+}
+
+std::vector<SourceLocation>
+Dwarf::program_counters_from_line_and_file(uint64_t line,
+                                           std::string_view file) {
+    std::vector<SourceLocation> locations;
+    for (const LineIndex::Match& match : line_index().find(file, line)) {
+        // A line can be entered several times within a function, e.g. the
+        // condition of a loop. Break on the first entry of each function.
+        std::vector<uint64_t> functions;
+        for (const uint64_t address : match.addresses) {
+            if (const auto function = m_function_index.find(address);
+                function) {
+                if (std::find(functions.begin(), functions.end(), *function) !=
+                    functions.end())
+                    continue;
+                functions.push_back(*function);
+            }
+            locations.push_back({.address = address,
+                                 .line = match.line,
+                                 .file = match.file,
+                                 .is_stmt = true,
+                                 .prologue_end = false});
         }
-        if (address)
-            break;
     }
+    return locations;
+}
 
-    if (!address)
+std::optional<SourceLocation>
+Dwarf::source_location_from_program_counter(uint64_t program_counter,
+                                            bool skip_prologues) {
+    const LineTable* table = line_table_from_program_counter(program_counter);
+    if (!table)
+        return std::nullopt;
+
+    // Find the line number entry which best matches |program_counter|.
+    std::optional<std::size_t> best_match = table->find(program_counter);
+    if (!best_match)
         return std::nullopt;
 
-    return source_location_from_program_counter(*address, true);
+    // If we can, skip function prologues.
+    const auto& rows = table->rows();
+    if (skip_prologues && *best_match + 1 < rows.size() &&
+        rows[*best_match + 1].prologue_end)
+        ++*best_match;
+
+    const LineTable::Row& row = rows[*best_match];
+    return SourceLocation{.address = row.address,
+                          .line = row.line,
+                          .file = table->file(row),
+                          .is_stmt = row.is_stmt,
+                          .prologue_end = row.prologue_end};
 }
 
-std::optional<uint64_t>
-Dwarf::program_counter_from_line_and_file(uint64_t line,
-                                          std::string_view file) {
-    // Get the .debug_line section offset for |file|.
-    const auto offset = debug_line_offset_from_file(file);
-    if (!offset)
+std::optional<AddressRange>
+Dwarf::line_range_from_program_counter(uint64_t program_counter) {
+    const LineTable* table = line_table_from_program_counter(program_counter);
+    if (!table)
+        return std::nullopt;
+    const std::optional<std::size_t> match = table->find(program_counter);
+    if (!match)
         return std::nullopt;
 
-    // Run the line number virtual machine to generate the line number table.
-    elf::ELFSection debug_line = m_elf->get_section_data(".debug_line");
-    elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
-    LineVM vm(debug_line.data + *offset, debug_str.data);
-    vm.exec();
+    // Extend the range over the neighbouring rows of the same line. Rows are
+    // sorted by address, so the range is contiguous.
+    const auto& rows = table->rows();
+    const auto same_line = [&](std::size_t i) {
+        return rows[i].line == rows[*match].line &&
+               rows[i].file == rows[*match].file;
+    };
+    std::size_t begin = *match;
+    while (begin > 0 && !rows[begin - 1].end_sequence && same_line(begin - 1))
+        --begin;
+    std::size_t end = *match + 1;
+    while (end < rows.size() && !rows[end].end_sequence && same_line(end))
+        ++end;
+    if (end == rows.size())
+        return std::nullopt;
+    return AddressRange{.low = rows[begin].address, .high = rows[end].address};
+}
 
-    // Find the closest line to |line| in |file|, favoring statements.
-    std::vector<LineNumberTableRow> line_numbers = vm.table();
-    int best_match = std::numeric_limits<int>::max();
-    int min_distance = std::numeric_limits<int>::max();
-    for (unsigned i = 0, e = line_numbers.size(); i < e; ++i) {
-        if (line_numbers[i].file != file)
-            continue;
-        int candidate = line_numbers[i].line;
-        const auto distance = std::abs(static_cast<int>(line) - candidate);
-        if (distance < min_distance && line_numbers[i].is_stmt) {
-            best_match = i;
-            min_distance = distance;
-        }
+std::optional<std::string>
+Dwarf::function_from_program_counter(uint64_t program_counter) {
+    std::optional<DIE> subprogram =
+        subprogram_from_program_counter(program_counter);
+    if (!subprogram)
+        return std::nullopt;
+
+    // Check if the subprogram has a name (or linkage_name). Out of line
+    // definitions take their name from the declaration they refer to.
+    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
+    const CompileUnit* cu =
+        compile_unit_from_offset(subprogram->entry() - debug_info.data);
+    for (DIE die = *subprogram; cu;) {
+        auto name = die.attribute(DW_AT::DW_AT_name);
+        if (!name)
+            name = die.attribute(DW_AT::DW_AT_linkage_name);
+        if (name)
+            return std::string(name->as_string_view());
+
+        auto origin = die.attribute(DW_AT::DW_AT_specification);
+        if (!origin)
+            origin = die.attribute(DW_AT::DW_AT_abstract_origin);
+        if (!origin)
+            break;
+        char* entry = cu->reference(*origin, debug_info.data);
+        cu = compile_unit_from_offset(entry - debug_info.data);
+        if (cu)
+            die = cu->die_at(entry);
     }
+    return std::nullopt;
+}
 
-    // Didn't find a match.
-    if (best_match == std::numeric_limits<unsigned>::max())
+std::optional<VariableLocation>
+Dwarf::variable_location(uint64_t program_counter,
+                         std::string_view variable_name) {
+    std::optional<DIE> subprogram =
+        subprogram_from_program_counter(program_counter);
+    const CompileUnit* cu =
+        subprogram ? compile_unit_from_offset(
+                         subprogram->entry() -
+                         m_elf->get_section_data(".debug_info").data)
+                   : compile_unit_from_program_counter(program_counter);
+    if (!cu)
         return std::nullopt;
 
-    // If we can, skip function prologues.
-    if (best_match < line_numbers.size() - 1 &&
-        line_numbers[best_match + 1].prologue_end)
-        ++best_match;
-
-    return line_numbers[best_match].address;
-}
+    const auto is_variable = [&](DIE& die) {
+        if (die.tag() != DW_TAG::DW_TAG_variable &&
+            die.tag() != DW_TAG::DW_TAG_formal_parameter)
+            return false;
+        if (die.attribute(DW_AT::DW_AT_declaration))
+            return false;
+        return entry_name(die) == variable_name;
+    };
+
+    // Look for a local variable or parameter first. Failing that, look for a
+    // variable of the compile unit, skipping the locals of other functions.
+    std::optional<DIE> variable;
+    if (subprogram) {
+        for (DIE& die : subprogram->get_nested()) {
+            if (is_variable(die)) {
+                variable = die;
+                break;
+            }
+        }
+    }
+    if (!variable && cu->root().has_children()) {
+        DIE die = cu->root();
+        int depth = 1;
+        for (++die; !die.is_null() && depth > 0 && !variable; ++die) {
+            if (die.tag() == DW_TAG::DW_TAG_null) {
+                --depth;
+                continue;
+            }
+            if (depth == 1 && is_variable(die))
+                variable = die;
+            if (die.has_children())
+                ++depth;
+        }
+    }
+    if (!variable)
+        return std::nullopt;
 
-std::optional<SourceLocation>
-Dwarf::source_location_from_program_counter(uint64_t program_counter,
-                                            bool skip_prologues) {
-    // Find the compile unit that contains |program_counter|.
-    const CompileUnit* compile_unit = [=]() -> CompileUnit* {
-        elf::ELFSection debug_ranges = m_elf->get_section_data(".debug_ranges");
-        for (auto& cu : m_compile_units) {
-            if (cu.contains_address(program_counter, debug_ranges.data))
-                return &cu;
+    // A variable without a location has been optimized out.
+    VariableLocation location;
+    if (std::optional<Attribute> attribute =
+            variable->attribute(DW_AT::DW_AT_location);
+        attribute) {
+        std::optional<LocationList> list = location_list(*attribute, *cu);
+        if (!list) {
+            std::cerr << "Unable to decode the location of " << variable_name
+                      << ".\n";
+            return std::nullopt;
         }
-        return nullptr;
-    }();
+        location.location = std::move(*list);
+    }
+    location.type = type_graph(*cu).type_of(*variable);
+    location.form_context = &cu->form_context();
+
+    if (subprogram) {
+        if (std::optional<Attribute> frame_base =
+                subprogram->attribute(DW_AT::DW_AT_frame_base);
+            frame_base)
+            location.frame_base = location_list(*frame_base, *cu);
+    }
+    return location;
+}
 
-    if (!compile_unit)
+std::optional<VariableLocation>
+Dwarf::call_site_value(uint64_t return_address, uint64_t reg) {
+    // The return address may be just past the end of the calling function.
+    std::optional<DIE> subprogram =
+        subprogram_from_program_counter(return_address - 1);
+    if (!subprogram)
         return std::nullopt;
-
-    // Get the offset into .debug_line.
-    std::optional<Attribute> stmt_list =
-        compile_unit->root().attribute(DW_AT::DW_AT_stmt_list);
-    if (!stmt_list)
+    const CompileUnit* cu = compile_unit_from_offset(
+        subprogram->entry() - m_elf->get_section_data(".debug_info").data);
+    if (!cu)
         return std::nullopt;
-    const uint64_t offset = stmt_list->as_uint64t();
 
-    // Run the line number virtual machine to generate the line number table.
-    elf::ELFSection debug_line = m_elf->get_section_data(".debug_line");
-    elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
-    LineVM vm(debug_line.data + offset, debug_str.data);
-    vm.exec();
+    // Section 3.4
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    // GCC emits the GNU extension the section was based on for DWARF 4.
+    for (DIE& site : subprogram->get_nested()) {
+        if (site.tag() != DW_TAG::DW_TAG_call_site &&
+            site.tag() != DW_TAG::DW_TAG_GNU_call_site)
+            continue;
+        const auto [call_return_pc, low_pc] = site.attributes(std::array{
+            DW_AT::DW_AT_call_return_pc, DW_AT::DW_AT_low_pc});
+        std::optional<Attribute> pc = call_return_pc ? call_return_pc : low_pc;
+        if (!pc || !is_address(pc->form()) ||
+            pc->as_uint64t() != return_address)
+            continue;
 
-    // Find the line number entry which best matches |program_counter|.
-    std::vector<LineNumberTableRow> line_numbers = vm.table();
-    int best_match = std::numeric_limits<int>::max();
-    for (unsigned i = 1, e = line_numbers.size(); i < e; ++i) {
-        const auto previous_address = line_numbers[i - 1].address;
-        const auto current_address = line_numbers[i].address;
-        if (previous_address <= program_counter &&
-            current_address > program_counter) {
-            if (line_numbers[i - 1].end_sequence)
+        for (DIE& parameter : site.get_nested()) {
+            if (parameter.tag() != DW_TAG::DW_TAG_call_site_parameter &&
+                parameter.tag() != DW_TAG::DW_TAG_GNU_call_site_parameter)
                 continue;
-            best_match = i - 1;
+            auto [location, value, gnu_value] =
+                parameter.attributes(std::array{
+                    DW_AT::DW_AT_location, DW_AT::DW_AT_call_value,
+                    DW_AT::DW_AT_GNU_call_site_value});
+            if (!value)
+                value = gnu_value;
+            if (!location || !value || !is_block(location->form()) ||
+                !is_block(value->form()))
+                continue;
+            const std::optional<DwarfExpression> parameter_location =
+                compile_expression(*location, *cu);
+            if (!parameter_location ||
+                parameter_location->register_number() != reg)
+                continue;
+
+            std::optional<DwarfExpression> expression =
+                compile_expression(*value, *cu);
+            if (!expression)
+                return std::nullopt;
+            VariableLocation call_value = {
+                .location = LocationList(std::move(*expression)),
+                .form_context = &cu->form_context()};
+            if (std::optional<Attribute> frame_base =
+                    subprogram->attribute(DW_AT::DW_AT_frame_base);
+                frame_base)
+                call_value.frame_base = location_list(*frame_base, *cu);
+            return call_value;
         }
+        return std::nullopt;
     }
+    return std::nullopt;
+}
 
-    if (best_match == std::numeric_limits<unsigned>::max())
-        return std::nullopt;
+void Dwarf::read_compile_units() {
+    // Get the ELF sections we need and read all of the compile units from
+    // the .debug_info section.
+    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
+    elf::ELFSection debug_abbrev = m_elf->get_section_data(".debug_abbrev");
+    const FormSections sections = {
+        .debug_str = m_elf->get_section_data(".debug_str").data,
+        .debug_line_str = m_elf->get_section_data(".debug_line_str").data,
+        .debug_str_offsets =
+            m_elf->get_section_data(".debug_str_offsets").data,
+        .debug_addr = m_elf->get_section_data(".debug_addr").data,
+        .debug_rnglists = m_elf->get_section_data(".debug_rnglists").data,
+        .debug_loclists = m_elf->get_section_data(".debug_loclists").data};
+    char* iter = debug_info.data;
+    while (std::distance(debug_info.data, iter) < debug_info.size) {
+        m_compile_units.emplace_back(&iter, debug_abbrev.data, sections);
+    }
+}
 
-    // If we can, skip function prologues.
-    if (skip_prologues && best_match < line_numbers.size() - 1 &&
-        line_numbers[best_match + 1].prologue_end)
-        ++best_match;
+std::string Dwarf::index_cache_id() {
+    const auto hex = [](uint64_t value) {
+        char digits[16];
+        const auto end =
+            std::to_chars(std::begin(digits), std::end(digits), value, 16).ptr;
+        return std::string(digits, end);
+    };
+
+    std::optional<std::string> id = m_elf->build_id();
+    if (!id) {
+        uint64_t hash = 0;
+        for (const char* name :
+             {".debug_info", ".debug_abbrev", ".debug_line", ".debug_line_str",
+              ".debug_str", ".debug_str_offsets", ".debug_addr",
+              ".debug_ranges", ".debug_rnglists", ".debug_aranges",
+              ".debug_names", ".gdb_index"}) {
+            const elf::ELFSection section = m_elf->get_section_data(name);
+            hash = util::hash({section.data, section.size}, hash);
+        }
+        id = hex(hash);
+    }
+    return *id + "-" + hex(m_elf->get_section_data(".debug_info").size);
+}
 
-    return SourceLocation{.address = line_numbers[best_match].address,
-                          .line = line_numbers[best_match].line,
-                          .file = line_numbers[best_match].file,
-                          .is_stmt = line_numbers[best_match].is_stmt,
-                          .prologue_end =
-                              line_numbers[best_match].prologue_end};
+bool Dwarf::load_indexes(IndexCache cache) {
+    std::optional<NameIndex> name_index = cache.name_index();
+    if (!name_index)
+        name_index = read_accelerator_table();
+    if (!name_index)
+        return false;
+
+    m_name_index = std::move(*name_index);
+    m_compile_unit_index = cache.compile_unit_index();
+    m_function_index = cache.function_index();
+    m_index_cache = std::move(cache);
+    return true;
 }
 
-std::optional<std::string>
-Dwarf::function_from_program_counter(uint64_t program_counter) {
-    std::optional<DIE> subprogram;
-    std::vector<DIE> entries = filter_die_by_tag(DW_TAG::DW_TAG_subprogram);
-    for (unsigned i = 0, e = entries.size(); i < e && !subprogram; ++i) {
-        auto low_pc_atr = entries[i].attribute(DW_AT::DW_AT_low_pc);
-        auto high_pc_atr = entries[i].attribute(DW_AT::DW_AT_high_pc);
-        if (!low_pc_atr || !high_pc_atr)
+void Dwarf::build_indexes(unsigned index_threads) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // Look up the sections before fanning out. ELF files read from a stream
+    // load sections on first use, which isn't safe to do concurrently.
+    const IndexSections sections = index_sections();
+
+    // Prefer the compiler or linker generated name index, if there is one.
+    std::optional<NameIndex> accelerator_table = read_accelerator_table();
+    const bool index_names = !accelerator_table;
+    if (accelerator_table)
+        m_name_index = std::move(*accelerator_table);
+
+    // Index each compile unit independently.
+    WorkQueue queue(index_threads);
+    std::vector<CompileUnitIndex> partial_indexes(m_compile_units.size());
+    queue.run(m_compile_units.size(), [&](std::size_t i) {
+        partial_indexes[i] =
+            index_compile_unit(m_compile_units[i], sections, index_names);
+    });
+
+    // Merge the partial indexes in .debug_info order, so the result doesn't
+    // depend on the order the compile units finished in.
+    const std::vector<bool> has_address_range_table =
+        read_address_range_tables();
+    if (index_names) {
+        std::size_t names = 0;
+        for (const CompileUnitIndex& partial : partial_indexes)
+            names += partial.function_names.size();
+        m_name_index.reserve(names);
+    }
+    for (std::size_t i = 0, e = partial_indexes.size(); i < e; ++i) {
+        CompileUnitIndex& partial = partial_indexes[i];
+        // Not every producer emits .debug_aranges for every compile unit.
+        if (!has_address_range_table[i])
+            for (const auto& range : partial.ranges)
+                m_compile_unit_index.insert(range.low, range.high, i);
+        for (const auto& function : partial.functions)
+            m_function_index.insert(function.low, function.high,
+                                    function.value);
+        for (const auto& [name, offset] : partial.function_names)
+            m_name_index.insert(name,
+                                {.offset = offset, .is_compile_unit = false});
+        if (partial.line_table_offset)
+            m_line_tables.try_emplace(*partial.line_table_offset,
+                                      std::move(partial.line_table));
+    }
+    m_compile_unit_index.finalize();
+    m_function_index.finalize();
+
+    m_index_statistics = {
+        .compile_units = m_compile_units.size(),
+        .threads = static_cast<unsigned>(
+            std::min<std::size_t>(queue.threads(), m_compile_units.size())),
+        .elapsed = std::chrono::steady_clock::now() - start};
+}
+
+Dwarf::CompileUnitIndex
+Dwarf::index_compile_unit(const CompileUnit& cu, const IndexSections& sections,
+                          bool index_names) const {
+    CompileUnitIndex index;
+    DIE root = cu.root();
+    index.ranges = cu.address_ranges(root, sections.debug_ranges);
+
+    // Index the subprograms by address and by name.
+    for_each_function(cu, sections, false, [&](Function& function) {
+        for (const auto& range : function.ranges)
+            index.functions.push_back({.low = range.low,
+                                       .high = range.high,
+                                       .value = function.offset});
+        if (index_names)
+            append_function_names(function, index.function_names);
+    });
+
+    // Decode the line number table.
+    if (auto stmt_list = root.attribute(DW_AT::DW_AT_stmt_list);
+        stmt_list && sections.debug_line) {
+        index.line_table_offset = stmt_list->as_uint64t();
+        LineVM vm(sections.debug_line + *index.line_table_offset,
+                  sections.debug_str, sections.debug_line_str);
+        vm.exec();
+        index.line_table = vm.compact_table();
+    }
+    return index;
+}
+
+void Dwarf::for_each_function(
+    const CompileUnit& cu, const IndexSections& sections, bool qualify_names,
+    const std::function<void(Function&)>& callback) const {
+    // The named namespaces and types enclosing the current entry, stored as a
+    // tree so qualified names are only assembled for the functions we report.
+    struct Scope {
+        std::string_view name;
+        std::size_t parent; // Index of the enclosing scope in |scopes|.
+    };
+    constexpr std::size_t root_scope = std::numeric_limits<std::size_t>::max();
+    std::vector<Scope> scopes;
+    const auto qualify = [&](std::size_t scope, std::string_view name) {
+        std::string qualified_name(name);
+        for (; scope != root_scope; scope = scopes[scope].parent)
+            qualified_name.insert(0, std::string(scopes[scope].name) + "::");
+        return qualified_name;
+    };
+
+    // The scope of each open list of child entries.
+    std::vector<std::size_t> open_scopes;
+
+    // The subprograms seen so far and their scopes, so definitions can pick
+    // up the names of the declarations they refer to. Entries are visited in
+    // .debug_info order, so the list is sorted by |entry|. Most subprograms
+    // are declarations that nothing refers to, so their names are only read
+    // on demand.
+    struct Subprogram {
+        char* entry;
+        std::size_t scope;
+    };
+    std::vector<Subprogram> subprograms;
+
+    // Read the names of |die|, following DW_AT_specification and
+    // DW_AT_abstract_origin to the entries it was declared by.
+    // Section 2.13.2 and 3.3.8.1
+    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    const auto read_names = [&](DIE die, std::size_t scope,
+                                Function& function) {
+        while (true) {
+            auto [name, linkage_name, specification, abstract_origin] =
+                die.attributes(std::array{
+                    DW_AT::DW_AT_name, DW_AT::DW_AT_linkage_name,
+                    DW_AT::DW_AT_specification, DW_AT::DW_AT_abstract_origin});
+            if (function.name.empty() && name) {
+                function.name = name->as_string_view();
+                if (qualify_names)
+                    function.qualified_name = qualify(scope, function.name);
+            }
+            if (function.linkage_name.empty() && linkage_name)
+                function.linkage_name =
+                    linkage_name->as_string_view();
+
+            const auto origin = specification ? specification : abstract_origin;
+            if (!origin ||
+                (!function.name.empty() && !function.linkage_name.empty()))
+                return;
+
+            // Only entries we've already seen are followed, so each step
+            // moves backwards through the compile unit.
+            char* entry = cu.reference(*origin, sections.debug_info);
+            const auto declaration = std::lower_bound(
+                subprograms.begin(), subprograms.end(), entry,
+                [](const Subprogram& subprogram, char* entry) {
+                    return subprogram.entry < entry;
+                });
+            if (declaration == subprograms.end() || declaration->entry != entry)
+                return;
+            die = cu.die_at(entry);
+            scope = declaration->scope;
+        }
+    };
+
+    for (DIE die = cu.root(); !die.is_null(); ++die) {
+        const DW_TAG tag = die.tag();
+        if (tag == DW_TAG::DW_TAG_null) {
+            if (!open_scopes.empty())
+                open_scopes.pop_back();
             continue;
+        }
 
-        // high_pc is either an absolute address or an offset.
-        const uint64_t low_pc = low_pc_atr->as_uint64t();
-        const uint64_t high_pc = [&]() -> uint64_t {
-            if (high_pc_atr->form() == DW_FORM::DW_FORM_addr)
-                return high_pc_atr->as_uint64t();
-            return low_pc + high_pc_atr->as_uint64t();
-        }();
+        const bool is_scope = tag == DW_TAG::DW_TAG_namespace ||
+                              tag == DW_TAG::DW_TAG_class_type ||
+                              tag == DW_TAG::DW_TAG_structure_type ||
+                              tag == DW_TAG::DW_TAG_union_type;
+        const std::size_t scope =
+            open_scopes.empty() ? root_scope : open_scopes.back();
+
+        if (tag == DW_TAG::DW_TAG_subprogram) {
+            subprograms.push_back({.entry = die.entry(), .scope = scope});
+            if (std::vector<AddressRange> ranges =
+                    cu.address_ranges(die, sections.debug_ranges);
+                !ranges.empty()) {
+                Function function = {
+                    .die = die,
+                    .offset = static_cast<uint64_t>(die.entry() -
+                                                    sections.debug_info),
+                    .ranges = std::move(ranges)};
+                read_names(die, scope, function);
+                callback(function);
+            }
+        }
 
-        if (low_pc <= program_counter && program_counter <= high_pc)
-            subprogram = entries[i];
+        if (!die.has_children())
+            continue;
+        if (auto name = is_scope ? die.attribute(DW_AT::DW_AT_name)
+                                 : std::nullopt;
+            name) {
+            scopes.push_back(
+                {.name = name->as_string_view(),
+                 .parent = scope});
+            open_scopes.push_back(scopes.size() - 1);
+        } else {
+            open_scopes.push_back(scope);
+        }
     }
+}
 
-    if (!subprogram)
-        return std::nullopt;
+void Dwarf::append_function_names(
+    const Function& function,
+    std::vector<std::pair<std::string_view, uint64_t>>& names) {
+    if (!function.name.empty())
+        names.emplace_back(function.name, function.offset);
+    if (!function.linkage_name.empty())
+        names.emplace_back(function.linkage_name, function.offset);
+}
 
-    // Check if the subprogram has a name (or linkage_name).
-    auto name = [&]() {
-        auto name = subprogram->attribute(DW_AT::DW_AT_name);
-        auto linkage_name = subprogram->attribute(DW_AT::DW_AT_linkage_name);
-        return name ? name : linkage_name ? linkage_name : std::nullopt;
-    }();
+const NameIndex& Dwarf::dwarf_name_index() {
+    if (m_dwarf_name_index)
+        return *m_dwarf_name_index;
+
+    const IndexSections sections = index_sections();
+    std::vector<std::vector<std::pair<std::string_view, uint64_t>>> names(
+        m_compile_units.size());
+    WorkQueue queue(m_index_threads);
+    queue.run(m_compile_units.size(), [&](std::size_t i) {
+        for_each_function(m_compile_units[i], sections, false,
+                          [&](Function& function) {
+                              append_function_names(function, names[i]);
+                          });
+    });
+
+    m_dwarf_name_index.emplace(NameIndex::Source::dwarf);
+    for (const auto& unit_names : names)
+        for (const auto& [name, offset] : unit_names)
+            m_dwarf_name_index->insert(
+                name, {.offset = offset, .is_compile_unit = false});
+    return *m_dwarf_name_index;
+}
 
-    if (!name)
-        return std::nullopt;
+Dwarf::IndexSections Dwarf::index_sections() {
+    return {.debug_info = m_elf->get_section_data(".debug_info").data,
+            .debug_ranges = m_elf->get_section_data(".debug_ranges").data,
+            .debug_line = m_elf->get_section_data(".debug_line").data,
+            .debug_str = m_elf->get_section_data(".debug_str").data,
+            .debug_line_str =
+                m_elf->get_section_data(".debug_line_str").data};
+}
 
+std::optional<NameIndex> Dwarf::read_accelerator_table() {
     elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
-    return std::string(name->as_string_view(debug_str.data));
+    if (auto index = NameIndex::read_debug_names(
+            m_elf->get_section_data(".debug_names"), debug_str.data);
+        index)
+        return index;
+    return NameIndex::read_gdb_index(m_elf->get_section_data(".gdb_index"));
 }
 
-std::optional<int64_t>
-Dwarf::variable_location(uint64_t program_counter,
-                         std::string_view variable_name) {
-    // Find the subprogram associated with |program_counter|.
-    std::optional<DIE> subprogram;
-    std::vector<DIE> entries = filter_die_by_tag(DW_TAG::DW_TAG_subprogram);
-    for (unsigned i = 0, e = entries.size(); i < e && !subprogram; ++i) {
-        auto low_pc = entries[i].attribute(DW_AT::DW_AT_low_pc);
-        auto high_pc = entries[i].attribute(DW_AT::DW_AT_high_pc);
-        if (!low_pc || !high_pc)
-            continue;
+std::vector<bool> Dwarf::read_address_range_tables() {
+    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
+    elf::ELFSection debug_aranges = m_elf->get_section_data(".debug_aranges");
+
+    // Compile units are stored in .debug_info order, so the unit an address
+    // range table refers to can be found by binary searching on its offset.
+    const auto compile_unit_index =
+        [&](uint64_t offset) -> std::optional<uint64_t> {
+        char* begin = debug_info.data + offset;
+        const auto cu = std::lower_bound(
+            m_compile_units.begin(), m_compile_units.end(), begin,
+            [](const CompileUnit& cu, char* begin) {
+                return cu.debug_info_begin() < begin;
+            });
+        if (cu == m_compile_units.end() || cu->debug_info_begin() != begin)
+            return std::nullopt;
+        return std::distance(m_compile_units.begin(), cu);
+    };
+
+    // Section 6.1.2
+    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    std::vector<bool> covered(m_compile_units.size(), false);
+    char* iter = debug_aranges.data;
+    char* const end = debug_aranges.data + debug_aranges.size;
+    while (iter && iter < end) {
+        char* const start = iter;
+        uint64_t unit_length = util::read_bytes<uint32_t>(iter);
+        const bool is_64bit = unit_length == 0xFFFFFFFF;
+        if (is_64bit)
+            unit_length = util::read_bytes<uint64_t>(iter);
+        char* const next = iter + unit_length;
+        if (unit_length == 0 || next > end)
+            break;
 
-        // |high_pc| is either an absolute address or an offset from |low_pc|.
-        const uint64_t low = low_pc->as_uint64t();
-        const uint64_t high = [&]() -> uint64_t {
-            if (high_pc->form() == DW_FORM::DW_FORM_addr)
-                return high_pc->as_uint64t();
-            return low + high_pc->as_uint64t();
-        }();
+        util::read_bytes<uint16_t>(iter); // version
+        const uint64_t debug_info_offset =
+            is_64bit ? util::read_bytes<uint64_t>(iter)
+                     : util::read_bytes<uint32_t>(iter);
+        const uint8_t address_size = util::read_bytes<uint8_t>(iter);
+        util::read_bytes<uint8_t>(iter); // segment_size
+
+        const std::optional<uint64_t> index =
+            compile_unit_index(debug_info_offset);
+        if (!index || address_size != sizeof(uint64_t)) {
+            iter = next;
+            continue;
+        }
 
-        if (low <= program_counter && program_counter <= high)
-            subprogram = entries[i];
+        // The first tuple is aligned to twice the address size, relative to
+        // the start of the set.
+        const uint64_t tuple_size = 2 * address_size;
+        const uint64_t header_size = iter - start;
+        iter += (tuple_size - header_size % tuple_size) % tuple_size;
+
+        while (iter + tuple_size <= next) {
+            const uint64_t address = util::read_bytes<uint64_t>(iter);
+            const uint64_t length = util::read_bytes<uint64_t>(iter);
+            if (address == 0 && length == 0)
+                break; // End of set.
+            m_compile_unit_index.insert(address, address + length, *index);
+        }
+        covered[*index] = true;
+        iter = next;
     }
+    return covered;
+}
 
-    if (!subprogram)
+const CompileUnit*
+Dwarf::compile_unit_from_program_counter(uint64_t program_counter) {
+    const std::optional<uint64_t> index =
+        m_compile_unit_index.find(program_counter);
+    if (!index)
+        return nullptr;
+    return &m_compile_units[*index];
+}
+
+const CompileUnit* Dwarf::compile_unit_from_offset(uint64_t offset) {
+    // Compile units are stored in .debug_info order, so we can binary search
+    // for the one containing |offset|.
+    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
+    char* entry = debug_info.data + offset;
+    const auto cu = std::upper_bound(
+        m_compile_units.begin(), m_compile_units.end(), entry,
+        [](char* entry, const CompileUnit& cu) {
+            return entry < cu.debug_info_begin();
+        });
+    if (cu == m_compile_units.begin())
+        return nullptr;
+    if (const auto& owner = *std::prev(cu); entry < owner.debug_info_end())
+        return &owner;
+    return nullptr;
+}
+
+std::optional<DIE> Dwarf::die_at_offset(uint64_t offset) {
+    const CompileUnit* cu = compile_unit_from_offset(offset);
+    if (!cu)
         return std::nullopt;
+    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
+    return cu->die_at(debug_info.data + offset);
+}
 
-    // Get the location of the variable.
-    std::optional<Attribute> location;
-    std::vector<DIE> nested = subprogram->get_nested();
-    for (unsigned i = 0, e = nested.size(); i < e && !location; ++i) {
-        elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
-        if (auto name = nested[i].attribute(DW_AT::DW_AT_name); name)
-            if (name->as_string_view(debug_str.data) != variable_name)
-                continue;
-        location = nested[i].attribute(DW_AT::DW_AT_location);
-        break;
+std::optional<std::string_view> Dwarf::entry_name(DIE die) {
+    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
+    const CompileUnit* cu = compile_unit_from_offset(die.entry() -
+                                                     debug_info.data);
+    while (cu) {
+        auto [name, specification, abstract_origin] =
+            die.attributes(std::array{DW_AT::DW_AT_name,
+                                      DW_AT::DW_AT_specification,
+                                      DW_AT::DW_AT_abstract_origin});
+        if (name)
+            return name->as_string_view();
+        const std::optional<Attribute> origin =
+            specification ? specification : abstract_origin;
+        if (!origin)
+            break;
+        char* entry = cu->reference(*origin, debug_info.data);
+        cu = compile_unit_from_offset(entry - debug_info.data);
+        if (cu)
+            die = cu->die_at(entry);
     }
+    return std::nullopt;
+}
 
-    // Get the subprogram frame base in case we need it.
-    std::optional<Attribute> frame_base =
-        subprogram->attribute(DW_AT::DW_AT_frame_base);
+std::optional<DwarfExpression>
+Dwarf::compile_expression(Attribute attribute, const CompileUnit& cu) {
+    return DwarfExpression::compile(attribute.as_block(), cu.offset_size(),
+                                   cu.form_context().address_size);
+}
+
+std::optional<LocationList> Dwarf::location_list(Attribute attribute,
+                                                 const CompileUnit& cu) {
+    if (is_block(attribute.form())) {
+        std::optional<DwarfExpression> expression =
+            compile_expression(attribute, cu);
+        if (!expression)
+            return std::nullopt;
+        return LocationList(std::move(*expression));
+    }
 
-    // TODO: Add proper location decoding support.
-    if (location->form() != DW_FORM::DW_FORM_exprloc) {
-        std::cerr << "Locations in the form of location lists are not "
-                     "currently supported.\n";
+    // Otherwise the attribute is an offset into the location list section,
+    // which changed format in DWARF 5.
+    // Section 7.5.5
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    if (attribute.form() != DW_FORM::DW_FORM_sec_offset &&
+        attribute.form() != DW_FORM::DW_FORM_loclistx &&
+        attribute.form() != DW_FORM::DW_FORM_data4 &&
+        attribute.form() != DW_FORM::DW_FORM_data8)
         return std::nullopt;
+    if (cu.dwarf_version() >= 5) {
+        elf::ELFSection debug_loclists =
+            m_elf->get_section_data(".debug_loclists");
+        return LocationList::read_debug_loclists(
+            {debug_loclists.data, debug_loclists.size},
+            attribute.as_uint64t(), cu.base_address(), cu.offset_size(),
+            cu.form_context().address_size,
+            [&](uint64_t index) { return cu.form_context().address(index); });
     }
+    elf::ELFSection debug_loc = m_elf->get_section_data(".debug_loc");
+    return LocationList::read_debug_loc(
+        {debug_loc.data, debug_loc.size}, attribute.as_uint64t(),
+        cu.base_address(), cu.offset_size(), cu.form_context().address_size);
+}
 
-    // Decode the frame base for the current variable.
-    DwarfLocationStackMachine frame_base_stack_machine;
-    DwarfLocation frame_base_value =
-        frame_base_stack_machine.exec(frame_base->as_raw());
+std::optional<DIE>
+Dwarf::subprogram_from_program_counter(uint64_t program_counter) {
+    const std::optional<uint64_t> offset =
+        m_function_index.find(program_counter);
+    if (!offset)
+        return std::nullopt;
+    return die_at_offset(*offset);
+}
+
+const LineTable& Dwarf::line_table(uint64_t offset) {
+    if (const auto cached = m_line_tables.find(offset);
+        cached != m_line_tables.end())
+        return cached->second;
 
-    // Decode the variable location.
-    DwarfLocationStackMachine variable_location_stack_machine;
-    DwarfLocation dwarfLocation =
-        variable_location_stack_machine.exec(location->as_raw());
+    if (m_index_cache) {
+        if (std::optional<LineTable> table = m_index_cache->line_table(offset);
+            table)
+            return m_line_tables.emplace(offset, std::move(*table))
+                .first->second;
+    }
 
-    return {dwarfLocation.offset};
+    // Run the line number virtual machine to generate the line number table.
+    elf::ELFSection debug_line = m_elf->get_section_data(".debug_line");
+    elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
+    elf::ELFSection debug_line_str = m_elf->get_section_data(".debug_line_str");
+    LineVM vm(debug_line.data + offset, debug_str.data, debug_line_str.data);
+    vm.exec();
+    return m_line_tables.emplace(offset, vm.compact_table()).first->second;
 }
 
-void Dwarf::read_compile_units() {
-    // Get the ELF sections we need and read all of the compile units from
-    // the .debug_info section.
-    elf::ELFSection debug_info = m_elf->get_section_data(".debug_info");
-    elf::ELFSection debug_abbrev = m_elf->get_section_data(".debug_abbrev");
-    char* iter = debug_info.data;
-    while (std::distance(debug_info.data, iter) < debug_info.size) {
-        m_compile_units.emplace_back(&iter, debug_abbrev.data);
-    }
+const LineTable*
+Dwarf::line_table_from_program_counter(uint64_t program_counter) {
+    const CompileUnit* compile_unit =
+        compile_unit_from_program_counter(program_counter);
+    if (!compile_unit)
+        return nullptr;
+    std::optional<Attribute> stmt_list =
+        compile_unit->root().attribute(DW_AT::DW_AT_stmt_list);
+    if (!stmt_list)
+        return nullptr;
+    return &line_table(stmt_list->as_uint64t());
 }
 
-std::vector<DIE> Dwarf::filter_die_by_tag(DW_TAG tag) {
-    std::vector<DIE> filtered;
-    for (auto cu : m_compile_units)
-        for (DIE die = cu.root(); !die.is_null(); ++die)
-            if (die.tag() == tag)
-                filtered.emplace_back(die);
-    return filtered;
+const LineIndex& Dwarf::line_index() {
+    if (m_line_index)
+        return *m_line_index;
+
+    // Insert the tables in .debug_info order, so files are matched in a
+    // stable order.
+    m_line_index.emplace();
+    for (const CompileUnit& cu : m_compile_units)
+        if (auto stmt_list = cu.root().attribute(DW_AT::DW_AT_stmt_list);
+            stmt_list)
+            m_line_index->insert(line_table(stmt_list->as_uint64t()));
+    m_line_index->finalize();
+    return *m_line_index;
 }
 
-std::optional<uint64_t>
-Dwarf::debug_line_offset_from_file(std::string_view file) {
-    elf::ELFSection debug_str = m_elf->get_section_data(".debug_str");
-    std::vector<DIE> entries = filter_die_by_tag(DW_TAG::DW_TAG_compile_unit);
-    for (auto entry : entries) {
-        if (auto attrib = entry.attribute(DW_AT::DW_AT_name); attrib) {
-            auto name = attrib->as_string_view(debug_str.data);
-            if (name != file)
-                continue;
-            auto stmt_list_attrib = entry.attribute(DW_AT::DW_AT_stmt_list);
-            if (!stmt_list_attrib)
-                return std::nullopt;
-            return stmt_list_attrib->as_uint64t();
-        }
-    }
-    return std::nullopt;
+TypeGraph& Dwarf::type_graph(const CompileUnit& cu) {
+    if (auto graph = m_type_graphs.find(&cu); graph != m_type_graphs.end())
+        return graph->second;
+    return m_type_graphs
+        .try_emplace(&cu, &cu, m_elf->get_section_data(".debug_info").data)
+        .first->second;
 }
 
 } // namespace smldbg::dwarf
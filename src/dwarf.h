@@ -1,15 +1,26 @@
 #pragma once
 
+#include "address_range_index.h"
 #include "attribute.h"
 #include "compile_unit.h"
 #include "die.h"
+#include "location_list.h"
 #include "elf.h"
+#include "index_cache.h"
+#include "line_index.h"
+#include "line_table.h"
+#include "name_index.h"
+#include "type_graph.h"
 
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <filesystem>
+#include <functional>
 #include <iterator>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -24,53 +35,282 @@ struct SourceLocation {
                        // prologue?
 };
 
-struct VariableLocation {
-    uint64_t address;
-    uint64_t register_id;
+struct IndexStatistics {
+    std::size_t compile_units; // Number of compile units indexed.
+    unsigned threads;          // Number of threads used to build the indexes.
+    std::chrono::duration<double, std::milli>
+        elapsed; // Wall clock time taken to build or load the indexes.
+    std::filesystem::path cache; // The index cache the indexes were loaded
+                                 // from, empty if they were built.
 };
 
 class Dwarf {
 public:
     Dwarf() = default;
-    Dwarf(elf::ELF* elf);
 
-    // Return the source location of the named function.
+    // Construct a new Dwarf instance for |elf|, indexing the compile units of
+    // the .debug_info section on |index_threads| threads. A value of zero uses
+    // one thread per hardware thread. If |index_cache_directory| is given, the
+    // indexes are loaded from the index cache for |elf| in that directory,
+    // or written to it once built if there isn't a valid one.
+    Dwarf(elf::ELF* elf, unsigned index_threads = 0,
+          const std::filesystem::path& index_cache_directory = {});
+
+    // Return the source location of the named function. |function| may be a
+    // plain, qualified (e.g. "ns::Class::method") or linkage name.
     std::optional<SourceLocation>
     source_location_from_function(std::string_view function);
 
-    // Return the program counter value associated with |line| of |file|.
-    std::optional<uint64_t>
-    program_counter_from_line_and_file(uint64_t line, std::string_view file);
+    // Return the DW_TAG_subprogram entries with code named |function|.
+    // |function| may be a plain, qualified or linkage name. Qualified names
+    // are resolved by looking up the unqualified name, then comparing the
+    // qualified names of the functions of each candidate compile unit.
+    std::vector<DIE> functions_from_name(std::string_view function);
+
+    // Return the program counter values associated with |line| of |file|,
+    // one for each function with statements on the line. |file| may be a
+    // file name or the trailing components of its path, every file it
+    // matches is searched. If |line| has no statements, the next line that
+    // does is used.
+    std::vector<SourceLocation>
+    program_counters_from_line_and_file(uint64_t line, std::string_view file);
 
     // Return the source location associated with a program counter value.
     std::optional<SourceLocation>
     source_location_from_program_counter(uint64_t program_counter,
                                          bool skip_prologues);
 
+    // Return the address range of the line table rows describing the source
+    // line that contains |program_counter|. Source level stepping runs the
+    // target until it leaves this range.
+    std::optional<AddressRange>
+    line_range_from_program_counter(uint64_t program_counter);
+
     // Return the name of the function associated with a program counter value.
     std::optional<std::string>
     function_from_program_counter(uint64_t program_counter);
 
-    // Return the location of a variable at a specific program counter value.
-    std::optional<int64_t> variable_location(uint64_t program_counter,
-                                             std::string_view variable_name);
+    // Return the location of the named variable in scope at a program
+    // counter value: a local variable or parameter of the function, or
+    // failing that a variable of the compile unit. Location lists are decoded
+    // whole, so the location can be looked up again at other program counter
+    // values of the function. The variable's type is decoded along with it.
+    // Prints the reason if the variable has a location that can't be
+    // decoded.
+    std::optional<VariableLocation>
+    variable_location(uint64_t program_counter,
+                      std::string_view variable_name);
+
+    // Return the value DWARF register |reg| was given by the call whose
+    // return address is |return_address|, as described by the
+    // DW_TAG_call_site_parameter entries of the calling function. This is
+    // what DW_OP_entry_value reads in the called function. The expression is
+    // evaluated in the caller's frame.
+    std::optional<VariableLocation> call_site_value(uint64_t return_address,
+                                                    uint64_t reg);
+
+    // Return how long it took to build the indexes.
+    const IndexStatistics& index_statistics() const {
+        return m_index_statistics;
+    }
 
 private:
+    // The parts of the indexes contributed by a single compile unit. These are
+    // built concurrently, then merged in .debug_info order.
+    struct CompileUnitIndex {
+        std::vector<AddressRange>
+            ranges; // Address ranges of the root DIE, used when the compile
+                    // unit has no .debug_aranges entry.
+        std::vector<AddressRangeIndex::Entry>
+            functions; // Address ranges of each DW_TAG_subprogram entry.
+        std::vector<std::pair<std::string_view, uint64_t>>
+            function_names; // Names and .debug_info offset of each
+                            // DW_TAG_subprogram entry with code.
+        std::optional<uint64_t>
+            line_table_offset; // DW_AT_stmt_list of the root DIE.
+        LineTable line_table;  // The decoded line number table.
+    };
+
+    // The sections read while indexing a compile unit.
+    struct IndexSections {
+        char* debug_info;
+        char* debug_ranges;
+        char* debug_line;
+        char* debug_str;
+        char* debug_line_str;
+    };
+
+    // A DW_TAG_subprogram entry with code and each of the names it can be
+    // found by.
+    struct Function {
+        DIE die;
+        uint64_t offset; // Offset of |die| in the .debug_info section.
+        std::vector<AddressRange> ranges;
+        std::string_view name;         // DW_AT_name.
+        std::string qualified_name;    // DW_AT_name, prefixed by the names of
+                                       // the enclosing namespaces and types.
+                                       // Only set when requested, as it has
+                                       // to be assembled.
+        std::string_view linkage_name; // DW_AT_linkage_name.
+    };
+
+    // Call |callback| for each DW_TAG_subprogram entry of |cu| that has code.
+    // Definitions that refer to a declaration (DW_AT_specification) or an
+    // abstract instance (DW_AT_abstract_origin) inherit its names. Qualified
+    // names are only assembled if |qualify_names| is true.
+    //
+    // Preconditions: None, this may be called concurrently for different
+    // compile units.
+    //
+    // Postconditions: None.
+    void
+    for_each_function(const CompileUnit& cu, const IndexSections& sections,
+                      bool qualify_names,
+                      const std::function<void(Function&)>& callback) const;
+
+    // Append the plain and linkage names of |function| to |names|.
+    static void append_function_names(
+        const Function& function,
+        std::vector<std::pair<std::string_view, uint64_t>>& names);
+
+    // Return the name index built from the DIEs of each compile unit. When
+    // the names were read from an accelerator table this index is only built
+    // the first time a name can't be found in the table, as the table may not
+    // record every form of a name (.gdb_index only records qualified names).
+    const NameIndex& dwarf_name_index();
+
+    // Return the sections read while indexing.
+    IndexSections index_sections();
+
     // Read each of the compile units present in |m_elf|.
     void read_compile_units();
 
-    // Return debug information entries with a tag matching |tag|.
-    std::vector<DIE> filter_die_by_tag(DW_TAG tag);
+    // Return the id of the build |m_elf| is of, which names its index cache:
+    // the build id, or failing that a hash of the sections the indexes are
+    // built from. The size of .debug_info is appended, as a stripped file
+    // and its debug information file share their build id.
+    std::string index_cache_id();
+
+    // Load the indexes from |cache|. Line tables are loaded as they are
+    // requested. Returns false, leaving the indexes empty, if the cache
+    // doesn't have the names and there is no accelerator table to read them
+    // from.
+    bool load_indexes(IndexCache cache);
+
+    // Build the compile unit, function, function name and line table indexes.
+    // Each compile unit is indexed independently on one of |index_threads|
+    // threads.
+    void build_indexes(unsigned index_threads);
+
+    // Build the index entries contributed by |cu|.
+    //
+    // Preconditions: None, this may be called concurrently for different
+    // compile units.
+    //
+    // Postconditions: Function names are only collected if |index_names| is
+    // true.
+    CompileUnitIndex index_compile_unit(const CompileUnit& cu,
+                                        const IndexSections& sections,
+                                        bool index_names) const;
+
+    // Return the name index of an accelerator table present in |m_elf|, if
+    // any. .debug_names is preferred over .gdb_index.
+    std::optional<NameIndex> read_accelerator_table();
+
+    // Add the address ranges of the .debug_aranges section to
+    // |m_compile_unit_index|. Returns which compile units had an address range
+    // table.
+    std::vector<bool> read_address_range_tables();
+
+    // Return the compile unit whose address ranges contain |program_counter|.
+    const CompileUnit*
+    compile_unit_from_program_counter(uint64_t program_counter);
+
+    // Return the compile unit containing the entry at |offset| bytes from the
+    // start of the .debug_info section.
+    const CompileUnit* compile_unit_from_offset(uint64_t offset);
 
-    // Get the offset into the .debug_line sections for the compile unit
-    // representing |file|.
-    std::optional<uint64_t> debug_line_offset_from_file(std::string_view file);
+    // Return the DIE at |offset| bytes from the start of the .debug_info
+    // section.
+    std::optional<DIE> die_at_offset(uint64_t offset);
+
+    // Return the DW_AT_name of |die|, or of the entry it completes
+    // (DW_AT_specification) or is an instance of (DW_AT_abstract_origin).
+    std::optional<std::string_view> entry_name(DIE die);
+
+    // Compile the block or exprloc class attribute |attribute| of an entry of
+    // |cu|.
+    static std::optional<DwarfExpression>
+    compile_expression(Attribute attribute, const CompileUnit& cu);
+
+    // Return the location described by |attribute|, an attribute of an
+    // entry of |cu| that is either a single expression or refers to a
+    // location list.
+    std::optional<LocationList> location_list(Attribute attribute,
+                                              const CompileUnit& cu);
+
+    // Return the DW_TAG_subprogram entry whose address range contains
+    // |program_counter|.
+    std::optional<DIE>
+    subprogram_from_program_counter(uint64_t program_counter);
+
+    // Return the line number table starting at |offset| bytes into the
+    // .debug_line section. The tables referenced by compile units are decoded
+    // while indexing, or read from the index cache the first time they are
+    // requested. Any other table is decoded the first time it is requested.
+    // Subsequent requests are served from |m_line_tables|.
+    const LineTable& line_table(uint64_t offset);
+
+    // Return the line number table of the compile unit containing
+    // |program_counter|, or nullptr if there isn't one.
+    const LineTable* line_table_from_program_counter(uint64_t program_counter);
+
+    // Return the index of the statements of every line table referenced by a
+    // compile unit, building it the first time it's requested.
+    const LineIndex& line_index();
+
+    // Return the type graph of |cu|, creating it the first time it's
+    // requested. Types are decoded as they are looked up.
+    TypeGraph& type_graph(const CompileUnit& cu);
 
     elf::ELF* m_elf; // The ELF file of the debug target.
 
     std::vector<CompileUnit>
         m_compile_units; // The compileu nits present in the .debug_info
                          // section of |m_elf|.
+
+    std::unordered_map<uint64_t, LineTable>
+        m_line_tables; // Decoded line number tables, keyed by their offset
+                       // into the .debug_line section.
+
+    std::optional<LineIndex>
+        m_line_index; // Maps file and line pairs to addresses.
+
+    std::unordered_map<const CompileUnit*, TypeGraph>
+        m_type_graphs; // The types decoded so far, by compile unit.
+
+    AddressRangeIndex m_function_index; // Maps the address ranges of each
+                                        // subprogram to the .debug_info offset
+                                        // of its DIE.
+
+    AddressRangeIndex
+        m_compile_unit_index; // Maps the address ranges of each compile unit
+                              // to its index in |m_compile_units|.
+
+    NameIndex m_name_index; // Maps function names to their DW_TAG_subprogram
+                            // entries.
+
+    std::optional<NameIndex>
+        m_dwarf_name_index; // Fallback for |m_name_index| when it was read
+                            // from an accelerator table.
+
+    std::optional<IndexCache>
+        m_index_cache; // The index cache the indexes were loaded from. Names
+                       // and file names refer into it.
+
+    unsigned m_index_threads = 0; // Number of threads used for indexing.
+
+    IndexStatistics m_index_statistics = {};
 };
 
 } // namespace smldbg::dwarf
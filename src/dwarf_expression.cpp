@@ -0,0 +1,711 @@
+#include "dwarf_expression.h"
+
+#include "byte_reader.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace smldbg::dwarf {
+
+namespace {
+
+// Evaluation gives up after this many operations, as branches can loop.
+constexpr std::size_t max_operations = 100000;
+
+// DWARF expression operations as encoded.
+// Section 7.7.1
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+enum : uint8_t {
+    DW_OP_addr = 0x03,
+    DW_OP_deref = 0x06,
+    DW_OP_const1u = 0x08,
+    DW_OP_const1s = 0x09,
+    DW_OP_const2u = 0x0a,
+    DW_OP_const2s = 0x0b,
+    DW_OP_const4u = 0x0c,
+    DW_OP_const4s = 0x0d,
+    DW_OP_const8u = 0x0e,
+    DW_OP_const8s = 0x0f,
+    DW_OP_constu = 0x10,
+    DW_OP_consts = 0x11,
+    DW_OP_dup = 0x12,
+    DW_OP_drop = 0x13,
+    DW_OP_over = 0x14,
+    DW_OP_pick = 0x15,
+    DW_OP_swap = 0x16,
+    DW_OP_rot = 0x17,
+    DW_OP_xderef = 0x18,
+    DW_OP_abs = 0x19,
+    DW_OP_and = 0x1a,
+    DW_OP_div = 0x1b,
+    DW_OP_minus = 0x1c,
+    DW_OP_mod = 0x1d,
+    DW_OP_mul = 0x1e,
+    DW_OP_neg = 0x1f,
+    DW_OP_not = 0x20,
+    DW_OP_or = 0x21,
+    DW_OP_plus = 0x22,
+    DW_OP_plus_uconst = 0x23,
+    DW_OP_shl = 0x24,
+    DW_OP_shr = 0x25,
+    DW_OP_shra = 0x26,
+    DW_OP_xor = 0x27,
+    DW_OP_bra = 0x28,
+    DW_OP_eq = 0x29,
+    DW_OP_ge = 0x2a,
+    DW_OP_gt = 0x2b,
+    DW_OP_le = 0x2c,
+    DW_OP_lt = 0x2d,
+    DW_OP_ne = 0x2e,
+    DW_OP_skip = 0x2f,
+    DW_OP_lit0 = 0x30,
+    DW_OP_lit31 = 0x4f,
+    DW_OP_reg0 = 0x50,
+    DW_OP_reg31 = 0x6f,
+    DW_OP_breg0 = 0x70,
+    DW_OP_breg31 = 0x8f,
+    DW_OP_regx = 0x90,
+    DW_OP_fbreg = 0x91,
+    DW_OP_bregx = 0x92,
+    DW_OP_piece = 0x93,
+    DW_OP_deref_size = 0x94,
+    DW_OP_xderef_size = 0x95,
+    DW_OP_nop = 0x96,
+    DW_OP_push_object_address = 0x97,
+    DW_OP_call2 = 0x98,
+    DW_OP_call4 = 0x99,
+    DW_OP_call_ref = 0x9a,
+    DW_OP_form_tls_address = 0x9b,
+    DW_OP_call_frame_cfa = 0x9c,
+    DW_OP_bit_piece = 0x9d,
+    DW_OP_implicit_value = 0x9e,
+    DW_OP_stack_value = 0x9f,
+    DW_OP_implicit_pointer = 0xa0,
+    DW_OP_addrx = 0xa1,
+    DW_OP_constx = 0xa2,
+    DW_OP_entry_value = 0xa3,
+    DW_OP_const_type = 0xa4,
+    DW_OP_regval_type = 0xa5,
+    DW_OP_deref_type = 0xa6,
+    DW_OP_xderef_type = 0xa7,
+    DW_OP_convert = 0xa8,
+    DW_OP_reinterpret = 0xa9,
+    DW_OP_GNU_push_tls_address = 0xe0,
+    DW_OP_GNU_uninit = 0xf0,
+    DW_OP_GNU_implicit_pointer = 0xf2,
+    DW_OP_GNU_entry_value = 0xf3,
+    DW_OP_GNU_const_type = 0xf4,
+    DW_OP_GNU_regval_type = 0xf5,
+    DW_OP_GNU_deref_type = 0xf6,
+    DW_OP_GNU_convert = 0xf7,
+    DW_OP_GNU_reinterpret = 0xf9,
+    DW_OP_GNU_parameter_ref = 0xfa,
+    DW_OP_GNU_addr_index = 0xfb,
+    DW_OP_GNU_const_index = 0xfc,
+};
+
+} // namespace
+
+std::optional<DwarfExpression>
+DwarfExpression::compile(std::span<const char> bytes, unsigned offset_size,
+                         unsigned address_size) {
+    DwarfExpression expression;
+    ByteReader reader(bytes);
+    std::vector<uint64_t> offsets; // Byte offset of each instruction.
+    std::vector<std::pair<std::size_t, uint64_t>>
+        branches; // Instruction index and target byte offset.
+
+    while (!reader.at_end()) {
+        offsets.push_back(reader.offset());
+        const uint8_t opcode = reader.fixed<uint8_t>();
+        Instruction instruction = {.opcode = static_cast<Opcode>(opcode)};
+        if (opcode >= DW_OP_lit0 && opcode <= DW_OP_lit31) {
+            instruction = {.opcode = Opcode::DW_OP_constu,
+                           .operand = uint64_t(opcode - DW_OP_lit0)};
+        } else if (opcode >= DW_OP_reg0 && opcode <= DW_OP_reg31) {
+            instruction = {.opcode = Opcode::DW_OP_regx,
+                           .operand = uint64_t(opcode - DW_OP_reg0)};
+        } else if (opcode >= DW_OP_breg0 && opcode <= DW_OP_breg31) {
+            instruction = {.opcode = Opcode::DW_OP_bregx,
+                           .operand = uint64_t(opcode - DW_OP_breg0),
+                           .operand2 = uint64_t(reader.sleb())};
+        } else {
+            switch (opcode) {
+            case DW_OP_addr:
+                instruction.operand = reader.address(address_size);
+                break;
+            case DW_OP_const1u:
+            case DW_OP_const1s:
+            case DW_OP_const2u:
+            case DW_OP_const2s:
+            case DW_OP_const4u:
+            case DW_OP_const4s:
+            case DW_OP_const8u:
+            case DW_OP_const8s:
+            case DW_OP_constu:
+            case DW_OP_consts: {
+                uint64_t value = 0;
+                switch (opcode) {
+                case DW_OP_const1u:
+                    value = reader.fixed<uint8_t>();
+                    break;
+                case DW_OP_const1s:
+                    value = reader.fixed<int8_t>();
+                    break;
+                case DW_OP_const2u:
+                    value = reader.fixed<uint16_t>();
+                    break;
+                case DW_OP_const2s:
+                    value = reader.fixed<int16_t>();
+                    break;
+                case DW_OP_const4u:
+                    value = reader.fixed<uint32_t>();
+                    break;
+                case DW_OP_const4s:
+                    value = reader.fixed<int32_t>();
+                    break;
+                case DW_OP_const8u:
+                case DW_OP_const8s:
+                    value = reader.fixed<uint64_t>();
+                    break;
+                case DW_OP_constu:
+                    value = reader.uleb();
+                    break;
+                case DW_OP_consts:
+                    value = reader.sleb();
+                    break;
+                }
+                instruction = {.opcode = Opcode::DW_OP_constu,
+                               .operand = value};
+                break;
+            }
+            case DW_OP_const_type:
+            case DW_OP_GNU_const_type: {
+                // The value is in the encoding of its base type, which is
+                // read as an unsigned integer.
+                reader.uleb();
+                const std::span<const char> value =
+                    reader.block(reader.fixed<uint8_t>());
+                instruction = {.opcode = Opcode::DW_OP_constu};
+                std::memcpy(&instruction.operand, value.data(),
+                            std::min(value.size(), sizeof(uint64_t)));
+                break;
+            }
+            case DW_OP_deref:
+                instruction = {.opcode = Opcode::DW_OP_deref_size,
+                               .operand = sizeof(uint64_t)};
+                break;
+            case DW_OP_deref_size:
+            case DW_OP_deref_type:
+            case DW_OP_GNU_deref_type:
+                instruction = {.opcode = Opcode::DW_OP_deref_size,
+                               .operand = reader.fixed<uint8_t>()};
+                if (opcode != DW_OP_deref_size)
+                    reader.uleb();
+                if (instruction.operand == 0 ||
+                    instruction.operand > sizeof(uint64_t))
+                    return std::nullopt;
+                break;
+            case DW_OP_over:
+                instruction = {.opcode = Opcode::DW_OP_pick, .operand = 1};
+                break;
+            case DW_OP_pick:
+            case DW_OP_xderef_size:
+                instruction.operand = reader.fixed<uint8_t>();
+                break;
+            case DW_OP_xderef_type:
+                reader.fixed<uint8_t>();
+                reader.uleb();
+                instruction.opcode = Opcode::DW_OP_xderef;
+                break;
+            case DW_OP_regval_type:
+            case DW_OP_GNU_regval_type:
+                instruction = {.opcode = Opcode::DW_OP_regval_type,
+                               .operand = reader.uleb()};
+                reader.uleb();
+                break;
+            case DW_OP_convert:
+            case DW_OP_reinterpret:
+            case DW_OP_GNU_convert:
+            case DW_OP_GNU_reinterpret:
+                // Values keep the generic type.
+                reader.uleb();
+                instruction.opcode = Opcode::DW_OP_nop;
+                break;
+            case DW_OP_GNU_uninit:
+                instruction.opcode = Opcode::DW_OP_nop;
+                break;
+            case DW_OP_plus_uconst:
+            case DW_OP_regx:
+            case DW_OP_piece:
+            case DW_OP_addrx:
+            case DW_OP_constx:
+                instruction.operand = reader.uleb();
+                break;
+            case DW_OP_GNU_addr_index:
+                instruction = {.opcode = Opcode::DW_OP_addrx,
+                               .operand = reader.uleb()};
+                break;
+            case DW_OP_GNU_const_index:
+                instruction = {.opcode = Opcode::DW_OP_constx,
+                               .operand = reader.uleb()};
+                break;
+            case DW_OP_fbreg:
+                instruction.operand = reader.sleb();
+                break;
+            case DW_OP_bregx:
+                instruction.operand = reader.uleb();
+                instruction.operand2 = reader.sleb();
+                break;
+            case DW_OP_bit_piece:
+                instruction.operand = reader.uleb();
+                instruction.operand2 = reader.uleb();
+                break;
+            case DW_OP_implicit_value: {
+                const std::span<const char> value =
+                    reader.block(reader.uleb());
+                instruction.operand = expression.m_data.size();
+                instruction.operand2 = value.size();
+                expression.m_data.insert(expression.m_data.end(),
+                                         value.begin(), value.end());
+                break;
+            }
+            case DW_OP_implicit_pointer:
+            case DW_OP_GNU_implicit_pointer:
+                instruction = {.opcode = Opcode::DW_OP_implicit_pointer,
+                               .operand = reader.offset(offset_size)};
+                instruction.operand2 = reader.sleb();
+                break;
+            case DW_OP_entry_value:
+            case DW_OP_GNU_entry_value: {
+                const std::span<const char> block =
+                    reader.block(reader.uleb());
+                if (reader.failed())
+                    return std::nullopt;
+                std::optional<DwarfExpression> entry_value =
+                    compile(block, offset_size, address_size);
+                if (!entry_value)
+                    return std::nullopt;
+                instruction = {.opcode = Opcode::DW_OP_entry_value,
+                               .operand = expression.m_entry_values.size()};
+                expression.m_entry_values.push_back(std::move(*entry_value));
+                break;
+            }
+            case DW_OP_skip:
+            case DW_OP_bra: {
+                // Offsets are from the end of the operand.
+                const int16_t offset = reader.fixed<int16_t>();
+                branches.emplace_back(expression.m_code.size(),
+                                      reader.offset() + offset);
+                break;
+            }
+            case DW_OP_call2:
+                instruction.operand = reader.fixed<uint16_t>();
+                break;
+            case DW_OP_call4:
+            case DW_OP_GNU_parameter_ref:
+                instruction.operand = reader.fixed<uint32_t>();
+                break;
+            case DW_OP_call_ref:
+                instruction.operand = reader.offset(offset_size);
+                break;
+            case DW_OP_GNU_push_tls_address:
+                instruction.opcode = Opcode::DW_OP_form_tls_address;
+                break;
+            case DW_OP_dup:
+            case DW_OP_drop:
+            case DW_OP_swap:
+            case DW_OP_rot:
+            case DW_OP_xderef:
+            case DW_OP_abs:
+            case DW_OP_and:
+            case DW_OP_div:
+            case DW_OP_minus:
+            case DW_OP_mod:
+            case DW_OP_mul:
+            case DW_OP_neg:
+            case DW_OP_not:
+            case DW_OP_or:
+            case DW_OP_plus:
+            case DW_OP_shl:
+            case DW_OP_shr:
+            case DW_OP_shra:
+            case DW_OP_xor:
+            case DW_OP_eq:
+            case DW_OP_ge:
+            case DW_OP_gt:
+            case DW_OP_le:
+            case DW_OP_lt:
+            case DW_OP_ne:
+            case DW_OP_nop:
+            case DW_OP_push_object_address:
+            case DW_OP_form_tls_address:
+            case DW_OP_call_frame_cfa:
+            case DW_OP_stack_value:
+                break;
+            default:
+                return std::nullopt;
+            }
+        }
+        if (reader.failed())
+            return std::nullopt;
+        expression.m_code.push_back(instruction);
+    }
+
+    // Branches must land on an operation, or the end of the expression.
+    offsets.push_back(bytes.size());
+    for (const auto& [index, target] : branches) {
+        const auto found =
+            std::lower_bound(offsets.begin(), offsets.end(), target);
+        if (found == offsets.end() || *found != target)
+            return std::nullopt;
+        expression.m_code[index].operand = found - offsets.begin();
+    }
+    return expression;
+}
+
+std::optional<DwarfLocation>
+DwarfExpression::evaluate(const Context& context,
+                          std::optional<uint64_t> initial) const {
+    // Section 2.5 and 2.6
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    std::vector<uint64_t> stack;
+    stack.reserve(8);
+    if (initial)
+        stack.push_back(*initial);
+    const auto pop = [&]() -> std::optional<uint64_t> {
+        if (stack.empty())
+            return std::nullopt;
+        const uint64_t value = stack.back();
+        stack.pop_back();
+        return value;
+    };
+    const auto read_register =
+        [&](uint64_t reg) -> std::optional<uint64_t> {
+        if (!context.read_register)
+            return std::nullopt;
+        return context.read_register(reg);
+    };
+
+    // A register or implicit location ends a piece, or the expression.
+    std::optional<DwarfLocation> location;
+    std::vector<DwarfLocation> pieces;
+
+    std::size_t operations = 0;
+    for (std::size_t pc = 0; pc < m_code.size(); ++pc) {
+        if (++operations > max_operations)
+            return std::nullopt;
+        const Instruction& instruction = m_code[pc];
+        switch (instruction.opcode) {
+        case Opcode::DW_OP_addr:
+            stack.push_back(instruction.operand + context.load_bias);
+            break;
+        case Opcode::DW_OP_addrx:
+        case Opcode::DW_OP_constx: {
+            if (!context.debug_addr)
+                return std::nullopt;
+            const auto address = context.debug_addr(instruction.operand);
+            if (!address)
+                return std::nullopt;
+            stack.push_back(instruction.opcode == Opcode::DW_OP_addrx
+                                ? *address + context.load_bias
+                                : *address);
+            break;
+        }
+        case Opcode::DW_OP_constu:
+            stack.push_back(instruction.operand);
+            break;
+        case Opcode::DW_OP_dup:
+            if (stack.empty())
+                return std::nullopt;
+            stack.push_back(stack.back());
+            break;
+        case Opcode::DW_OP_drop:
+            if (!pop())
+                return std::nullopt;
+            break;
+        case Opcode::DW_OP_pick:
+            if (instruction.operand >= stack.size())
+                return std::nullopt;
+            stack.push_back(stack[stack.size() - 1 - instruction.operand]);
+            break;
+        case Opcode::DW_OP_swap:
+            if (stack.size() < 2)
+                return std::nullopt;
+            std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+            break;
+        case Opcode::DW_OP_rot:
+            if (stack.size() < 3)
+                return std::nullopt;
+            std::rotate(stack.end() - 3, stack.end() - 1, stack.end());
+            break;
+        case Opcode::DW_OP_deref_size: {
+            const auto address = pop();
+            uint64_t value = 0;
+            if (!address || !context.read_memory ||
+                !context.read_memory(*address,
+                                     {reinterpret_cast<char*>(&value),
+                                      instruction.operand}))
+                return std::nullopt;
+            stack.push_back(value);
+            break;
+        }
+        case Opcode::DW_OP_abs:
+        case Opcode::DW_OP_neg:
+        case Opcode::DW_OP_not: {
+            const auto value = pop();
+            if (!value)
+                return std::nullopt;
+            const int64_t signed_value = static_cast<int64_t>(*value);
+            if (instruction.opcode == Opcode::DW_OP_abs)
+                stack.push_back(signed_value < 0 ? -*value : *value);
+            else if (instruction.opcode == Opcode::DW_OP_neg)
+                stack.push_back(-*value);
+            else
+                stack.push_back(~*value);
+            break;
+        }
+        case Opcode::DW_OP_plus_uconst:
+            if (stack.empty())
+                return std::nullopt;
+            stack.back() += instruction.operand;
+            break;
+        case Opcode::DW_OP_and:
+        case Opcode::DW_OP_div:
+        case Opcode::DW_OP_minus:
+        case Opcode::DW_OP_mod:
+        case Opcode::DW_OP_mul:
+        case Opcode::DW_OP_or:
+        case Opcode::DW_OP_plus:
+        case Opcode::DW_OP_shl:
+        case Opcode::DW_OP_shr:
+        case Opcode::DW_OP_shra:
+        case Opcode::DW_OP_xor:
+        case Opcode::DW_OP_eq:
+        case Opcode::DW_OP_ge:
+        case Opcode::DW_OP_gt:
+        case Opcode::DW_OP_le:
+        case Opcode::DW_OP_lt:
+        case Opcode::DW_OP_ne: {
+            // The second entry is the left hand side.
+            const auto right = pop();
+            const auto left = pop();
+            if (!left || !right)
+                return std::nullopt;
+            const int64_t a = static_cast<int64_t>(*left);
+            const int64_t b = static_cast<int64_t>(*right);
+            uint64_t result = 0;
+            switch (instruction.opcode) {
+            case Opcode::DW_OP_and:
+                result = *left & *right;
+                break;
+            case Opcode::DW_OP_div:
+                if (b == 0)
+                    return std::nullopt;
+                result = b == -1 ? -*left : a / b;
+                break;
+            case Opcode::DW_OP_minus:
+                result = *left - *right;
+                break;
+            case Opcode::DW_OP_mod:
+                if (*right == 0)
+                    return std::nullopt;
+                result = *left % *right;
+                break;
+            case Opcode::DW_OP_mul:
+                result = *left * *right;
+                break;
+            case Opcode::DW_OP_or:
+                result = *left | *right;
+                break;
+            case Opcode::DW_OP_plus:
+                result = *left + *right;
+                break;
+            case Opcode::DW_OP_shl:
+                result = *right < 64 ? *left << *right : 0;
+                break;
+            case Opcode::DW_OP_shr:
+                result = *right < 64 ? *left >> *right : 0;
+                break;
+            case Opcode::DW_OP_shra:
+                result = a >> std::min<uint64_t>(*right, 63);
+                break;
+            case Opcode::DW_OP_xor:
+                result = *left ^ *right;
+                break;
+            case Opcode::DW_OP_eq:
+                result = a == b;
+                break;
+            case Opcode::DW_OP_ge:
+                result = a >= b;
+                break;
+            case Opcode::DW_OP_gt:
+                result = a > b;
+                break;
+            case Opcode::DW_OP_le:
+                result = a <= b;
+                break;
+            case Opcode::DW_OP_lt:
+                result = a < b;
+                break;
+            case Opcode::DW_OP_ne:
+                result = a != b;
+                break;
+            default:
+                break;
+            }
+            stack.push_back(result);
+            break;
+        }
+        case Opcode::DW_OP_bra: {
+            const auto condition = pop();
+            if (!condition)
+                return std::nullopt;
+            if (*condition != 0)
+                pc = instruction.operand - 1;
+            break;
+        }
+        case Opcode::DW_OP_skip:
+            // The increment of the loop takes |pc| to the target.
+            pc = instruction.operand - 1;
+            break;
+        case Opcode::DW_OP_regx:
+            location = {.kind = DwarfLocationKind::reg,
+                        .value = instruction.operand};
+            break;
+        case Opcode::DW_OP_regval_type: {
+            const auto value = read_register(instruction.operand);
+            if (!value)
+                return std::nullopt;
+            stack.push_back(*value);
+            break;
+        }
+        case Opcode::DW_OP_bregx: {
+            const auto value = read_register(instruction.operand);
+            if (!value)
+                return std::nullopt;
+            stack.push_back(*value + instruction.operand2);
+            break;
+        }
+        case Opcode::DW_OP_fbreg: {
+            if (!context.frame_base)
+                return std::nullopt;
+            const auto frame_base = context.frame_base();
+            if (!frame_base)
+                return std::nullopt;
+            stack.push_back(*frame_base + instruction.operand);
+            break;
+        }
+        case Opcode::DW_OP_call_frame_cfa: {
+            if (!context.cfa)
+                return std::nullopt;
+            const auto cfa = context.cfa();
+            if (!cfa)
+                return std::nullopt;
+            stack.push_back(*cfa);
+            break;
+        }
+        case Opcode::DW_OP_push_object_address:
+            if (!context.object_address)
+                return std::nullopt;
+            stack.push_back(*context.object_address);
+            break;
+        case Opcode::DW_OP_form_tls_address: {
+            const auto offset = pop();
+            if (!offset || !context.tls_address)
+                return std::nullopt;
+            const auto address = context.tls_address(*offset);
+            if (!address)
+                return std::nullopt;
+            stack.push_back(*address);
+            break;
+        }
+        case Opcode::DW_OP_entry_value: {
+            // Usually just a register, whose value on entry is pushed.
+            // Otherwise the expression is evaluated with the values the
+            // registers had on entry.
+            if (!context.entry_value)
+                return std::nullopt;
+            const DwarfExpression& expression =
+                m_entry_values[instruction.operand];
+            if (const auto reg = expression.register_number(); reg) {
+                const auto value = context.entry_value(*reg);
+                if (!value)
+                    return std::nullopt;
+                stack.push_back(*value);
+                break;
+            }
+            Context entry = context;
+            entry.read_register = context.entry_value;
+            const auto value = expression.evaluate(entry);
+            if (!value || (value->kind != DwarfLocationKind::memory &&
+                           value->kind != DwarfLocationKind::value))
+                return std::nullopt;
+            stack.push_back(value->value);
+            break;
+        }
+        case Opcode::DW_OP_stack_value:
+            if (stack.empty())
+                return std::nullopt;
+            location = {.kind = DwarfLocationKind::value,
+                        .value = stack.back()};
+            break;
+        case Opcode::DW_OP_implicit_value:
+            location = {.kind = DwarfLocationKind::implicit,
+                        .bytes = std::span(m_data.data() + instruction.operand,
+                                           instruction.operand2)};
+            break;
+        case Opcode::DW_OP_implicit_pointer:
+            // The object pointed to has no address to give.
+            location = {.kind = DwarfLocationKind::undefined};
+            break;
+        case Opcode::DW_OP_piece:
+        case Opcode::DW_OP_bit_piece: {
+            // A piece without a location has been optimized out.
+            DwarfLocation piece;
+            if (location)
+                piece = *location;
+            else if (const auto address = pop(); address)
+                piece = {.kind = DwarfLocationKind::memory, .value = *address};
+            location.reset();
+            if (instruction.opcode == Opcode::DW_OP_piece) {
+                piece.bit_size = instruction.operand * 8;
+            } else {
+                piece.bit_size = instruction.operand;
+                piece.bit_offset = instruction.operand2;
+            }
+            pieces.push_back(std::move(piece));
+            break;
+        }
+        case Opcode::DW_OP_nop:
+            break;
+        case Opcode::DW_OP_xderef:
+        case Opcode::DW_OP_xderef_size:
+        case Opcode::DW_OP_call2:
+        case Opcode::DW_OP_call4:
+        case Opcode::DW_OP_call_ref:
+        case Opcode::DW_OP_GNU_parameter_ref:
+            return std::nullopt;
+        }
+    }
+
+    if (!pieces.empty())
+        return DwarfLocation{.kind = DwarfLocationKind::composite,
+                             .pieces = std::move(pieces)};
+    if (location)
+        return location;
+    if (stack.empty())
+        return DwarfLocation{.kind = DwarfLocationKind::undefined};
+    return DwarfLocation{.kind = DwarfLocationKind::memory,
+                         .value = stack.back()};
+}
+
+std::optional<uint64_t> DwarfExpression::register_number() const {
+    if (m_code.size() != 1 || m_code[0].opcode != Opcode::DW_OP_regx)
+        return std::nullopt;
+    return m_code[0].operand;
+}
+
+} // namespace smldbg::dwarf
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+// What a DWARF expression says about an object.
+// Section 2.6
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+enum class DwarfLocationKind : uint8_t {
+    memory,    // The object is in memory at |value|.
+    reg,       // The object is in DWARF register |value|.
+    value,     // The object isn't anywhere, its value is |value|.
+    implicit,  // The object isn't anywhere, its value is |bytes|.
+    undefined, // The object has been optimized out.
+    composite, // The object is in |pieces|.
+};
+
+struct DwarfLocation {
+    DwarfLocationKind kind = DwarfLocationKind::undefined;
+    uint64_t value = 0;
+    std::span<const char> bytes; // Points into the expression.
+
+    // The size of a piece of a composite location, and the offset of the
+    // piece in the register or memory |value| describes, both in bits. A
+    // size of zero is the whole object.
+    uint64_t bit_size = 0;
+    uint64_t bit_offset = 0;
+
+    std::vector<DwarfLocation> pieces; // In order of increasing address.
+};
+
+// A DWARF expression (a location description, a frame base or a CFI rule),
+// decoded once into an array of instructions with their operands. Evaluating
+// the expression again, e.g. at each hit of a conditional breakpoint, only
+// runs the instructions: LEB128 operands are decoded, and branch offsets
+// resolved to instruction indexes, when the expression is compiled.
+//
+// Every operation of DWARF 5 is understood, along with the GNU extensions
+// GCC emits for DWARF 4. Typed operations work on the generic type: values
+// are 64 bits wide whatever their base type. DW_OP_call2, DW_OP_call4,
+// DW_OP_call_ref, the DW_OP_xderef operations and DW_OP_GNU_parameter_ref
+// compile, but fail to evaluate.
+class DwarfExpression {
+public:
+    // How an expression reads the state of the target. Operations fail when
+    // the function they need isn't set, or returns std::nullopt.
+    struct Context {
+        // Return the contents of DWARF register |reg|.
+        std::function<std::optional<uint64_t>(uint64_t reg)> read_register;
+
+        // Read |bytes.size()| bytes of memory at |address|.
+        std::function<bool(uint64_t address, std::span<char> bytes)>
+            read_memory;
+
+        // Return the frame base of the current function (DW_OP_fbreg).
+        std::function<std::optional<uint64_t>()> frame_base;
+
+        // Return the canonical frame address (DW_OP_call_frame_cfa).
+        std::function<std::optional<uint64_t>()> cfa;
+
+        // Return the contents DWARF register |reg| had on entry to the
+        // current function (DW_OP_entry_value).
+        std::function<std::optional<uint64_t>(uint64_t reg)> entry_value;
+
+        // Return the address of the thread local storage at |offset| into
+        // the TLS block of the module (DW_OP_form_tls_address).
+        std::function<std::optional<uint64_t>(uint64_t offset)> tls_address;
+
+        // Return entry |index| of the .debug_addr table of the compile unit
+        // (DW_OP_addrx and DW_OP_constx).
+        std::function<std::optional<uint64_t>(uint64_t index)> debug_addr;
+
+        // The object being evaluated (DW_OP_push_object_address).
+        std::optional<uint64_t> object_address;
+
+        // Added to the link-time addresses of DW_OP_addr and DW_OP_addrx.
+        uint64_t load_bias = 0;
+    };
+
+    DwarfExpression() = default;
+
+    // Decode |bytes|. |offset_size| is the size of section offsets, 8 in
+    // the 64-bit DWARF format, and |address_size| the size of the target
+    // addresses of DW_OP_addr.
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if |bytes| is truncated, has an
+    // unknown operation, or branches outside of the expression.
+    static std::optional<DwarfExpression>
+    compile(std::span<const char> bytes, unsigned offset_size = 4,
+            unsigned address_size = 8);
+
+    // Evaluate the expression with |context|, pushing |initial| first if it
+    // is set (the CFA, for CFI rules). The bytes of implicit locations point
+    // into this expression.
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if an operation fails, e.g. the
+    // stack underflows or memory can't be read.
+    std::optional<DwarfLocation>
+    evaluate(const Context& context,
+             std::optional<uint64_t> initial = std::nullopt) const;
+
+    // Is the expression empty? An empty location means the object has been
+    // optimized out.
+    bool empty() const { return m_code.empty(); }
+
+    // Return the register the expression is just DW_OP_reg* of, if it is.
+    std::optional<uint64_t> register_number() const;
+
+private:
+    // Section 7.7.1
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    // Constants, DW_OP_reg* and DW_OP_breg* are decoded to DW_OP_constu,
+    // DW_OP_regx and DW_OP_bregx, and the GNU extensions to the operations
+    // DWARF 5 standardized.
+    enum class Opcode : uint8_t {
+        DW_OP_addr = 0x03,
+        DW_OP_constu = 0x10,
+        DW_OP_dup = 0x12,
+        DW_OP_drop = 0x13,
+        DW_OP_pick = 0x15,
+        DW_OP_swap = 0x16,
+        DW_OP_rot = 0x17,
+        DW_OP_xderef = 0x18,
+        DW_OP_abs = 0x19,
+        DW_OP_and = 0x1a,
+        DW_OP_div = 0x1b,
+        DW_OP_minus = 0x1c,
+        DW_OP_mod = 0x1d,
+        DW_OP_mul = 0x1e,
+        DW_OP_neg = 0x1f,
+        DW_OP_not = 0x20,
+        DW_OP_or = 0x21,
+        DW_OP_plus = 0x22,
+        DW_OP_plus_uconst = 0x23,
+        DW_OP_shl = 0x24,
+        DW_OP_shr = 0x25,
+        DW_OP_shra = 0x26,
+        DW_OP_xor = 0x27,
+        DW_OP_bra = 0x28,
+        DW_OP_eq = 0x29,
+        DW_OP_ge = 0x2a,
+        DW_OP_gt = 0x2b,
+        DW_OP_le = 0x2c,
+        DW_OP_lt = 0x2d,
+        DW_OP_ne = 0x2e,
+        DW_OP_skip = 0x2f,
+        DW_OP_regx = 0x90,
+        DW_OP_fbreg = 0x91,
+        DW_OP_bregx = 0x92,
+        DW_OP_piece = 0x93,
+        DW_OP_deref_size = 0x94,
+        DW_OP_xderef_size = 0x95,
+        DW_OP_nop = 0x96,
+        DW_OP_push_object_address = 0x97,
+        DW_OP_call2 = 0x98,
+        DW_OP_call4 = 0x99,
+        DW_OP_call_ref = 0x9a,
+        DW_OP_form_tls_address = 0x9b,
+        DW_OP_call_frame_cfa = 0x9c,
+        DW_OP_bit_piece = 0x9d,
+        DW_OP_implicit_value = 0x9e,
+        DW_OP_stack_value = 0x9f,
+        DW_OP_implicit_pointer = 0xa0,
+        DW_OP_addrx = 0xa1,
+        DW_OP_constx = 0xa2,
+        DW_OP_entry_value = 0xa3,
+        DW_OP_regval_type = 0xa5,
+        DW_OP_GNU_parameter_ref = 0xfa,
+    };
+
+    // |operand| and |operand2| are the operands of the operation, except:
+    // branch targets are instruction indexes, the bytes of
+    // DW_OP_implicit_value are |operand2| bytes at |operand| into |m_data|,
+    // and DW_OP_entry_value's expression is |m_entry_values[operand]|.
+    struct Instruction {
+        Opcode opcode;
+        uint64_t operand = 0;
+        uint64_t operand2 = 0;
+    };
+
+    std::vector<Instruction> m_code;
+    std::vector<char> m_data;
+    std::vector<DwarfExpression> m_entry_values;
+};
+
+} // namespace smldbg::dwarf
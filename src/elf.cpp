@@ -1,16 +1,88 @@
 #include "elf.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace smldbg::elf {
 
 ELF::ELF(std::unique_ptr<std::istream> is) : m_is(std::move(is)) {
     read_file_header();
-    read_program_header();
+    read_program_headers();
     read_section_headers();
 }
 
+ELF::ELF(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Unable to open " << path << ".\n";
+        std::exit(1);
+    }
+
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        std::cerr << "Unable to stat " << path << ".\n";
+        std::exit(1);
+    }
+
+    // The mapping outlives the file descriptor.
+    void* mapping =
+        mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Unable to map " << path << ".\n";
+        std::exit(1);
+    }
+    m_mapping = static_cast<char*>(mapping);
+    m_mapping_size = file_stat.st_size;
+
+    read_file_header();
+    read_program_headers();
+    read_section_headers();
+}
+
+ELF::ELF(ELF&& other) noexcept { *this = std::move(other); }
+
+ELF& ELF::operator=(ELF&& other) noexcept {
+    if (this == &other)
+        return *this;
+
+    unmap();
+    m_is = std::move(other.m_is);
+    m_mapping = std::exchange(other.m_mapping, nullptr);
+    m_mapping_size = std::exchange(other.m_mapping_size, 0);
+    m_file_header = other.m_file_header;
+    m_program_headers = std::move(other.m_program_headers);
+    m_section_headers = std::move(other.m_section_headers);
+    m_string_table = std::move(other.m_string_table);
+    m_section_header_names = std::move(other.m_section_header_names);
+    m_section_data_cache = std::move(other.m_section_data_cache);
+    return *this;
+}
+
+ELF::~ELF() { unmap(); }
+
 ELFSection ELF::get_section_data(std::string section_name) {
+    // Mapped files can hand out a view of the section directly.
+    if (m_mapping) {
+        const auto index = find_section(section_name);
+        if (!index)
+            return {.data = nullptr, .size = 0};
+        const auto& header = m_section_headers[*index];
+        if (header.SH_OFFSET + header.SH_SIZE > m_mapping_size) {
+            std::cerr << "Section " << section_name
+                      << " extends past the end of the file.\n";
+            return {.data = nullptr, .size = 0};
+        }
+        return {.data = m_mapping + header.SH_OFFSET, .size = header.SH_SIZE};
+    }
+
     // Check if the data for this section is already in our cache.
     if (m_section_data_cache.count(section_name)) {
         auto& bytes = m_section_data_cache.at(section_name);
@@ -23,22 +95,60 @@ ELFSection ELF::get_section_data(std::string section_name) {
     return {.data = section_data.data(), .size = section_data.size()};
 }
 
+std::optional<uint64_t> ELF::section_address(std::string_view section_name) {
+    const auto index = find_section(section_name);
+    if (!index)
+        return std::nullopt;
+    return m_section_headers[*index].SH_ADDR;
+}
+
+std::optional<std::string> ELF::build_id() {
+    // An ELF note: the sizes of the name and descriptor, the note type, then
+    // the name and the descriptor, each padded to four bytes.
+    // https://refspecs.linuxfoundation.org/elf/gabi4+/ch5.pheader.html#note_section
+    constexpr uint32_t NT_GNU_BUILD_ID = 3;
+    const ELFSection note = get_section_data(".note.gnu.build-id");
+    uint32_t sizes[3] = {};
+    if (note.size < sizeof(sizes))
+        return std::nullopt;
+    std::memcpy(sizes, note.data, sizeof(sizes));
+    const auto [name_size, descriptor_size, type] = sizes;
+    const uint64_t descriptor =
+        sizeof(sizes) + (uint64_t(name_size) + 3) / 4 * 4;
+    if (type != NT_GNU_BUILD_ID || descriptor_size == 0 ||
+        descriptor + descriptor_size > note.size)
+        return std::nullopt;
+
+    constexpr char digits[] = "0123456789abcdef";
+    std::string id;
+    for (uint32_t i = 0; i < descriptor_size; ++i) {
+        const auto byte = static_cast<uint8_t>(note.data[descriptor + i]);
+        id += digits[byte >> 4];
+        id += digits[byte & 0xf];
+    }
+    return id;
+}
+
 void ELF::read_file_header() {
-    m_is->read(reinterpret_cast<char*>(&m_file_header), sizeof(ELFFileHeader));
+    read(0, reinterpret_cast<char*>(&m_file_header), sizeof(ELFFileHeader));
 }
 
-void ELF::read_program_header() {
-    m_is->read(reinterpret_cast<char*>(&m_program_header),
-               sizeof(ELFProgramHeader));
+void ELF::read_program_headers() {
+    m_program_headers.resize(m_file_header.E_PHNUM);
+    for (unsigned i = 0, e = m_file_header.E_PHNUM; i < e; ++i) {
+        read(m_file_header.E_PHOFF + i * sizeof(ELFProgramHeader),
+             reinterpret_cast<char*>(&m_program_headers[i]),
+             sizeof(ELFProgramHeader));
+    }
 }
 
 void ELF::read_section_headers() {
-    // Seek to the start of the section headers.
-    m_is->seekg(m_file_header.E_SHOFF, std::ios::beg);
+    // Read each of the section headers.
     m_section_headers.resize(m_file_header.E_SHNUM);
     for (unsigned i = 0, e = m_file_header.E_SHNUM; i < e; ++i) {
-        m_is->read(reinterpret_cast<char*>(&m_section_headers[i]),
-                   sizeof(ELFSectionHeader));
+        read(m_file_header.E_SHOFF + i * sizeof(ELFSectionHeader),
+             reinterpret_cast<char*>(&m_section_headers[i]),
+             sizeof(ELFSectionHeader));
     }
 
     // String table offset and size.
@@ -48,8 +158,7 @@ void ELF::read_section_headers() {
 
     // Read the .shstrtab section bytes.
     m_string_table.resize(shstrtab_size);
-    m_is->seekg(shstrtab_offset, std::ios::beg);
-    m_is->read(reinterpret_cast<char*>(m_string_table.data()), shstrtab_size);
+    read(shstrtab_offset, m_string_table.data(), shstrtab_size);
 
     m_section_header_names.resize(m_file_header.E_SHNUM);
     for (unsigned i = 0, e = m_file_header.E_SHNUM; i < e; ++i) {
@@ -67,26 +176,45 @@ void ELF::read_section_headers() {
 
 bool ELF::read_section_data(std::string_view section_name,
                             std::vector<char>& section_bytes) {
-    // Try and find the named section.
-    const auto found = std::find(m_section_header_names.begin(),
-                                 m_section_header_names.end(), section_name);
-
     // No section header with this name.
-    if (found == m_section_header_names.end())
+    const auto index = find_section(section_name);
+    if (!index)
         return false;
 
-    // Get the header for the section.
-    const auto& header = [&]() {
-        const auto index = std::distance(m_section_header_names.begin(), found);
-        return m_section_headers[index];
-    }();
-
     // Read the section bytes.
+    const auto& header = m_section_headers[*index];
     section_bytes.resize(header.SH_SIZE);
-    m_is->seekg(header.SH_OFFSET, std::ios::beg);
-    m_is->read(reinterpret_cast<char*>(section_bytes.data()), header.SH_SIZE);
+    read(header.SH_OFFSET, section_bytes.data(), header.SH_SIZE);
 
     return true;
 }
 
+std::optional<unsigned> ELF::find_section(std::string_view section_name) {
+    const auto found = std::find(m_section_header_names.begin(),
+                                 m_section_header_names.end(), section_name);
+    if (found == m_section_header_names.end())
+        return std::nullopt;
+    return std::distance(m_section_header_names.begin(), found);
+}
+
+void ELF::read(uint64_t offset, char* bytes, uint64_t size) {
+    if (m_mapping) {
+        if (offset + size > m_mapping_size) {
+            std::cerr << "Read past the end of the ELF file.\n";
+            std::exit(1);
+        }
+        std::memcpy(bytes, m_mapping + offset, size);
+        return;
+    }
+    m_is->seekg(offset, std::ios::beg);
+    m_is->read(bytes, size);
+}
+
+void ELF::unmap() {
+    if (m_mapping)
+        munmap(m_mapping, m_mapping_size);
+    m_mapping = nullptr;
+    m_mapping_size = 0;
+}
+
 } // namespace smldbg::elf
@@ -3,7 +3,9 @@
 #include <cstdint>
 #include <istream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -33,6 +35,15 @@ struct ELFFileHeader {
     uint16_t E_SHSTRNDX;
 };
 
+// Object file types (E_TYPE).
+constexpr uint16_t ET_EXEC = 2; // Executable loaded at a fixed address.
+constexpr uint16_t ET_DYN = 3;  // Shared object or position independent
+                                // executable.
+
+// Segment types (P_TYPE).
+constexpr uint32_t PT_LOAD = 1;
+constexpr uint32_t PT_TLS = 7;
+
 // 64 bit ELF program header.
 #pragma(pack(1))
 struct ELFProgramHeader {
@@ -61,6 +72,8 @@ struct ELFSectionHeader {
     uint64_t SH_ENTSIZE;
 };
 
+// A view of the bytes of a single section. When the parent ELF instance is
+// memory mapped, |data| points directly into the (read-only) mapping.
 struct ELFSection {
     char* data;
     uint64_t size;
@@ -70,25 +83,77 @@ class ELF {
 public:
     ELF() = default;
 
-    // Construct a new ELF instance from a stream.
+    // Construct a new ELF instance from a stream. Section data is copied out of
+    // the stream on first request and cached. Prefer the path based
+    // constructor for files on disk.
     //
     // Preconditions: |is| should represent the byte stream of an ELF format
     // file.
     ELF(std::unique_ptr<std::istream> is);
 
+    // Construct a new ELF instance by memory mapping the file at |path|.
+    // Section data is never copied, ELFSection instances point straight into
+    // the mapping.
+    //
+    // Preconditions: |path| should name an ELF format file.
+    //
+    // Postconditions: The file is mapped read-only for the lifetime of the
+    // instance.
+    ELF(const std::string& path);
+
+    ELF(const ELF&) = delete;
+    ELF& operator=(const ELF&) = delete;
+    ELF(ELF&& other) noexcept;
+    ELF& operator=(ELF&& other) noexcept;
+    ~ELF();
+
     ELFSection get_section_data(std::string section_name);
 
+    // Return the link-time address of the named section, if present.
+    std::optional<uint64_t> section_address(std::string_view section_name);
+
+    // Return the NT_GNU_BUILD_ID note of the file as a hexadecimal string, if
+    // it has one. The linker derives it from the contents of the file, so it
+    // identifies a build.
+    std::optional<std::string> build_id();
+
+    const ELFFileHeader& file_header() const { return m_file_header; }
+
+    // The program headers, which describe how the file is loaded into memory.
+    const std::vector<ELFProgramHeader>& program_headers() const {
+        return m_program_headers;
+    }
+
+    // Is the file loaded at an address chosen at run time, so that its
+    // addresses need relocating by the load bias?
+    bool is_position_independent() const {
+        return m_file_header.E_TYPE == ET_DYN;
+    }
+
 private:
     void read_file_header();
-    void read_program_header();
+    void read_program_headers();
     void read_section_headers();
     bool read_section_data(std::string_view section_name,
                            std::vector<char>& section_bytes);
 
+    // Return the index of the named section header, if present.
+    std::optional<unsigned> find_section(std::string_view section_name);
+
+    // Copy |size| bytes starting at file |offset| to |bytes|, either from the
+    // mapping or from the stream.
+    void read(uint64_t offset, char* bytes, uint64_t size);
+
+    // Release the mapping, if any.
+    void unmap();
+
     std::unique_ptr<std::istream> m_is;
 
+    char* m_mapping = nullptr; // First byte of the mapped file, if mapped.
+    uint64_t m_mapping_size = 0;
+
     ELFFileHeader m_file_header;
-    ELFProgramHeader m_program_header;
+    std::vector<ELFProgramHeader> m_program_headers;
     std::vector<ELFSectionHeader> m_section_headers;
 
     std::vector<char> m_string_table;
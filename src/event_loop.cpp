@@ -0,0 +1,200 @@
+#include "event_loop.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+
+namespace smldbg {
+
+namespace {
+
+// Add |fd| to the epoll set |epoll| for reading. Returns false, with errno
+// set, if it can't be.
+bool add_to_epoll(int epoll, int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+} // namespace
+
+EventLoop::EventLoop(int input) : m_input(input) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGINT);
+    sigprocmask(SIG_BLOCK, &signals, &m_original_mask);
+
+    m_signals = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_signals == -1 || m_epoll == -1 ||
+        !add_to_epoll(m_epoll, m_signals)) {
+        std::cerr << "Unable to create the event loop: " << std::strerror(errno)
+                  << "\n";
+        std::exit(1);
+    }
+    if (!add_to_epoll(m_epoll, m_input)) {
+        if (errno != EPERM) {
+            std::cerr << "Unable to wait for input: " << std::strerror(errno)
+                      << "\n";
+            std::exit(1);
+        }
+        m_input_always_ready = true;
+    }
+}
+
+EventLoop::~EventLoop() {
+    unwatch_process();
+    stop_timer();
+    close(m_epoll);
+    close(m_signals);
+    sigprocmask(SIG_SETMASK, &m_original_mask, nullptr);
+}
+
+void EventLoop::restore_signal_mask() const {
+    sigprocmask(SIG_SETMASK, &m_original_mask, nullptr);
+}
+
+void EventLoop::watch_process(int pid) {
+    unwatch_process();
+
+    // Not fatal, SIGCHLD is still delivered for the target's stops and exit.
+    m_pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (m_pidfd == -1 || !add_to_epoll(m_epoll, m_pidfd)) {
+        std::cerr << "Unable to watch process " << pid << ": "
+                  << std::strerror(errno) << "\n";
+        unwatch_process();
+    }
+}
+
+void EventLoop::unwatch_process() {
+    if (m_pidfd == -1)
+        return;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_pidfd, nullptr);
+    close(m_pidfd);
+    m_pidfd = -1;
+}
+
+void EventLoop::start_timer(std::chrono::nanoseconds interval) {
+    if (m_timer == -1) {
+        m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_timer == -1 || !add_to_epoll(m_epoll, m_timer)) {
+            std::cerr << "Unable to create a timer: " << std::strerror(errno)
+                      << "\n";
+            std::exit(1);
+        }
+    }
+
+    const timespec period = {
+        .tv_sec = static_cast<time_t>(interval.count() / 1000000000),
+        .tv_nsec = static_cast<long>(interval.count() % 1000000000)};
+    const itimerspec timer = {.it_interval = period, .it_value = period};
+    timerfd_settime(m_timer, 0, &timer, nullptr);
+}
+
+void EventLoop::stop_timer() {
+    if (m_timer == -1)
+        return;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_timer, nullptr);
+    close(m_timer);
+    m_timer = -1;
+}
+
+EventLoop::Events EventLoop::wait() {
+    Events events;
+    if (m_input_always_ready && !m_end_of_input) {
+        read_input();
+        events.input = true;
+        return events;
+    }
+
+    std::array<epoll_event, 4> ready;
+    int count = 0;
+    do {
+        count = epoll_wait(m_epoll, ready.data(), ready.size(), -1);
+    } while (count == -1 && errno == EINTR);
+    if (count == -1) {
+        std::cerr << "epoll_wait() failed: " << std::strerror(errno) << "\n";
+        std::exit(1);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const int fd = ready[i].data.fd;
+        if (fd == m_signals) {
+            // Signals of the same kind are merged while pending, so there is
+            // at most one of each to read.
+            std::array<signalfd_siginfo, 2> signals;
+            const ssize_t size =
+                read(m_signals, signals.data(), sizeof(signals));
+            for (ssize_t i = 0; i < size / ssize_t(sizeof(signalfd_siginfo));
+                 ++i) {
+                if (signals[i].ssi_signo == SIGINT)
+                    events.interrupt = true;
+                else
+                    events.target = true;
+            }
+        } else if (fd == m_pidfd) {
+            events.target = true;
+        } else if (fd == m_timer) {
+            uint64_t expirations = 0;
+            if (read(m_timer, &expirations, sizeof(expirations)) ==
+                sizeof(expirations))
+                events.timer = expirations;
+        } else if (fd == m_input) {
+            read_input();
+            events.input = true;
+        }
+    }
+    return events;
+}
+
+std::optional<std::string> EventLoop::next_line() {
+    if (m_lines.empty())
+        return std::nullopt;
+    std::string line = std::move(m_lines.front());
+    m_lines.pop_front();
+    return line;
+}
+
+std::size_t EventLoop::erase_lines(
+    const std::function<bool(const std::string&)>& predicate) {
+    return std::erase_if(m_lines, predicate);
+}
+
+void EventLoop::read_input() {
+    std::array<char, 4096> buffer;
+    const ssize_t size = read(m_input, buffer.data(), buffer.size());
+    if (size == -1 && (errno == EINTR || errno == EAGAIN))
+        return;
+    if (size <= 0) {
+        // Closed, or unreadable, which is as good as closed. A last line
+        // without a newline is still a line.
+        m_end_of_input = true;
+        if (!m_input_always_ready)
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, m_input, nullptr);
+        if (!m_partial.empty())
+            m_lines.push_back(std::exchange(m_partial, {}));
+        return;
+    }
+
+    m_partial.append(buffer.data(), size);
+    std::size_t begin = 0;
+    for (std::size_t end = m_partial.find('\n'); end != std::string::npos;
+         end = m_partial.find('\n', begin)) {
+        m_lines.push_back(m_partial.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    m_partial.erase(0, begin);
+}
+
+} // namespace smldbg
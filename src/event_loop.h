@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace smldbg {
+
+// Waits on everything the debugger reacts to with a single epoll(7) set: the
+// target changing state, the user pressing Ctrl-C, input on a command source
+// and a periodic timer. SIGCHLD and SIGINT are blocked and read from a
+// signalfd(2) instead, so neither is lost between checking for them and
+// waiting, and the target's exit is watched with a pidfd as well. Input is
+// read as it arrives and split into lines, so that commands can be taken
+// while the target runs.
+class EventLoop {
+public:
+    // What woke up a call to wait().
+    struct Events {
+        bool target = false;    // A child changed state, or the target exited.
+        bool interrupt = false; // The user pressed Ctrl-C.
+        bool input = false;     // More input was read.
+        uint64_t timer = 0;     // Times the timer expired since the last wait.
+    };
+
+    // Read commands from |input|, which defaults to standard input.
+    //
+    // Preconditions: No other threads are running, as they would otherwise
+    // still take the signals that are now read from the signalfd.
+    explicit EventLoop(int input = STDIN_FILENO);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Restore the signal mask the process had before, in a forked child
+    // about to execute the target.
+    void restore_signal_mask() const;
+
+    // Watch the process |pid| for exiting, in place of any process watched
+    // before.
+    void watch_process(int pid);
+
+    // Stop watching the process passed to watch_process(...), if any.
+    void unwatch_process();
+
+    // Have wait() report the timer every |interval|, replacing any interval
+    // set before.
+    void start_timer(std::chrono::nanoseconds interval);
+
+    // Stop the timer started with start_timer(...), if any.
+    void stop_timer();
+
+    // Block until there is at least one event, and return all of them. Any
+    // input is read into complete lines and the partial line after them.
+    Events wait();
+
+    // Remove and return the first complete line of input, without its
+    // newline, or std::nullopt if there isn't one yet.
+    std::optional<std::string> next_line();
+
+    // Remove the complete lines of input for which |predicate| holds, e.g.
+    // commands that can't wait for the target to stop. Returns how many were
+    // removed.
+    std::size_t
+    erase_lines(const std::function<bool(const std::string&)>& predicate);
+
+    // Whether the input has been closed. Complete lines may still be left.
+    bool end_of_input() const { return m_end_of_input; }
+
+private:
+    // Read whatever input is available and split off the complete lines.
+    void read_input();
+
+    int m_input;        // File descriptor commands are read from.
+    int m_epoll = -1;   // Waits on all the file descriptors below.
+    int m_signals = -1; // Reads SIGCHLD and SIGINT.
+    int m_pidfd = -1;   // The process passed to watch_process(...).
+    int m_timer = -1;   // The timer started with start_timer(...).
+    sigset_t m_original_mask;
+
+    // Regular files and the like can't be waited on with epoll, but are
+    // always ready to read anyway.
+    bool m_input_always_ready = false;
+    bool m_end_of_input = false;
+    std::deque<std::string> m_lines; // Complete lines not yet taken.
+    std::string m_partial;           // Input after the last complete line.
+};
+
+} // namespace smldbg
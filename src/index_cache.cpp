@@ -0,0 +1,385 @@
+#include "index_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smldbg::dwarf {
+
+namespace {
+
+// Bump when the layout of the file, or of any record in it, changes.
+constexpr uint32_t index_cache_version = 1;
+constexpr char index_cache_magic[8] = {'S', 'M', 'L', 'D', 'B', 'G', 'I', 'X'};
+
+// Records are aligned to eight bytes from the start of the file, which is
+// page aligned once mapped, so they can be read in place.
+constexpr uint64_t record_alignment = 8;
+
+// A run of |count| records starting |offset| bytes into the file.
+struct Array {
+    uint64_t offset;
+    uint64_t count;
+};
+
+// A string starting |offset| bytes into the strings of the file.
+struct String {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// An entry of the name index.
+struct NameRecord {
+    String name;
+    uint64_t offset; // NameIndex::Entry::offset.
+    uint64_t is_compile_unit;
+};
+
+// A line table and the offset of its line number program.
+struct LineTableRecord {
+    uint64_t offset;        // Offset into the .debug_line section.
+    Array rows;             // LineTable::Row records.
+    Array file_names;       // String records.
+    Array file_directories; // String records.
+};
+
+// Lays out the records of a cache file in memory, ready to be written.
+class Writer {
+public:
+    Writer(std::size_t header_size) : m_bytes(header_size, '\0') {}
+
+    // Append |records|, aligned, returning where they were put.
+    template <typename T> Array append(std::span<const T> records) {
+        m_bytes.resize((m_bytes.size() + record_alignment - 1) /
+                       record_alignment * record_alignment);
+        const Array array = {.offset = m_bytes.size(),
+                             .count = records.size()};
+        m_bytes.append(reinterpret_cast<const char*>(records.data()),
+                       records.size_bytes());
+        return array;
+    }
+
+    // Add |string| to the strings of the file, each distinct string once.
+    String add(std::string_view string) {
+        const auto [added, inserted] = m_string_offsets.try_emplace(
+            std::string(string), m_strings.size());
+        if (inserted)
+            m_strings += string;
+        return {.offset = added->second, .size = string.size()};
+    }
+
+    // Append the strings, then return the bytes of the file.
+    std::string& finish(Array& strings) {
+        strings = append(std::span<const char>(m_strings));
+        return m_bytes;
+    }
+
+private:
+    std::string m_bytes;
+    std::string m_strings;
+    std::unordered_map<std::string, uint64_t> m_string_offsets;
+};
+
+} // namespace
+
+struct IndexCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t has_names;  // Whether |names| holds the name index.
+    uint32_t row_size;   // sizeof(LineTable::Row) and
+    uint32_t entry_size; // sizeof(AddressRangeIndex::Entry), whose layout
+                         // is up to the compiler.
+    uint64_t size;       // Size of the file.
+    String id;           // Id of the build the indexes are of.
+    Array compile_units; // AddressRangeIndex::Entry records.
+    Array functions;     // AddressRangeIndex::Entry records.
+    Array names;         // NameRecord records.
+    Array line_tables;   // LineTableRecord records, sorted by offset.
+    Array strings;       // Characters.
+};
+
+std::optional<IndexCache> IndexCache::open(const std::filesystem::path& path,
+                                           std::string_view id) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return std::nullopt;
+
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<uint64_t>(file_stat.st_size) < sizeof(Header)) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    // The mapping outlives the file descriptor.
+    void* mapping =
+        mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return std::nullopt;
+
+    IndexCache cache;
+    cache.m_mapping = static_cast<char*>(mapping);
+    cache.m_mapping_size = file_stat.st_size;
+    if (!cache.validate(id))
+        return std::nullopt;
+    return cache;
+}
+
+bool IndexCache::write(
+    const std::filesystem::path& path, std::string_view id,
+    const AddressRangeIndex& compile_unit_index,
+    const AddressRangeIndex& function_index, const NameIndex* name_index,
+    const std::unordered_map<uint64_t, LineTable>& line_tables) {
+    Header header = {.version = index_cache_version,
+                     .has_names = name_index != nullptr,
+                     .row_size = sizeof(LineTable::Row),
+                     .entry_size = sizeof(AddressRangeIndex::Entry)};
+    std::memcpy(header.magic, index_cache_magic, sizeof(header.magic));
+
+    using Entries = std::span<const AddressRangeIndex::Entry>;
+    Writer writer(sizeof(Header));
+    header.id = writer.add(id);
+    header.compile_units =
+        writer.append(Entries(compile_unit_index.entries()));
+    header.functions = writer.append(Entries(function_index.entries()));
+
+    if (name_index) {
+        std::vector<NameRecord> names;
+        for (const auto& [name, entries] : name_index->entries()) {
+            const String string = writer.add(name);
+            for (const NameIndex::Entry& entry : entries)
+                names.push_back({.name = string,
+                                 .offset = entry.offset,
+                                 .is_compile_unit = entry.is_compile_unit});
+        }
+        header.names = writer.append(std::span<const NameRecord>(names));
+    }
+
+    // Write the tables in .debug_line order, so they can be binary searched.
+    std::vector<uint64_t> offsets;
+    offsets.reserve(line_tables.size());
+    for (const auto& [offset, table] : line_tables)
+        offsets.push_back(offset);
+    std::sort(offsets.begin(), offsets.end());
+    const auto add_strings = [&](const std::vector<std::string_view>& strings) {
+        std::vector<String> added;
+        added.reserve(strings.size());
+        for (const std::string_view string : strings)
+            added.push_back(writer.add(string));
+        return writer.append(std::span<const String>(added));
+    };
+    std::vector<LineTableRecord> tables;
+    tables.reserve(offsets.size());
+    for (const uint64_t offset : offsets) {
+        const LineTable& table = line_tables.at(offset);
+        tables.push_back(
+            {.offset = offset,
+             .rows =
+                 writer.append(std::span<const LineTable::Row>(table.rows())),
+             .file_names = add_strings(table.file_names()),
+             .file_directories = add_strings(table.file_directories())});
+    }
+    header.line_tables =
+        writer.append(std::span<const LineTableRecord>(tables));
+
+    std::string& bytes = writer.finish(header.strings);
+    header.size = bytes.size();
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream os(temporary, std::ios::binary | std::ios::trunc);
+        os.write(bytes.data(), bytes.size());
+        if (!os.flush()) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+std::filesystem::path IndexCache::default_directory() {
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        return std::filesystem::path(cache) / "smldbg";
+    if (const char* home = std::getenv("HOME"); home && *home)
+        return std::filesystem::path(home) / ".cache" / "smldbg";
+    return {};
+}
+
+IndexCache::IndexCache(IndexCache&& other) noexcept {
+    *this = std::move(other);
+}
+
+IndexCache& IndexCache::operator=(IndexCache&& other) noexcept {
+    if (this == &other)
+        return *this;
+
+    unmap();
+    m_mapping = std::exchange(other.m_mapping, nullptr);
+    m_mapping_size = std::exchange(other.m_mapping_size, 0);
+    return *this;
+}
+
+IndexCache::~IndexCache() { unmap(); }
+
+AddressRangeIndex IndexCache::compile_unit_index() const {
+    AddressRangeIndex index;
+    const Array array = header().compile_units;
+    const auto entries =
+        records<AddressRangeIndex::Entry>(array.offset, array.count);
+    index.reserve(entries.size());
+    for (const AddressRangeIndex::Entry& entry : entries)
+        index.insert(entry.low, entry.high, entry.value);
+    index.finalize();
+    return index;
+}
+
+AddressRangeIndex IndexCache::function_index() const {
+    AddressRangeIndex index;
+    const Array array = header().functions;
+    const auto entries =
+        records<AddressRangeIndex::Entry>(array.offset, array.count);
+    index.reserve(entries.size());
+    for (const AddressRangeIndex::Entry& entry : entries)
+        index.insert(entry.low, entry.high, entry.value);
+    index.finalize();
+    return index;
+}
+
+std::optional<NameIndex> IndexCache::name_index() const {
+    if (!header().has_names)
+        return std::nullopt;
+
+    NameIndex index(NameIndex::Source::dwarf);
+    const Array array = header().names;
+    const auto names = records<NameRecord>(array.offset, array.count);
+    index.reserve(names.size());
+    for (const NameRecord& name : names)
+        index.insert(string(name.name.offset, name.name.size),
+                     {.offset = name.offset,
+                      .is_compile_unit = name.is_compile_unit != 0});
+    return index;
+}
+
+std::optional<LineTable> IndexCache::line_table(uint64_t offset) const {
+    const Array array = header().line_tables;
+    const auto tables = records<LineTableRecord>(array.offset, array.count);
+    const auto table = std::lower_bound(
+        tables.begin(), tables.end(), offset,
+        [](const LineTableRecord& table, uint64_t offset) {
+            return table.offset < offset;
+        });
+    if (table == tables.end() || table->offset != offset)
+        return std::nullopt;
+
+    const auto rows =
+        records<LineTable::Row>(table->rows.offset, table->rows.count);
+    const auto strings = [&](const Array& array) {
+        std::vector<std::string_view> strings;
+        strings.reserve(array.count);
+        for (const String& s : records<String>(array.offset, array.count))
+            strings.push_back(string(s.offset, s.size));
+        return strings;
+    };
+    return LineTable(std::vector<LineTable::Row>(rows.begin(), rows.end()),
+                     strings(table->file_names),
+                     strings(table->file_directories));
+}
+
+std::size_t IndexCache::line_tables() const {
+    return m_mapping ? header().line_tables.count : 0;
+}
+
+const IndexCache::Header& IndexCache::header() const {
+    return *reinterpret_cast<const Header*>(m_mapping);
+}
+
+template <typename T>
+std::span<const T> IndexCache::records(uint64_t offset, uint64_t count) const {
+    return {reinterpret_cast<const T*>(m_mapping + offset), count};
+}
+
+std::string_view IndexCache::string(uint64_t offset, uint64_t size) const {
+    return {m_mapping + header().strings.offset + offset, size};
+}
+
+bool IndexCache::validate(std::string_view id) const {
+    const Header& cached = header();
+    if (std::memcmp(cached.magic, index_cache_magic, sizeof(cached.magic)) !=
+            0 ||
+        cached.version != index_cache_version ||
+        cached.row_size != sizeof(LineTable::Row) ||
+        cached.entry_size != sizeof(AddressRangeIndex::Entry) ||
+        cached.size != m_mapping_size)
+        return false;
+
+    // Is |array|, of records |size| bytes long, within the file?
+    const auto fits = [&](const Array& array, uint64_t size) {
+        return array.offset % record_alignment == 0 &&
+               array.offset <= m_mapping_size &&
+               array.count <= (m_mapping_size - array.offset) / size;
+    };
+    const auto fits_strings = [&](const String& string) {
+        return string.offset <= cached.strings.count &&
+               string.size <= cached.strings.count - string.offset;
+    };
+    if (!fits(cached.strings, 1) || !fits_strings(cached.id) ||
+        this->string(cached.id.offset, cached.id.size) != id ||
+        !fits(cached.compile_units, sizeof(AddressRangeIndex::Entry)) ||
+        !fits(cached.functions, sizeof(AddressRangeIndex::Entry)) ||
+        !fits(cached.names, sizeof(NameRecord)) ||
+        !fits(cached.line_tables, sizeof(LineTableRecord)))
+        return false;
+
+    for (const NameRecord& name :
+         records<NameRecord>(cached.names.offset, cached.names.count))
+        if (!fits_strings(name.name))
+            return false;
+
+    const auto fits_string_array = [&](const Array& array) {
+        if (!fits(array, sizeof(String)))
+            return false;
+        const auto strings = records<String>(array.offset, array.count);
+        return std::all_of(strings.begin(), strings.end(), fits_strings);
+    };
+    const auto tables = records<LineTableRecord>(cached.line_tables.offset,
+                                                 cached.line_tables.count);
+    for (std::size_t i = 0; i < tables.size(); ++i) {
+        const LineTableRecord& table = tables[i];
+        if ((i > 0 && tables[i - 1].offset >= table.offset) ||
+            !fits(table.rows, sizeof(LineTable::Row)) ||
+            !fits_string_array(table.file_names) ||
+            !fits_string_array(table.file_directories) ||
+            table.file_directories.count > table.file_names.count)
+            return false;
+    }
+    return true;
+}
+
+void IndexCache::unmap() {
+    if (m_mapping)
+        munmap(m_mapping, m_mapping_size);
+    m_mapping = nullptr;
+    m_mapping_size = 0;
+}
+
+} // namespace smldbg::dwarf
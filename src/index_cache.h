@@ -0,0 +1,109 @@
+#pragma once
+
+#include "address_range_index.h"
+#include "line_table.h"
+#include "name_index.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace smldbg::dwarf {
+
+// The function, compile unit, name and line indexes of a Dwarf instance,
+// serialized to a file so that debugging the same build again doesn't have to
+// walk its DWARF. Caches are keyed by an id of the build they were made from,
+// see Dwarf::index_cache_id(), and are only valid for the version of the
+// format they were written with.
+//
+// The file is laid out so it can be used in place once mapped: a header, then
+// arrays of fixed size records, then the strings they refer to. Opening a
+// cache maps the file and checks the header and the bounds of every array and
+// string. Names and file names are views into the mapping, and line tables
+// are only read from it the first time they are requested.
+class IndexCache {
+public:
+    IndexCache() = default;
+
+    // Map the index cache at |path|.
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if there is no file at |path|, or
+    // if it isn't a valid cache for |id| written in the current format.
+    static std::optional<IndexCache> open(const std::filesystem::path& path,
+                                          std::string_view id);
+
+    // Write the indexes of the build identified by |id| to |path|, creating
+    // its directory if needed. |name_index| may be null, e.g. when the names
+    // come from an accelerator table, which is cheaper to read again than
+    // the cache. The file is written under a temporary name and then renamed,
+    // so a cache is never seen half written.
+    //
+    // Preconditions: |compile_unit_index| and |function_index| should be
+    // finalized.
+    //
+    // Postconditions: Returns false if the file couldn't be written.
+    static bool
+    write(const std::filesystem::path& path, std::string_view id,
+          const AddressRangeIndex& compile_unit_index,
+          const AddressRangeIndex& function_index, const NameIndex* name_index,
+          const std::unordered_map<uint64_t, LineTable>& line_tables);
+
+    // Return the directory caches are kept in by default:
+    // $XDG_CACHE_HOME/smldbg, or ~/.cache/smldbg. Empty if neither
+    // $XDG_CACHE_HOME nor $HOME is set.
+    static std::filesystem::path default_directory();
+
+    IndexCache(const IndexCache&) = delete;
+    IndexCache& operator=(const IndexCache&) = delete;
+    IndexCache(IndexCache&& other) noexcept;
+    IndexCache& operator=(IndexCache&& other) noexcept;
+    ~IndexCache();
+
+    // Return the finalized index of compile unit address ranges.
+    AddressRangeIndex compile_unit_index() const;
+
+    // Return the finalized index of function address ranges.
+    AddressRangeIndex function_index() const;
+
+    // Return the name index, or std::nullopt if it wasn't cached. Its names
+    // are views into the mapping.
+    std::optional<NameIndex> name_index() const;
+
+    // Return the line table starting at |offset| bytes into the .debug_line
+    // section, if it was cached. Its file names are views into the mapping.
+    std::optional<LineTable> line_table(uint64_t offset) const;
+
+    // Return the number of line tables in the cache.
+    std::size_t line_tables() const;
+
+private:
+    struct Header;
+
+    // Return the header of the mapped file.
+    const Header& header() const;
+
+    // Return the |count| records of type T at |offset| bytes into the file.
+    template <typename T>
+    std::span<const T> records(uint64_t offset, uint64_t count) const;
+
+    // Return the string |size| bytes long at |offset| bytes into the strings
+    // of the file.
+    std::string_view string(uint64_t offset, uint64_t size) const;
+
+    // Check that every array and string of the mapped file lies within it.
+    bool validate(std::string_view id) const;
+
+    // Release the mapping, if any.
+    void unmap();
+
+    char* m_mapping = nullptr; // First byte of the mapped file, if mapped.
+    uint64_t m_mapping_size = 0;
+};
+
+} // namespace smldbg::dwarf
@@ -0,0 +1,109 @@
+#include "line_index.h"
+
+#include <algorithm>
+
+namespace smldbg {
+
+namespace {
+
+// Return the path of |name| relative to the compilation directory.
+std::string path(std::string_view directory, std::string_view name) {
+    if (directory.empty() || name.starts_with('/'))
+        return std::string(name);
+    std::string path(directory);
+    path += '/';
+    path += name;
+    return path;
+}
+
+// Return the last component of |path|.
+std::string_view base_name(std::string_view path) {
+    const auto slash = path.rfind('/');
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+void LineIndex::insert(const LineTable& table) {
+    // Map the file indexes of |table| to file ids on first use.
+    std::vector<uint32_t> file_ids(table.file_names().size(), UINT32_MAX);
+
+    const auto& rows = table.rows();
+    for (std::size_t i = 0, e = rows.size(); i < e; ++i) {
+        const LineTable::Row& row = rows[i];
+        if (!row.is_stmt || row.end_sequence || row.file >= file_ids.size())
+            continue;
+
+        // Only the first row of a run of rows for the same line starts the
+        // line, the following ones are in the middle of it.
+        if (i > 0 && !rows[i - 1].end_sequence &&
+            rows[i - 1].line == row.line && rows[i - 1].file == row.file)
+            continue;
+
+        uint32_t& file = file_ids[row.file];
+        if (file == UINT32_MAX)
+            file = file_id(table.directory(row), table.file(row));
+
+        // If we can, skip function prologues.
+        const bool skip_prologue =
+            i + 1 < e && rows[i + 1].prologue_end && !rows[i + 1].end_sequence;
+        std::vector<uint64_t>& addresses = m_addresses[key(file, row.line)];
+        if (addresses.empty())
+            m_files[file].lines.push_back(row.line);
+        addresses.push_back(skip_prologue ? rows[i + 1].address : row.address);
+    }
+}
+
+void LineIndex::finalize() {
+    for (auto& [key, addresses] : m_addresses) {
+        std::sort(addresses.begin(), addresses.end());
+        addresses.erase(std::unique(addresses.begin(), addresses.end()),
+                        addresses.end());
+    }
+    for (File& file : m_files)
+        std::sort(file.lines.begin(), file.lines.end());
+}
+
+std::vector<LineIndex::Match> LineIndex::find(std::string_view file,
+                                              uint32_t line) const {
+    std::vector<Match> matches;
+    const auto candidates = m_files_by_name.find(base_name(file));
+    if (candidates == m_files_by_name.end())
+        return matches;
+
+    for (const uint32_t id : candidates->second) {
+        const File& candidate = m_files[id];
+        const std::string candidate_path =
+            path(candidate.directory, candidate.name);
+        if (candidate_path != file &&
+            !(candidate_path.ends_with(file) &&
+              candidate_path[candidate_path.size() - file.size() - 1] == '/'))
+            continue;
+
+        // Use the first line with statements at or after |line|.
+        const auto next = std::lower_bound(candidate.lines.begin(),
+                                           candidate.lines.end(), line);
+        if (next == candidate.lines.end())
+            continue;
+        const std::vector<uint64_t>& addresses =
+            m_addresses.at(key(id, *next));
+        matches.push_back({.directory = candidate.directory,
+                           .file = candidate.name,
+                           .line = *next,
+                           .addresses = addresses});
+    }
+    return matches;
+}
+
+uint32_t LineIndex::file_id(std::string_view directory,
+                            std::string_view name) {
+    const auto [id, added] =
+        m_file_ids.try_emplace(path(directory, name), m_files.size());
+    if (added) {
+        m_files.push_back({.directory = directory, .name = name});
+        m_files_by_name[base_name(name)].push_back(id->second);
+    }
+    return id->second;
+}
+
+} // namespace smldbg
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "line_table.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace smldbg {
+
+// Maps (file, line) pairs to the addresses of the statements on that line,
+// across the line tables of every compile unit. This is the inverse of
+// LineTable, which maps addresses to lines. Header files and inlined code are
+// indexed under the file they come from, regardless of the compile unit.
+class LineIndex {
+public:
+    // The statements of a single file and line.
+    struct Match {
+        std::string_view directory; // Include directory of the file, empty
+                                    // for the compilation directory.
+        std::string_view file;
+        uint32_t line;
+        std::span<const uint64_t> addresses; // Sorted, without duplicates.
+    };
+
+    LineIndex() = default;
+
+    // Add the statements of |table|. Each run of rows for the same line
+    // contributes the address of its first row, or of the end of the prologue
+    // if the next row marks it.
+    //
+    // Preconditions: finalize() has not yet been called. The file names of
+    // |table| must outlive the index.
+    //
+    // Postconditions: None.
+    void insert(const LineTable& table);
+
+    // Sort the inserted addresses and lines. Must be called once all tables
+    // have been inserted and before any call to find(...).
+    void finalize();
+
+    // Return a match for each file whose path ends in |file|, e.g. "solver.cpp"
+    // matches both "src/solver.cpp" and "test/solver.cpp". If |line| has no
+    // statements, the next line in the file that does is used instead.
+    //
+    // Preconditions: finalize() has been called.
+    //
+    // Postconditions: Files without statements on or after |line| are not
+    // included.
+    std::vector<Match> find(std::string_view file, uint32_t line) const;
+
+private:
+    struct File {
+        std::string_view directory;
+        std::string_view name;
+        std::vector<uint32_t> lines; // Lines with statements, sorted once
+                                     // finalized.
+    };
+
+    // Return the id of the file |name| in |directory|, adding it if needed.
+    uint32_t file_id(std::string_view directory, std::string_view name);
+
+    static uint64_t key(uint32_t file, uint32_t line) {
+        return static_cast<uint64_t>(file) << 32 | line;
+    }
+
+    std::vector<File> m_files; // Indexed by file id.
+
+    std::unordered_map<std::string, uint32_t>
+        m_file_ids; // File ids keyed by the path of the file.
+
+    std::unordered_map<std::string_view, std::vector<uint32_t>>
+        m_files_by_name; // File ids keyed by the last path component.
+
+    std::unordered_map<uint64_t, std::vector<uint64_t>>
+        m_addresses; // Statement addresses keyed by key(file, line).
+};
+
+} // namespace smldbg
@@ -0,0 +1,57 @@
+#include "line_table.h"
+
+#include <algorithm>
+
+namespace smldbg {
+
+LineTable::LineTable(std::vector<Row> rows,
+                     std::vector<std::string_view> file_names,
+                     std::vector<std::string_view> file_directories)
+    : m_file_names(std::move(file_names)),
+      m_file_directories(std::move(file_directories)) {
+    // Split the rows into sequences. The addresses within a sequence are
+    // non-decreasing, but the sequences themselves can appear in any order.
+    struct Sequence {
+        std::size_t begin;
+        std::size_t end;
+    };
+    std::vector<Sequence> sequences;
+    for (std::size_t i = 0, begin = 0, e = rows.size(); i < e; ++i) {
+        if (rows[i].end_sequence || i == e - 1) {
+            sequences.push_back({.begin = begin, .end = i + 1});
+            begin = i + 1;
+        }
+    }
+
+    // Order sequences by start address and concatenate them. Rows read back
+    // from the index cache are already in order.
+    const auto by_address = [&](const Sequence& lhs, const Sequence& rhs) {
+        return rows[lhs.begin].address < rows[rhs.begin].address;
+    };
+    if (std::is_sorted(sequences.begin(), sequences.end(), by_address)) {
+        m_rows = std::move(rows);
+        return;
+    }
+    std::stable_sort(sequences.begin(), sequences.end(), by_address);
+    m_rows.reserve(rows.size());
+    for (const auto& sequence : sequences)
+        m_rows.insert(m_rows.end(), rows.begin() + sequence.begin,
+                      rows.begin() + sequence.end);
+}
+
+std::optional<std::size_t> LineTable::find(uint64_t address) const {
+    const auto upper = std::upper_bound(
+        m_rows.begin(), m_rows.end(), address,
+        [](uint64_t address, const Row& row) { return address < row.address; });
+    if (upper == m_rows.begin())
+        return std::nullopt;
+
+    // The row marking the end of a sequence describes the first address
+    // past the sequence, not an instruction.
+    const auto match = std::prev(upper);
+    if (match->end_sequence)
+        return std::nullopt;
+    return std::distance(m_rows.begin(), match);
+}
+
+} // namespace smldbg
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace smldbg {
+
+// A decoded line number table for a single compile unit, stored compactly and
+// sorted by address so that program counter lookups are a binary search.
+class LineTable {
+public:
+    struct Row {
+        uint64_t address;
+        uint32_t line;
+        uint32_t file; // Index into file_names().
+        uint16_t column;
+        bool is_stmt : 1;
+        bool basic_block : 1;
+        bool end_sequence : 1;
+        bool prologue_end : 1;
+        bool epilogue_begin : 1;
+    };
+
+    LineTable() = default;
+
+    // Construct a new LineTable from the rows committed by a line number
+    // program.
+    //
+    // Preconditions: |rows| should be in the order committed by the line
+    // number program, i.e. each sequence is terminated by a row with
+    // |end_sequence| set. |file_names| should be indexed by Row::file, as
+    // should |file_directories| if given.
+    //
+    // Postconditions: Sequences are reordered by start address, the rows of
+    // each sequence keep their relative order.
+    LineTable(std::vector<Row> rows, std::vector<std::string_view> file_names,
+              std::vector<std::string_view> file_directories = {});
+
+    // Return the index of the row describing |address|, i.e. the last row
+    // with an address less than or equal to |address|. If |address| falls
+    // outside every sequence, std::nullopt is returned.
+    std::optional<std::size_t> find(uint64_t address) const;
+
+    const std::vector<Row>& rows() const { return m_rows; }
+
+    // Return the name of the file associated with |row|.
+    std::string_view file(const Row& row) const {
+        return row.file < m_file_names.size() ? m_file_names[row.file]
+                                               : std::string_view();
+    }
+
+    // Return the include directory of the file associated with |row|. This is
+    // empty for files in the compilation directory.
+    std::string_view directory(const Row& row) const {
+        return row.file < m_file_directories.size()
+                   ? m_file_directories[row.file]
+                   : std::string_view();
+    }
+
+    const std::vector<std::string_view>& file_names() const {
+        return m_file_names;
+    }
+
+    const std::vector<std::string_view>& file_directories() const {
+        return m_file_directories;
+    }
+
+private:
+    std::vector<Row> m_rows; // Rows sorted by address.
+    std::vector<std::string_view> m_file_names;
+    std::vector<std::string_view> m_file_directories;
+};
+
+} // namespace smldbg
@@ -7,9 +7,10 @@
 
 namespace smldbg {
 
-LineVM::LineVM(char* debug_line, char* debug_str)
+LineVM::LineVM(char* debug_line, char* debug_str, char* debug_line_str)
     : m_debug_line(debug_line), m_debug_line_end(debug_line),
-      m_debug_str(debug_str) {
+      m_forms({.sections = {.debug_str = debug_str,
+                            .debug_line_str = debug_line_str}}) {
     read_header();
 }
 
@@ -37,8 +38,10 @@ void LineVM::exec() {
                 registers.op_index = 0;
                 break;
             }
-            case (DW_LNE_define_file):
             case (DW_LNE_set_discriminator):
+                registers.discriminator = util::decodeULEB128(iter);
+                break;
+            case (DW_LNE_define_file):
             case (DW_LNE_lo_user):
             case (DW_LNE_hi_user):
                 // TODO: Add support for these opcodes.
@@ -157,7 +160,7 @@ std::vector<LineNumberTableRow> LineVM::table() {
     for (unsigned i = 0; const auto& row : m_state) {
         rows[i++] = {
             .address = row.address,
-            .file = m_header.file_names[row.file - 1], // 1 indexed.
+            .file = m_header.file_names[row.file - m_header.first_file],
             .line = row.line,
             .column = row.column,
             .is_stmt = row.is_stmt,
@@ -170,6 +173,26 @@ std::vector<LineNumberTableRow> LineVM::table() {
     return rows;
 }
 
+LineTable LineVM::compact_table() const {
+    std::vector<LineTable::Row> rows;
+    rows.reserve(m_state.size());
+    for (const auto& row : m_state) {
+        rows.push_back({
+            .address = row.address,
+            .line = static_cast<uint32_t>(row.line),
+            .file = static_cast<uint32_t>(row.file - m_header.first_file),
+            .column = static_cast<uint16_t>(row.column),
+            .is_stmt = row.is_stmt,
+            .basic_block = row.basic_block,
+            .end_sequence = row.end_sequence,
+            .prologue_end = row.prologue_end,
+            .epilogue_begin = row.epilogue_begin,
+        });
+    }
+    return LineTable(std::move(rows), m_header.file_names,
+                     m_header.file_directories);
+}
+
 void LineVM::read_header() {
     char* iter = m_debug_line;
     uint32_t maybe_padding = util::read_bytes<uint32_t>(iter);
@@ -185,6 +208,13 @@ void LineVM::read_header() {
 
     // Dwarf version.
     m_header.version = util::read_bytes<uint16_t>(iter);
+    m_forms.is_64bit = m_header.is_64bit;
+    if (m_header.version >= 5) {
+        m_header.address_size = util::read_bytes<uint8_t>(iter);
+        m_forms.address_size = m_header.address_size;
+        m_header.segment_selector_size = util::read_bytes<uint8_t>(iter);
+        m_header.first_file = 0;
+    }
     if (m_header.is_64bit)
         m_header.header_length = util::read_bytes<uint64_t>(iter);
     else
@@ -209,8 +239,19 @@ void LineVM::read_header() {
     // We don't care about opcode lengths.
     std::advance(iter, sizeof(uint8_t) * m_header.opcode_base - 1);
 
+    if (m_header.version >= 5)
+        read_file_names_v5(iter);
+    else
+        read_file_names_v4(iter, header_end_iter);
+
+    // If we've not consumed the whole header, something has gone wrong.
+    assert(iter == header_end_iter);
+    m_instructions = iter;
+}
+
+void LineVM::read_file_names_v4(char*& iter, char* header_end) {
     // Decode the include paths. Sequence terminates with "\0\0".
-    while (iter != header_end_iter) {
+    while (iter != header_end) {
         if (std::string_view path(iter); path.length() > 0) {
             std::advance(iter, path.length() + 1);
             m_header.include_paths.emplace_back(path);
@@ -220,23 +261,74 @@ void LineVM::read_header() {
     std::advance(iter, sizeof(uint8_t)); // Skip the terminating '\0'
 
     // Decode the file names.
-    while (iter != header_end_iter) {
+    while (iter != header_end) {
         if (std::string_view file_name(iter); file_name.length() > 0) {
             std::advance(iter, file_name.length() + 1);
             m_header.file_names.emplace_back(file_name);
 
+            // Directory index. 0 is the compilation directory, include paths
+            // are 1 indexed.
+            const uint64_t directory = util::decodeULEB128(iter);
+            m_header.file_directories.push_back(
+                directory > 0 && directory <= m_header.include_paths.size()
+                    ? m_header.include_paths[directory - 1]
+                    : std::string_view());
+
             // Munch other parameters.
             util::decodeULEB128(iter);
             util::decodeULEB128(iter);
-            util::decodeULEB128(iter);
         } else
             break;
     }
     std::advance(iter, sizeof(uint8_t)); // Skip the terminating '\0'.
+}
 
-    // If we've not consumed the whole header, something has gone wrong.
-    assert(iter == header_end_iter);
-    m_instructions = iter;
+void LineVM::read_file_names_v5(char*& iter) {
+    // Directory entries. The first is the compilation directory.
+    const std::vector<EntryFormat> directory_format = read_entry_formats(iter);
+    const uint64_t directories_count = util::decodeULEB128(iter);
+    for (uint64_t i = 0; i < directories_count; ++i) {
+        std::string_view path;
+        for (const auto& [content_type, form] : directory_format) {
+            if (content_type == DW_LNCT_path)
+                path = dwarf::Attribute(form, iter, &m_forms).as_string_view();
+            dwarf::Attribute::eat(form, iter, m_forms);
+        }
+        m_header.include_paths.emplace_back(path);
+    }
+
+    // File name entries. The first is the primary source file.
+    const std::vector<EntryFormat> file_name_format = read_entry_formats(iter);
+    const uint64_t file_names_count = util::decodeULEB128(iter);
+    for (uint64_t i = 0; i < file_names_count; ++i) {
+        std::string_view file_name;
+        uint64_t directory = 0;
+        for (const auto& [content_type, form] : file_name_format) {
+            if (content_type == DW_LNCT_path)
+                file_name =
+                    dwarf::Attribute(form, iter, &m_forms).as_string_view();
+            else if (content_type == DW_LNCT_directory_index)
+                directory = dwarf::Attribute(form, iter, &m_forms).as_uint64t();
+            dwarf::Attribute::eat(form, iter, m_forms);
+        }
+        m_header.file_names.emplace_back(file_name);
+
+        // Directory 0 is the compilation directory.
+        m_header.file_directories.push_back(
+            directory > 0 && directory < m_header.include_paths.size()
+                ? m_header.include_paths[directory]
+                : std::string_view());
+    }
+}
+
+std::vector<LineVM::EntryFormat> LineVM::read_entry_formats(char*& iter) {
+    const uint8_t count = util::read_bytes<uint8_t>(iter);
+    std::vector<EntryFormat> formats(count);
+    for (auto& [content_type, form] : formats) {
+        content_type = util::decodeULEB128(iter);
+        form = static_cast<dwarf::DW_FORM>(util::decodeULEB128(iter));
+    }
+    return formats;
 }
 
 } // namespace smldbg
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "attribute.h"
+#include "line_table.h"
+
 #include <cstdint>
 #include <optional>
 #include <string>
@@ -27,11 +30,13 @@ public:
     // file.
     //
     // Preconditions: |debug_line| should point to the first byte of the line
-    // number header for the compile unit. |debug_str| should point to the first
-    // byte of the .debug_str ELF section.
+    // number header for the compile unit. |debug_str| and |debug_line_str|
+    // should point to the first byte of the .debug_str and .debug_line_str ELF
+    // sections, which DWARF 5 headers refer into. |debug_line_str| may be null
+    // if the ELF file has no such section.
     //
     // Postconditions: None.
-    LineVM(char* debug_line, char* debug_str);
+    LineVM(char* debug_line, char* debug_str, char* debug_line_str = nullptr);
 
     // Run the virtual machine and generate the line number table.
     void exec();
@@ -39,21 +44,31 @@ public:
     // Get the line number table
     std::vector<LineNumberTableRow> table();
 
+    // Get the line number table in its compact, address sorted form. This is
+    // the representation to cache, as the rows are a fraction of the size of
+    // LineNumberTableRow and support binary search by address.
+    //
+    // Preconditions: exec() has been called.
+    LineTable compact_table() const;
+
 private:
     // Line number program header.
     // Section 6.2.4
-    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
     struct Header {
         Header()
-            : is_64bit(false), unit_length(0), version(0), header_length(0),
+            : is_64bit(false), unit_length(0), version(0), address_size(0),
+              segment_selector_size(0), header_length(0),
               minimum_instruction_length(0),
               maximum_operations_per_instruction(0), default_is_stmt(false),
               line_base(0), line_range(0), opcode_base(0),
-              standard_opcode_lengths(0) {}
+              standard_opcode_lengths(0), first_file(1) {}
 
         bool is_64bit;
         uint64_t unit_length;
         uint16_t version;
+        uint8_t address_size;          // DWARF 5 only.
+        uint8_t segment_selector_size; // DWARF 5 only.
         uint64_t header_length;
         uint8_t minimum_instruction_length;
         uint8_t maximum_operations_per_instruction;
@@ -64,6 +79,29 @@ private:
         std::vector<uint8_t> standard_opcode_lengths;
         std::vector<std::string_view> include_paths;
         std::vector<std::string_view> file_names;
+        std::vector<std::string_view>
+            file_directories; // The include path of each of |file_names|,
+                              // empty for the compilation directory.
+        uint64_t first_file; // The index of the first of |file_names|. Files
+                             // are 1 indexed before DWARF 5, and 0 indexed
+                             // from DWARF 5.
+    };
+
+    // Line number header entry formats.
+    // Section 6.2.4.1
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    enum ContentType {
+        DW_LNCT_path = 0x1,
+        DW_LNCT_directory_index = 0x2,
+        DW_LNCT_timestamp = 0x3,
+        DW_LNCT_size = 0x4,
+        DW_LNCT_MD5 = 0x5,
+    };
+
+    // A field of a DWARF 5 directory or file name entry.
+    struct EntryFormat {
+        uint64_t content_type;
+        dwarf::DW_FORM form;
     };
 
     // Opcodes.
@@ -142,6 +180,17 @@ private:
     // opcode.
     void read_header();
 
+    // Read the DWARF 4 include directories and file names tables, which
+    // |iter| points to the first byte of.
+    void read_file_names_v4(char*& iter, char* header_end);
+
+    // Read the DWARF 5 directories and file names tables, which |iter| points
+    // to the first byte of. Each table is described by its own entry format.
+    void read_file_names_v5(char*& iter);
+
+    // Read a DWARF 5 entry format description at |iter|.
+    static std::vector<EntryFormat> read_entry_formats(char*& iter);
+
     Header m_header; // The header for the .debug_line entry.
 
     char* m_debug_line; // Points to the first byte of the .debug_line entry.
@@ -153,7 +202,9 @@ private:
     char* m_instructions; // Set by |read_header()|. Points to the first byte of
                           // the first opcode.
 
-    char* m_debug_str; // The first byte of the .debug_str ELF section.
+    dwarf::FormContext m_forms; // What reading the fields of DWARF 5 header
+                                // entries depends on, i.e. the .debug_str and
+                                // .debug_line_str sections.
 
     std::vector<Registers> m_state; // Commited registers.
 };
@@ -0,0 +1,199 @@
+#include "location_list.h"
+
+#include "byte_reader.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace smldbg::dwarf {
+
+namespace {
+
+// Section 7.7.3
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+enum : uint8_t {
+    DW_LLE_end_of_list = 0x00,
+    DW_LLE_base_addressx = 0x01,
+    DW_LLE_startx_endx = 0x02,
+    DW_LLE_startx_length = 0x03,
+    DW_LLE_offset_pair = 0x04,
+    DW_LLE_default_location = 0x05,
+    DW_LLE_base_address = 0x06,
+    DW_LLE_start_end = 0x07,
+    DW_LLE_start_length = 0x08,
+    DW_LLE_GNU_view_pair = 0x09,
+};
+
+// Return a reader of |section| from |offset| bytes in, which fails straight
+// away if |offset| is out of bounds.
+ByteReader reader_at(std::span<const char> section, uint64_t offset) {
+    ByteReader reader(section);
+    reader.block(offset);
+    return reader;
+}
+
+} // namespace
+
+LocationList::LocationList(DwarfExpression expression)
+    : m_default(std::move(expression)) {}
+
+std::optional<LocationList>
+LocationList::read_debug_loc(std::span<const char> section, uint64_t offset,
+                             uint64_t base_address, unsigned offset_size,
+                             unsigned address_size) {
+    // A base address selection entry starts with the largest address.
+    const uint64_t max_address =
+        address_size < sizeof(uint64_t)
+            ? (uint64_t(1) << (8 * address_size)) - 1
+            : std::numeric_limits<uint64_t>::max();
+
+    LocationList list;
+    ByteReader reader = reader_at(section, offset);
+    while (!reader.failed()) {
+        const uint64_t begin = reader.address(address_size);
+        const uint64_t end = reader.address(address_size);
+        if (begin == 0 && end == 0)
+            break; // End of list entry.
+        if (begin == max_address) {
+            base_address = end; // Base address selection entry.
+            continue;
+        }
+
+        const uint16_t size = reader.fixed<uint16_t>();
+        const std::span<const char> bytes = reader.block(size);
+        if (reader.failed())
+            break;
+        std::optional<DwarfExpression> expression =
+            DwarfExpression::compile(bytes, offset_size, address_size);
+        if (!expression)
+            return std::nullopt;
+        list.m_entries.push_back({.low = base_address + begin,
+                                  .high = base_address + end,
+                                  .expression = std::move(*expression)});
+    }
+    if (reader.failed())
+        return std::nullopt;
+
+    list.finalize();
+    return list;
+}
+
+std::optional<LocationList> LocationList::read_debug_loclists(
+    std::span<const char> section, uint64_t offset, uint64_t base_address,
+    unsigned offset_size, unsigned address_size,
+    const std::function<std::optional<uint64_t>(uint64_t index)>&
+        debug_addr) {
+    LocationList list;
+    ByteReader reader = reader_at(section, offset);
+    const auto address = [&](uint64_t index) -> std::optional<uint64_t> {
+        if (reader.failed() || !debug_addr)
+            return std::nullopt;
+        return debug_addr(index);
+    };
+
+    while (!reader.failed()) {
+        const uint8_t kind = reader.fixed<uint8_t>();
+        if (kind == DW_LLE_end_of_list)
+            break;
+
+        // Work out the range, if any, the entry's expression applies to.
+        std::optional<uint64_t> low;
+        std::optional<uint64_t> high;
+        switch (kind) {
+        case DW_LLE_base_addressx: {
+            const std::optional<uint64_t> base = address(reader.uleb());
+            if (!base)
+                return std::nullopt;
+            base_address = *base;
+            continue;
+        }
+        case DW_LLE_startx_endx:
+            low = address(reader.uleb());
+            high = address(reader.uleb());
+            break;
+        case DW_LLE_startx_length:
+            low = address(reader.uleb());
+            if (low)
+                high = *low + reader.uleb();
+            break;
+        case DW_LLE_offset_pair:
+            low = base_address + reader.uleb();
+            high = base_address + reader.uleb();
+            break;
+        case DW_LLE_default_location:
+            break;
+        case DW_LLE_base_address:
+            base_address = reader.address(address_size);
+            continue;
+        case DW_LLE_start_end:
+            low = reader.address(address_size);
+            high = reader.address(address_size);
+            break;
+        case DW_LLE_start_length:
+            low = reader.address(address_size);
+            high = *low + reader.uleb();
+            break;
+        case DW_LLE_GNU_view_pair:
+            // Location views tell apart entries starting at the same
+            // address. They aren't tracked, the first such entry is used.
+            reader.uleb();
+            reader.uleb();
+            continue;
+        default:
+            return std::nullopt;
+        }
+        if (kind != DW_LLE_default_location && (!low || !high))
+            return std::nullopt;
+
+        const std::span<const char> bytes = reader.block(reader.uleb());
+        if (reader.failed())
+            break;
+        std::optional<DwarfExpression> expression =
+            DwarfExpression::compile(bytes, offset_size, address_size);
+        if (!expression)
+            return std::nullopt;
+        if (kind == DW_LLE_default_location)
+            list.m_default = std::move(*expression);
+        else
+            list.m_entries.push_back({.low = *low,
+                                      .high = *high,
+                                      .expression = std::move(*expression)});
+    }
+    if (reader.failed())
+        return std::nullopt;
+
+    list.finalize();
+    return list;
+}
+
+const DwarfExpression* LocationList::find(uint64_t program_counter) const {
+    // The last entry starting at or before |program_counter|.
+    const auto entry = std::upper_bound(
+        m_entries.begin(), m_entries.end(), program_counter,
+        [](uint64_t pc, const Entry& entry) { return pc < entry.low; });
+    if (entry != m_entries.begin() && program_counter < std::prev(entry)->high)
+        return &std::prev(entry)->expression;
+    return m_default ? &*m_default : nullptr;
+}
+
+void LocationList::finalize() {
+    std::stable_sort(
+        m_entries.begin(), m_entries.end(),
+        [](const Entry& a, const Entry& b) { return a.low < b.low; });
+
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        Entry& entry = m_entries[i];
+        if (size > 0)
+            entry.low = std::max(entry.low, m_entries[size - 1].high);
+        if (entry.low >= entry.high)
+            continue;
+        if (i != size)
+            m_entries[size] = std::move(entry);
+        ++size;
+    }
+    m_entries.erase(m_entries.begin() + size, m_entries.end());
+}
+
+} // namespace smldbg::dwarf
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "dwarf_expression.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+struct FormContext;
+struct Type;
+
+// The location of an object that moves as its function runs, e.g. from the
+// register a parameter is passed in to a callee-saved register or the stack,
+// described by a different expression for each range of program counter
+// values. Outside of every range the object has been optimized out.
+//
+// The entries of a list are decoded once and kept sorted by address, so the
+// expression at a program counter value is found by binary search.
+class LocationList {
+public:
+    // An expression and the link-time program counter values it is valid
+    // for, [low, high).
+    struct Entry {
+        uint64_t low;
+        uint64_t high;
+        DwarfExpression expression;
+    };
+
+    LocationList() = default;
+
+    // Construct a list holding the single expression of a location that
+    // doesn't move, valid at every program counter value.
+    explicit LocationList(DwarfExpression expression);
+
+    // Decode the DWARF 4 location list at |offset| bytes into the .debug_loc
+    // |section|. Addresses are relative to |base_address|, the base address
+    // of the compile unit, until a base address selection entry changes it.
+    // |offset_size| is the size of section offsets in the compile unit, and
+    // |address_size| the size of its target addresses.
+    // Section 2.6.2
+    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if the list is truncated or one
+    // of its expressions can't be decoded.
+    static std::optional<LocationList>
+    read_debug_loc(std::span<const char> section, uint64_t offset,
+                   uint64_t base_address, unsigned offset_size,
+                   unsigned address_size);
+
+    // Decode the DWARF 5 location list at |offset| bytes into the
+    // .debug_loclists |section|, with sizes as for read_debug_loc.
+    // |debug_addr| returns entry |index| of the .debug_addr table of the
+    // compile unit, for the entries that refer to addresses by index.
+    // Section 2.6.2
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if the list is truncated, has an
+    // unknown entry or an address index |debug_addr| can't resolve, or one
+    // of its expressions can't be decoded.
+    static std::optional<LocationList> read_debug_loclists(
+        std::span<const char> section, uint64_t offset,
+        uint64_t base_address, unsigned offset_size, unsigned address_size,
+        const std::function<std::optional<uint64_t>(uint64_t index)>&
+            debug_addr);
+
+    // Return the expression locating the object at |program_counter|, a
+    // link-time address, or nullptr if the object has been optimized out
+    // there.
+    const DwarfExpression* find(uint64_t program_counter) const;
+
+    // Return the entries of the list, sorted by address and without
+    // overlaps.
+    const std::vector<Entry>& entries() const { return m_entries; }
+
+private:
+    // Sort |m_entries| by address. Overlapping entries describe an object
+    // that is in several places at once, any of which will do, so each entry
+    // is trimmed to start where the one before it ends.
+    void finalize();
+
+    std::vector<Entry> m_entries;
+
+    std::optional<DwarfExpression>
+        m_default; // The location wherever no entry applies, if any
+                   // (DW_LLE_default_location, or a location that doesn't
+                   // move).
+};
+
+// The locations of a variable, and of the frame base of the function it is
+// in, which DW_OP_fbreg is relative to, along with the variable's type.
+struct VariableLocation {
+    LocationList location;
+    std::optional<LocationList> frame_base;
+    const Type* type = nullptr; // Null if the type is unknown. Owned by the
+                                // type graph of the variable's compile unit.
+    const FormContext* form_context =
+        nullptr; // The form context of the variable's compile unit, which
+                 // resolves the .debug_addr indexes of DW_OP_addrx and
+                 // DW_OP_constx.
+};
+
+} // namespace smldbg::dwarf
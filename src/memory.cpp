@@ -0,0 +1,204 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace smldbg {
+
+Memory::Memory(Memory&& other) noexcept { *this = std::move(other); }
+
+Memory& Memory::operator=(Memory&& other) noexcept {
+    if (this == &other)
+        return *this;
+    if (m_proc_mem_fd >= 0)
+        close(m_proc_mem_fd);
+    m_pid = other.m_pid;
+    m_proc_mem_fd = std::exchange(other.m_proc_mem_fd, -1);
+    m_pages = std::move(other.m_pages);
+    m_statistics = other.m_statistics;
+    return *this;
+}
+
+Memory::~Memory() {
+    if (m_proc_mem_fd >= 0)
+        close(m_proc_mem_fd);
+}
+
+bool Memory::read(uint64_t address, std::span<char> bytes) {
+    ++m_statistics.reads;
+    if (bytes.empty())
+        return true;
+
+    // Collect the pages covering the request that we haven't cached yet.
+    const uint64_t first_page = address & ~(page_size - 1);
+    const uint64_t last_page = (address + bytes.size() - 1) & ~(page_size - 1);
+    std::vector<uint64_t> missing;
+    for (uint64_t page = first_page; page <= last_page; page += page_size) {
+        if (m_pages.count(page))
+            ++m_statistics.page_hits;
+        else
+            missing.push_back(page);
+    }
+
+    // Fetch all of the missing pages straight into the cache in one go.
+    if (!missing.empty()) {
+        std::vector<Page*> pages(missing.size());
+        for (unsigned i = 0, e = missing.size(); i < e; ++i)
+            pages[i] = &m_pages[missing[i]];
+        if (!fetch_pages(missing, pages)) {
+            for (const auto page : missing)
+                m_pages.erase(page);
+            return false;
+        }
+    }
+
+    // Copy the requested bytes out of the cached pages.
+    for (uint64_t copied = 0; copied < bytes.size();) {
+        const uint64_t current = address + copied;
+        const uint64_t page = current & ~(page_size - 1);
+        const uint64_t offset = current - page;
+        const uint64_t count =
+            std::min<uint64_t>(page_size - offset, bytes.size() - copied);
+        std::memcpy(bytes.data() + copied, m_pages.at(page).data() + offset,
+                    count);
+        copied += count;
+    }
+    return true;
+}
+
+void Memory::prefetch(uint64_t address, uint64_t size) {
+    if (size == 0)
+        return;
+
+    constexpr std::size_t max_iovecs = 1024;
+    const uint64_t first_page = address & ~(page_size - 1);
+    const uint64_t last_page = (address + size - 1) & ~(page_size - 1);
+    std::vector<uint64_t> missing;
+    for (uint64_t page = first_page;
+         page <= last_page && missing.size() < max_iovecs; page += page_size) {
+        if (!m_pages.count(page))
+            missing.push_back(page);
+    }
+    if (missing.empty())
+        return;
+
+    std::vector<iovec> local(missing.size());
+    std::vector<iovec> remote(missing.size());
+    for (std::size_t i = 0; i < missing.size(); ++i) {
+        local[i] = {.iov_base = m_pages[missing[i]].data(),
+                    .iov_len = page_size};
+        remote[i] = {.iov_base = reinterpret_cast<void*>(missing[i]),
+                     .iov_len = page_size};
+    }
+    ++m_statistics.syscalls;
+    const ssize_t read = process_vm_readv(m_pid, local.data(), local.size(),
+                                          remote.data(), remote.size(), 0);
+
+    // Keep the pages before the first one that couldn't be read.
+    const std::size_t complete = read > 0 ? read / page_size : 0;
+    m_statistics.page_misses += complete;
+    for (std::size_t i = complete; i < missing.size(); ++i)
+        m_pages.erase(missing[i]);
+}
+
+bool Memory::write(uint64_t address, std::span<const char> bytes) {
+    ++m_statistics.writes;
+    if (bytes.empty())
+        return true;
+
+    // Try process_vm_writev(2) first. It honours page protections, so writes
+    // to text pages (i.e. inserting breakpoints) need /proc/<pid>/mem.
+    ++m_statistics.syscalls;
+    iovec local = {.iov_base = const_cast<char*>(bytes.data()),
+                   .iov_len = bytes.size()};
+    iovec remote = {.iov_base = reinterpret_cast<void*>(address),
+                    .iov_len = bytes.size()};
+    const ssize_t written = process_vm_writev(m_pid, &local, 1, &remote, 1, 0);
+    if (written != static_cast<ssize_t>(bytes.size())) {
+        const uint64_t done = written > 0 ? written : 0;
+        if (!write_proc_mem(address + done, bytes.subspan(done)))
+            return false;
+    }
+
+    // Keep any cached pages coherent with the write.
+    for (uint64_t copied = 0; copied < bytes.size();) {
+        const uint64_t current = address + copied;
+        const uint64_t page = current & ~(page_size - 1);
+        const uint64_t offset = current - page;
+        const uint64_t count =
+            std::min<uint64_t>(page_size - offset, bytes.size() - copied);
+        if (auto cached = m_pages.find(page); cached != m_pages.end())
+            std::memcpy(cached->second.data() + offset, bytes.data() + copied,
+                        count);
+        copied += count;
+    }
+    return true;
+}
+
+bool Memory::fetch_pages(std::span<const uint64_t> addresses,
+                         std::span<Page*> pages) {
+    m_statistics.page_misses += addresses.size();
+
+    // process_vm_readv(2) accepts at most IOV_MAX iovecs per call.
+    constexpr std::size_t max_iovecs = 1024;
+    for (std::size_t begin = 0; begin < addresses.size(); begin += max_iovecs) {
+        const std::size_t count =
+            std::min(max_iovecs, addresses.size() - begin);
+        std::vector<iovec> local(count);
+        std::vector<iovec> remote(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            local[i] = {.iov_base = pages[begin + i]->data(),
+                        .iov_len = page_size};
+            remote[i] = {.iov_base = reinterpret_cast<void*>(
+                             addresses[begin + i]),
+                         .iov_len = page_size};
+        }
+
+        ++m_statistics.syscalls;
+        const ssize_t read = process_vm_readv(m_pid, local.data(), count,
+                                              remote.data(), count, 0);
+
+        // Reads stop at the first page that couldn't be accessed, retry the
+        // remaining pages individually through /proc/<pid>/mem.
+        const std::size_t complete = read > 0 ? read / page_size : 0;
+        for (std::size_t i = complete; i < count; ++i) {
+            if (!read_proc_mem(addresses[begin + i], *pages[begin + i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool Memory::read_proc_mem(uint64_t address, std::span<char> bytes) {
+    const int fd = proc_mem_fd();
+    if (fd < 0)
+        return false;
+    ++m_statistics.syscalls;
+    return pread(fd, bytes.data(), bytes.size(), address) ==
+           static_cast<ssize_t>(bytes.size());
+}
+
+bool Memory::write_proc_mem(uint64_t address, std::span<const char> bytes) {
+    const int fd = proc_mem_fd();
+    if (fd < 0)
+        return false;
+    ++m_statistics.syscalls;
+    return pwrite(fd, bytes.data(), bytes.size(), address) ==
+           static_cast<ssize_t>(bytes.size());
+}
+
+int Memory::proc_mem_fd() {
+    if (m_proc_mem_fd < 0) {
+        const std::string path = "/proc/" + std::to_string(m_pid) + "/mem";
+        m_proc_mem_fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    }
+    return m_proc_mem_fd;
+}
+
+} // namespace smldbg
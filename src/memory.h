@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+namespace smldbg {
+
+// Reads and writes the memory of a stopped target in bulk. Reads go through
+// process_vm_readv(2) a page at a time and are cached until the target is
+// resumed, so walking a stack or decoding a run of instructions costs a
+// handful of syscalls rather than one PTRACE_PEEKDATA per word. Pages that
+// process_vm_readv/process_vm_writev can't access (e.g. writes to read-only
+// text pages when inserting breakpoints) fall back to /proc/<pid>/mem.
+class Memory {
+public:
+    static constexpr uint64_t page_size = 4096;
+
+    Memory() = default;
+    Memory(int pid) : m_pid(pid) {}
+
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+    Memory(Memory&& other) noexcept;
+    Memory& operator=(Memory&& other) noexcept;
+    ~Memory();
+
+    // Read |bytes.size()| bytes of target memory starting at |address| into
+    // |bytes|. Returns false if any of the requested bytes are not mapped.
+    bool read(uint64_t address, std::span<char> bytes);
+
+    // Cache as much of the |size| bytes starting at |address| as can be read
+    // with a single process_vm_readv(2), for a caller about to make many
+    // small reads there, e.g. an unwinder walking the stack. Pages past the
+    // end of the mapping are silently left out.
+    void prefetch(uint64_t address, uint64_t size);
+
+    // Write |bytes| to target memory starting at |address|. Returns false if
+    // any of the bytes could not be written.
+    bool write(uint64_t address, std::span<const char> bytes);
+
+    // Read a value of type |T| from |address|.
+    template <typename T> std::optional<T> read_value(uint64_t address) {
+        std::array<char, sizeof(T)> bytes;
+        if (!read(address, bytes))
+            return std::nullopt;
+        T value;
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return value;
+    }
+
+    // Write |value| to |address|.
+    template <typename T> bool write_value(uint64_t address, const T& value) {
+        std::array<char, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), &value, sizeof(T));
+        return write(address, bytes);
+    }
+
+    // Drop all cached pages. Call whenever the target is resumed.
+    void invalidate() { m_pages.clear(); }
+
+    struct Statistics {
+        uint64_t reads;       // Number of read requests.
+        uint64_t writes;      // Number of write requests.
+        uint64_t page_hits;   // Pages served from the cache.
+        uint64_t page_misses; // Pages fetched from the target.
+        uint64_t syscalls;    // Number of syscalls issued.
+    };
+
+    const Statistics& statistics() const { return m_statistics; }
+
+private:
+    using Page = std::array<char, page_size>;
+
+    // Fetch the pages starting at each of |addresses| into |pages| with as few
+    // syscalls as possible. Returns false if any page could not be read.
+    bool fetch_pages(std::span<const uint64_t> addresses,
+                     std::span<Page*> pages);
+
+    // Access |bytes| at |address| through /proc/<pid>/mem.
+    bool read_proc_mem(uint64_t address, std::span<char> bytes);
+    bool write_proc_mem(uint64_t address, std::span<const char> bytes);
+
+    // Return a descriptor for /proc/<pid>/mem, opening it on first use.
+    int proc_mem_fd();
+
+    int m_pid = 0;
+    int m_proc_mem_fd = -1;
+
+    std::unordered_map<uint64_t, Page>
+        m_pages; // Cached pages, keyed by page address.
+
+    Statistics m_statistics = {};
+};
+
+} // namespace smldbg
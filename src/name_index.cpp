@@ -0,0 +1,257 @@
+#include "name_index.h"
+
+#include "abbreviation_table.h"
+#include "attribute.h"
+#include "util.h"
+
+#include <cstring>
+
+namespace smldbg::dwarf {
+
+namespace {
+
+// Read a value of |form| from the entry pool of a name index. Returns
+// std::nullopt for forms that aren't valid in a name index.
+std::optional<uint64_t> read_index_attribute(DW_FORM form, char*& data) {
+    switch (form) {
+    case DW_FORM::DW_FORM_data1:
+    case DW_FORM::DW_FORM_ref1:
+    case DW_FORM::DW_FORM_flag:
+        return util::read_bytes<uint8_t>(data);
+    case DW_FORM::DW_FORM_data2:
+    case DW_FORM::DW_FORM_ref2:
+        return util::read_bytes<uint16_t>(data);
+    case DW_FORM::DW_FORM_data4:
+    case DW_FORM::DW_FORM_ref4:
+        return util::read_bytes<uint32_t>(data);
+    case DW_FORM::DW_FORM_data8:
+    case DW_FORM::DW_FORM_ref8:
+    case DW_FORM::DW_FORM_ref_sig8:
+        return util::read_bytes<uint64_t>(data);
+    case DW_FORM::DW_FORM_udata:
+    case DW_FORM::DW_FORM_ref_udata:
+        return util::decodeULEB128(data);
+    case DW_FORM::DW_FORM_sdata:
+        return util::decodeLEB128(data);
+    case DW_FORM::DW_FORM_flag_present:
+        return 1;
+    default:
+        return std::nullopt;
+    }
+}
+
+} // namespace
+
+std::optional<NameIndex>
+NameIndex::read_debug_names(elf::ELFSection debug_names, char* debug_str) {
+    if (!debug_names.data || debug_names.size == 0 || !debug_str)
+        return std::nullopt;
+
+    // A linker that doesn't merge name indexes leaves one per compile unit, so
+    // the section may hold several.
+    NameIndex index(Source::debug_names);
+    char* iter = debug_names.data;
+    char* const end = debug_names.data + debug_names.size;
+    while (iter < end) {
+        // Section 6.1.1.4.1
+        // http://www.dwarfstd.org/doc/DWARF5.pdf
+        uint64_t unit_length = util::read_bytes<uint32_t>(iter);
+        const bool is_64bit = unit_length == 0xFFFFFFFF;
+        if (is_64bit)
+            unit_length = util::read_bytes<uint64_t>(iter);
+        char* const next = iter + unit_length;
+        if (next > end)
+            return std::nullopt;
+
+        const auto version = util::read_bytes<uint16_t>(iter);
+        if (version != 5)
+            return std::nullopt;
+        util::read_bytes<uint16_t>(iter); // padding
+        const auto comp_unit_count = util::read_bytes<uint32_t>(iter);
+        const auto local_type_unit_count = util::read_bytes<uint32_t>(iter);
+        const auto foreign_type_unit_count = util::read_bytes<uint32_t>(iter);
+        const auto bucket_count = util::read_bytes<uint32_t>(iter);
+        const auto name_count = util::read_bytes<uint32_t>(iter);
+        const auto abbrev_table_size = util::read_bytes<uint32_t>(iter);
+        const auto augmentation_string_size = util::read_bytes<uint32_t>(iter);
+        iter += (augmentation_string_size + 3) & ~3u;
+
+        const uint64_t offset_size = is_64bit ? 8 : 4;
+        const auto read_offset = [&](char* data) -> uint64_t {
+            return is_64bit ? util::read_bytes<uint64_t>(data)
+                            : util::read_bytes<uint32_t>(data);
+        };
+
+        // Locate each of the arrays that follow the header. We don't use the
+        // hash table, every name is read into the index.
+        char* const comp_units = iter;
+        iter += comp_unit_count * offset_size;
+        iter += local_type_unit_count * offset_size;
+        iter += foreign_type_unit_count * sizeof(uint64_t);
+        iter += bucket_count * sizeof(uint32_t);
+        if (bucket_count)
+            iter += name_count * sizeof(uint32_t); // Hashes.
+        char* const string_offsets = iter;
+        iter += name_count * offset_size;
+        char* const entry_offsets = iter;
+        iter += name_count * offset_size;
+        char* const abbreviation_table = iter;
+        char* const entry_pool = abbreviation_table + abbrev_table_size;
+        if (entry_pool > next)
+            return std::nullopt;
+
+        // Section 6.1.1.4.7
+        // http://www.dwarfstd.org/doc/DWARF5.pdf
+        struct Abbreviation {
+            uint64_t tag;
+            std::vector<std::pair<DW_IDX, DW_FORM>> attributes;
+        };
+        std::unordered_map<uint64_t, Abbreviation> abbreviations;
+        while (iter < entry_pool) {
+            const uint64_t code = util::decodeULEB128(iter);
+            if (code == 0)
+                break;
+            Abbreviation& abbreviation = abbreviations[code];
+            abbreviation.tag = util::decodeULEB128(iter);
+            while (iter < entry_pool) {
+                const uint64_t attribute = util::decodeULEB128(iter);
+                const uint64_t form = util::decodeULEB128(iter);
+                if (attribute == 0 && form == 0)
+                    break;
+                abbreviation.attributes.emplace_back(
+                    static_cast<DW_IDX>(attribute), static_cast<DW_FORM>(form));
+            }
+        }
+
+        // Read the entries of each name. Each series of entries is terminated
+        // by an abbreviation code of 0.
+        for (uint32_t i = 0; i < name_count; ++i) {
+            const char* name =
+                debug_str + read_offset(string_offsets + i * offset_size);
+            char* entry =
+                entry_pool + read_offset(entry_offsets + i * offset_size);
+            while (entry < next) {
+                const uint64_t code = util::decodeULEB128(entry);
+                if (code == 0)
+                    break;
+                const auto abbreviation = abbreviations.find(code);
+                if (abbreviation == abbreviations.end())
+                    return std::nullopt;
+
+                std::optional<uint64_t> comp_unit;
+                std::optional<uint64_t> die_offset;
+                bool is_type_unit = false;
+                for (const auto& [attribute, form] :
+                     abbreviation->second.attributes) {
+                    const std::optional<uint64_t> value =
+                        read_index_attribute(form, entry);
+                    if (!value)
+                        return std::nullopt;
+                    if (attribute == DW_IDX::DW_IDX_compile_unit)
+                        comp_unit = value;
+                    else if (attribute == DW_IDX::DW_IDX_type_unit)
+                        is_type_unit = true;
+                    else if (attribute == DW_IDX::DW_IDX_die_offset)
+                        die_offset = value;
+                }
+
+                // DW_IDX_compile_unit may be omitted when the index covers a
+                // single compile unit. DW_IDX_die_offset is relative to the
+                // start of the compile unit header.
+                if (abbreviation->second.tag !=
+                        static_cast<uint64_t>(DW_TAG::DW_TAG_subprogram) ||
+                    is_type_unit || !die_offset)
+                    continue;
+                const uint64_t unit = comp_unit.value_or(0);
+                if (unit >= comp_unit_count)
+                    continue;
+                index.insert(name,
+                             {.offset = read_offset(comp_units +
+                                                    unit * offset_size) +
+                                        *die_offset,
+                              .is_compile_unit = false});
+            }
+        }
+        iter = next;
+    }
+    return index;
+}
+
+std::optional<NameIndex> NameIndex::read_gdb_index(elf::ELFSection gdb_index) {
+    // https://sourceware.org/gdb/onlinedocs/gdb/Index-Section-Format.html
+    constexpr uint64_t header_size = 6 * sizeof(uint32_t);
+    if (!gdb_index.data || gdb_index.size < header_size)
+        return std::nullopt;
+
+    char* iter = gdb_index.data;
+    const auto version = util::read_bytes<uint32_t>(iter);
+    if (version < 7 || version > 8)
+        return std::nullopt;
+    const auto cu_list = util::read_bytes<uint32_t>(iter);
+    const auto types_cu_list = util::read_bytes<uint32_t>(iter);
+    util::read_bytes<uint32_t>(iter); // address_area
+    const auto symbol_table = util::read_bytes<uint32_t>(iter);
+    const auto constant_pool = util::read_bytes<uint32_t>(iter);
+    if (cu_list > types_cu_list || symbol_table > constant_pool ||
+        constant_pool > gdb_index.size)
+        return std::nullopt;
+
+    // Each compile unit is described by a pair of 64 bit values, the offset of
+    // the unit in .debug_info followed by its length.
+    const uint64_t cu_count = (types_cu_list - cu_list) / 16;
+    const auto cu_offset = [&](uint64_t cu) {
+        char* data = gdb_index.data + cu_list + cu * 16;
+        return util::read_bytes<uint64_t>(data);
+    };
+
+    // The symbol table is an open addressed hash table of (name, CU vector)
+    // offset pairs into the constant pool. Unused slots are all zero.
+    NameIndex index(Source::gdb_index);
+    char* const pool = gdb_index.data + constant_pool;
+    char* const pool_end = gdb_index.data + gdb_index.size;
+    char* slot = gdb_index.data + symbol_table;
+    while (slot + 2 * sizeof(uint32_t) <= pool) {
+        const auto name_offset = util::read_bytes<uint32_t>(slot);
+        const auto vector_offset = util::read_bytes<uint32_t>(slot);
+        if (name_offset == 0 && vector_offset == 0)
+            continue;
+        if (pool + name_offset >= pool_end ||
+            pool + vector_offset + sizeof(uint32_t) > pool_end)
+            return std::nullopt;
+
+        const char* name = pool + name_offset;
+        char* vector = pool + vector_offset;
+        const auto count = util::read_bytes<uint32_t>(vector);
+        if (vector + count * sizeof(uint32_t) > pool_end)
+            return std::nullopt;
+        for (uint32_t i = 0; i < count; ++i) {
+            // Bits 0-23 hold the CU index, bits 28-30 the symbol kind. Some
+            // linkers (e.g. gold) leave the kind as 0, meaning unknown.
+            const auto value = util::read_bytes<uint32_t>(vector);
+            const uint64_t cu = value & 0xFFFFFF;
+            const uint32_t kind = (value >> 28) & 0x7;
+            constexpr uint32_t unknown_kind = 0;
+            constexpr uint32_t function_kind = 3;
+            if ((kind != unknown_kind && kind != function_kind) ||
+                cu >= cu_count)
+                continue;
+            index.insert(name,
+                         {.offset = cu_offset(cu), .is_compile_unit = true});
+        }
+    }
+    return index;
+}
+
+void NameIndex::insert(std::string_view name, Entry entry) {
+    m_entries[name].push_back(entry);
+}
+
+std::span<const NameIndex::Entry>
+NameIndex::find(std::string_view name) const {
+    const auto found = m_entries.find(name);
+    if (found == m_entries.end())
+        return {};
+    return found->second;
+}
+
+} // namespace smldbg::dwarf
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "elf.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+// Name index attribute encodings.
+// Section 6.1.1.4.7
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+enum class DW_IDX {
+    DW_IDX_null = 0x0,
+    DW_IDX_compile_unit = 0x01,
+    DW_IDX_type_unit = 0x02,
+    DW_IDX_die_offset = 0x03,
+    DW_IDX_parent = 0x04,
+    DW_IDX_type_hash = 0x05,
+};
+
+// Maps function names to the .debug_info entries that define them. The index
+// is either read from an accelerator table emitted by the compiler or linker
+// (.debug_names, .gdb_index) or built by walking the DIEs of each compile
+// unit. Names are plain DW_AT_name ("foo") or linkage (mangled) names
+// ("_ZN2ns5Class3fooEv"), .gdb_index also records qualified names
+// ("ns::Class::foo").
+//
+// The index doesn't own its names, they are views into the sections of the
+// ELF file the index was read from.
+class NameIndex {
+public:
+    struct Entry {
+        uint64_t offset; // Offset into the .debug_info section.
+        bool is_compile_unit; // Does |offset| refer to the DW_TAG_subprogram
+                              // entry itself (false) or to the header of a
+                              // compile unit containing the function (true)?
+    };
+
+    // Where the entries of the index came from.
+    enum class Source { dwarf, debug_names, gdb_index };
+
+    NameIndex(Source source = Source::dwarf) : m_source(source) {}
+
+    // Read the function names of a DWARF 5 name index.
+    //
+    // Preconditions: |debug_str| should point to the first byte of the
+    // .debug_str section of the same ELF file.
+    //
+    // Postconditions: Returns std::nullopt if |debug_names| is empty or isn't
+    // a name index we understand. The entries of the returned index refer to
+    // DW_TAG_subprogram entries.
+    static std::optional<NameIndex>
+    read_debug_names(elf::ELFSection debug_names, char* debug_str);
+
+    // Read the function names of a .gdb_index section (versions 7 and 8).
+    //
+    // Preconditions: None.
+    //
+    // Postconditions: Returns std::nullopt if |gdb_index| is empty or isn't a
+    // version we understand. The .gdb_index symbol table only records which
+    // compile units define a name, so the entries of the returned index refer
+    // to compile units.
+    static std::optional<NameIndex> read_gdb_index(elf::ELFSection gdb_index);
+
+    // Add |entry| under |name|.
+    //
+    // Preconditions: |name| must outlive the index.
+    //
+    // Postconditions: None.
+    void insert(std::string_view name, Entry entry);
+
+    // Reserve space for at least |names| distinct names.
+    void reserve(std::size_t names) { m_entries.reserve(names); }
+
+    // Return the entries recorded under |name|, in insertion order.
+    std::span<const Entry> find(std::string_view name) const;
+
+    // Return the number of distinct names in the index.
+    std::size_t size() const { return m_entries.size(); }
+
+    Source source() const { return m_source; }
+
+    // Return the entries of the index, keyed by name.
+    const std::unordered_map<std::string_view, std::vector<Entry>>&
+    entries() const {
+        return m_entries;
+    }
+
+private:
+    Source m_source;
+
+    std::unordered_map<std::string_view, std::vector<Entry>>
+        m_entries; // Entries keyed by name.
+};
+
+} // namespace smldbg::dwarf
@@ -0,0 +1,46 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+namespace smldbg {
+
+void Profile::add_sample(std::vector<uint64_t> stack) {
+    ++m_stacks[std::move(stack)];
+    ++m_samples;
+}
+
+std::size_t Profile::write_folded(
+    std::ostream& os,
+    const std::function<std::string(uint64_t)>& symbolize) const {
+    std::unordered_map<uint64_t, std::string> names;
+    const auto name = [&](uint64_t pc) -> const std::string& {
+        auto found = names.find(pc);
+        if (found == names.end()) {
+            // Semicolons separate the frames.
+            std::string symbol = symbolize(pc);
+            std::replace(symbol.begin(), symbol.end(), ';', ':');
+            found = names.emplace(pc, std::move(symbol)).first;
+        }
+        return found->second;
+    };
+
+    // Stacks of different program counters in the same functions fold into
+    // one.
+    std::map<std::string, uint64_t> folded;
+    for (const auto& [stack, count] : m_stacks) {
+        std::string line;
+        for (auto frame = stack.rbegin(); frame != stack.rend(); ++frame) {
+            if (!line.empty())
+                line += ';';
+            line += name(*frame);
+        }
+        folded[line] += count;
+    }
+    for (const auto& [line, count] : folded)
+        os << line << " " << count << "\n";
+    return names.size();
+}
+
+} // namespace smldbg
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace smldbg {
+
+// Options of the 'profile' mode, from the command line.
+struct ProfileOptions {
+    unsigned frequency = 99;              // Samples per second.
+    std::string output = "smldbg.folded"; // Where the folded stacks go.
+    bool lines = false; // Whether frames name source lines as well.
+    std::optional<int> pid; // Process to attach to, rather than starting one.
+
+    // How long to profile for, or until the target exits if unset.
+    std::optional<std::chrono::nanoseconds> duration;
+};
+
+// The stacks sampled by the 'profile' mode. Samples are kept as the program
+// counters of their frames, and only symbolized when the profile is written
+// out, once for each distinct program counter, so that taking a sample costs
+// no more than unwinding the stack.
+class Profile {
+public:
+    // Add a sample of a thread's stack, given as the program counter to look
+    // up for each frame, innermost first.
+    void add_sample(std::vector<uint64_t> stack);
+
+    // Number of samples added.
+    uint64_t samples() const { return m_samples; }
+
+    // Number of distinct stacks sampled.
+    std::size_t stacks() const { return m_stacks.size(); }
+
+    // Write the samples to |os| as folded stacks, as read by flamegraph.pl
+    // and most other flame graph tools: a line for each distinct stack with
+    // its frames from the outermost in, separated by semicolons, then the
+    // number of samples. |symbolize| names the frame at a program counter.
+    // Returns the number of distinct program counters symbolized.
+    std::size_t
+    write_folded(std::ostream& os,
+                 const std::function<std::string(uint64_t)>& symbolize) const;
+
+private:
+    std::map<std::vector<uint64_t>, uint64_t>
+        m_stacks; // Number of samples of each stack.
+    uint64_t m_samples = 0;
+};
+
+} // namespace smldbg
@@ -0,0 +1,45 @@
+#include "register_cache.h"
+
+#include <iostream>
+
+#include <sys/ptrace.h>
+
+namespace smldbg {
+
+const user_regs_struct& RegisterCache::get() {
+    ++m_statistics.reads;
+    if (!m_valid)
+        fetch();
+    return m_registers;
+}
+
+user_regs_struct& RegisterCache::modify() {
+    ++m_statistics.writes;
+    if (!m_valid)
+        fetch();
+    m_dirty = true;
+    return m_registers;
+}
+
+void RegisterCache::flush() {
+    if (!m_dirty)
+        return;
+    ++m_statistics.setregs;
+    if (ptrace(PTRACE_SETREGS, m_pid, 0, &m_registers) < 0)
+        std::cerr << "Failed to write registers of process " << m_pid << ".\n";
+    m_dirty = false;
+}
+
+void RegisterCache::invalidate() {
+    flush();
+    m_valid = false;
+}
+
+void RegisterCache::fetch() {
+    ++m_statistics.getregs;
+    if (ptrace(PTRACE_GETREGS, m_pid, 0, &m_registers) < 0)
+        std::cerr << "Failed to read registers of process " << m_pid << ".\n";
+    m_valid = true;
+}
+
+} // namespace smldbg
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include <sys/user.h>
+
+namespace smldbg {
+
+// Caches the general purpose registers of a stopped target between resumes.
+// The first read after a stop fetches every register with a single
+// PTRACE_GETREGS, subsequent reads are served from the cache. Modifications
+// are written back with a single PTRACE_SETREGS when the cache is flushed,
+// which must happen before the target is resumed.
+class RegisterCache {
+public:
+    RegisterCache() = default;
+    RegisterCache(int pid) : m_pid(pid) {}
+
+    // Return the current register values.
+    const user_regs_struct& get();
+
+    // Return the current register values for modification. Modified values
+    // are not visible to the target until flush() is called.
+    user_regs_struct& modify();
+
+    // Write back modified register values, if any.
+    void flush();
+
+    // Flush and then drop the cached register values. Call whenever the target
+    // is resumed.
+    void invalidate();
+
+    struct Statistics {
+        uint64_t reads;    // Number of calls to get().
+        uint64_t writes;   // Number of calls to modify().
+        uint64_t getregs;  // Number of PTRACE_GETREGS requests issued.
+        uint64_t setregs;  // Number of PTRACE_SETREGS requests issued.
+
+        // Without the cache, every read is a PTRACE_GETREGS and every write is
+        // a PTRACE_GETREGS followed by a PTRACE_SETREGS.
+        uint64_t saved() const {
+            return (reads + 2 * writes) - (getregs + setregs);
+        }
+    };
+
+    const Statistics& statistics() const { return m_statistics; }
+
+private:
+    void fetch();
+
+    int m_pid = 0;
+
+    user_regs_struct m_registers = {};
+    bool m_valid = false; // Does |m_registers| hold the current values?
+    bool m_dirty = false; // Does |m_registers| need writing back?
+
+    Statistics m_statistics = {};
+};
+
+} // namespace smldbg
@@ -0,0 +1,29 @@
+#include "thread_table.h"
+
+namespace smldbg {
+
+Thread& ThreadTable::add(int tid) {
+    auto [thread, added] = m_threads.try_emplace(
+        tid, Thread{.tid = tid,
+                    .number = m_next_number,
+                    .registers = RegisterCache(tid)});
+    if (added)
+        ++m_next_number;
+    return thread->second;
+}
+
+void ThreadTable::remove(int tid) { m_threads.erase(tid); }
+
+Thread* ThreadTable::find(int tid) {
+    const auto thread = m_threads.find(tid);
+    return thread != m_threads.end() ? &thread->second : nullptr;
+}
+
+Thread* ThreadTable::find_number(int number) {
+    for (auto& [tid, thread] : m_threads)
+        if (thread.number == number)
+            return &thread;
+    return nullptr;
+}
+
+} // namespace smldbg
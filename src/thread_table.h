@@ -0,0 +1,74 @@
+#pragma once
+
+#include "register_cache.h"
+
+#include <cstddef>
+#include <map>
+#include <optional>
+
+#include <sys/ptrace.h>
+
+namespace smldbg {
+
+// Why a thread of the target last stopped.
+enum class StopReason {
+    none,        // Hasn't stopped since it was first traced.
+    created,     // New thread, stopped before running any of its code.
+    stopped,     // Stopped by the debugger because another thread stopped.
+    breakpoint,  // Hit a software breakpoint.
+    hardware,    // Hit a hardware breakpoint or watchpoint.
+    step,        // Completed a single step.
+    signal,      // Received a signal.
+    interrupted, // Stopped by the debugger at the user's request.
+};
+
+// A traced thread of the target.
+struct Thread {
+    int tid;    // Kernel thread id, as passed to ptrace(...).
+    int number; // Numbered from 1 in the order the threads were seen.
+
+    RegisterCache registers; // Registers of the thread, cached between
+                             // resumes.
+
+    bool running = false;        // Resumed and not yet reported a stop.
+    bool stop_requested = false; // Sent a stop that hasn't been reported yet.
+    __ptrace_request resumed_with = PTRACE_CONT; // How it was last resumed.
+
+    StopReason stop_reason = StopReason::none;
+    int stop_signal = 0; // Signal reported with the last stop.
+
+    // A stop reported while the other threads were being stopped, which is
+    // reported in place of resuming the target the next time around.
+    std::optional<int> pending_status;
+};
+
+// The threads of the target, keyed by thread id. Threads are only ever added
+// and removed, so references to them stay valid until they are removed.
+class ThreadTable {
+public:
+    ThreadTable() = default;
+
+    // Start tracking the thread |tid|, numbering it after the threads seen so
+    // far.
+    Thread& add(int tid);
+
+    // Stop tracking the thread |tid|, e.g. after it exits.
+    void remove(int tid);
+
+    // Return the thread with id |tid|, or nullptr if it isn't tracked.
+    Thread* find(int tid);
+
+    // Return the thread numbered |number|, or nullptr if there isn't one.
+    Thread* find_number(int number);
+
+    std::size_t size() const { return m_threads.size(); }
+
+    std::map<int, Thread>::iterator begin() { return m_threads.begin(); }
+    std::map<int, Thread>::iterator end() { return m_threads.end(); }
+
+private:
+    std::map<int, Thread> m_threads;
+    int m_next_number = 1;
+};
+
+} // namespace smldbg
@@ -0,0 +1,626 @@
+#include "type_graph.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace smldbg::dwarf {
+
+namespace {
+
+// Call |callback| for each direct child of |die|.
+template <typename Callback> void for_each_child(DIE die, Callback callback) {
+    if (!die.has_children())
+        return;
+    int depth = 1;
+    for (++die; !die.is_null() && depth > 0; ++die) {
+        if (die.tag() == DW_TAG::DW_TAG_null) {
+            --depth;
+            continue;
+        }
+        if (depth == 1)
+            callback(die);
+        if (die.has_children())
+            ++depth;
+    }
+}
+
+// Return the byte offset of a data member. Older producers describe it with
+// an expression, normally just DW_OP_plus_uconst.
+// Section 5.7.6
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+uint64_t member_offset(Attribute attribute) {
+    if (attribute.form() != DW_FORM::DW_FORM_exprloc &&
+        attribute.form() != DW_FORM::DW_FORM_block1)
+        return attribute.as_uint64t();
+    std::span<char> block = attribute.as_block();
+    constexpr char DW_OP_plus_uconst = 0x23;
+    if (block.empty() || block[0] != DW_OP_plus_uconst)
+        return 0;
+    char* iter = block.data() + 1;
+    return util::decodeULEB128(iter);
+}
+
+// Read the |size| byte little endian integer at the start of |bytes|,
+// sign-extending it if |is_signed|.
+uint64_t read_integer(std::span<const char> bytes, uint64_t size,
+                      bool is_signed) {
+    uint64_t value = 0;
+    size = std::min<uint64_t>(size, sizeof(value));
+    std::memcpy(&value, bytes.data(), size);
+    if (is_signed && size > 0 && size < sizeof(value) &&
+        (value >> (size * 8 - 1) & 1))
+        value |= ~uint64_t(0) << (size * 8);
+    return value;
+}
+
+// Is |type| a one byte character type, whose arrays are shown as strings?
+bool is_character(const Type* type) {
+    type = type ? type->strip() : nullptr;
+    return type && type->kind == TypeKind::base && type->byte_size == 1 &&
+           (type->encoding == DW_ATE::DW_ATE_signed_char ||
+            type->encoding == DW_ATE::DW_ATE_unsigned_char);
+}
+
+// Append |c| to |out| as it would be written in a C character or string
+// literal delimited by |quote|.
+void append_escaped(std::string& out, char c, char quote) {
+    switch (c) {
+    case '\n':
+        out += "\\n";
+        return;
+    case '\t':
+        out += "\\t";
+        return;
+    case '\\':
+        out += "\\\\";
+        return;
+    }
+    if (c == quote) {
+        out += '\\';
+        out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20 ||
+               static_cast<unsigned char>(c) >= 0x7f) {
+        std::ostringstream escape;
+        escape << "\\" << std::oct << +static_cast<unsigned char>(c);
+        out += escape.str();
+    } else {
+        out += c;
+    }
+}
+
+// Append the value of |type| held in |bytes| to |out|, |depth| aggregates
+// deep.
+void format(std::string& out, const Type* type, std::span<const char> bytes,
+            const FormatLimits& limits, unsigned depth) {
+    type = type ? type->strip() : nullptr;
+    if (!type) {
+        out += "<unknown type>";
+        return;
+    }
+    const uint64_t size = type->size();
+    if (bytes.size() < size) {
+        out += "<unavailable>";
+        return;
+    }
+
+    switch (type->kind) {
+    case TypeKind::base: {
+        switch (type->encoding) {
+        case DW_ATE::DW_ATE_boolean:
+            out += read_integer(bytes, size, false) ? "true" : "false";
+            return;
+        case DW_ATE::DW_ATE_float: {
+            std::ostringstream value;
+            if (size == sizeof(float)) {
+                float f = 0;
+                std::memcpy(&f, bytes.data(), sizeof(f));
+                value << f;
+            } else if (size == sizeof(double)) {
+                double d = 0;
+                std::memcpy(&d, bytes.data(), sizeof(d));
+                value << d;
+            } else {
+                // x87 extended precision, padded to 16 bytes.
+                long double ld = 0;
+                std::memcpy(&ld, bytes.data(),
+                            std::min<uint64_t>(size, sizeof(ld)));
+                value << ld;
+            }
+            out += value.str();
+            return;
+        }
+        case DW_ATE::DW_ATE_signed:
+        case DW_ATE::DW_ATE_signed_char: {
+            const auto value =
+                static_cast<int64_t>(read_integer(bytes, size, true));
+            out += std::to_string(value);
+            if (is_character(type)) {
+                out += " '";
+                append_escaped(out, static_cast<char>(value), '\'');
+                out += "'";
+            }
+            return;
+        }
+        case DW_ATE::DW_ATE_unsigned:
+        case DW_ATE::DW_ATE_unsigned_char:
+        case DW_ATE::DW_ATE_UTF:
+        case DW_ATE::DW_ATE_address: {
+            const uint64_t value = read_integer(bytes, size, false);
+            out += std::to_string(value);
+            if (is_character(type)) {
+                out += " '";
+                append_escaped(out, static_cast<char>(value), '\'');
+                out += "'";
+            }
+            return;
+        }
+        default:
+            out += "<unsupported encoding>";
+            return;
+        }
+    }
+    case TypeKind::pointer:
+    case TypeKind::reference: {
+        std::ostringstream value;
+        value << (type->kind == TypeKind::reference ? "@" : "") << "0x"
+              << std::hex << read_integer(bytes, size, false);
+        out += value.str();
+        return;
+    }
+    case TypeKind::enumeration: {
+        const Type* underlying = type->target ? type->target->strip() : nullptr;
+        const bool is_signed =
+            !underlying || underlying->encoding == DW_ATE::DW_ATE_signed ||
+            underlying->encoding == DW_ATE::DW_ATE_signed_char;
+        const auto value =
+            static_cast<int64_t>(read_integer(bytes, size, is_signed));
+        const auto enumerator = std::find_if(
+            type->enumerators.begin(), type->enumerators.end(),
+            [&](const Type::Enumerator& e) { return e.value == value; });
+        if (enumerator != type->enumerators.end())
+            out += enumerator->name;
+        else
+            out += std::to_string(value);
+        return;
+    }
+    case TypeKind::structure:
+    case TypeKind::union_type: {
+        if (depth >= limits.max_depth) {
+            out += "{...}";
+            return;
+        }
+        out += "{";
+        for (bool first = true; const Type::Member& member : type->members) {
+            if (!first)
+                out += ", ";
+            first = false;
+            if (!member.name.empty()) {
+                out += member.name;
+                out += " = ";
+            }
+            if (member.offset > bytes.size()) {
+                out += "<unavailable>";
+                continue;
+            }
+            const std::span<const char> member_bytes =
+                bytes.subspan(member.offset);
+            if (member.bit_size == 0) {
+                format(out, member.type, member_bytes, limits, depth + 1);
+                continue;
+            }
+
+            // Bit fields are extracted into a value of their own.
+            const uint64_t last_bit = member.bit_offset + member.bit_size;
+            if (member.bit_size > 64 ||
+                (last_bit + 7) / 8 > member_bytes.size()) {
+                out += "<unavailable>";
+                continue;
+            }
+            uint64_t bits = 0;
+            for (uint64_t bit = 0; bit < member.bit_size; ++bit) {
+                const uint64_t from = member.bit_offset + bit;
+                if (member_bytes[from / 8] >> (from % 8) & 1)
+                    bits |= uint64_t(1) << bit;
+            }
+            const Type* field = member.type ? member.type->strip() : nullptr;
+            if (field && field->kind != TypeKind::enumeration &&
+                (field->encoding == DW_ATE::DW_ATE_signed ||
+                 field->encoding == DW_ATE::DW_ATE_signed_char) &&
+                member.bit_size < 64 && (bits >> (member.bit_size - 1) & 1))
+                bits |= ~uint64_t(0) << member.bit_size;
+            char value[sizeof(bits)];
+            std::memcpy(value, &bits, sizeof(bits));
+            format(out, member.type, value, limits, depth + 1);
+        }
+        out += "}";
+        return;
+    }
+    case TypeKind::array: {
+        if (type->dimensions.empty() || !type->target) {
+            out += "{}";
+            return;
+        }
+
+        // A multi-dimensional array is an array of arrays, formatted one
+        // dimension at a time.
+        Type element_type;
+        const Type* element = type->target;
+        if (type->dimensions.size() > 1) {
+            element_type = *type;
+            element_type.dimensions.erase(element_type.dimensions.begin());
+            element_type.byte_size = 0;
+            element = &element_type;
+        }
+        const uint64_t count = type->dimensions.front();
+        const uint64_t element_size = element->size();
+
+        // Strings are shown up to their terminator.
+        if (is_character(element)) {
+            const std::size_t length =
+                std::find(bytes.begin(), bytes.begin() + count, '\0') -
+                bytes.begin();
+            out += "\"";
+            for (std::size_t i = 0;
+                 i < std::min<uint64_t>(length, limits.max_elements); ++i)
+                append_escaped(out, bytes[i], '"');
+            out += "\"";
+            if (length > limits.max_elements)
+                out += "...";
+            return;
+        }
+
+        if (depth >= limits.max_depth) {
+            out += "{...}";
+            return;
+        }
+        out += "{";
+        for (uint64_t i = 0; i < count; ++i) {
+            if (i > 0)
+                out += ", ";
+            if (i == limits.max_elements) {
+                out += "...";
+                break;
+            }
+            format(out, element, bytes.subspan(i * element_size), limits,
+                   depth + 1);
+        }
+        out += "}";
+        return;
+    }
+    case TypeKind::const_type:
+    case TypeKind::volatile_type:
+    case TypeKind::typedef_type:
+    case TypeKind::unsupported:
+        break;
+    }
+    out += "<unsupported type>";
+}
+
+} // namespace
+
+uint64_t Type::size() const {
+    const Type* type = strip();
+    if (type->byte_size || type->kind != TypeKind::array)
+        return type->byte_size;
+    if (!type->target)
+        return 0;
+    uint64_t size = type->target->size();
+    for (const uint64_t count : type->dimensions)
+        size *= count;
+    return size;
+}
+
+const Type* Type::strip() const {
+    const Type* type = this;
+    while ((type->kind == TypeKind::const_type ||
+            type->kind == TypeKind::volatile_type ||
+            type->kind == TypeKind::typedef_type) &&
+           type->target)
+        type = type->target;
+    return type;
+}
+
+std::string Type::display_name() const {
+    switch (kind) {
+    case TypeKind::base:
+    case TypeKind::typedef_type:
+        if (!name.empty() || !target)
+            return std::string(name);
+        return target->display_name();
+    case TypeKind::structure:
+        return std::string(name.empty() ? "<anonymous struct>" : name);
+    case TypeKind::union_type:
+        return std::string(name.empty() ? "<anonymous union>" : name);
+    case TypeKind::enumeration:
+        return std::string(name.empty() ? "<anonymous enum>" : name);
+    case TypeKind::pointer:
+        return (target ? target->display_name() : "void") + " *";
+    case TypeKind::reference:
+        return (target ? target->display_name() : "void") + " &";
+    case TypeKind::const_type:
+        return "const " + (target ? target->display_name() : "void");
+    case TypeKind::volatile_type:
+        return "volatile " + (target ? target->display_name() : "void");
+    case TypeKind::array: {
+        std::string display = target ? target->display_name() : "void";
+        display += " ";
+        for (const uint64_t count : dimensions)
+            display += "[" + std::to_string(count) + "]";
+        return display;
+    }
+    case TypeKind::unsupported:
+        break;
+    }
+    return name.empty() ? "<unsupported type>" : std::string(name);
+}
+
+TypeGraph::TypeGraph(const CompileUnit* cu, char* debug_info)
+    : m_cu(cu), m_debug_info(debug_info) {}
+
+const Type* TypeGraph::type_of(DIE die) {
+    const std::optional<Attribute> type = die.attribute(DW_AT::DW_AT_type);
+    if (!type)
+        return nullptr;
+    return type_at(m_cu->reference(*type, m_debug_info));
+}
+
+const Type* TypeGraph::type_at(char* entry) {
+    const uint64_t offset = entry - m_debug_info;
+    if (const auto type = m_types.find(offset); type != m_types.end())
+        return type->second.get();
+
+    // The type is cached before it is decoded, so the types it refers to
+    // can refer back to it.
+    Type& type = *m_types.emplace(offset, std::make_unique<Type>())
+                      .first->second;
+    if (entry >= m_cu->debug_info_begin() && entry < m_cu->debug_info_end())
+        decode(m_cu->die_at(entry), type);
+    return &type;
+}
+
+void TypeGraph::decode(DIE die, Type& type) {
+    // Section 5
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    auto [name, byte_size, encoding] = die.attributes(std::array{
+        DW_AT::DW_AT_name, DW_AT::DW_AT_byte_size, DW_AT::DW_AT_encoding});
+    if (name)
+        type.name = name->as_string_view();
+    if (byte_size)
+        type.byte_size = byte_size->as_uint64t();
+
+    switch (die.tag()) {
+    case DW_TAG::DW_TAG_base_type:
+        type.kind = TypeKind::base;
+        if (encoding)
+            type.encoding = static_cast<DW_ATE>(encoding->as_uint64t());
+        return;
+    case DW_TAG::DW_TAG_pointer_type:
+    case DW_TAG::DW_TAG_reference_type:
+    case DW_TAG::DW_TAG_rvalue_reference_type:
+        type.kind = die.tag() == DW_TAG::DW_TAG_pointer_type
+                        ? TypeKind::pointer
+                        : TypeKind::reference;
+        if (!type.byte_size)
+            type.byte_size = m_cu->form_context().address_size;
+        type.target = type_of(die);
+        return;
+    case DW_TAG::DW_TAG_const_type:
+        type.kind = TypeKind::const_type;
+        type.target = type_of(die);
+        return;
+    case DW_TAG::DW_TAG_volatile_type:
+        type.kind = TypeKind::volatile_type;
+        type.target = type_of(die);
+        return;
+    case DW_TAG::DW_TAG_typedef:
+    case DW_TAG::DW_TAG_restrict_type:
+        // Restrict doesn't change how a value is shown, so it is treated
+        // as an unnamed typedef.
+        type.kind = TypeKind::typedef_type;
+        type.target = type_of(die);
+        return;
+    case DW_TAG::DW_TAG_enumeration_type:
+        type.kind = TypeKind::enumeration;
+        type.target = type_of(die);
+        for_each_child(die, [&](DIE& child) {
+            if (child.tag() != DW_TAG::DW_TAG_enumerator)
+                return;
+            auto [enumerator_name, value] = child.attributes(
+                std::array{DW_AT::DW_AT_name, DW_AT::DW_AT_const_value});
+            if (enumerator_name && value)
+                type.enumerators.push_back(
+                    {.name = enumerator_name->as_string_view(),
+                     .value = static_cast<int64_t>(value->as_uint64t())});
+        });
+        return;
+    case DW_TAG::DW_TAG_structure_type:
+    case DW_TAG::DW_TAG_class_type:
+    case DW_TAG::DW_TAG_union_type:
+        type.kind = die.tag() == DW_TAG::DW_TAG_union_type
+                        ? TypeKind::union_type
+                        : TypeKind::structure;
+        for_each_child(die, [&](DIE& child) {
+            // Base classes are shown like members, without a name.
+            if (child.tag() != DW_TAG::DW_TAG_member &&
+                child.tag() != DW_TAG::DW_TAG_inheritance)
+                return;
+            auto [member_name, location, bit_size, data_bit_offset,
+                        bit_offset, member_byte_size, declaration] =
+                child.attributes(std::array{
+                    DW_AT::DW_AT_name, DW_AT::DW_AT_data_member_location,
+                    DW_AT::DW_AT_bit_size, DW_AT::DW_AT_data_bit_offset,
+                    DW_AT::DW_AT_bit_offset, DW_AT::DW_AT_byte_size,
+                    DW_AT::DW_AT_declaration});
+            // Static members are declarations without storage in the object.
+            if (declaration)
+                return;
+            Type::Member member = {
+                .name = member_name ? member_name->as_string_view()
+                                    : std::string_view(),
+                .offset = location ? member_offset(*location) : 0,
+                .type = type_of(child),
+                .bit_offset = 0,
+                .bit_size = bit_size ? bit_size->as_uint64t() : 0};
+            if (member.bit_size && data_bit_offset) {
+                const uint64_t bits = data_bit_offset->as_uint64t();
+                member.offset = bits / 8;
+                member.bit_offset = bits % 8;
+            } else if (member.bit_size && bit_offset) {
+                // DWARF 2 to 4 count the bit offset from the most significant
+                // bit of the storage unit holding the field.
+                const uint64_t storage_bits =
+                    8 * (member_byte_size ? member_byte_size->as_uint64t()
+                         : member.type    ? member.type->size()
+                                          : 0);
+                member.bit_offset =
+                    storage_bits - bit_offset->as_uint64t() - member.bit_size;
+            }
+            type.members.push_back(member);
+        });
+        return;
+    case DW_TAG::DW_TAG_array_type:
+        type.kind = TypeKind::array;
+        type.target = type_of(die);
+        for_each_child(die, [&](DIE& child) {
+            if (child.tag() != DW_TAG::DW_TAG_subrange_type)
+                return;
+            auto [count, lower_bound, upper_bound] =
+                child.attributes(std::array{DW_AT::DW_AT_count,
+                                            DW_AT::DW_AT_lower_bound,
+                                            DW_AT::DW_AT_upper_bound});
+            // Arrays of unknown bound (e.g. flexible array members) and
+            // bounds given by an expression (variable length arrays) have no
+            // elements we can show.
+            uint64_t elements = 0;
+            if (count && count->form() != DW_FORM::DW_FORM_exprloc)
+                elements = count->as_uint64t();
+            else if (upper_bound &&
+                     upper_bound->form() != DW_FORM::DW_FORM_exprloc)
+                elements = upper_bound->as_uint64t() + 1 -
+                           (lower_bound ? lower_bound->as_uint64t() : 0);
+            type.dimensions.push_back(elements);
+        });
+        return;
+    default:
+        type.kind = TypeKind::unsupported;
+        return;
+    }
+}
+
+std::string format_value(const Type* type, std::span<const char> bytes,
+                         const FormatLimits& limits) {
+    std::string out;
+    format(out, type, bytes, limits, 0);
+    return out;
+}
+
+bool is_integer(const Type* type) {
+    type = type ? type->strip() : nullptr;
+    if (!type || type->size() == 0 || type->size() > sizeof(uint64_t))
+        return false;
+    switch (type->kind) {
+    case TypeKind::base:
+        return type->encoding != DW_ATE::DW_ATE_float &&
+               type->encoding != DW_ATE::DW_ATE_complex_float;
+    case TypeKind::enumeration:
+    case TypeKind::pointer:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::optional<int64_t> integer_value(const Type* type,
+                                     std::span<const char> bytes) {
+    if (!is_integer(type))
+        return std::nullopt;
+    type = type->strip();
+    if (bytes.size() < type->size())
+        return std::nullopt;
+    const Type* encoded = type->kind == TypeKind::enumeration && type->target
+                              ? type->target->strip()
+                              : type;
+    const bool is_signed =
+        encoded->kind == TypeKind::enumeration ||
+        (encoded->kind == TypeKind::base &&
+         (encoded->encoding == DW_ATE::DW_ATE_signed ||
+          encoded->encoding == DW_ATE::DW_ATE_signed_char));
+    return static_cast<int64_t>(read_integer(bytes, type->size(), is_signed));
+}
+
+std::optional<std::string> encode_value(const Type* type,
+                                        std::string_view text) {
+    type = type ? type->strip() : nullptr;
+    if (!type || type->size() == 0 || type->size() > sizeof(uint64_t))
+        return std::nullopt;
+    const std::string value_text(text);
+    std::string bytes(type->size(), '\0');
+
+    // Parse an integer in any base strtoll(3) understands, requiring it to
+    // take up the whole of |text|.
+    const auto parse_integer = [&]() -> std::optional<uint64_t> {
+        if (value_text.empty())
+            return std::nullopt;
+        char* end = nullptr;
+        errno = 0;
+        const char* text = value_text.c_str();
+        const uint64_t value =
+            value_text.front() == '-'
+                ? static_cast<uint64_t>(std::strtoll(text, &end, 0))
+                : std::strtoull(text, &end, 0);
+        if (errno || *end != '\0')
+            return std::nullopt;
+        return value;
+    };
+
+    std::optional<uint64_t> value;
+    switch (type->kind) {
+    case TypeKind::base:
+        if (type->encoding == DW_ATE::DW_ATE_float) {
+            char* end = nullptr;
+            const double d = std::strtod(value_text.c_str(), &end);
+            if (value_text.empty() || *end != '\0')
+                return std::nullopt;
+            if (bytes.size() == sizeof(float)) {
+                const float f = static_cast<float>(d);
+                std::memcpy(bytes.data(), &f, sizeof(f));
+            } else if (bytes.size() == sizeof(double)) {
+                std::memcpy(bytes.data(), &d, sizeof(d));
+            } else {
+                return std::nullopt;
+            }
+            return bytes;
+        }
+        if (type->encoding == DW_ATE::DW_ATE_boolean &&
+            (text == "true" || text == "false"))
+            value = text == "true";
+        else
+            value = parse_integer();
+        break;
+    case TypeKind::enumeration: {
+        const auto enumerator = std::find_if(
+            type->enumerators.begin(), type->enumerators.end(),
+            [&](const Type::Enumerator& e) { return e.name == text; });
+        value = enumerator != type->enumerators.end()
+                    ? std::optional<uint64_t>(enumerator->value)
+                    : parse_integer();
+        break;
+    }
+    case TypeKind::pointer:
+        value = parse_integer();
+        break;
+    default:
+        return std::nullopt;
+    }
+    if (!value)
+        return std::nullopt;
+    std::memcpy(bytes.data(), &*value, bytes.size());
+    return bytes;
+}
+
+} // namespace smldbg::dwarf
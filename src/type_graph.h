@@ -0,0 +1,174 @@
+#pragma once
+
+#include "compile_unit.h"
+#include "die.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace smldbg::dwarf {
+
+// Base type encodings.
+// Section 7.8
+// http://www.dwarfstd.org/doc/DWARF5.pdf
+enum class DW_ATE : uint8_t {
+    DW_ATE_address = 0x01,
+    DW_ATE_boolean = 0x02,
+    DW_ATE_complex_float = 0x03,
+    DW_ATE_float = 0x04,
+    DW_ATE_signed = 0x05,
+    DW_ATE_signed_char = 0x06,
+    DW_ATE_unsigned = 0x07,
+    DW_ATE_unsigned_char = 0x08,
+    DW_ATE_UTF = 0x10,
+};
+
+enum class TypeKind {
+    base,
+    pointer,
+    reference, // Lvalue or rvalue reference.
+    const_type,
+    volatile_type,
+    typedef_type,
+    structure, // Structure or class.
+    union_type,
+    array,
+    enumeration,
+    unsupported, // E.g. a function type, or a type in another compile unit.
+};
+
+// A type described by a DIE, with the types it refers to (e.g. the type a
+// pointer points to) linked directly.
+struct Type {
+    // A data member of a structure, class or union.
+    struct Member {
+        std::string_view name;
+        uint64_t offset;        // Byte offset of the member in the aggregate.
+        const Type* type;       // Null if the type is unknown.
+        uint64_t bit_offset;    // For bit fields, the offset of the first bit
+                                // from |offset|.
+        uint64_t bit_size;      // For bit fields, the size in bits, otherwise
+                                // zero.
+    };
+
+    struct Enumerator {
+        std::string_view name;
+        int64_t value;
+    };
+
+    TypeKind kind = TypeKind::unsupported;
+    std::string_view name; // DW_AT_name, empty for unnamed types.
+    uint64_t byte_size = 0; // DW_AT_byte_size, zero if not given.
+    DW_ATE encoding = {};   // For base types.
+    const Type* target = nullptr; // The type pointed to, referred to,
+                                  // qualified, named by a typedef, held by an
+                                  // array or underlying an enumeration. Null
+                                  // for void.
+    std::vector<Member> members;         // For structures and unions.
+    std::vector<uint64_t> dimensions;    // For arrays, the element count of
+                                         // each dimension, outermost first.
+    std::vector<Enumerator> enumerators; // For enumerations.
+
+    // Return the size of a value of the type in bytes, looking through
+    // typedefs and qualifiers and multiplying out array dimensions.
+    uint64_t size() const;
+
+    // Return the type with typedefs and qualifiers removed.
+    const Type* strip() const;
+
+    // Return the name of the type as it would be written in C, e.g.
+    // "const char *" or "int [4]".
+    std::string display_name() const;
+};
+
+// The types of a compile unit, decoded as they are requested and cached by
+// the .debug_info offset of their DIE. Types refer to each other by pointer,
+// which stay valid for the lifetime of the graph, so recursive types (e.g. a
+// list node pointing to the next node) are decoded once.
+class TypeGraph {
+public:
+    // Construct an empty type graph for |cu|.
+    //
+    // Preconditions: |cu| should outlive the graph. |debug_info| should point
+    // to the start of the .debug_info section of the corresponding ELF file.
+    //
+    // Postconditions: None.
+    TypeGraph(const CompileUnit* cu, char* debug_info);
+
+    // Return the type of |die|, its DW_AT_type, or nullptr if it has none
+    // (e.g. a pointer to void).
+    //
+    // Preconditions: |die| should belong to the graph's compile unit.
+    //
+    // Postconditions: None.
+    const Type* type_of(DIE die);
+
+    // Return the type described by the entry starting at |entry|. References
+    // outside of the compile unit decode to TypeKind::unsupported.
+    const Type* type_at(char* entry);
+
+private:
+    // Fill in |type| from |die|.
+    void decode(DIE die, Type& type);
+
+    const CompileUnit* m_cu;
+    char* m_debug_info; // The start of the .debug_info section.
+
+    std::unordered_map<uint64_t, std::unique_ptr<Type>>
+        m_types; // Decoded types, keyed by the .debug_info offset of their
+                 // DIE.
+};
+
+// Limits on how much of an aggregate is formatted.
+struct FormatLimits {
+    unsigned max_depth = 3;       // Aggregates nested deeper are shown as
+                                  // "{...}".
+    uint64_t max_elements = 200;  // Array elements after these are shown as
+                                  // "...".
+};
+
+// Format the value of |type| held in |bytes| as C-like text, e.g.
+// "{x = 1, y = 2}" for a structure. Pointers and references are formatted as
+// the address they hold, they aren't followed.
+//
+// Preconditions: None. Members or elements that lie past the end of |bytes|
+// are shown as "<unavailable>".
+//
+// Postconditions: None.
+std::string format_value(const Type* type, std::span<const char> bytes,
+                         const FormatLimits& limits = {});
+
+// Is |type| an integer type, i.e. a base type other than a floating point
+// one, an enumeration or a pointer (possibly named by a typedef or
+// qualified)?
+bool is_integer(const Type* type);
+
+// Return the value of |type|, an integer type, held in |bytes|. Values are
+// sign-extended or zero-extended to 64 bits according to the encoding of the
+// type.
+//
+// Preconditions: None.
+//
+// Postconditions: Returns std::nullopt if |type| isn't an integer type or
+// |bytes| is shorter than it.
+std::optional<int64_t> integer_value(const Type* type,
+                                     std::span<const char> bytes);
+
+// Encode |text| as a value of |type|, a base, enumeration or pointer type
+// (possibly named by a typedef or qualified). Integers may be given in
+// decimal, octal or hexadecimal, enumerations by enumerator name.
+//
+// Preconditions: None.
+//
+// Postconditions: Returns |type|->size() bytes, or std::nullopt if |text|
+// can't be encoded as a value of |type|.
+std::optional<std::string> encode_value(const Type* type,
+                                        std::string_view text);
+
+} // namespace smldbg::dwarf
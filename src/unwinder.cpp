@@ -0,0 +1,343 @@
+#include "unwinder.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smldbg {
+
+namespace {
+
+// How much of the stack is read up front, enough for the frames of most
+// backtraces.
+constexpr uint64_t stack_prefetch_size = 64 * 1024;
+
+// Whether |path| names a regular file that starts like an ELF file, which
+// elf::ELF needs before it's handed the file.
+bool is_elf_file(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat file_stat = {};
+    char magic[4] = {};
+    const bool is_elf = fstat(fd, &file_stat) == 0 &&
+                        S_ISREG(file_stat.st_mode) &&
+                        read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+                        std::equal(magic, magic + 4, "\x7f" "ELF");
+    close(fd);
+    return is_elf;
+}
+
+} // namespace
+
+Unwinder::Registers
+Unwinder::frame_registers(const user_regs_struct& registers) {
+    Registers frame_registers;
+    for (unsigned reg = 0; reg < dwarf::cfi_registers; ++reg)
+        frame_registers[reg] = registers.*register_fields[reg];
+    return frame_registers;
+}
+
+std::vector<StackFrame> Unwinder::unwind(const user_regs_struct& registers,
+                                         std::size_t max_frames) {
+    m_mappings_current = false;
+    Registers frame_registers = Unwinder::frame_registers(registers);
+
+    // Read the top of the stack, where the saved registers of the innermost
+    // frames are, in a single system call.
+    m_memory->prefetch(registers.rsp, stack_prefetch_size);
+
+    std::vector<StackFrame> frames;
+    uint64_t pc = registers.rip;
+    bool is_caller = false;
+    while (frames.size() < max_frames) {
+        StackFrame& frame = frames.emplace_back(StackFrame{
+            .pc = pc, .sp = *frame_registers[dwarf::cfi_rsp], .cfa = 0});
+        bool caller_is_caller = true;
+        if (!step(frame_registers, pc, is_caller, frame.cfa, caller_is_caller))
+            break;
+
+        // Stacks grow down, so a caller whose stack pointer isn't above its
+        // callee's means the unwind has gone wrong.
+        const auto caller_pc = frame_registers[dwarf::cfi_return_address];
+        const auto caller_sp = frame_registers[dwarf::cfi_rsp];
+        if (!caller_pc || *caller_pc == 0 || !caller_sp ||
+            *caller_sp <= frame.sp)
+            break;
+        pc = *caller_pc;
+        is_caller = caller_is_caller;
+    }
+    return frames;
+}
+
+std::optional<uint64_t> Unwinder::cfa(const Registers& registers,
+                                      bool is_caller) {
+    m_mappings_current = false;
+    const auto pc = registers[dwarf::cfi_return_address];
+    if (!pc)
+        return std::nullopt;
+    if (const auto row = row_at(*pc, is_caller); row)
+        return row_cfa(*row, registers);
+
+    // As in step(), without call frame information the frame pointer is
+    // assumed to be in use.
+    const auto frame_pointer = registers[dwarf::cfi_rbp];
+    if (!frame_pointer || *frame_pointer == 0)
+        return std::nullopt;
+    return *frame_pointer + 16;
+}
+
+std::optional<Unwinder::Registers>
+Unwinder::caller(const Registers& registers, bool is_caller) {
+    m_mappings_current = false;
+    const auto pc = registers[dwarf::cfi_return_address];
+    if (!pc)
+        return std::nullopt;
+    Registers caller = registers;
+    uint64_t cfa = 0;
+    bool caller_is_caller = true;
+    if (!step(caller, *pc, is_caller, cfa, caller_is_caller))
+        return std::nullopt;
+    return caller;
+}
+
+std::optional<std::string> Unwinder::object_at(uint64_t address) {
+    const Mapping* mapping = mapping_at(address);
+    if (!mapping)
+        return std::nullopt;
+    return mapping->path;
+}
+
+Unwinder::Mapping* Unwinder::mapping_at(uint64_t address) {
+    const auto find = [&]() -> Mapping* {
+        const auto after = std::upper_bound(
+            m_mappings.begin(), m_mappings.end(), address,
+            [](uint64_t address, const Mapping& mapping) {
+                return address < mapping.start;
+            });
+        if (after == m_mappings.begin() || address >= std::prev(after)->end)
+            return nullptr;
+        return &*std::prev(after);
+    };
+
+    Mapping* mapping = find();
+    if (!mapping && !m_mappings_current) {
+        read_mappings();
+        mapping = find();
+    }
+    if (!mapping || mapping->loaded)
+        return mapping;
+
+    // The bias is the difference between where the segment containing the
+    // mapping's file offset was mapped and its link-time address.
+    mapping->loaded = true;
+    mapping->object = load_object(*mapping);
+    if (mapping->object) {
+        for (const auto& header : mapping->object->elf.program_headers()) {
+            if (header.P_TYPE == elf::PT_LOAD &&
+                (header.P_OFFSET & ~uint64_t(0xfff)) == mapping->offset) {
+                mapping->bias =
+                    mapping->start - (header.P_VADDR & ~uint64_t(0xfff));
+                break;
+            }
+        }
+    }
+    return mapping;
+}
+
+void Unwinder::read_mappings() {
+    m_mappings_current = true;
+
+    // Each line of the maps file is of the form
+    // 'start-end permissions offset device inode path'.
+    // https://man7.org/linux/man-pages/man5/proc.5.html
+    std::vector<Mapping> mappings;
+    std::ifstream maps("/proc/" + std::to_string(m_pid) + "/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        const std::vector<std::string> fields = util::tokenize(line, ' ');
+        if (fields.size() < 6 || fields[1].size() < 3 || fields[1][2] != 'x')
+            continue;
+        const std::string& path = fields.back();
+        if (!path.starts_with('/') && path != "[vdso]")
+            continue;
+        const auto dash = fields[0].find('-');
+        if (dash == std::string::npos)
+            continue;
+        mappings.push_back(
+            {.start = std::stoull(fields[0].substr(0, dash), nullptr, 16),
+             .end = std::stoull(fields[0].substr(dash + 1), nullptr, 16),
+             .offset = std::stoull(fields[2], nullptr, 16),
+             .path = path});
+    }
+
+    // Keep what was loaded for mappings that haven't changed.
+    for (Mapping& mapping : mappings) {
+        for (const Mapping& known : m_mappings) {
+            if (known.start == mapping.start && known.path == mapping.path) {
+                mapping = known;
+                break;
+            }
+        }
+    }
+    std::sort(mappings.begin(), mappings.end(),
+              [](const Mapping& a, const Mapping& b) {
+                  return a.start < b.start;
+              });
+    m_mappings = std::move(mappings);
+}
+
+Unwinder::Object* Unwinder::load_object(const Mapping& mapping) {
+    if (const auto found = m_objects.find(mapping.path);
+        found != m_objects.end())
+        return found->second.get();
+
+    // The vDSO has no file, but is mapped whole, section headers and all.
+    std::optional<elf::ELF> elf;
+    if (mapping.path == "[vdso]") {
+        std::string image(mapping.end - mapping.start, '\0');
+        if (m_memory->read(mapping.start, image) && image.starts_with("\x7f"
+                                                                      "ELF"))
+            elf.emplace(std::make_unique<std::istringstream>(image));
+    } else if (is_elf_file(mapping.path)) {
+        elf.emplace(mapping.path);
+    }
+
+    std::unique_ptr<Object>& object = m_objects[mapping.path];
+    if (elf) {
+        object = std::make_unique<Object>();
+        object->elf = std::move(*elf);
+        object->call_frame_info = dwarf::CallFrameInfo(object->elf);
+    }
+    return object.get();
+}
+
+bool Unwinder::step(Registers& registers, uint64_t pc, bool is_caller,
+                    uint64_t& cfa, bool& caller_is_caller) {
+    const std::optional<dwarf::CallFrameRow> row = row_at(pc, is_caller);
+
+    // Without call frame information, assume the frame pointer is in use:
+    // rbp points at the caller's rbp, just below the return address.
+    if (!row) {
+        const auto frame_pointer = registers[dwarf::cfi_rbp];
+        if (!frame_pointer || *frame_pointer == 0)
+            return false;
+        const auto caller_rbp = m_memory->read_value<uint64_t>(*frame_pointer);
+        const auto return_address =
+            m_memory->read_value<uint64_t>(*frame_pointer + 8);
+        if (!caller_rbp || !return_address)
+            return false;
+        registers[dwarf::cfi_rbp] = *caller_rbp;
+        registers[dwarf::cfi_rsp] = *frame_pointer + 16;
+        registers[dwarf::cfi_return_address] = *return_address;
+        caller_is_caller = true;
+        return true;
+    }
+
+    const std::optional<uint64_t> row_cfa = this->row_cfa(*row, registers);
+    if (!row_cfa)
+        return false;
+    cfa = *row_cfa;
+
+    // The rules are all in terms of the callee's registers, so work on a copy.
+    // The caller's stack pointer is the CFA, unless a rule says otherwise.
+    Registers caller = registers;
+    caller[dwarf::cfi_rsp] = cfa;
+    for (unsigned reg = 0; reg < dwarf::cfi_registers; ++reg) {
+        const dwarf::RegisterRule& rule = row->registers[reg];
+        switch (rule.kind) {
+        case dwarf::RegisterRule::Kind::undefined:
+            caller[reg].reset();
+            break;
+        case dwarf::RegisterRule::Kind::same_value:
+            break;
+        case dwarf::RegisterRule::Kind::offset:
+            caller[reg] = m_memory->read_value<uint64_t>(cfa + rule.value);
+            break;
+        case dwarf::RegisterRule::Kind::val_offset:
+            caller[reg] = cfa + rule.value;
+            break;
+        case dwarf::RegisterRule::Kind::reg:
+            caller[reg].reset();
+            if (rule.value >= 0 &&
+                static_cast<uint64_t>(rule.value) < dwarf::cfi_registers)
+                caller[reg] = registers[rule.value];
+            break;
+        case dwarf::RegisterRule::Kind::expression:
+            caller[reg].reset();
+            if (const auto address =
+                    evaluate(rule.expression, registers, cfa))
+                caller[reg] = m_memory->read_value<uint64_t>(*address);
+            break;
+        case dwarf::RegisterRule::Kind::val_expression:
+            caller[reg] = evaluate(rule.expression, registers, cfa);
+            break;
+        }
+    }
+
+    // An undefined return address marks the outermost frame, e.g. _start.
+    if (row->return_address_register >= dwarf::cfi_registers ||
+        row->registers[row->return_address_register].kind ==
+            dwarf::RegisterRule::Kind::undefined)
+        return false;
+    caller[dwarf::cfi_return_address] = caller[row->return_address_register];
+    caller_is_caller = !row->signal_frame;
+    registers = caller;
+    return true;
+}
+
+std::optional<dwarf::CallFrameRow> Unwinder::row_at(uint64_t pc,
+                                                    bool is_caller) {
+    // A return address is just past the call, which may be the last
+    // instruction of the function, so look up the call instead.
+    const uint64_t lookup = is_caller ? pc - 1 : pc;
+    const Mapping* mapping = mapping_at(lookup);
+    if (!mapping || !mapping->object)
+        return std::nullopt;
+    return mapping->object->call_frame_info.row_at(lookup - mapping->bias);
+}
+
+std::optional<uint64_t> Unwinder::row_cfa(const dwarf::CallFrameRow& row,
+                                          const Registers& registers) {
+    // Section 6.4.1
+    // http://www.dwarfstd.org/doc/DWARF4.pdf
+    if (!row.cfa_expression.empty())
+        return evaluate(row.cfa_expression, registers, {});
+    if (row.cfa_register >= dwarf::cfi_registers ||
+        !registers[row.cfa_register])
+        return std::nullopt;
+    return *registers[row.cfa_register] + row.cfa_offset;
+}
+
+std::optional<uint64_t> Unwinder::evaluate(std::span<char> expression,
+                                           const Registers& registers,
+                                           std::optional<uint64_t> cfa) {
+    const std::optional<dwarf::DwarfExpression> compiled =
+        dwarf::DwarfExpression::compile(expression);
+    if (!compiled)
+        return std::nullopt;
+    dwarf::DwarfExpression::Context context;
+    context.read_register = [&](uint64_t reg) -> std::optional<uint64_t> {
+        if (reg >= dwarf::cfi_registers)
+            return std::nullopt;
+        return registers[reg];
+    };
+    context.read_memory = [&](uint64_t address, std::span<char> bytes) {
+        return m_memory->read(address, bytes);
+    };
+
+    // Rules compute an address or a value, not a location.
+    const std::optional<dwarf::DwarfLocation> location =
+        compiled->evaluate(context, cfa);
+    if (!location || location->kind != dwarf::DwarfLocationKind::memory)
+        return std::nullopt;
+    return location->value;
+}
+
+} // namespace smldbg
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "call_frame_info.h"
+#include "dwarf_expression.h"
+#include "elf.h"
+#include "memory.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/user.h>
+
+namespace smldbg {
+
+// A frame of a thread's stack, innermost first.
+struct StackFrame {
+    uint64_t pc;  // Where the frame is executing, a return address in callers.
+    uint64_t sp;  // The stack pointer in the frame.
+    uint64_t cfa; // The stack pointer before the call that made the frame, or
+                  // zero where there was no call frame information.
+};
+
+// Unwinds the stacks of a stopped target with the call frame information of
+// each object it has mapped: the executable and shared libraries are read
+// from disk as needed, and the vDSO from the target. Frames without frame
+// pointers, e.g. in -O2 builds and libc, unwind correctly. Where an object
+// has no call frame information the rbp chain is followed instead. Decoded
+// rows are cached per program counter, and the stack is read in bulk, so
+// repeated backtraces of the same code cost little more than a single read
+// of the target's memory.
+class Unwinder {
+public:
+    // The registers of a frame, indexed by DWARF register number, unset where
+    // they can't be recovered. The return address register is the frame's pc.
+    using Registers =
+        std::array<std::optional<uint64_t>, dwarf::cfi_registers>;
+
+    // The field of user_regs_struct holding each DWARF register.
+    // Section 3.38
+    // https://software.intel.com/sites/default/files/article/402129/mpx-linux64-abi.pdf
+    static constexpr std::array<unsigned long long user_regs_struct::*,
+                                dwarf::cfi_registers>
+        register_fields = {
+            &user_regs_struct::rax, &user_regs_struct::rdx,
+            &user_regs_struct::rcx, &user_regs_struct::rbx,
+            &user_regs_struct::rsi, &user_regs_struct::rdi,
+            &user_regs_struct::rbp, &user_regs_struct::rsp,
+            &user_regs_struct::r8,  &user_regs_struct::r9,
+            &user_regs_struct::r10, &user_regs_struct::r11,
+            &user_regs_struct::r12, &user_regs_struct::r13,
+            &user_regs_struct::r14, &user_regs_struct::r15,
+            &user_regs_struct::rip};
+
+    Unwinder() = default;
+    Unwinder(int pid, Memory* memory) : m_pid(pid), m_memory(memory) {}
+
+    // Return the registers of the innermost frame of a thread stopped with
+    // |registers|.
+    static Registers frame_registers(const user_regs_struct& registers);
+
+    // Unwind the stack of a thread stopped with |registers|, returning up to
+    // |max_frames| frames.
+    std::vector<StackFrame> unwind(const user_regs_struct& registers,
+                                   std::size_t max_frames = 256);
+
+    // Return the CFA of the frame with |registers|. |is_caller| says whether
+    // the frame's pc is a return address, i.e. it isn't the innermost frame.
+    std::optional<uint64_t> cfa(const Registers& registers,
+                                bool is_caller = false);
+
+    // Return the registers of the caller of the frame with |registers|, or
+    // std::nullopt at the outermost frame. Registers the callee may have
+    // clobbered are only correct where the call frame information says how
+    // they were saved.
+    std::optional<Registers> caller(const Registers& registers,
+                                    bool is_caller = false);
+
+    // Return the path of the object mapped at |address|, if any.
+    std::optional<std::string> object_at(uint64_t address);
+
+private:
+    // The call frame information of an object file, which points into
+    // |elf|.
+    struct Object {
+        elf::ELF elf;
+        dwarf::CallFrameInfo call_frame_info;
+    };
+
+    // An object mapped executable into the target.
+    struct Mapping {
+        uint64_t start;
+        uint64_t end;
+        uint64_t offset; // Offset of |start| in the file.
+        std::string path;
+        bool loaded = false;      // Whether |object| and |bias| are set yet.
+        Object* object = nullptr; // Null if the file couldn't be read.
+        uint64_t bias = 0;        // Target address minus link-time address.
+    };
+
+    // Find the mapping containing |address|, loading its object on first
+    // use. /proc/<pid>/maps is read again, once per unwind, if |address|
+    // isn't among the mappings read so far.
+    Mapping* mapping_at(uint64_t address);
+
+    // Read the executable mappings of the target.
+    void read_mappings();
+
+    // Return the object mapped by |mapping|, loading it on first use.
+    // Returns nullptr if it isn't a readable ELF file.
+    Object* load_object(const Mapping& mapping);
+
+    // Replace |registers|, those of the frame at |pc|, with those of its
+    // caller. |is_caller| says whether |pc| is a return address, which is
+    // looked up one byte back to land in the call. Sets |cfa| to the frame's
+    // CFA and |caller_is_caller| to whether the caller's pc is a return
+    // address, which it isn't for the code a signal interrupted. Returns false
+    // at the outermost frame, or if the caller's registers can't be
+    // recovered.
+    bool step(Registers& registers, uint64_t pc, bool is_caller,
+              uint64_t& cfa, bool& caller_is_caller);
+
+    // Return the call frame row of the frame at |pc|, as in step().
+    std::optional<dwarf::CallFrameRow> row_at(uint64_t pc, bool is_caller);
+
+    // Return the CFA |row| gives the frame with |registers|.
+    std::optional<uint64_t> row_cfa(const dwarf::CallFrameRow& row,
+                                    const Registers& registers);
+
+    // Evaluate the DWARF expression |expression| of a CFI rule, with |cfa|
+    // pushed first if it's set, returning the value it computes.
+    std::optional<uint64_t> evaluate(std::span<char> expression,
+                                     const Registers& registers,
+                                     std::optional<uint64_t> cfa);
+
+    int m_pid = 0;
+    Memory* m_memory = nullptr;
+    std::vector<Mapping> m_mappings; // Sorted by |start|.
+    bool m_mappings_current = false; // Read during the current unwind.
+    std::unordered_map<std::string, std::unique_ptr<Object>> m_objects;
+};
+
+} // namespace smldbg
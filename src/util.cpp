@@ -1,5 +1,7 @@
 #include "util.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -13,7 +15,8 @@ uint64_t decodeULEB128(char*& iter) {
     uint8_t shift = 0;
     while (true) {
         uint8_t byte = *iter++;
-        result |= ((byte & 0b01111111) << shift);
+        if (shift < 64)
+            result |= uint64_t(byte & 0b01111111) << shift;
         if ((byte >> 7) == 0)
             break;
         shift += 7;
@@ -29,7 +32,8 @@ int64_t decodeLEB128(char*& iter) {
     const uint8_t size = 64;
     uint8_t byte = *iter++;
     while (true) {
-        result |= ((byte & 0b01111111) << shift);
+        if (shift < size)
+            result |= int64_t(byte & 0b01111111) << shift;
         shift += 7;
         if ((byte & 0b10000000) == 0)
             break;
@@ -56,4 +60,74 @@ std::vector<std::string> tokenize(const std::string& input, char delimiter) {
     return tokens;
 }
 
+bool is_line_location(std::string_view location) {
+    const auto colon = location.rfind(':');
+    if (colon == std::string_view::npos || colon == 0 ||
+        colon + 1 == location.size() || location[colon - 1] == ':')
+        return false;
+    const std::string_view line = location.substr(colon + 1);
+    return std::all_of(line.begin(), line.end(),
+                       [](char c) { return c >= '0' && c <= '9'; });
+}
+
+std::string_view unqualified_name(std::string_view name) {
+    std::size_t start = 0;
+    int depth = 0;
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        const char c = name[i];
+        if (c == '<' || c == '(')
+            ++depth;
+        else if ((c == '>' || c == ')') && depth > 0)
+            --depth;
+        else if (c == ':' && depth == 0 && i + 1 < name.size() &&
+                 name[i + 1] == ':')
+            start = ++i + 1;
+    }
+    return name.substr(start);
+}
+
+std::optional<std::chrono::nanoseconds> parse_duration(std::string_view text) {
+    uint64_t count = 0;
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), count);
+    if (error != std::errc() || end == text.data())
+        return std::nullopt;
+
+    const std::string_view unit(end, text.data() + text.size() - end);
+    if (unit.empty() || unit == "s")
+        return std::chrono::seconds(count);
+    if (unit == "ms")
+        return std::chrono::milliseconds(count);
+    if (unit == "us")
+        return std::chrono::microseconds(count);
+    if (unit == "m")
+        return std::chrono::minutes(count);
+    if (unit == "h")
+        return std::chrono::hours(count);
+    return std::nullopt;
+}
+
+uint64_t hash(std::string_view bytes, uint64_t seed) {
+    // Mix in eight bytes at a time, then the tail, with the multiplier and
+    // finalizer of MurmurHash64A.
+    constexpr uint64_t multiplier = 0xc6a4a7935bd1e995;
+    const auto mix = [&](uint64_t value) {
+        seed = (seed ^ value) * multiplier;
+        seed ^= seed >> 47;
+    };
+    std::size_t i = 0;
+    for (const std::size_t e = bytes.size() & ~std::size_t(7); i < e; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, sizeof(word));
+        mix(word * multiplier);
+    }
+    uint64_t tail = 0;
+    if (i < bytes.size())
+        std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+    mix(tail);
+    mix(bytes.size());
+    seed *= multiplier;
+    return seed ^ (seed >> 47);
+}
+
 } // namespace smldbg::util
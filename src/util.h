@@ -1,7 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <cstring>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace smldbg::util {
@@ -31,4 +34,21 @@ int64_t decodeLEB128(char*& iter);
 // Split |input| by delimiter and return the resulting collection of tokens.
 std::vector<std::string> tokenize(const std::string& input, char delimiter);
 
+// Is |location| of the form 'file:line'? Qualified names such as
+// 'ns::function' are not.
+bool is_line_location(std::string_view location);
+
+// Return the last component of the qualified name |name|, e.g. "bar" for
+// "ns::Foo<int>::bar". Separators inside template arguments and parameter
+// lists are skipped.
+std::string_view unqualified_name(std::string_view name);
+
+// Parse a duration such as "30s", "500ms", "2m" or "1h". A number without
+// a unit is in seconds.
+std::optional<std::chrono::nanoseconds> parse_duration(std::string_view text);
+
+// Return a 64 bit hash of |bytes|, continuing from |seed|, the hash of the
+// bytes before them. This is fast rather than cryptographically strong.
+uint64_t hash(std::string_view bytes, uint64_t seed = 0);
+
 } // namespace smldbg::util
@@ -0,0 +1,41 @@
+#include "work_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace smldbg {
+
+WorkQueue::WorkQueue(unsigned threads) : m_threads(threads) {
+    if (m_threads == 0)
+        m_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void WorkQueue::run(std::size_t count,
+                    const std::function<void(std::size_t)>& task) {
+    // Don't bother spinning up threads for a single worker.
+    const std::size_t workers = std::min<std::size_t>(m_threads, count);
+    if (workers <= 1) {
+        for (std::size_t i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next = 0;
+    const auto worker = [&]() {
+        for (std::size_t i = next++; i < count; i = next++)
+            task(i);
+    };
+
+    // The calling thread is one of the workers.
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (std::size_t i = 1; i < workers; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+}
+
+} // namespace smldbg
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace smldbg {
+
+// Runs a batch of independent tasks across a fixed number of threads. Each
+// thread repeatedly claims the next unclaimed task index from a shared atomic
+// counter, so threads that finish cheap tasks early pick up the remaining
+// work instead of idling behind a static partition.
+class WorkQueue {
+public:
+    // Construct a queue that runs tasks on |threads| threads. A value of zero
+    // uses one thread per hardware thread.
+    WorkQueue(unsigned threads = 0);
+
+    // Call |task| once for each index in [0, |count|) and wait for every call
+    // to return. Calls are made concurrently and in no particular order.
+    //
+    // Preconditions: |task| must be safe to call concurrently with different
+    // indices.
+    //
+    // Postconditions: Every task has completed.
+    void run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    // Return the number of threads used to run tasks.
+    unsigned threads() const { return m_threads; }
+
+private:
+    unsigned m_threads; // Number of threads used by run(...).
+};
+
+} // namespace smldbg
@@ -0,0 +1,424 @@
+#include "x86_decoder.h"
+
+#include <array>
+#include <cstring>
+
+namespace smldbg::x86 {
+
+namespace {
+
+// Opcode maps.
+// Section 2.1.2 and Appendix A
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+enum class Map { one_byte, two_byte, three_byte_38, three_byte_3a };
+
+// Classes of the bytes that can precede the opcode.
+// Section 2.1.1 and 2.2.1
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+enum PrefixClass : uint8_t {
+    not_prefix = 0,
+    legacy = 1 << 0,       // Segment overrides, LOCK, REP and REPNE.
+    operand_size = 1 << 1, // 66, also a legacy prefix.
+    address_size = 1 << 2, // 67, also a legacy prefix.
+    rex = 1 << 3,          // 40 to 4F.
+};
+
+constexpr std::array<uint8_t, 256> make_prefix_table() {
+    std::array<uint8_t, 256> table = {};
+    for (const uint8_t prefix :
+         {0x26, 0x2E, 0x36, 0x3E, 0x64, 0x65, 0xF0, 0xF2, 0xF3})
+        table[prefix] = legacy;
+    table[0x66] = legacy | operand_size;
+    table[0x67] = legacy | address_size;
+    for (std::size_t prefix = 0x40; prefix <= 0x4F; ++prefix)
+        table[prefix] = rex;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> prefix_table = make_prefix_table();
+
+// The size of an opcode's immediate operand, or branch displacement.
+// Appendix A.2.2
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+enum class Immediate : uint8_t {
+    none,
+    byte,        // Ib, Jb.
+    word,        // Iw.
+    word_byte,   // Iw, Ib (ENTER).
+    dword,       // Jz in 64-bit mode, which ignores the operand size.
+    z,           // Iz: 16 bits with an operand size prefix, 32 otherwise.
+    v,           // Iv: as Iz, or 64 bits with REX.W (MOV r64, imm64).
+    offset,      // Ob, Ov: 32 bits with an address size prefix, 64 otherwise.
+    group3_byte, // Ib, for the TEST forms (/0 and /1) of group 3 only.
+    group3_z,    // Iz, for the TEST forms (/0 and /1) of group 3 only.
+};
+
+// Everything about an opcode that is needed to find the length of the
+// instruction and its effect on control flow.
+struct Opcode {
+    bool valid = true;
+    bool modrm = false;
+    bool relative = false; // Is the immediate a branch displacement?
+    bool group5 = false;   // Control flow depends on the ModRM reg field.
+    Immediate immediate = Immediate::none;
+    ControlFlow control_flow = ControlFlow::none;
+};
+
+using OpcodeTable = std::array<Opcode, 256>;
+
+constexpr Opcode invalid = {.valid = false};
+constexpr Opcode modrm = {.modrm = true};
+constexpr Opcode modrm_byte = {.modrm = true, .immediate = Immediate::byte};
+constexpr Opcode modrm_z = {.modrm = true, .immediate = Immediate::z};
+constexpr Opcode byte = {.immediate = Immediate::byte};
+
+constexpr Opcode branch(Immediate immediate, ControlFlow control_flow) {
+    return {.relative = true,
+            .immediate = immediate,
+            .control_flow = control_flow};
+}
+
+constexpr void fill(OpcodeTable& table, std::size_t first, std::size_t last,
+                    Opcode opcode) {
+    for (std::size_t i = first; i <= last; ++i)
+        table[i] = opcode;
+}
+
+// The one byte opcode map. Prefixes and escapes (0F, VEX and EVEX) are
+// consumed before the table is consulted.
+// Table A-2
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+constexpr OpcodeTable make_one_byte_table() {
+    // The remaining opcodes (PUSH/POP r64, XCHG, string operations, flag
+    // manipulation, ...) are a single byte.
+    OpcodeTable table = {};
+
+    // The arithmetic rows: op r/m,r / op r,r/m / op al,imm8 / op eAX,imm. The
+    // last two columns are segment pushes/pops and BCD adjustment, which are
+    // invalid in 64-bit mode.
+    for (std::size_t row = 0x00; row < 0x40; row += 8) {
+        fill(table, row, row + 3, modrm);
+        table[row + 4] = byte;
+        table[row + 5] = {.immediate = Immediate::z};
+        fill(table, row + 6, row + 7, invalid);
+    }
+
+    fill(table, 0x60, 0x62, invalid); // PUSHA, POPA, BOUND (EVEX).
+    table[0x63] = modrm;
+    table[0x68] = {.immediate = Immediate::z};
+    table[0x69] = modrm_z;
+    table[0x6A] = byte;
+    table[0x6B] = modrm_byte;
+    fill(table, 0x70, 0x7F,
+         branch(Immediate::byte, ControlFlow::conditional_jump));
+
+    fill(table, 0x80, 0x8F, modrm);
+    table[0x80] = modrm_byte;
+    table[0x81] = modrm_z;
+    table[0x82] = invalid;
+    table[0x83] = modrm_byte;
+    table[0x9A] = invalid; // CALLF ptr16:32.
+
+    // MOV with a 64-bit (or 32-bit) absolute address.
+    fill(table, 0xA0, 0xA3, {.immediate = Immediate::offset});
+    table[0xA8] = byte;
+    table[0xA9] = {.immediate = Immediate::z};
+    fill(table, 0xB0, 0xB7, byte);
+    fill(table, 0xB8, 0xBF, {.immediate = Immediate::v});
+
+    table[0xC0] = modrm_byte;
+    table[0xC1] = modrm_byte;
+    table[0xC2] = {.immediate = Immediate::word,
+                   .control_flow = ControlFlow::ret}; // RET imm16.
+    table[0xC3] = {.control_flow = ControlFlow::ret};
+    fill(table, 0xC4, 0xC5, invalid); // VEX.
+    table[0xC6] = modrm_byte;
+    table[0xC7] = modrm_z;
+    table[0xC8] = {.immediate = Immediate::word_byte}; // ENTER.
+    table[0xCA] = {.immediate = Immediate::word,
+                   .control_flow = ControlFlow::ret}; // RETF imm16.
+    table[0xCB] = {.control_flow = ControlFlow::ret}; // RETF.
+    table[0xCC] = {.control_flow = ControlFlow::other}; // INT3.
+    table[0xCD] = {.immediate = Immediate::byte,
+                   .control_flow = ControlFlow::syscall}; // INT imm8.
+    table[0xCE] = invalid; // INTO.
+    table[0xCF] = {.control_flow = ControlFlow::ret}; // IRET.
+
+    fill(table, 0xD0, 0xD3, modrm);
+    fill(table, 0xD4, 0xD6, invalid);
+    fill(table, 0xD8, 0xDF, modrm); // x87.
+
+    fill(table, 0xE0, 0xE3, // LOOPNE, LOOPE, LOOP, JRCXZ.
+         branch(Immediate::byte, ControlFlow::conditional_jump));
+    fill(table, 0xE4, 0xE7, byte);
+    table[0xE8] = branch(Immediate::dword, ControlFlow::call);
+    table[0xE9] = branch(Immediate::dword, ControlFlow::jump);
+    table[0xEA] = invalid; // JMPF ptr16:32.
+    table[0xEB] = branch(Immediate::byte, ControlFlow::jump);
+
+    table[0xF1] = {.control_flow = ControlFlow::other}; // INT1.
+    table[0xF4] = {.control_flow = ControlFlow::other}; // HLT.
+    table[0xF6] = {.modrm = true, .immediate = Immediate::group3_byte};
+    table[0xF7] = {.modrm = true, .immediate = Immediate::group3_z};
+    table[0xFE] = modrm;
+    table[0xFF] = {.modrm = true, .group5 = true};
+    return table;
+}
+
+// The two byte (0F) opcode map.
+// Table A-3
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+constexpr OpcodeTable make_two_byte_table() {
+    // Almost everything in the map takes a ModRM byte.
+    OpcodeTable table;
+    table.fill(modrm);
+
+    table[0x05] = {.control_flow = ControlFlow::syscall}; // SYSCALL.
+    table[0x07] = {.control_flow = ControlFlow::other};   // SYSRET.
+    table[0x0B] = {.control_flow = ControlFlow::other};   // UD2.
+    for (const uint8_t opcode : {0x06, 0x08, 0x09, 0x0E, 0x77, 0xA0, 0xA1,
+                                 0xA2, 0xA8, 0xA9, 0xAA})
+        table[opcode] = {};
+    for (const uint8_t opcode : {0x0F, 0x70, 0x71, 0x72, 0x73, 0xA4, 0xAC,
+                                 0xBA, 0xC2, 0xC4, 0xC5, 0xC6})
+        table[opcode] = modrm_byte; // 0F 0F is 3DNow!, with an imm8 opcode.
+
+    fill(table, 0x30, 0x37, {}); // WRMSR, RDTSC, ..., GETSEC.
+    table[0x34] = {.control_flow = ControlFlow::syscall}; // SYSENTER.
+    table[0x35] = {.control_flow = ControlFlow::other};   // SYSEXIT.
+    fill(table, 0x80, 0x8F,
+         branch(Immediate::dword, ControlFlow::conditional_jump));
+    table[0xB9] = {.modrm = true, .control_flow = ControlFlow::other}; // UD1.
+    fill(table, 0xC8, 0xCF, {}); // BSWAP.
+    table[0xFF] = {.modrm = true, .control_flow = ControlFlow::other}; // UD0.
+    return table;
+}
+
+// The three byte opcode maps have no branches, 0F 38 has no immediates and
+// every opcode in 0F 3A takes an imm8.
+constexpr OpcodeTable make_three_byte_table(Opcode opcode) {
+    OpcodeTable table;
+    table.fill(opcode);
+    return table;
+}
+
+// Indexed by Map.
+constexpr std::array<OpcodeTable, 4> opcode_tables = {
+    make_one_byte_table(), make_two_byte_table(),
+    make_three_byte_table(modrm), make_three_byte_table(modrm_byte)};
+
+// Group 5 (FF) holds INC, DEC, CALL, CALLF, JMP, JMPF and PUSH.
+constexpr std::array<Opcode, 8> group5 = {
+    modrm,
+    modrm,
+    {.modrm = true, .control_flow = ControlFlow::call},
+    {.modrm = true, .control_flow = ControlFlow::call},
+    {.modrm = true, .control_flow = ControlFlow::jump},
+    {.modrm = true, .control_flow = ControlFlow::jump},
+    modrm,
+    invalid};
+
+// Return the length of the ModRM byte at |bytes[position]| and the SIB byte
+// and displacement that follow it, or zero if they are truncated. In 64-bit
+// mode 32-bit addressing uses the same encoding as 64-bit addressing, so the
+// address size doesn't matter.
+// Section 2.1.5
+// https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+std::size_t modrm_length(std::span<const uint8_t> bytes, std::size_t position) {
+    if (position >= bytes.size())
+        return 0;
+    const uint8_t modrm = bytes[position];
+    const uint8_t mod = modrm >> 6;
+    const uint8_t rm = modrm & 0x7;
+    if (mod == 3)
+        return 1;
+
+    std::size_t length = 1;
+    if (rm == 4) {
+        if (position + 1 >= bytes.size())
+            return 0;
+        ++length; // SIB byte.
+        if (mod == 0 && (bytes[position + 1] & 0x7) == 5)
+            length += 4; // No base register, disp32.
+    } else if (mod == 0 && rm == 5) {
+        length += 4; // RIP relative, disp32.
+    }
+    if (mod == 1)
+        length += 1;
+    else if (mod == 2)
+        length += 4;
+    return length;
+}
+
+// Return the size in bytes of |immediate|. |reg| is the reg field of the
+// ModRM byte, if the opcode has one.
+std::size_t immediate_size(Immediate immediate, uint8_t prefixes, bool rex_w,
+                           uint8_t reg) {
+    const std::size_t z = prefixes & operand_size ? 2 : 4;
+    switch (immediate) {
+    case Immediate::none:
+        return 0;
+    case Immediate::byte:
+        return 1;
+    case Immediate::word:
+        return 2;
+    case Immediate::word_byte:
+        return 3;
+    case Immediate::dword:
+        return 4;
+    case Immediate::z:
+        return z;
+    case Immediate::v:
+        return rex_w ? 8 : z;
+    case Immediate::offset:
+        return prefixes & address_size ? 4 : 8;
+    case Immediate::group3_byte:
+        return reg < 2 ? 1 : 0;
+    case Immediate::group3_z:
+        return reg < 2 ? z : 0;
+    }
+    return 0;
+}
+
+// Decode the instruction at the start of |bytes| into |instruction|. Returns
+// false if there is no valid instruction.
+bool decode_instruction(std::span<const uint8_t> bytes, uint64_t address,
+                        Instruction& instruction) {
+    if (bytes.size() > max_instruction_length)
+        bytes = bytes.first(max_instruction_length);
+
+    // Legacy prefixes, in any order, followed by an optional REX prefix. A REX
+    // prefix that isn't immediately followed by the opcode is ignored.
+    std::size_t i = 0;
+    uint8_t prefixes = 0;
+    bool rex_w = false;
+    for (; i < bytes.size(); ++i) {
+        const uint8_t prefix = prefix_table[bytes[i]];
+        if (prefix == not_prefix)
+            break;
+        prefixes |= prefix;
+        rex_w = prefix == rex && (bytes[i] & 0x8);
+    }
+    if (i >= bytes.size())
+        return false;
+
+    // Find the opcode map and the opcode. VEX and EVEX prefixes select the map
+    // themselves and replace the REX prefix.
+    // Section 2.3 and 2.7
+    // https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html
+    Map map = Map::one_byte;
+    uint8_t opcode = bytes[i++];
+    if (opcode == 0x0F) {
+        if (i >= bytes.size())
+            return false;
+        opcode = bytes[i++];
+        map = Map::two_byte;
+        if (opcode == 0x38 || opcode == 0x3A) {
+            map = opcode == 0x38 ? Map::three_byte_38 : Map::three_byte_3a;
+            if (i >= bytes.size())
+                return false;
+            opcode = bytes[i++];
+        }
+    } else if (opcode == 0xC4 || opcode == 0xC5 || opcode == 0x62) {
+        // Three byte VEX (C4), two byte VEX (C5) and EVEX (62).
+        const std::size_t payload = opcode == 0xC5 ? 1 : opcode == 0xC4 ? 2 : 3;
+        if (i + payload >= bytes.size())
+            return false;
+        const uint8_t selector =
+            opcode == 0xC5 ? 1 : bytes[i] & (opcode == 0xC4 ? 0x1F : 0x7);
+        switch (selector) {
+        case 1:
+            map = Map::two_byte;
+            break;
+        case 2:
+            map = Map::three_byte_38;
+            break;
+        case 3:
+            map = Map::three_byte_3a;
+            break;
+        case 5: // EVEX maps 5 and 6 (AVX512-FP16) have no immediates.
+        case 6:
+            map = Map::three_byte_38;
+            break;
+        default:
+            return false;
+        }
+        i += payload;
+        opcode = bytes[i++];
+    }
+
+    // Look up the opcode's operands. Some one byte opcodes depend on the reg
+    // field of the ModRM byte.
+    const uint8_t reg = i < bytes.size() ? (bytes[i] >> 3) & 0x7 : 0;
+    Opcode operands = opcode_tables[static_cast<std::size_t>(map)][opcode];
+    if (operands.group5)
+        operands = group5[reg];
+    if (!operands.valid)
+        return false;
+
+    // A ModRM byte with mod 00 and r/m 101 addresses memory relative to the
+    // next instruction, with a disp32 following the ModRM byte.
+    uint8_t rip_displacement = 0;
+    if (operands.modrm) {
+        const std::size_t length = modrm_length(bytes, i);
+        if (length == 0)
+            return false;
+        if ((bytes[i] & 0xC7) == 0x05)
+            rip_displacement = static_cast<uint8_t>(i + 1);
+        i += length;
+    }
+    const std::size_t immediate = i;
+    const std::size_t size =
+        immediate_size(operands.immediate, prefixes, rex_w, reg);
+    i += size;
+    if (i > bytes.size())
+        return false;
+
+    instruction = {.address = address,
+                   .length = static_cast<uint8_t>(i),
+                   .control_flow = operands.control_flow,
+                   .target = std::nullopt,
+                   .rip_displacement = rip_displacement};
+    if (operands.relative) {
+        int64_t displacement = 0;
+        if (size == 1) {
+            displacement = static_cast<int8_t>(bytes[immediate]);
+        } else {
+            int32_t rel32 = 0;
+            std::memcpy(&rel32, bytes.data() + immediate, sizeof(rel32));
+            displacement = rel32;
+        }
+        instruction.target = address + i + displacement;
+    }
+    return true;
+}
+
+} // namespace
+
+std::optional<Instruction> decode(std::span<const uint8_t> bytes,
+                                  uint64_t address) {
+    Instruction instruction;
+    if (!decode_instruction(bytes, address, instruction))
+        return std::nullopt;
+    return instruction;
+}
+
+std::vector<Instruction> decode_all(std::span<const uint8_t> bytes,
+                                    uint64_t address) {
+    // Most instructions are a few bytes long, so this avoids growing the
+    // vector in the common case without over-allocating much.
+    std::vector<Instruction> instructions;
+    instructions.reserve(bytes.size() / 3 + 1);
+
+    Instruction instruction;
+    for (std::size_t offset = 0; offset < bytes.size();
+         offset += instruction.length) {
+        if (!decode_instruction(bytes.subspan(offset), address + offset,
+                                instruction))
+            break;
+        instructions.push_back(instruction);
+    }
+    return instructions;
+}
+
+} // namespace smldbg::x86
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace smldbg::x86 {
+
+// The architectural limit on the length of an instruction, prefixes included.
+constexpr std::size_t max_instruction_length = 15;
+
+// How an instruction affects the flow of control.
+enum class ControlFlow {
+    none,             // Falls through to the next instruction.
+    call,             // Direct or indirect call.
+    jump,             // Unconditional direct or indirect jump.
+    conditional_jump, // Direct jump taken depending on flags or a counter
+                      // (Jcc, LOOP, JRCXZ).
+    ret,              // Return (RET, IRET).
+    syscall,          // System call or software interrupt that returns to the
+                      // next instruction.
+    other,            // Anything else that doesn't simply fall through (HLT,
+                      // UD2, INT3).
+};
+
+// A single decoded instruction.
+struct Instruction {
+    uint64_t address; // Address of the first byte of the instruction.
+    uint8_t length;   // Length of the instruction in bytes, prefixes included.
+    ControlFlow control_flow;
+    std::optional<uint64_t> target; // Destination of direct calls and jumps.
+    uint8_t rip_displacement; // Offset of the disp32 of a RIP relative memory
+                              // operand, or zero if there isn't one.
+};
+
+// Decode the length and control flow of the 64-bit mode instruction at the
+// start of |bytes|. Only as much of the instruction is decoded as is needed to
+// find its length, operands are not decoded.
+//
+// Preconditions: |address| is the address of |bytes| in the target, used to
+// resolve relative branch targets.
+//
+// Postconditions: Returns std::nullopt if |bytes| doesn't start with a valid
+// instruction, or the instruction is truncated.
+std::optional<Instruction> decode(std::span<const uint8_t> bytes,
+                                  uint64_t address);
+
+// Decode the instructions of |bytes| in order, starting from its first byte,
+// until the end of |bytes| or the first byte that isn't a valid instruction.
+// This is the bulk form of decode(...) for decoding whole address ranges.
+//
+// Preconditions: |address| is the address of |bytes| in the target.
+//
+// Postconditions: The returned instructions are contiguous. Their lengths sum
+// to less than |bytes.size()| if decoding stopped at an invalid or truncated
+// instruction.
+std::vector<Instruction> decode_all(std::span<const uint8_t> bytes,
+                                    uint64_t address);
+
+} // namespace smldbg::x86
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Helpers for building synthetic DWARF sections in tests.
+namespace smldbg::test {
+
+// Append the little endian bytes of |value| to |bytes|, a std::string or
+// std::vector<char>.
+template <typename T, typename Bytes> void append(Bytes& bytes, T value) {
+    char data[sizeof(T)];
+    std::memcpy(data, &value, sizeof(T));
+    bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+// Append |value| to |bytes|, LEB128 encoded.
+template <typename Bytes> void append_uleb(Bytes& bytes, uint64_t value) {
+    do {
+        const char byte = value & 0x7f;
+        value >>= 7;
+        bytes.push_back(value ? byte | 0x80 : byte);
+    } while (value);
+}
+
+// Append |value| to |bytes|, signed LEB128 encoded.
+template <typename Bytes> void append_sleb(Bytes& bytes, int64_t value) {
+    while (true) {
+        const char byte = value & 0x7f;
+        value >>= 7;
+        const bool done = (value == 0 && !(byte & 0x40)) ||
+                          (value == -1 && (byte & 0x40));
+        bytes.push_back(done ? byte : byte | 0x80);
+        if (done)
+            return;
+    }
+}
+
+// Overwrite the 32-bit unit length at the start of |bytes| with the size of
+// what follows it.
+template <typename Bytes> void patch_unit_length(Bytes& bytes) {
+    const uint32_t length = bytes.size() - sizeof(uint32_t);
+    std::memcpy(bytes.data(), &length, sizeof(length));
+}
+
+} // namespace smldbg::test
@@ -0,0 +1,33 @@
+#include "gtest/gtest.h"
+
+#include "address_range_index.h"
+
+namespace {
+
+using namespace smldbg;
+
+TEST(TestAddressRangeIndex, Find) {
+    // Arrange
+    dwarf::AddressRangeIndex index;
+    index.insert(0x2000, 0x2010, 2);
+    index.insert(0x1000, 0x1100, 1);
+    index.insert(0x1040, 0x1080, 3); // Nested inside [0x1000, 0x1100).
+    index.insert(0x3000, 0x3000, 4); // Empty, ignored.
+    index.finalize();
+
+    // Act / Assert
+    EXPECT_EQ(index.find(0x1000), 1);
+    EXPECT_EQ(index.find(0x103f), 1);
+    EXPECT_EQ(index.find(0x1040), 3);
+    EXPECT_EQ(index.find(0x107f), 3);
+    EXPECT_EQ(index.find(0x1080), 1);
+    EXPECT_EQ(index.find(0x10ff), 1);
+    EXPECT_EQ(index.find(0x200f), 2);
+    EXPECT_FALSE(index.find(0x0fff));
+    EXPECT_FALSE(index.find(0x1100)); // Ranges are half open.
+    EXPECT_FALSE(index.find(0x2010));
+    EXPECT_FALSE(index.find(0x3000));
+    EXPECT_EQ(index.entries().size(), 3);
+}
+
+} // namespace
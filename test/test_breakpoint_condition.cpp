@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+
+#include "breakpoint_condition.h"
+
+#include <cstdint>
+#include <map>
+
+namespace {
+
+using namespace smldbg;
+
+// Ids of the variables of a fake frame.
+constexpr int64_t n_id = 0;
+constexpr int64_t w_id = 1;
+
+std::optional<int64_t> resolve(std::string_view variable) {
+    if (variable == "n")
+        return n_id;
+    if (variable == "w")
+        return w_id;
+    return std::nullopt;
+}
+
+std::optional<int64_t> evaluate(std::string_view expression, int64_t n,
+                                int64_t w) {
+    const std::map<int64_t, int64_t> variables = {{n_id, n}, {w_id, w}};
+    const auto condition = BreakpointCondition::compile(expression, resolve);
+    if (!condition)
+        return std::nullopt;
+    return condition->evaluate([&](int64_t id) -> std::optional<int64_t> {
+        const auto found = variables.find(id);
+        if (found == variables.end())
+            return std::nullopt;
+        return found->second;
+    });
+}
+
+TEST(TestBreakpointCondition, Evaluate) {
+    // Act & Assert
+    EXPECT_EQ(evaluate("n > 1000 && w == 0", 1001, 0), 1);
+    EXPECT_EQ(evaluate("n > 1000 && w == 0", 1000, 0), 0);
+    EXPECT_EQ(evaluate("n > 1000 && w == 0", 1001, 1), 0);
+    EXPECT_EQ(evaluate("n < 0 || w", 5, 7), 1);
+    EXPECT_EQ(evaluate("n < 0 || w", 5, 0), 0);
+    EXPECT_EQ(evaluate("1 + 2 * 3 == 7", 0, 0), 1);
+    EXPECT_EQ(evaluate("(1 + 2) * -3", 0, 0), -9);
+    EXPECT_EQ(evaluate("!(n % 0x10) != 0", 32, 0), 1);
+    EXPECT_EQ(evaluate("n >= w && n <= w", 3, 3), 1);
+    EXPECT_EQ(evaluate("n < 0 && w == 4294967295", -123456789012, 0xffffffff),
+              1);
+
+    // Overflow wraps around, including INT64_MIN / -1, which would trap.
+    EXPECT_EQ(evaluate("(0 - 9223372036854775807 - 1) / -1 == n", INT64_MIN,
+                       0),
+              1);
+    EXPECT_EQ(evaluate("n % -1", INT64_MIN, 0), 0);
+    EXPECT_EQ(evaluate("n + 1", INT64_MAX, 0), INT64_MIN);
+    EXPECT_EQ(evaluate("-n * w", INT64_MIN, 2), 0);
+
+    // Short-circuiting avoids the division by zero.
+    EXPECT_EQ(evaluate("w != 0 && n / w > 2", 9, 0), 0);
+    EXPECT_FALSE(evaluate("n / w > 2", 9, 0));
+}
+
+TEST(TestBreakpointCondition, Compile_Errors) {
+    // Act & Assert
+    EXPECT_FALSE(BreakpointCondition::compile("n >", resolve));
+    EXPECT_FALSE(BreakpointCondition::compile("(n > 1", resolve));
+    EXPECT_FALSE(BreakpointCondition::compile("n > 1 )", resolve));
+    EXPECT_FALSE(BreakpointCondition::compile("missing == 1", resolve));
+    EXPECT_EQ(BreakpointCondition::compile("n == 1", resolve)->expression(),
+              "n == 1");
+}
+
+} // namespace
@@ -0,0 +1,147 @@
+#include "gtest/gtest.h"
+
+#include "call_frame_info.h"
+#include "memory.h"
+#include "unwinder.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <dlfcn.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace smldbg;
+
+// The load bias of |elf|, the test executable, which contains |function|.
+uint64_t executable_bias(const elf::ELF& elf, void* function) {
+    Dl_info info = {};
+    if (!dladdr(function, &info))
+        return 0;
+    for (const auto& header : elf.program_headers()) {
+        if (header.P_TYPE == elf::PT_LOAD)
+            return reinterpret_cast<uint64_t>(info.dli_fbase) -
+                   (header.P_VADDR & ~uint64_t(0xfff));
+    }
+    return 0;
+}
+
+// Unwind the stack from the registers of this function's frame, as they are
+// once getcontext() has returned, and set |return_address| to the address
+// the function returns to.
+[[gnu::noinline]] std::vector<StackFrame>
+unwind_here(Unwinder& unwinder, user_regs_struct& registers,
+            uint64_t& return_address) {
+    ucontext_t context;
+    getcontext(&context);
+    const greg_t* gregs = context.uc_mcontext.gregs;
+    registers = {};
+    registers.rbx = gregs[REG_RBX];
+    registers.rbp = gregs[REG_RBP];
+    registers.rsp = gregs[REG_RSP];
+    registers.r12 = gregs[REG_R12];
+    registers.r13 = gregs[REG_R13];
+    registers.r14 = gregs[REG_R14];
+    registers.r15 = gregs[REG_R15];
+    registers.rip = gregs[REG_RIP];
+    return_address = reinterpret_cast<uint64_t>(__builtin_return_address(0));
+    return unwinder.unwind(registers);
+}
+
+TEST(TestCallFrameInfo, Debug_Frame) {
+    // Arrange
+    // A CIE setting the CFA to rsp + 8 with the return address below it, and
+    // an FDE for a function at 0x1000 that pushes rbp and then uses it as the
+    // frame pointer.
+    std::vector<char> debug_frame = {
+        // CIE: length, id, version, augmentation, alignments, RA register.
+        0x0e, 0x00, 0x00, 0x00, char(0xff), char(0xff), char(0xff),
+        char(0xff), 0x01, 0x00, 0x01, 0x78, 0x10,
+        // DW_CFA_def_cfa rsp 8, DW_CFA_offset r16 1.
+        0x0c, 0x07, 0x08, char(0x90), 0x01,
+        // FDE: length, CIE pointer, initial location and range.
+        0x1c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00,
+        // DW_CFA_advance_loc 1, DW_CFA_def_cfa_offset 16,
+        // DW_CFA_offset rbp 2, DW_CFA_advance_loc 3,
+        // DW_CFA_def_cfa_register rbp.
+        0x41, 0x0e, 0x10, char(0x86), 0x02, 0x43, 0x0d, 0x06};
+    dwarf::CallFrameInfo call_frame_info(
+        {}, {},
+        {.data = debug_frame.data(), .size = debug_frame.size(), .address = 0});
+
+    // Act
+    const auto entry = call_frame_info.row_at(0x1000);
+    const auto pushed = call_frame_info.row_at(0x1003);
+    const auto body = call_frame_info.row_at(0x101f);
+    const auto after = call_frame_info.row_at(0x1020);
+
+    // Assert
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->cfa_register, dwarf::cfi_rsp);
+    EXPECT_EQ(entry->cfa_offset, 8);
+    EXPECT_EQ(entry->registers[dwarf::cfi_return_address].kind,
+              dwarf::RegisterRule::Kind::offset);
+    EXPECT_EQ(entry->registers[dwarf::cfi_return_address].value, -8);
+    EXPECT_EQ(entry->registers[dwarf::cfi_rbp].kind,
+              dwarf::RegisterRule::Kind::same_value);
+
+    ASSERT_TRUE(pushed);
+    EXPECT_EQ(pushed->cfa_register, dwarf::cfi_rsp);
+    EXPECT_EQ(pushed->cfa_offset, 16);
+    EXPECT_EQ(pushed->registers[dwarf::cfi_rbp].kind,
+              dwarf::RegisterRule::Kind::offset);
+    EXPECT_EQ(pushed->registers[dwarf::cfi_rbp].value, -16);
+
+    ASSERT_TRUE(body);
+    EXPECT_EQ(body->cfa_register, dwarf::cfi_rbp);
+    EXPECT_EQ(body->cfa_offset, 16);
+
+    EXPECT_FALSE(after);
+}
+
+TEST(TestCallFrameInfo, Eh_Frame) {
+    // Arrange
+    elf::ELF elf("/proc/self/exe");
+    dwarf::CallFrameInfo call_frame_info(elf);
+    const uint64_t function =
+        reinterpret_cast<uint64_t>(&unwind_here) -
+        executable_bias(elf, reinterpret_cast<void*>(&unwind_here));
+
+    // Act
+    const auto entry = call_frame_info.row_at(function);
+
+    // Assert
+    // Every function is entered with the return address on top of the stack.
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->cfa_register, dwarf::cfi_rsp);
+    EXPECT_EQ(entry->cfa_offset, 8);
+    EXPECT_EQ(entry->registers[dwarf::cfi_return_address].kind,
+              dwarf::RegisterRule::Kind::offset);
+    EXPECT_EQ(entry->registers[dwarf::cfi_return_address].value, -8);
+}
+
+TEST(TestCallFrameInfo, Unwind_Self) {
+    // Arrange
+    Memory memory(getpid());
+    Unwinder unwinder(getpid(), &memory);
+    user_regs_struct registers;
+    uint64_t return_address = 0;
+
+    // Act
+    const std::vector<StackFrame> frames =
+        unwind_here(unwinder, registers, return_address);
+
+    // Assert
+    ASSERT_GE(frames.size(), 3);
+    EXPECT_EQ(frames[0].pc, registers.rip);
+    EXPECT_EQ(frames[1].pc, return_address);
+    EXPECT_GT(frames[1].sp, frames[0].sp);
+    EXPECT_EQ(frames[1].sp, frames[0].cfa);
+    EXPECT_TRUE(unwinder.object_at(frames[0].pc));
+}
+
+} // namespace
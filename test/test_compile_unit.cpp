@@ -0,0 +1,181 @@
+#include "gtest/gtest.h"
+
+#include "compile_unit.h"
+#include "dwarf_builder.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace smldbg;
+using test::append;
+using test::append_sleb;
+using test::append_uleb;
+using test::patch_unit_length;
+
+// The sections of a DWARF 5 compile unit "cu.c" with a single function
+// "main". Strings and addresses are referred to by index, the function's
+// ranges by a DW_FORM_rnglistx index, and two attributes are implicit
+// constants.
+struct Sections {
+    Sections() {
+        // Abbreviations 1 (the compile unit) and 2 (the function).
+        // Section 7.5.3
+        // http://www.dwarfstd.org/doc/DWARF5.pdf
+        debug_abbrev += "\x01\x11\x01"; // DW_TAG_compile_unit, children.
+        debug_abbrev += "\x03\x25";     // DW_AT_name DW_FORM_strx1
+        debug_abbrev += "\x11\x1b";     // DW_AT_low_pc DW_FORM_addrx
+        debug_abbrev += "\x72\x17"; // DW_AT_str_offsets_base sec_offset
+        debug_abbrev += "\x73\x17"; // DW_AT_addr_base DW_FORM_sec_offset
+        debug_abbrev += "\x74\x17"; // DW_AT_rnglists_base sec_offset
+        debug_abbrev += "\x13\x21"; // DW_AT_language DW_FORM_implicit_const
+        append_sleb(debug_abbrev, 0x21);
+        debug_abbrev += std::string("\x00\x00", 2);
+        debug_abbrev += std::string("\x02\x2e\x00", 3); // DW_TAG_subprogram
+        debug_abbrev += "\x03\x26"; // DW_AT_name DW_FORM_strx2
+        debug_abbrev += "\x3b\x21"; // DW_AT_decl_line implicit_const
+        append_sleb(debug_abbrev, -5);
+        debug_abbrev += "\x55\x23"; // DW_AT_ranges DW_FORM_rnglistx
+        debug_abbrev += std::string("\x00\x00\x00", 3);
+
+        // The unit header, then the entries.
+        // Section 7.5.1
+        // http://www.dwarfstd.org/doc/DWARF5.pdf
+        append<uint32_t>(debug_info, 0); // unit_length, patched below.
+        append<uint16_t>(debug_info, 5); // version
+        append<uint8_t>(debug_info, 1);  // DW_UT_compile
+        append<uint8_t>(debug_info, 8);  // address_size
+        append<uint32_t>(debug_info, 0); // debug_abbrev_offset
+        append_uleb(debug_info, 1);
+        append<uint8_t>(debug_info, 0);   // DW_AT_name: string 0.
+        append_uleb(debug_info, 0);       // DW_AT_low_pc: address 0.
+        append<uint32_t>(debug_info, 8);  // DW_AT_str_offsets_base
+        append<uint32_t>(debug_info, 8);  // DW_AT_addr_base
+        append<uint32_t>(debug_info, 12); // DW_AT_rnglists_base
+        append_uleb(debug_info, 2);
+        append<uint16_t>(debug_info, 1); // DW_AT_name: string 1.
+        append_uleb(debug_info, 0);      // DW_AT_ranges: list 0.
+        append<uint8_t>(debug_info, 0);  // End of the children.
+        patch_unit_length(debug_info);
+
+        debug_str = std::string("cu.c\0main\0", 10);
+
+        // Each table starts with an 8 byte header, which the bases skip.
+        append<uint32_t>(debug_str_offsets, 0);
+        append<uint32_t>(debug_str_offsets, 0);
+        append<uint32_t>(debug_str_offsets, 0); // "cu.c"
+        append<uint32_t>(debug_str_offsets, 5); // "main"
+
+        append<uint32_t>(debug_addr, 0);
+        append<uint32_t>(debug_addr, 0);
+        append<uint64_t>(debug_addr, 0x1000);
+        append<uint64_t>(debug_addr, 0x2000);
+        append<uint64_t>(debug_addr, 0x3000);
+
+        // A 12 byte header with one offset, then the list the offset points
+        // to (relative to the base).
+        // Section 7.28
+        // http://www.dwarfstd.org/doc/DWARF5.pdf
+        append<uint32_t>(debug_rnglists, 0);
+        append<uint32_t>(debug_rnglists, 0);
+        append<uint32_t>(debug_rnglists, 1); // offset_entry_count
+        append<uint32_t>(debug_rnglists, 4);
+        // DW_RLE_offset_pair 0x10 0x20, relative to the unit's low_pc.
+        debug_rnglists += "\x04\x10\x20";
+        // DW_RLE_base_addressx 1, then DW_RLE_offset_pair 0 8.
+        debug_rnglists += std::string("\x01\x01\x04\x00\x08", 5);
+        // DW_RLE_startx_length 2 0x40, then DW_RLE_end_of_list.
+        debug_rnglists += std::string("\x03\x02\x40\x00", 4);
+    }
+
+    dwarf::FormSections form_sections() {
+        return {.debug_str = debug_str.data(),
+                .debug_str_offsets = debug_str_offsets.data(),
+                .debug_addr = debug_addr.data(),
+                .debug_rnglists = debug_rnglists.data()};
+    }
+
+    std::string debug_abbrev;
+    std::string debug_info;
+    std::string debug_str;
+    std::string debug_str_offsets;
+    std::string debug_addr;
+    std::string debug_rnglists;
+};
+
+TEST(TestCompileUnit, Index_Forms) {
+    // Arrange
+    Sections sections;
+    char* debug_info = sections.debug_info.data();
+
+    // Act
+    const dwarf::CompileUnit cu(&debug_info, sections.debug_abbrev.data(),
+                                sections.form_sections());
+    dwarf::DIE root = cu.root();
+    dwarf::DIE function = root;
+    ++function;
+
+    // Assert
+    EXPECT_EQ(debug_info,
+              sections.debug_info.data() + sections.debug_info.size());
+    EXPECT_EQ(cu.dwarf_version(), 5);
+    EXPECT_EQ(root.attribute(dwarf::DW_AT::DW_AT_name)->as_string_view(),
+              "cu.c");
+    EXPECT_EQ(cu.base_address(), 0x1000);
+    ASSERT_EQ(function.tag(), dwarf::DW_TAG::DW_TAG_subprogram);
+    EXPECT_EQ(function.attribute(dwarf::DW_AT::DW_AT_name)->as_string_view(),
+              "main");
+}
+
+TEST(TestCompileUnit, Implicit_Constants) {
+    // Arrange
+    Sections sections;
+    char* debug_info = sections.debug_info.data();
+    const dwarf::CompileUnit cu(&debug_info, sections.debug_abbrev.data(),
+                                sections.form_sections());
+    dwarf::DIE root = cu.root();
+    dwarf::DIE function = root;
+    ++function;
+
+    // Act
+    auto language = root.attribute(dwarf::DW_AT::DW_AT_language);
+    auto [line, ranges] = function.attributes(
+        std::array{dwarf::DW_AT::DW_AT_decl_line, dwarf::DW_AT::DW_AT_ranges});
+
+    // Assert
+    ASSERT_TRUE(language && line && ranges);
+    EXPECT_EQ(language->as_uint64t(), 0x21);
+    EXPECT_EQ(static_cast<int64_t>(line->as_uint64t()), -5);
+    // Implicit constants take no space in the entry, so the attribute after
+    // one is still found.
+    EXPECT_EQ(ranges->form(), dwarf::DW_FORM::DW_FORM_rnglistx);
+    EXPECT_EQ(ranges->as_uint64t(), 16);
+}
+
+TEST(TestCompileUnit, Range_List) {
+    // Arrange
+    Sections sections;
+    char* debug_info = sections.debug_info.data();
+    const dwarf::CompileUnit cu(&debug_info, sections.debug_abbrev.data(),
+                                sections.form_sections());
+    dwarf::DIE function = cu.root();
+    ++function;
+
+    // Act
+    const std::vector<dwarf::AddressRange> ranges =
+        cu.address_ranges(function, nullptr);
+
+    // Assert
+    ASSERT_EQ(ranges.size(), 3);
+    EXPECT_EQ(ranges[0].low, 0x1010);
+    EXPECT_EQ(ranges[0].high, 0x1020);
+    EXPECT_EQ(ranges[1].low, 0x2000);
+    EXPECT_EQ(ranges[1].high, 0x2008);
+    EXPECT_EQ(ranges[2].low, 0x3000);
+    EXPECT_EQ(ranges[2].high, 0x3040);
+}
+
+} // namespace
@@ -30,14 +30,16 @@ TEST(TestDwarf, ProgramCounter_From_LineAndFile) {
 
     for (unsigned i = 0, e = lines.size(); i < e; ++i) {
         std::string_view expected_file = i < 5 ? "main.cpp" : "solver.cpp";
-        const std::optional<uint64_t> program_counter =
-            dwarf.program_counter_from_line_and_file(lines[i], expected_file);
-        ASSERT_TRUE(program_counter);
-        EXPECT_EQ(*program_counter, expected_program_counter_values[i])
+        const std::vector<dwarf::SourceLocation> source_locations =
+            dwarf.program_counters_from_line_and_file(lines[i], expected_file);
+        ASSERT_EQ(source_locations.size(), 1);
+        EXPECT_EQ(source_locations[0].address,
+                  expected_program_counter_values[i])
             << "Expected program counter value for line " << std::dec
             << lines[i] << " of " << expected_file << ": " << std::hex
             << expected_program_counter_values[i] << "\n"
-            << "Actual program counter value: " << *program_counter;
+            << "Actual program counter value: "
+            << source_locations[0].address;
     }
 }
 
@@ -0,0 +1,282 @@
+#include "gtest/gtest.h"
+
+#include "attribute.h"
+#include "dwarf_expression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace {
+
+using namespace smldbg;
+
+// A fake frame: rbx (3) is 0x10, rbp (6) is 0x1000, memory holds a 64 bit
+// value at 0x1000, and the frame base is the CFA, 0x2000.
+dwarf::DwarfExpression::Context context() {
+    dwarf::DwarfExpression::Context context;
+    context.read_register = [](uint64_t reg) -> std::optional<uint64_t> {
+        const std::map<uint64_t, uint64_t> registers = {{3, 0x10},
+                                                        {6, 0x1000}};
+        const auto found = registers.find(reg);
+        if (found == registers.end())
+            return std::nullopt;
+        return found->second;
+    };
+    context.read_memory = [](uint64_t address, std::span<char> bytes) {
+        const uint64_t value = 0x1122334455667788;
+        if (address < 0x1000 || address + bytes.size() > 0x1008)
+            return false;
+        std::memcpy(bytes.data(),
+                    reinterpret_cast<const char*>(&value) + address - 0x1000,
+                    bytes.size());
+        return true;
+    };
+    context.cfa = []() -> std::optional<uint64_t> { return 0x2000; };
+    context.frame_base = context.cfa;
+    return context;
+}
+
+std::optional<dwarf::DwarfLocation>
+evaluate(const std::string& bytes,
+         const dwarf::DwarfExpression::Context& context = ::context()) {
+    const auto expression = dwarf::DwarfExpression::compile(bytes);
+    if (!expression)
+        return std::nullopt;
+    return expression->evaluate(context);
+}
+
+// Evaluate |bytes| to the value on top of the stack.
+std::optional<uint64_t> value(const std::string& bytes) {
+    const auto location = evaluate(bytes);
+    if (!location || location->kind != dwarf::DwarfLocationKind::memory)
+        return std::nullopt;
+    return location->value;
+}
+
+TEST(TestDwarfExpression, Arithmetic) {
+    // Act & Assert
+    // DW_OP_lit5 DW_OP_lit3 DW_OP_minus
+    EXPECT_EQ(value("\x35\x33\x1c"), 2);
+    // DW_OP_const1s -2 DW_OP_lit3 DW_OP_mul DW_OP_abs
+    EXPECT_EQ(value("\x09\xfe\x33\x1e\x19"), 6);
+    // DW_OP_consts -8 DW_OP_lit3 DW_OP_shra
+    EXPECT_EQ(value(std::string("\x11\x78\x33\x26", 4)), uint64_t(-1));
+    // DW_OP_lit7 DW_OP_lit2 DW_OP_over DW_OP_over DW_OP_mod DW_OP_rot ...
+    EXPECT_EQ(value("\x37\x32\x14\x14\x1d\x17\x1b\x22"), 4);
+    // DW_OP_constu 2^63, which needs all ten bytes of its LEB128 operand.
+    EXPECT_EQ(value("\x10\x80\x80\x80\x80\x80\x80\x80\x80\x80\x01"),
+              uint64_t(1) << 63);
+    // DW_OP_lit1 DW_OP_lit0 DW_OP_div
+    EXPECT_FALSE(value(std::string("\x31\x30\x1b", 3)));
+    // DW_OP_plus with a single entry.
+    EXPECT_FALSE(value("\x31\x22"));
+}
+
+TEST(TestDwarfExpression, Branches) {
+    // Act & Assert
+    // Sum 1 to 4 with a loop: counter and total on the stack.
+    // 0: DW_OP_lit4 DW_OP_lit0
+    // 2: DW_OP_over DW_OP_plus DW_OP_swap DW_OP_lit1 DW_OP_minus DW_OP_swap
+    // 8: DW_OP_over DW_OP_bra -10 (back to 2)
+    // 12: DW_OP_swap DW_OP_drop
+    EXPECT_EQ(value("\x34\x30\x14\x22\x16\x31\x1c\x16\x14\x28\xf6\xff\x16\x13"),
+              10);
+    // DW_OP_skip over a DW_OP_lit1 to DW_OP_lit2.
+    EXPECT_EQ(value(std::string("\x2f\x01\x00\x31\x32", 5)), 2);
+    // Branches must land on an operation.
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(
+        std::string("\x2f\x01\x00\x0a\x01\x00", 6)));
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(
+        std::string("\x2f\x03\x00\x31", 4)));
+    // An endless loop gives up.
+    EXPECT_FALSE(value(std::string("\x2f\xfd\xff", 3)));
+}
+
+TEST(TestDwarfExpression, Registers_And_Memory) {
+    // Act & Assert
+    // DW_OP_breg6 -8
+    EXPECT_EQ(value("\x76\x78"), 0xff8);
+    // DW_OP_fbreg -20
+    EXPECT_EQ(value("\x91\x6c"), 0x2000 - 20);
+    // DW_OP_call_frame_cfa
+    EXPECT_EQ(value("\x9c"), 0x2000);
+    // DW_OP_breg6 0 DW_OP_deref
+    EXPECT_EQ(value(std::string("\x76\x00\x06", 3)), 0x1122334455667788);
+    // DW_OP_breg6 2 DW_OP_deref_size 2
+    EXPECT_EQ(value("\x76\x02\x94\x02"), 0x5566);
+    // DW_OP_breg6 8 DW_OP_deref, past the end of the memory.
+    EXPECT_FALSE(value("\x76\x08\x06"));
+    // DW_OP_addr 0x4000, with the load bias added.
+    dwarf::DwarfExpression::Context biased = context();
+    biased.load_bias = 0x10000;
+    const auto address = evaluate(
+        std::string("\x03\x00\x40\x00\x00\x00\x00\x00\x00", 9), biased);
+    ASSERT_TRUE(address);
+    EXPECT_EQ(address->value, 0x14000);
+    // DW_OP_addr 0x4000 DW_OP_stack_value, with 4 byte addresses.
+    const auto short_address = dwarf::DwarfExpression::compile(
+        std::string("\x03\x00\x40\x00\x00\x9f", 6), 4, 4);
+    ASSERT_TRUE(short_address);
+    EXPECT_EQ(short_address->evaluate(context())->value, 0x4000);
+    // DW_OP_entry_value(DW_OP_addr 0x4000) DW_OP_stack_value. The nested
+    // expression is decoded with the same address size, its operand is
+    // truncated with 8 byte addresses.
+    const std::string entry_address("\xa3\x05\x03\x00\x40\x00\x00\x9f", 8);
+    EXPECT_TRUE(dwarf::DwarfExpression::compile(entry_address, 4, 4));
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(entry_address, 4, 8));
+
+    // DW_OP_reg3
+    const auto reg = evaluate("\x53");
+    ASSERT_TRUE(reg);
+    EXPECT_EQ(reg->kind, dwarf::DwarfLocationKind::reg);
+    EXPECT_EQ(reg->value, 3);
+    // DW_OP_regx 17
+    EXPECT_EQ(evaluate("\x90\x11")->value, 17);
+}
+
+TEST(TestDwarfExpression, Implicit_Locations) {
+    // Act
+    // DW_OP_breg3 5 DW_OP_stack_value
+    const auto stack_value = evaluate("\x73\x05\x9f");
+    // DW_OP_implicit_value 4 0x01020304, whose bytes point into the
+    // expression.
+    const auto expression = dwarf::DwarfExpression::compile(
+        std::string("\x9e\x04\x04\x03\x02\x01"));
+    ASSERT_TRUE(expression);
+    const auto implicit_value = expression->evaluate(context());
+    // An empty expression.
+    const auto optimized_out = evaluate("");
+
+    // Assert
+    ASSERT_TRUE(stack_value);
+    EXPECT_EQ(stack_value->kind, dwarf::DwarfLocationKind::value);
+    EXPECT_EQ(stack_value->value, 0x15);
+    ASSERT_TRUE(implicit_value);
+    EXPECT_EQ(implicit_value->kind, dwarf::DwarfLocationKind::implicit);
+    EXPECT_EQ(std::string(implicit_value->bytes.begin(),
+                          implicit_value->bytes.end()),
+              "\x04\x03\x02\x01");
+    ASSERT_TRUE(optimized_out);
+    EXPECT_EQ(optimized_out->kind, dwarf::DwarfLocationKind::undefined);
+}
+
+TEST(TestDwarfExpression, Pieces) {
+    // Act
+    // DW_OP_reg3 DW_OP_piece 4, DW_OP_piece 2 (optimized out),
+    // DW_OP_breg6 0 DW_OP_piece 2, DW_OP_lit9 DW_OP_stack_value
+    // DW_OP_bit_piece 3 1
+    const auto location = evaluate(
+        std::string("\x53\x93\x04\x93\x02\x76\x00\x93\x02\x39\x9f\x9d\x03\x01",
+                    14));
+
+    // Assert
+    ASSERT_TRUE(location);
+    EXPECT_EQ(location->kind, dwarf::DwarfLocationKind::composite);
+    ASSERT_EQ(location->pieces.size(), 4);
+    EXPECT_EQ(location->pieces[0].kind, dwarf::DwarfLocationKind::reg);
+    EXPECT_EQ(location->pieces[0].value, 3);
+    EXPECT_EQ(location->pieces[0].bit_size, 32);
+    EXPECT_EQ(location->pieces[1].kind, dwarf::DwarfLocationKind::undefined);
+    EXPECT_EQ(location->pieces[2].kind, dwarf::DwarfLocationKind::memory);
+    EXPECT_EQ(location->pieces[2].value, 0x1000);
+    EXPECT_EQ(location->pieces[2].bit_size, 16);
+    EXPECT_EQ(location->pieces[3].kind, dwarf::DwarfLocationKind::value);
+    EXPECT_EQ(location->pieces[3].value, 9);
+    EXPECT_EQ(location->pieces[3].bit_size, 3);
+    EXPECT_EQ(location->pieces[3].bit_offset, 1);
+}
+
+TEST(TestDwarfExpression, Entry_Values_And_TLS) {
+    // Arrange
+    dwarf::DwarfExpression::Context context = ::context();
+    context.entry_value = [](uint64_t reg) -> std::optional<uint64_t> {
+        if (reg == 5)
+            return 0x500;
+        return std::nullopt;
+    };
+    context.tls_address = [](uint64_t offset) -> std::optional<uint64_t> {
+        return 0x7000 + offset;
+    };
+
+    // Act
+    // DW_OP_entry_value(DW_OP_reg5) DW_OP_stack_value
+    const auto entry_value = evaluate("\xa3\x01\x55\x9f", context);
+    // DW_OP_GNU_entry_value(DW_OP_breg5 8) DW_OP_stack_value
+    const auto gnu_entry_value = evaluate("\xf3\x02\x75\x08\x9f", context);
+    // DW_OP_entry_value(DW_OP_reg4), which isn't known.
+    const auto unknown = evaluate("\xa3\x01\x54\x9f", context);
+    // DW_OP_const8u 0x10 DW_OP_GNU_push_tls_address
+    const auto tls = evaluate(
+        std::string("\x0e\x10\x00\x00\x00\x00\x00\x00\x00\xe0", 10), context);
+
+    // Assert
+    ASSERT_TRUE(entry_value);
+    EXPECT_EQ(entry_value->kind, dwarf::DwarfLocationKind::value);
+    EXPECT_EQ(entry_value->value, 0x500);
+    ASSERT_TRUE(gnu_entry_value);
+    EXPECT_EQ(gnu_entry_value->value, 0x508);
+    EXPECT_FALSE(unknown);
+    ASSERT_TRUE(tls);
+    EXPECT_EQ(tls->kind, dwarf::DwarfLocationKind::memory);
+    EXPECT_EQ(tls->value, 0x7010);
+}
+
+TEST(TestDwarfExpression, Indexed_Addresses) {
+    // Arrange
+    // A .debug_addr section holding the table of a compile unit, whose
+    // entries start after the table's 8 byte header, as given by its
+    // DW_AT_addr_base. This is how Clang locates DWARF 5 globals.
+    std::string debug_addr("\x14\x00\x00\x00\x05\x00\x08\x00", 8);
+    for (const uint64_t address : {0x4000, 0x4010}) {
+        char bytes[sizeof(address)];
+        std::memcpy(bytes, &address, sizeof(address));
+        debug_addr.append(bytes, sizeof(bytes));
+    }
+    const dwarf::FormContext form_context = {
+        .address_size = 8,
+        .sections = {.debug_addr = debug_addr.data()},
+        .addr_base = 8};
+    dwarf::DwarfExpression::Context context = ::context();
+    context.load_bias = 0x10000;
+    context.debug_addr = [&](uint64_t index) {
+        return form_context.address(index);
+    };
+
+    // Act
+    // DW_OP_addrx 1
+    const auto global = evaluate("\xa1\x01", context);
+    // DW_OP_constx 0 DW_OP_stack_value
+    const auto constant = evaluate(std::string("\xa2\x00\x9f", 3), context);
+    // DW_OP_addrx 1, without a .debug_addr table to look it up in.
+    const auto unresolved = evaluate("\xa1\x01");
+
+    // Assert
+    ASSERT_TRUE(global);
+    EXPECT_EQ(global->kind, dwarf::DwarfLocationKind::memory);
+    EXPECT_EQ(global->value, 0x14010);
+    ASSERT_TRUE(constant);
+    EXPECT_EQ(constant->kind, dwarf::DwarfLocationKind::value);
+    EXPECT_EQ(constant->value, 0x4000);
+    EXPECT_FALSE(unresolved);
+}
+
+TEST(TestDwarfExpression, Invalid_Expressions) {
+    // Act & Assert
+    // Truncated operands.
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(std::string("\x0c\x01\x02")));
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(std::string("\x10\x80")));
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(std::string("\x9e\x08\x01")));
+    // An unknown operation.
+    EXPECT_FALSE(dwarf::DwarfExpression::compile(std::string("\x01")));
+    // DW_OP_call2 compiles, but isn't supported.
+    EXPECT_TRUE(dwarf::DwarfExpression::compile(std::string("\x98\x10\x20")));
+    EXPECT_FALSE(evaluate("\x98\x10\x20"));
+    // Operations with nothing to read from.
+    EXPECT_FALSE(evaluate("\x9c", {}));
+    EXPECT_FALSE(evaluate(std::string("\x73\x00", 2), {}));
+}
+
+} // namespace
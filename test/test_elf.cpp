@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+
+#include "elf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char* path = R"(clang-7.0.0/solver/solver)";
+
+using namespace smldbg;
+
+TEST(TestElf, Mapped_Sections_Match_Stream_Sections) {
+    // Arrange
+    elf::ELF mapped(path);
+    elf::ELF streamed(std::make_unique<std::ifstream>(path));
+
+    const std::vector<std::string> sections = {
+        ".debug_info", ".debug_abbrev", ".debug_line", ".debug_str",
+        ".text"};
+
+    // Act / Assert
+    for (const auto& section : sections) {
+        const elf::ELFSection mapped_section =
+            mapped.get_section_data(section);
+        const elf::ELFSection streamed_section =
+            streamed.get_section_data(section);
+        ASSERT_EQ(mapped_section.size, streamed_section.size) << section;
+        ASSERT_GT(mapped_section.size, 0) << section;
+        EXPECT_EQ(std::memcmp(mapped_section.data, streamed_section.data,
+                              mapped_section.size),
+                  0)
+            << section;
+    }
+
+    // Missing sections are empty.
+    EXPECT_EQ(mapped.get_section_data(".not_a_section").size, 0);
+}
+
+TEST(TestElf, Program_Headers) {
+    // Arrange
+    elf::ELF elf(path);
+
+    // Act
+    const std::vector<elf::ELFProgramHeader>& headers = elf.program_headers();
+
+    // Assert
+    ASSERT_EQ(headers.size(), elf.file_header().E_PHNUM);
+    EXPECT_TRUE(std::any_of(headers.begin(), headers.end(),
+                            [](const elf::ELFProgramHeader& header) {
+                                return header.P_TYPE == elf::PT_LOAD;
+                            }));
+
+    // The test executable is linked at a fixed address.
+    EXPECT_FALSE(elf.is_position_independent());
+}
+
+} // namespace
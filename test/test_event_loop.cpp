@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+
+#include "event_loop.h"
+
+#include <chrono>
+#include <string_view>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace smldbg;
+
+TEST(TestEventLoop, Lines) {
+    // Arrange
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    EventLoop events(fds[0]);
+    const std::string_view input = "break main\ninterrupt\ncont";
+
+    // Act
+    ASSERT_EQ(write(fds[1], input.data(), input.size()), input.size());
+    const EventLoop::Events first = events.wait();
+    const std::size_t erased = events.erase_lines(
+        [](const std::string& line) { return line == "interrupt"; });
+    const auto line = events.next_line();
+    const auto partial = events.next_line();
+    close(fds[1]);
+    events.wait();
+    const auto last = events.next_line();
+    close(fds[0]);
+
+    // Assert
+    EXPECT_TRUE(first.input);
+    EXPECT_FALSE(first.target);
+    EXPECT_EQ(erased, 1);
+    EXPECT_EQ(line, "break main");
+    EXPECT_EQ(partial, std::nullopt); // 'cont' isn't complete yet.
+    EXPECT_EQ(last, "cont");
+    EXPECT_TRUE(events.end_of_input());
+}
+
+TEST(TestEventLoop, Child_Exit) {
+    // Arrange
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    EventLoop events(fds[0]);
+
+    // Act
+    const pid_t pid = fork();
+    if (pid == 0)
+        _exit(0);
+    events.watch_process(pid);
+    const EventLoop::Events exited = events.wait();
+    int status = 0;
+    waitpid(pid, &status, 0);
+    events.unwatch_process();
+    close(fds[0]);
+    close(fds[1]);
+
+    // Assert
+    EXPECT_TRUE(exited.target);
+    EXPECT_FALSE(exited.input);
+    EXPECT_TRUE(WIFEXITED(status));
+}
+
+TEST(TestEventLoop, Timer) {
+    // Arrange
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    EventLoop events(fds[0]);
+
+    // Act
+    events.start_timer(std::chrono::milliseconds(1));
+    const EventLoop::Events expired = events.wait();
+    events.stop_timer();
+    ASSERT_EQ(write(fds[1], "\n", 1), 1);
+    const EventLoop::Events input = events.wait();
+    close(fds[0]);
+    close(fds[1]);
+
+    // Assert
+    EXPECT_GE(expired.timer, 1);
+    EXPECT_FALSE(expired.input);
+    EXPECT_EQ(input.timer, 0);
+    EXPECT_TRUE(input.input);
+}
+
+} // namespace
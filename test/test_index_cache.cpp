@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+
+#include "index_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include <unistd.h>
+
+namespace {
+
+using namespace smldbg;
+
+LineTable::Row row(uint64_t address, uint32_t line, uint32_t file,
+                   bool end_sequence = false) {
+    return {.address = address,
+            .line = line,
+            .file = file,
+            .column = 0,
+            .is_stmt = true,
+            .basic_block = false,
+            .end_sequence = end_sequence,
+            .prologue_end = false,
+            .epilogue_begin = false};
+}
+
+// A directory for the test's caches, removed with its contents at the end of
+// the test.
+class TemporaryDirectory {
+public:
+    TemporaryDirectory()
+        : m_path(std::filesystem::temp_directory_path() /
+                 ("smldbg_test_index_cache." + std::to_string(getpid()))) {}
+    ~TemporaryDirectory() { std::filesystem::remove_all(m_path); }
+
+    const std::filesystem::path& path() const { return m_path; }
+
+private:
+    std::filesystem::path m_path;
+};
+
+// Write a cache of a couple of functions in two compile units to |path|.
+bool write_cache(const std::filesystem::path& path, std::string_view id) {
+    dwarf::AddressRangeIndex compile_units;
+    compile_units.insert(0x1000, 0x2000, 0);
+    compile_units.insert(0x2000, 0x3000, 1);
+    compile_units.finalize();
+    dwarf::AddressRangeIndex functions;
+    functions.insert(0x2000, 0x2800, 0x80);
+    functions.insert(0x1000, 0x1100, 0x40);
+    functions.finalize();
+    // The names are views, as they are of the ELF file normally.
+    const std::string names = "mainsolve_Z5solvev";
+    dwarf::NameIndex name_index;
+    name_index.insert(std::string_view(names).substr(0, 4),
+                      {.offset = 0x40, .is_compile_unit = false});
+    name_index.insert(std::string_view(names).substr(4, 5),
+                      {.offset = 0x80, .is_compile_unit = false});
+    name_index.insert(std::string_view(names).substr(9),
+                      {.offset = 0x80, .is_compile_unit = false});
+    std::unordered_map<uint64_t, LineTable> line_tables;
+    line_tables.emplace(
+        0x30, LineTable({row(0x2000, 7, 0), row(0x2010, 9, 1),
+                         row(0x2800, 0, 1, true)},
+                        {"solver.cpp", "solver.h"}, {"", "include"}));
+    line_tables.emplace(
+        0x0, LineTable({row(0x1000, 3, 0), row(0x1100, 0, 0, true)},
+                       {"main.cpp"}));
+    return dwarf::IndexCache::write(path, id, compile_units, functions,
+                                    &name_index, line_tables);
+}
+
+TEST(TestIndexCache, Round_Trip) {
+    // Arrange
+    const TemporaryDirectory directory;
+    const std::filesystem::path path = directory.path() / "build.index";
+    ASSERT_TRUE(write_cache(path, "build"));
+
+    // Act
+    const std::optional<dwarf::IndexCache> cache =
+        dwarf::IndexCache::open(path, "build");
+
+    // Assert
+    ASSERT_TRUE(cache);
+    const dwarf::AddressRangeIndex compile_units = cache->compile_unit_index();
+    EXPECT_EQ(compile_units.find(0x1800), 0);
+    EXPECT_EQ(compile_units.find(0x2000), 1);
+    EXPECT_FALSE(compile_units.find(0x3000));
+    const dwarf::AddressRangeIndex functions = cache->function_index();
+    EXPECT_EQ(functions.find(0x1010), 0x40);
+    EXPECT_EQ(functions.find(0x27ff), 0x80);
+    EXPECT_FALSE(functions.find(0x1100));
+
+    const std::optional<dwarf::NameIndex> name_index = cache->name_index();
+    ASSERT_TRUE(name_index);
+    EXPECT_EQ(name_index->size(), 3);
+    ASSERT_EQ(name_index->find("solve").size(), 1);
+    EXPECT_EQ(name_index->find("solve")[0].offset, 0x80);
+    ASSERT_EQ(name_index->find("_Z5solvev").size(), 1);
+    EXPECT_TRUE(name_index->find("solver").empty());
+
+    EXPECT_EQ(cache->line_tables(), 2);
+    const std::optional<LineTable> table = cache->line_table(0x30);
+    ASSERT_TRUE(table);
+    ASSERT_EQ(table->rows().size(), 3);
+    const LineTable::Row& match = table->rows()[*table->find(0x2020)];
+    EXPECT_EQ(match.line, 9);
+    EXPECT_EQ(table->file(match), "solver.h");
+    EXPECT_EQ(table->directory(match), "include");
+    EXPECT_TRUE(table->rows()[2].end_sequence);
+    EXPECT_TRUE(cache->line_table(0x0));
+    EXPECT_FALSE(cache->line_table(0x10));
+}
+
+TEST(TestIndexCache, Reject_Invalid_Caches) {
+    // Arrange
+    const TemporaryDirectory directory;
+    const std::filesystem::path path = directory.path() / "build.index";
+    const std::filesystem::path truncated = directory.path() / "cut.index";
+    ASSERT_TRUE(write_cache(path, "build"));
+    std::filesystem::copy_file(path, truncated);
+    std::filesystem::resize_file(truncated,
+                                 std::filesystem::file_size(path) - 1);
+    const std::filesystem::path garbage = directory.path() / "garbage.index";
+    std::ofstream(garbage) << std::string(4096, 'x');
+
+    // Act / Assert
+    EXPECT_TRUE(dwarf::IndexCache::open(path, "build"));
+    EXPECT_FALSE(dwarf::IndexCache::open(path, "other build"));
+    EXPECT_FALSE(dwarf::IndexCache::open(truncated, "build"));
+    EXPECT_FALSE(dwarf::IndexCache::open(garbage, "build"));
+    EXPECT_FALSE(dwarf::IndexCache::open(directory.path() / "missing.index",
+                                         "build"));
+}
+
+} // namespace
@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include "line_index.h"
+
+namespace {
+
+using namespace smldbg;
+
+LineTable::Row row(uint64_t address, uint32_t line, uint32_t file = 0,
+                   bool end_sequence = false) {
+    return {.address = address,
+            .line = line,
+            .file = file,
+            .column = 0,
+            .is_stmt = true,
+            .basic_block = false,
+            .end_sequence = end_sequence,
+            .prologue_end = false,
+            .epilogue_begin = false};
+}
+
+TEST(TestLineIndex, Find_Across_Tables) {
+    // Arrange
+    // Two compile units that both have code from line 5 of "util.h".
+    LineTable main_table({row(0x1000, 10), row(0x1004, 11), row(0x1008, 11),
+                          row(0x100c, 5, 1), row(0x1010, 12),
+                          row(0x1014, 0, 0, true)},
+                         {"main.cpp", "util.h"}, {"src", "include"});
+    LineTable solver_table(
+        {row(0x2000, 5, 1), row(0x2004, 20), row(0x2008, 0, 0, true)},
+        {"solver.cpp", "util.h"}, {"src", "include"});
+    LineIndex index;
+    index.insert(main_table);
+    index.insert(solver_table);
+    index.finalize();
+
+    // Act
+    const auto header = index.find("util.h", 5);
+    const auto path = index.find("src/main.cpp", 11);
+    const auto next_line = index.find("main.cpp", 6);
+
+    // Assert
+    ASSERT_EQ(header.size(), 1);
+    EXPECT_EQ(header[0].file, "util.h");
+    EXPECT_EQ(header[0].directory, "include");
+    ASSERT_EQ(header[0].addresses.size(), 2);
+    EXPECT_EQ(header[0].addresses[0], 0x100c);
+    EXPECT_EQ(header[0].addresses[1], 0x2000);
+
+    // Only the first row of line 11 starts it.
+    ASSERT_EQ(path.size(), 1);
+    ASSERT_EQ(path[0].addresses.size(), 1);
+    EXPECT_EQ(path[0].addresses[0], 0x1004);
+
+    ASSERT_EQ(next_line.size(), 1);
+    EXPECT_EQ(next_line[0].line, 10);
+    EXPECT_EQ(next_line[0].addresses[0], 0x1000);
+
+    EXPECT_TRUE(index.find("main.cpp", 13).empty());
+    EXPECT_TRUE(index.find("ain.cpp", 10).empty());
+    EXPECT_TRUE(index.find("other/main.cpp", 10).empty());
+}
+
+TEST(TestLineIndex, Find_Skips_Prologue) {
+    // Arrange
+    LineTable::Row prologue_end = row(0x1008, 4);
+    prologue_end.prologue_end = true;
+    LineTable table({row(0x1000, 3), prologue_end, row(0x1010, 0, 0, true)},
+                    {"main.cpp"});
+    LineIndex index;
+    index.insert(table);
+    index.finalize();
+
+    // Act
+    const auto matches = index.find("main.cpp", 3);
+
+    // Assert
+    ASSERT_EQ(matches.size(), 1);
+    ASSERT_EQ(matches[0].addresses.size(), 1);
+    EXPECT_EQ(matches[0].addresses[0], 0x1008);
+}
+
+} // namespace
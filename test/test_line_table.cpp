@@ -0,0 +1,44 @@
+#include "gtest/gtest.h"
+
+#include "line_table.h"
+
+namespace {
+
+using namespace smldbg;
+
+LineTable::Row row(uint64_t address, uint32_t line, bool end_sequence = false) {
+    return {.address = address,
+            .line = line,
+            .file = 0,
+            .column = 0,
+            .is_stmt = true,
+            .basic_block = false,
+            .end_sequence = end_sequence,
+            .prologue_end = false,
+            .epilogue_begin = false};
+}
+
+TEST(TestLineTable, Find_Across_Unordered_Sequences) {
+    // Arrange
+    // Two sequences, emitted in reverse address order. The second sequence
+    // starts exactly where the first one ends.
+    LineTable table(
+        {
+            row(0x2000, 20), row(0x2008, 21), row(0x2010, 0, true), // Seq. B
+            row(0x1000, 10), row(0x1004, 11), row(0x2000, 0, true), // Seq. A
+        },
+        {"main.cpp"});
+
+    // Act / Assert
+    ASSERT_EQ(table.rows().front().address, 0x1000);
+    EXPECT_EQ(table.rows()[*table.find(0x1000)].line, 10);
+    EXPECT_EQ(table.rows()[*table.find(0x1003)].line, 10);
+    EXPECT_EQ(table.rows()[*table.find(0x1fff)].line, 11);
+    EXPECT_EQ(table.rows()[*table.find(0x2000)].line, 20);
+    EXPECT_EQ(table.rows()[*table.find(0x200f)].line, 21);
+    EXPECT_EQ(table.file(table.rows()[*table.find(0x200f)]), "main.cpp");
+    EXPECT_FALSE(table.find(0x0fff));
+    EXPECT_FALSE(table.find(0x2010)); // Past the end of the last sequence.
+}
+
+} // namespace
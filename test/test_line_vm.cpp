@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include "dwarf_builder.h"
+#include "line_vm.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace {
+
+using namespace smldbg;
+using test::append;
+using test::append_sleb;
+using test::append_uleb;
+using test::patch_unit_length;
+
+TEST(TestLineVM, Version_5_Header) {
+    // Arrange
+    // Paths are offsets into .debug_line_str. Directory 0 is the compilation
+    // directory, so only files in directory 1 have an include directory.
+    std::string debug_line_str("/src\0include\0main.c\0util.h\0", 27);
+
+    // Section 6.2.4
+    // http://www.dwarfstd.org/doc/DWARF5.pdf
+    std::string debug_line;
+    append<uint32_t>(debug_line, 0); // unit_length, patched below.
+    append<uint16_t>(debug_line, 5); // version
+    append<uint8_t>(debug_line, 8);  // address_size
+    append<uint8_t>(debug_line, 0);  // segment_selector_size
+    append<uint32_t>(debug_line, 0); // header_length, patched below.
+    const std::size_t header_start = debug_line.size();
+    debug_line += "\x01\x01\x01"; // Instruction lengths and default_is_stmt.
+    append<int8_t>(debug_line, -5); // line_base
+    append<uint8_t>(debug_line, 14); // line_range
+    append<uint8_t>(debug_line, 13); // opcode_base
+    // standard_opcode_lengths
+    debug_line += std::string(
+        "\x00\x01\x01\x01\x01\x00\x00\x00\x01\x00\x00\x01", 12);
+    // Directories: DW_LNCT_path DW_FORM_line_strp.
+    debug_line += "\x01\x01\x1f\x02";
+    append<uint32_t>(debug_line, 0);
+    append<uint32_t>(debug_line, 5);
+    // Files: DW_LNCT_path DW_FORM_line_strp, DW_LNCT_directory_index
+    // DW_FORM_udata.
+    debug_line += "\x02\x01\x1f\x02\x0f\x02";
+    append<uint32_t>(debug_line, 13);
+    append_uleb(debug_line, 0);
+    append<uint32_t>(debug_line, 20);
+    append_uleb(debug_line, 1);
+    const uint32_t header_length = debug_line.size() - header_start;
+    std::memcpy(debug_line.data() + header_start - sizeof(uint32_t),
+                &header_length, sizeof(header_length));
+
+    // DW_LNE_set_address 0x1000, DW_LNS_set_file 0, DW_LNS_copy, then
+    // DW_LNS_advance_pc 4, DW_LNS_set_file 1, DW_LNS_advance_line 2,
+    // DW_LNS_copy, then DW_LNS_advance_pc 4, DW_LNE_end_sequence.
+    debug_line += std::string("\x00\x09\x02", 3);
+    append<uint64_t>(debug_line, 0x1000);
+    debug_line += std::string("\x04\x00\x01\x02\x04\x04\x01\x03", 8);
+    append_sleb(debug_line, 2);
+    debug_line += std::string("\x01\x02\x04\x00\x01\x01", 6);
+    patch_unit_length(debug_line);
+
+    // Act
+    LineVM vm(debug_line.data(), nullptr, debug_line_str.data());
+    vm.exec();
+    const LineTable table = vm.compact_table();
+
+    // Assert
+    ASSERT_EQ(table.file_names().size(), 2);
+    EXPECT_EQ(table.file_names()[0], "main.c");
+    EXPECT_EQ(table.file_names()[1], "util.h");
+    EXPECT_EQ(table.file_directories()[0], "");
+    EXPECT_EQ(table.file_directories()[1], "include");
+    ASSERT_EQ(table.rows().size(), 3);
+    const LineTable::Row& first = table.rows()[*table.find(0x1000)];
+    EXPECT_EQ(table.file(first), "main.c");
+    EXPECT_EQ(first.line, 1);
+    const LineTable::Row& second = table.rows()[*table.find(0x1004)];
+    EXPECT_EQ(table.file(second), "util.h");
+    EXPECT_EQ(table.directory(second), "include");
+    EXPECT_EQ(second.line, 3);
+}
+
+} // namespace
@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+
+#include "dwarf_builder.h"
+#include "location_list.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace {
+
+using namespace smldbg;
+using test::append;
+using test::append_uleb;
+
+// Return the register |expression| is just DW_OP_reg* of, if it is one.
+std::optional<uint64_t> reg(const dwarf::DwarfExpression* expression) {
+    if (!expression)
+        return std::nullopt;
+    return expression->register_number();
+}
+
+TEST(TestLocationList, Debug_Loc) {
+    // Arrange
+    // Some padding, then a list of an entry relative to the compile unit's
+    // base address, a base address selection entry and an entry relative to
+    // the new base.
+    std::string section = "pad";
+    append<uint64_t>(section, 0x10);
+    append<uint64_t>(section, 0x20);
+    append<uint16_t>(section, 1);
+    section += "\x55"; // DW_OP_reg5
+    append<uint64_t>(section, ~uint64_t(0));
+    append<uint64_t>(section, 0x4000);
+    append<uint64_t>(section, 0x0);
+    append<uint64_t>(section, 0x8);
+    append<uint16_t>(section, 1);
+    section += "\x53"; // DW_OP_reg3
+    append<uint64_t>(section, 0);
+    append<uint64_t>(section, 0);
+
+    // Act
+    const std::optional<dwarf::LocationList> list =
+        dwarf::LocationList::read_debug_loc(section, 3, 0x1000, 4, 8);
+
+    // Assert
+    ASSERT_TRUE(list);
+    ASSERT_EQ(list->entries().size(), 2);
+    EXPECT_FALSE(list->find(0x100f));
+    EXPECT_EQ(reg(list->find(0x1010)), 5);
+    EXPECT_EQ(reg(list->find(0x101f)), 5);
+    EXPECT_FALSE(list->find(0x1020));
+    EXPECT_EQ(reg(list->find(0x4000)), 3);
+    EXPECT_FALSE(list->find(0x4008));
+    EXPECT_FALSE(dwarf::LocationList::read_debug_loc(section, section.size(),
+                                                     0, 4, 8));
+}
+
+TEST(TestLocationList, Debug_Loclists) {
+    // Arrange
+    const auto debug_addr = [](uint64_t index) -> std::optional<uint64_t> {
+        if (index == 2)
+            return 0x3000;
+        return std::nullopt;
+    };
+    std::string section;
+    // DW_LLE_offset_pair 0x10 0x20 DW_OP_reg5
+    section += "\x04";
+    append_uleb(section, 0x10);
+    append_uleb(section, 0x20);
+    section += "\x01\x55";
+    // DW_LLE_base_address 0x2000, DW_LLE_offset_pair 0 0x8 DW_OP_reg0
+    section += "\x06";
+    append<uint64_t>(section, 0x2000);
+    section += std::string("\x04\x00\x08\x01\x50", 5);
+    // DW_LLE_startx_length 2 0x100 DW_OP_reg1
+    section += "\x03\x02";
+    append_uleb(section, 0x100);
+    section += "\x01\x51";
+    // DW_LLE_start_end 0x5000 0x5010 DW_OP_reg2
+    section += "\x07";
+    append<uint64_t>(section, 0x5000);
+    append<uint64_t>(section, 0x5010);
+    section += "\x01\x52";
+    // DW_LLE_default_location DW_OP_reg3, DW_LLE_end_of_list
+    section += std::string("\x05\x01\x53\x00", 4);
+
+    // Act
+    const std::optional<dwarf::LocationList> list =
+        dwarf::LocationList::read_debug_loclists(section, 0, 0x1000, 4, 8,
+                                                 debug_addr);
+
+    // Assert
+    ASSERT_TRUE(list);
+    ASSERT_EQ(list->entries().size(), 4);
+    EXPECT_EQ(reg(list->find(0x1018)), 5);
+    EXPECT_EQ(reg(list->find(0x2004)), 0);
+    EXPECT_EQ(reg(list->find(0x30ff)), 1);
+    EXPECT_EQ(reg(list->find(0x5000)), 2);
+    // Anywhere else is the default location.
+    EXPECT_EQ(reg(list->find(0x0)), 3);
+    EXPECT_EQ(reg(list->find(0x3100)), 3);
+    // Address indexes have to be resolved.
+    EXPECT_FALSE(dwarf::LocationList::read_debug_loclists(section, 0, 0x1000,
+                                                          4, 8, {}));
+}
+
+TEST(TestLocationList, Overlaps_And_Single_Expressions) {
+    // Arrange
+    // Out of order and overlapping entries: [0x20, 0x40) DW_OP_reg1,
+    // [0x10, 0x30) DW_OP_reg2, and an empty range [0x50, 0x50) DW_OP_reg3.
+    std::string section;
+    section += "\x07";
+    append<uint64_t>(section, 0x20);
+    append<uint64_t>(section, 0x40);
+    section += "\x01\x51\x07";
+    append<uint64_t>(section, 0x10);
+    append<uint64_t>(section, 0x30);
+    section += "\x01\x52\x07";
+    append<uint64_t>(section, 0x50);
+    append<uint64_t>(section, 0x50);
+    section += std::string("\x01\x53\x00", 3);
+    const auto expression =
+        dwarf::DwarfExpression::compile(std::string("\x54"));
+    ASSERT_TRUE(expression);
+
+    // Act
+    const std::optional<dwarf::LocationList> list =
+        dwarf::LocationList::read_debug_loclists(section, 0, 0, 4, 8, {});
+    const dwarf::LocationList single(*expression);
+
+    // Assert
+    ASSERT_TRUE(list);
+    ASSERT_EQ(list->entries().size(), 2);
+    EXPECT_EQ(list->entries()[0].low, 0x10);
+    EXPECT_EQ(list->entries()[1].low, 0x30);
+    EXPECT_EQ(reg(list->find(0x2f)), 2);
+    EXPECT_EQ(reg(list->find(0x30)), 1);
+    EXPECT_FALSE(list->find(0x50));
+    EXPECT_TRUE(single.entries().empty());
+    EXPECT_EQ(reg(single.find(0)), 4);
+    EXPECT_EQ(reg(single.find(~uint64_t(0))), 4);
+}
+
+TEST(TestLocationList, Invalid_Lists) {
+    // Act & Assert
+    // An unknown entry kind.
+    EXPECT_FALSE(dwarf::LocationList::read_debug_loclists(
+        std::string("\x0a\x00", 2), 0, 0, 4, 8, {}));
+    // A list without an end.
+    EXPECT_FALSE(dwarf::LocationList::read_debug_loclists(
+        std::string("\x04\x00\x08\x01\x50", 5), 0, 0, 4, 8, {}));
+    // An expression that can't be decoded (DW_OP_const4u with one byte).
+    EXPECT_FALSE(dwarf::LocationList::read_debug_loclists(
+        std::string("\x04\x00\x08\x02\x0c\x01\x00", 7), 0, 0, 4, 8, {}));
+    // An empty section.
+    EXPECT_FALSE(dwarf::LocationList::read_debug_loc({}, 0, 0, 4, 8));
+}
+
+} // namespace
@@ -0,0 +1,124 @@
+#include "gtest/gtest.h"
+
+#include "dwarf_builder.h"
+#include "name_index.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace smldbg;
+using test::append;
+
+// Append |string| to |bytes|, null terminated.
+void append(std::vector<char>& bytes, const std::string& string) {
+    bytes.insert(bytes.end(), string.begin(), string.end());
+    bytes.push_back('\0');
+}
+
+TEST(TestNameIndex, Read_Debug_Names) {
+    // Arrange
+    std::vector<char> debug_str;
+    append(debug_str, std::string("foo"));
+    append(debug_str, std::string("bar"));
+
+    // A name index covering a single compile unit at offset 0x40 with two
+    // names. "foo" is a function, "bar" is a variable.
+    std::vector<char> debug_names;
+    append<uint32_t>(debug_names, 0);    // unit_length, patched below.
+    append<uint16_t>(debug_names, 5);    // version
+    append<uint16_t>(debug_names, 0);    // padding
+    append<uint32_t>(debug_names, 1);    // comp_unit_count
+    append<uint32_t>(debug_names, 0);    // local_type_unit_count
+    append<uint32_t>(debug_names, 0);    // foreign_type_unit_count
+    append<uint32_t>(debug_names, 0);    // bucket_count
+    append<uint32_t>(debug_names, 2);    // name_count
+    append<uint32_t>(debug_names, 13);   // abbrev_table_size
+    append<uint32_t>(debug_names, 0);    // augmentation_string_size
+    append<uint32_t>(debug_names, 0x40); // CU list
+    append<uint32_t>(debug_names, 0);    // String offset of "foo".
+    append<uint32_t>(debug_names, 4);    // String offset of "bar".
+    append<uint32_t>(debug_names, 0);    // Entry offset of "foo".
+    append<uint32_t>(debug_names, 6);    // Entry offset of "bar".
+    // Abbreviations 1 (DW_TAG_subprogram) and 2 (DW_TAG_variable), both with
+    // a DW_IDX_die_offset in DW_FORM_ref4.
+    for (const uint8_t byte : {1, 0x2e, 3, 0x13, 0, 0, 2, 0x34, 3, 0x13, 0, 0})
+        append<uint8_t>(debug_names, byte);
+    append<uint8_t>(debug_names, 0); // End of abbreviations.
+    // Entry pool.
+    append<uint8_t>(debug_names, 1);
+    append<uint32_t>(debug_names, 0x2a);
+    append<uint8_t>(debug_names, 0);
+    append<uint8_t>(debug_names, 2);
+    append<uint32_t>(debug_names, 0x30);
+    append<uint8_t>(debug_names, 0);
+    const uint32_t unit_length = debug_names.size() - sizeof(uint32_t);
+    std::memcpy(debug_names.data(), &unit_length, sizeof(unit_length));
+
+    // Act
+    auto index = dwarf::NameIndex::read_debug_names(
+        {.data = debug_names.data(), .size = debug_names.size()},
+        debug_str.data());
+
+    // Assert
+    ASSERT_TRUE(index);
+    EXPECT_EQ(index->source(), dwarf::NameIndex::Source::debug_names);
+    const auto foo = index->find("foo");
+    ASSERT_EQ(foo.size(), 1);
+    EXPECT_EQ(foo[0].offset, 0x40 + 0x2a);
+    EXPECT_FALSE(foo[0].is_compile_unit);
+    EXPECT_TRUE(index->find("bar").empty());
+}
+
+TEST(TestNameIndex, Read_Gdb_Index) {
+    // Arrange
+    std::vector<char> gdb_index;
+    append<uint32_t>(gdb_index, 7);  // version
+    append<uint32_t>(gdb_index, 24); // CU list
+    append<uint32_t>(gdb_index, 56); // Types CU list
+    append<uint32_t>(gdb_index, 56); // Address area
+    append<uint32_t>(gdb_index, 56); // Symbol table
+    append<uint32_t>(gdb_index, 80); // Constant pool
+    // Two compile units.
+    append<uint64_t>(gdb_index, 0x0);
+    append<uint64_t>(gdb_index, 0x100);
+    append<uint64_t>(gdb_index, 0x100);
+    append<uint64_t>(gdb_index, 0x80);
+    // Symbol table with an empty slot.
+    append<uint32_t>(gdb_index, 0);
+    append<uint32_t>(gdb_index, 0);
+    append<uint32_t>(gdb_index, 0);  // "ns::foo"
+    append<uint32_t>(gdb_index, 8);  // CU vector
+    append<uint32_t>(gdb_index, 20); // "value"
+    append<uint32_t>(gdb_index, 26); // CU vector
+    // Constant pool.
+    append(gdb_index, std::string("ns::foo"));
+    append<uint32_t>(gdb_index, 1);
+    append<uint32_t>(gdb_index, (3u << 28) | 1); // Function in CU 1.
+    append<uint32_t>(gdb_index, 1);              // Padding.
+    append(gdb_index, std::string("value"));
+    append<uint32_t>(gdb_index, 1);
+    append<uint32_t>(gdb_index, (2u << 28) | 0); // Variable in CU 0.
+
+    // Act
+    auto index = dwarf::NameIndex::read_gdb_index(
+        {.data = gdb_index.data(), .size = gdb_index.size()});
+
+    // Assert
+    ASSERT_TRUE(index);
+    const auto foo = index->find("ns::foo");
+    ASSERT_EQ(foo.size(), 1);
+    EXPECT_EQ(foo[0].offset, 0x100);
+    EXPECT_TRUE(foo[0].is_compile_unit);
+    EXPECT_TRUE(index->find("value").empty());
+}
+
+TEST(TestNameIndex, Read_Missing_Sections) {
+    // Act / Assert
+    EXPECT_FALSE(dwarf::NameIndex::read_debug_names({}, nullptr));
+    EXPECT_FALSE(dwarf::NameIndex::read_gdb_index({}));
+}
+
+} // namespace
@@ -0,0 +1,43 @@
+#include "gtest/gtest.h"
+
+#include "profile.h"
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+using namespace smldbg;
+
+TEST(TestProfile, Write_Folded) {
+    // Arrange
+    Profile profile;
+    profile.add_sample({0x1010, 0x2020, 0x3030});
+    profile.add_sample({0x1010, 0x2020, 0x3030});
+    profile.add_sample({0x1018, 0x2020, 0x3030}); // Elsewhere in the same.
+    profile.add_sample({0x4040, 0x3030});
+    int lookups = 0;
+    const auto symbolize = [&](uint64_t pc) -> std::string {
+        ++lookups;
+        if (pc >= 0x1000 && pc < 0x2000)
+            return "leaf";
+        if (pc == 0x2020)
+            return "middle";
+        if (pc == 0x3030)
+            return "main";
+        return "operator;";
+    };
+    std::ostringstream os;
+
+    // Act
+    const std::size_t symbolized = profile.write_folded(os, symbolize);
+
+    // Assert
+    EXPECT_EQ(profile.samples(), 4);
+    EXPECT_EQ(profile.stacks(), 3);
+    EXPECT_EQ(symbolized, 5);
+    EXPECT_EQ(lookups, 5); // Once for each distinct program counter.
+    EXPECT_EQ(os.str(), "main;middle;leaf 3\nmain;operator: 1\n");
+}
+
+} // namespace
@@ -0,0 +1,43 @@
+#include "gtest/gtest.h"
+
+#include "thread_table.h"
+
+namespace {
+
+using namespace smldbg;
+
+TEST(TestThreadTable, Numbering) {
+    // Arrange
+    ThreadTable threads;
+
+    // Act
+    Thread& main_thread = threads.add(100);
+    threads.add(102);
+    threads.remove(102);
+    Thread& added = threads.add(101);
+
+    // Assert
+    EXPECT_EQ(main_thread.number, 1);
+    EXPECT_EQ(added.number, 3); // Numbers aren't reused.
+    EXPECT_EQ(threads.size(), 2);
+    EXPECT_EQ(threads.find(102), nullptr);
+    EXPECT_EQ(threads.find_number(3), &added);
+    EXPECT_EQ(threads.find_number(2), nullptr);
+}
+
+TEST(TestThreadTable, Add_Existing) {
+    // Arrange
+    ThreadTable threads;
+    Thread& thread = threads.add(100);
+    thread.stop_reason = StopReason::created;
+
+    // Act
+    Thread& again = threads.add(100);
+
+    // Assert
+    EXPECT_EQ(&again, &thread);
+    EXPECT_EQ(again.stop_reason, StopReason::created);
+    EXPECT_EQ(threads.size(), 1);
+}
+
+} // namespace
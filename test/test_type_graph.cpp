@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+
+#include "dwarf_builder.h"
+#include "type_graph.h"
+
+#include <cstdint>
+#include <string>
+
+namespace {
+
+using namespace smldbg;
+using test::append;
+
+dwarf::Type base_type(std::string_view name, uint64_t byte_size,
+                      dwarf::DW_ATE encoding) {
+    return {.kind = dwarf::TypeKind::base,
+            .name = name,
+            .byte_size = byte_size,
+            .encoding = encoding};
+}
+
+TEST(TestTypeGraph, Format_BaseTypes) {
+    // Arrange
+    const dwarf::Type int_type =
+        base_type("int", 4, dwarf::DW_ATE::DW_ATE_signed);
+    const dwarf::Type char_type =
+        base_type("char", 1, dwarf::DW_ATE::DW_ATE_signed_char);
+    const dwarf::Type double_type =
+        base_type("double", 8, dwarf::DW_ATE::DW_ATE_float);
+    const dwarf::Type bool_type =
+        base_type("bool", 1, dwarf::DW_ATE::DW_ATE_boolean);
+    std::string minus_two, letter, half, yes;
+    append<int32_t>(minus_two, -2);
+    append<char>(letter, 'A');
+    append<double>(half, 0.5);
+    append<uint8_t>(yes, 1);
+
+    // Act / Assert
+    EXPECT_EQ(dwarf::format_value(&int_type, minus_two), "-2");
+    EXPECT_EQ(dwarf::format_value(&char_type, letter), "65 'A'");
+    EXPECT_EQ(dwarf::format_value(&double_type, half), "0.5");
+    EXPECT_EQ(dwarf::format_value(&bool_type, yes), "true");
+    EXPECT_EQ(dwarf::format_value(&int_type, letter), "<unavailable>");
+}
+
+TEST(TestTypeGraph, Format_Aggregates) {
+    // Arrange
+    // struct { int x; const int* p; int values[2][2]; char name[4]; }
+    const dwarf::Type int_type =
+        base_type("int", 4, dwarf::DW_ATE::DW_ATE_signed);
+    const dwarf::Type char_type =
+        base_type("char", 1, dwarf::DW_ATE::DW_ATE_signed_char);
+    const dwarf::Type const_int = {.kind = dwarf::TypeKind::const_type,
+                                   .target = &int_type};
+    const dwarf::Type pointer = {.kind = dwarf::TypeKind::pointer,
+                                 .byte_size = 8,
+                                 .target = &const_int};
+    const dwarf::Type matrix = {.kind = dwarf::TypeKind::array,
+                                .target = &int_type,
+                                .dimensions = {2, 2}};
+    const dwarf::Type name = {.kind = dwarf::TypeKind::array,
+                              .target = &char_type,
+                              .dimensions = {4}};
+    const dwarf::Type structure = {
+        .kind = dwarf::TypeKind::structure,
+        .name = "S",
+        .byte_size = 36,
+        .members = {{.name = "x", .offset = 0, .type = &int_type},
+                    {.name = "p", .offset = 8, .type = &pointer},
+                    {.name = "values", .offset = 16, .type = &matrix},
+                    {.name = "name", .offset = 32, .type = &name}}};
+    std::string bytes;
+    append<int32_t>(bytes, 7);
+    append<int32_t>(bytes, 0);
+    append<uint64_t>(bytes, 0x1000);
+    for (int32_t value : {1, 2, 3, 4})
+        append<int32_t>(bytes, value);
+    bytes += std::string("ab\0", 4);
+
+    // Act / Assert
+    EXPECT_EQ(pointer.display_name(), "const int *");
+    EXPECT_EQ(matrix.size(), 16);
+    EXPECT_EQ(dwarf::format_value(&structure, bytes),
+              "{x = 7, p = 0x1000, values = {{1, 2}, {3, 4}}, name = \"ab\"}");
+    EXPECT_EQ(dwarf::format_value(&structure, bytes, {.max_depth = 1}),
+              "{x = 7, p = 0x1000, values = {...}, name = \"ab\"}");
+    EXPECT_EQ(dwarf::format_value(&matrix, bytes.substr(16),
+                                  {.max_elements = 1}),
+              "{{1, ...}, ...}");
+}
+
+TEST(TestTypeGraph, Format_EnumerationsAndBitFields) {
+    // Arrange
+    const dwarf::Type int_type =
+        base_type("int", 4, dwarf::DW_ATE::DW_ATE_signed);
+    const dwarf::Type colour = {.kind = dwarf::TypeKind::enumeration,
+                                .name = "Colour",
+                                .byte_size = 4,
+                                .target = &int_type,
+                                .enumerators = {{"red", 0}, {"green", 5}}};
+    // struct { int a : 3; int b : 5; }
+    const dwarf::Type flags = {
+        .kind = dwarf::TypeKind::structure,
+        .byte_size = 4,
+        .members = {{.name = "a", .offset = 0, .type = &int_type,
+                     .bit_offset = 0, .bit_size = 3},
+                    {.name = "b", .offset = 0, .type = &int_type,
+                     .bit_offset = 3, .bit_size = 5}}};
+    std::string green, unknown, fields;
+    append<int32_t>(green, 5);
+    append<int32_t>(unknown, -1);
+    append<uint32_t>(fields, 0b11101'010); // b = -3, a = 2
+
+    // Act / Assert
+    EXPECT_EQ(dwarf::format_value(&colour, green), "green");
+    EXPECT_EQ(dwarf::format_value(&colour, unknown), "-1");
+    EXPECT_EQ(dwarf::format_value(&flags, fields), "{a = 2, b = -3}");
+}
+
+TEST(TestTypeGraph, Encode) {
+    // Arrange
+    const dwarf::Type short_type =
+        base_type("short", 2, dwarf::DW_ATE::DW_ATE_signed);
+    const dwarf::Type float_type =
+        base_type("float", 4, dwarf::DW_ATE::DW_ATE_float);
+    const dwarf::Type colour = {.kind = dwarf::TypeKind::enumeration,
+                                .byte_size = 4,
+                                .enumerators = {{"red", 0}, {"green", 5}}};
+    const dwarf::Type typedef_type = {.kind = dwarf::TypeKind::typedef_type,
+                                      .name = "colour_t",
+                                      .target = &colour};
+    const dwarf::Type structure = {.kind = dwarf::TypeKind::structure,
+                                   .byte_size = 4};
+    std::string minus_one, hex, quarter, green;
+    append<int16_t>(minus_one, -1);
+    append<int16_t>(hex, 0x10);
+    append<float>(quarter, 0.25f);
+    append<int32_t>(green, 5);
+
+    // Act / Assert
+    EXPECT_EQ(dwarf::encode_value(&short_type, "-1"), minus_one);
+    EXPECT_EQ(dwarf::encode_value(&short_type, "0x10"), hex);
+    EXPECT_EQ(dwarf::encode_value(&float_type, "0.25"), quarter);
+    EXPECT_EQ(dwarf::encode_value(&typedef_type, "green"), green);
+    EXPECT_FALSE(dwarf::encode_value(&short_type, "12abc"));
+    EXPECT_FALSE(dwarf::encode_value(&structure, "1"));
+    EXPECT_FALSE(dwarf::encode_value(nullptr, "1"));
+}
+
+} // namespace
@@ -20,4 +20,45 @@ TEST(TestUtil, Tokenize) {
               (std::vector<std::string>{"hello", "world", "more", "tokens"}));
 }
 
+TEST(TestUtil, Is_Line_Location) {
+    // Act / Assert
+    EXPECT_TRUE(smldbg::util::is_line_location("main.cpp:12"));
+    EXPECT_FALSE(smldbg::util::is_line_location("main"));
+    EXPECT_FALSE(smldbg::util::is_line_location("main.cpp:"));
+    EXPECT_FALSE(smldbg::util::is_line_location("ns::function"));
+    EXPECT_FALSE(smldbg::util::is_line_location("ns::12"));
+}
+
+TEST(TestUtil, Unqualified_Name) {
+    // Act / Assert
+    EXPECT_EQ(smldbg::util::unqualified_name("main"), "main");
+    EXPECT_EQ(smldbg::util::unqualified_name("ns::Foo::bar"), "bar");
+    EXPECT_EQ(smldbg::util::unqualified_name("ns::Foo<a::b>::bar"), "bar");
+    EXPECT_EQ(smldbg::util::unqualified_name("ns::bar(a::b)"), "bar(a::b)");
+}
+
+TEST(TestUtil, Parse_Duration) {
+    // Act / Assert
+    EXPECT_EQ(smldbg::util::parse_duration("30s"), std::chrono::seconds(30));
+    EXPECT_EQ(smldbg::util::parse_duration("30"), std::chrono::seconds(30));
+    EXPECT_EQ(smldbg::util::parse_duration("250ms"),
+              std::chrono::milliseconds(250));
+    EXPECT_EQ(smldbg::util::parse_duration("2m"), std::chrono::minutes(2));
+    EXPECT_EQ(smldbg::util::parse_duration("s"), std::nullopt);
+    EXPECT_EQ(smldbg::util::parse_duration("10 s"), std::nullopt);
+    EXPECT_EQ(smldbg::util::parse_duration("-1s"), std::nullopt);
+}
+
+TEST(TestUtil, Hash) {
+    // Arrange
+    const std::string_view bytes = "0123456789abcdefghij";
+
+    // Act / Assert
+    EXPECT_EQ(smldbg::util::hash(bytes), smldbg::util::hash(bytes));
+    EXPECT_NE(smldbg::util::hash(bytes), smldbg::util::hash(bytes.substr(1)));
+    EXPECT_NE(smldbg::util::hash(bytes), smldbg::util::hash(bytes, 1));
+    EXPECT_NE(smldbg::util::hash(""),
+              smldbg::util::hash(std::string_view("\0", 1)));
+}
+
 } // namespace
\ No newline at end of file
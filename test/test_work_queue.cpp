@@ -0,0 +1,39 @@
+#include "gtest/gtest.h"
+
+#include "work_queue.h"
+
+#include <atomic>
+#include <vector>
+
+namespace {
+
+using namespace smldbg;
+
+TEST(TestWorkQueue, Run) {
+    for (unsigned threads : {1u, 2u, 8u}) {
+        // Arrange
+        WorkQueue queue(threads);
+        std::vector<std::atomic<int>> calls(1000);
+
+        // Act
+        queue.run(calls.size(), [&](std::size_t i) { ++calls[i]; });
+
+        // Assert
+        for (const auto& count : calls)
+            ASSERT_EQ(count, 1);
+    }
+}
+
+TEST(TestWorkQueue, Run_No_Tasks) {
+    // Arrange
+    WorkQueue queue(4);
+    bool called = false;
+
+    // Act
+    queue.run(0, [&](std::size_t) { called = true; });
+
+    // Assert
+    EXPECT_FALSE(called);
+}
+
+} // namespace
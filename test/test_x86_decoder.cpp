@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+
+#include "x86_decoder.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using namespace smldbg;
+
+std::optional<x86::Instruction> decode(std::vector<uint8_t> bytes) {
+    return x86::decode(bytes, 0x1000);
+}
+
+TEST(TestX86Decoder, Decode_Control_Flow) {
+    // Arrange
+    // call 0x1105; call *%r8 (ff /2 with REX.B); je 0xff0; ret; syscall;
+    // jmp *0x10(%rip).
+    const std::vector<uint8_t> call = {0xe8, 0x00, 0x01, 0x00, 0x00};
+    const std::vector<uint8_t> indirect_call = {0x41, 0xff, 0xd0};
+    const std::vector<uint8_t> jcc = {0x74, 0xee};
+    const std::vector<uint8_t> ret = {0xc3};
+    const std::vector<uint8_t> syscall = {0x0f, 0x05};
+    const std::vector<uint8_t> indirect_jump = {0xff, 0x25, 0x10,
+                                                0x00, 0x00, 0x00};
+
+    // Act
+    const auto call_instruction = decode(call);
+    const auto indirect_call_instruction = decode(indirect_call);
+    const auto jcc_instruction = decode(jcc);
+    const auto ret_instruction = decode(ret);
+    const auto syscall_instruction = decode(syscall);
+    const auto indirect_jump_instruction = decode(indirect_jump);
+
+    // Assert
+    ASSERT_TRUE(call_instruction);
+    EXPECT_EQ(call_instruction->length, 5);
+    EXPECT_EQ(call_instruction->control_flow, x86::ControlFlow::call);
+    EXPECT_EQ(call_instruction->target, 0x1105);
+
+    ASSERT_TRUE(indirect_call_instruction);
+    EXPECT_EQ(indirect_call_instruction->length, 3);
+    EXPECT_EQ(indirect_call_instruction->control_flow, x86::ControlFlow::call);
+    EXPECT_FALSE(indirect_call_instruction->target);
+
+    ASSERT_TRUE(jcc_instruction);
+    EXPECT_EQ(jcc_instruction->length, 2);
+    EXPECT_EQ(jcc_instruction->control_flow,
+              x86::ControlFlow::conditional_jump);
+    EXPECT_EQ(jcc_instruction->target, 0xff0);
+
+    ASSERT_TRUE(ret_instruction);
+    EXPECT_EQ(ret_instruction->length, 1);
+    EXPECT_EQ(ret_instruction->control_flow, x86::ControlFlow::ret);
+
+    ASSERT_TRUE(syscall_instruction);
+    EXPECT_EQ(syscall_instruction->length, 2);
+    EXPECT_EQ(syscall_instruction->control_flow, x86::ControlFlow::syscall);
+
+    ASSERT_TRUE(indirect_jump_instruction);
+    EXPECT_EQ(indirect_jump_instruction->length, 6);
+    EXPECT_EQ(indirect_jump_instruction->control_flow, x86::ControlFlow::jump);
+    EXPECT_FALSE(indirect_jump_instruction->target);
+}
+
+TEST(TestX86Decoder, Decode_Lengths) {
+    // Arrange
+    // movabs $0x1122334455667788, %rax; mov 0x8(%rsp,%rbx,4), %eax;
+    // mov $0x1234, %ax (operand size prefix); vpaddd %ymm2, %ymm1, %ymm0;
+    // nopw 0x0(%rax,%rax,1).
+    const std::vector<uint8_t> movabs = {0x48, 0xb8, 0x88, 0x77, 0x66,
+                                         0x55, 0x44, 0x33, 0x22, 0x11};
+    const std::vector<uint8_t> sib = {0x8b, 0x44, 0x9c, 0x08};
+    const std::vector<uint8_t> operand_size = {0x66, 0xb8, 0x34, 0x12};
+    const std::vector<uint8_t> vex = {0xc5, 0xf5, 0xfe, 0xc2};
+    const std::vector<uint8_t> nop = {0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00};
+
+    // Act & Assert
+    EXPECT_EQ(decode(movabs)->length, 10);
+    EXPECT_EQ(decode(sib)->length, 4);
+    EXPECT_EQ(decode(operand_size)->length, 4);
+    EXPECT_EQ(decode(vex)->length, 4);
+    EXPECT_EQ(decode(nop)->length, 6);
+    EXPECT_EQ(decode(nop)->control_flow, x86::ControlFlow::none);
+
+    // testl $0x1, (%rax) has an immediate, notl (%rax) doesn't.
+    EXPECT_EQ(decode({0xf7, 0x00, 0x01, 0x00, 0x00, 0x00})->length, 6);
+    EXPECT_EQ(decode({0xf7, 0x10})->length, 2);
+
+    // vaddps %zmm2, %zmm1, %zmm0 (EVEX) and movabs 0x1000, %al.
+    EXPECT_EQ(decode({0x62, 0xf1, 0x74, 0x48, 0x58, 0xc2})->length, 6);
+    EXPECT_EQ(decode({0xa0, 0x00, 0x10, 0, 0, 0, 0, 0, 0})->length, 9);
+
+    // Truncated instructions don't decode.
+    EXPECT_FALSE(decode({0xe8, 0x00, 0x01}));
+    EXPECT_FALSE(decode({}));
+}
+
+TEST(TestX86Decoder, Decode_Rip_Relative) {
+    // Arrange
+    // mov 0x10(%rip), %rax; cmpl $0x1, 0x10(%rip); vmovups 0x10(%rip), %ymm0;
+    // mov 0x8(%rbp), %eax; mov 0x10, %eax (SIB with no base, not RIP
+    // relative).
+    const std::vector<uint8_t> mov = {0x48, 0x8b, 0x05, 0x10, 0x00, 0x00, 0x00};
+    const std::vector<uint8_t> cmp = {0x83, 0x3d, 0x10, 0x00,
+                                      0x00, 0x00, 0x01};
+    const std::vector<uint8_t> vex = {0xc5, 0xfc, 0x10, 0x05,
+                                      0x10, 0x00, 0x00, 0x00};
+    const std::vector<uint8_t> rbp = {0x8b, 0x45, 0x08};
+    const std::vector<uint8_t> absolute = {0x8b, 0x04, 0x25, 0x10,
+                                           0x00, 0x00, 0x00};
+
+    // Act & Assert
+    EXPECT_EQ(decode(mov)->rip_displacement, 3);
+    EXPECT_EQ(decode(cmp)->rip_displacement, 2);
+    EXPECT_EQ(decode(cmp)->length, 7);
+    EXPECT_EQ(decode(vex)->rip_displacement, 4);
+    EXPECT_EQ(decode(rbp)->rip_displacement, 0);
+    EXPECT_EQ(decode(absolute)->rip_displacement, 0);
+}
+
+TEST(TestX86Decoder, Decode_All) {
+    // Arrange
+    // push %rbp; mov %rsp,%rbp; call 0x1009, followed by a byte
+    // that doesn't decode.
+    const std::vector<uint8_t> bytes = {0x55, 0x48, 0x89, 0xe5, 0xe8,
+                                        0x00, 0x00, 0x00, 0x00, 0x06};
+
+    // Act
+    const auto instructions = x86::decode_all(bytes, 0x1000);
+
+    // Assert
+    ASSERT_EQ(instructions.size(), 3);
+    EXPECT_EQ(instructions[0].address, 0x1000);
+    EXPECT_EQ(instructions[1].address, 0x1001);
+    EXPECT_EQ(instructions[1].length, 3);
+    EXPECT_EQ(instructions[2].address, 0x1004);
+    EXPECT_EQ(instructions[2].control_flow, x86::ControlFlow::call);
+    EXPECT_EQ(instructions[2].target, 0x1009);
+}
+
+} // namespace